@@ -0,0 +1,62 @@
+#ifndef ZAMT_BATCH_BATCH_H_
+#define ZAMT_BATCH_BATCH_H_
+
+/// Extracts the features of a batch of audio files and quits, for the
+/// zamtbatch target.
+/**
+ * The files are the WAV files of a directory or the lines of a list file
+ * (-in). They are processed several at once by a BatchRunner on the default
+ * pool of the scheduler (see -j), the features of each file can be stored
+ * into a directory (-out). The real-time factor of every file and of the
+ * whole batch is printed at the end.
+ * Only the features of BatchRunner are extracted: the stages of dft_fftw and
+ * pitch_yin take the audio of LiveAudio and are not part of this target.
+ */
+
+#include "zamt/core/CLIParameters.h"
+#include "zamt/core/Module.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zamt {
+
+class BatchRunner;
+class Log;
+
+class Batch : public Module {
+ public:
+  const static char* kModuleLabel;
+  const static char* kInputParamStr;
+  const static char* kOutputParamStr;
+  const static char* kFilesAtOnceParamStr;
+
+  Batch(int argc, const char* const* argv);
+  ~Batch();
+
+  void Initialize(const ModuleCenter* mc);
+
+  /// Returns the paths of the WAV files in a directory or the lines of a
+  /// list file (sorted or in the order of the list), false if unreadable.
+  static bool ListFiles(const char* input, std::vector<std::string>& paths);
+
+ private:
+  void Run();
+  void Shutdown(int exit_code);
+  void PrintHelp();
+
+  CLIParameters cli_;
+  std::unique_ptr<Log> log_;
+  const ModuleCenter* mc_ = nullptr;
+  bool started_ = false;
+  std::vector<std::string> paths_;
+  std::unique_ptr<BatchRunner> runner_;
+  std::unique_ptr<std::thread> thread_;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_BATCH_BATCH_H_
@@ -0,0 +1,102 @@
+#ifndef ZAMT_BATCH_BATCHRUNNER_H_
+#define ZAMT_BATCH_BATCHRUNNER_H_
+
+/// Extracts the features of many audio files at once on one pool of the
+/// scheduler.
+/**
+ * Files are taken by lanes, each is an independent pipeline with its own
+ * source: a thread reading the file into packets of mono samples and an in
+ * order sink on the pool computing a frame of features (level and zero
+ * crossing rate) from each packet, stored into a feature file if an output
+ * directory is given. A lane takes the next file when its sink has
+ * processed every packet of the previous one.
+ * The packets in flight are limited to a budget for the whole pool, shared
+ * equally by the lanes with files (see Scheduler::SetQueueLimit()). When
+ * lanes run out of files at the end, the others get their share, so the
+ * workers stay busy with fewer files.
+ * The time a file took compared to its length is its real-time factor.
+ */
+
+#include "zamt/core/Scheduler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zamt {
+
+class BatchRunner {
+ public:
+  const static int kSamplesPerPacket = 1024;
+  const static int kPacketsPerWorker = 4;  // budget of packets in flight
+  const static int kWaitForSinksInMs = 100;  // then checks for stopping
+  const static int kFeatures = 2;  // level in dBFS, zero crossings / sample
+  const static int kMaxLanes = 64;  // a source each, far below the table
+
+  struct FileResult {
+    std::string path;
+    bool ok = false;
+    int sample_rate = 0;
+    int64_t samples = 0;
+    double audio_seconds = 0.0;
+    double wall_seconds = 0.0;  // from opening until the last feature
+    double real_time_factor() const {
+      return audio_seconds > 0.0 ? wall_seconds / audio_seconds : 0.0;
+    }
+  };
+
+  /// Registers a source for each lane, lanes == 0 means one for each worker
+  /// of the pool, at most kMaxLanes.
+  BatchRunner(Scheduler& scheduler, int lanes = 0,
+              Scheduler::PoolId pool_id = Scheduler::kDefaultPool);
+  ~BatchRunner();
+
+  BatchRunner(const BatchRunner&) = delete;
+  BatchRunner& operator=(const BatchRunner&) = delete;
+
+  /// Processes the files in the lanes, returns after all of them are done
+  /// or Stop() is called. Feature files are named after the audio files.
+  std::vector<FileResult> Run(const std::vector<std::string>& paths,
+                              const std::string& output_dir = "");
+
+  /// Makes Run() return soon, the files not done are not ok.
+  void Stop() { should_run_ = false; }
+
+  int lanes() const { return (int)lanes_.size(); }
+  Scheduler::SourceId GetSourceId(int lane) const;
+  /// Seconds Run() took, for the real-time factor of the whole batch.
+  double wall_seconds() const { return wall_seconds_; }
+
+  /// Returns the feature file of an audio file in output_dir.
+  static std::string GetFeaturePath(const std::string& path,
+                                    const std::string& output_dir);
+
+ private:
+  struct Lane;
+
+  void RunLane(Lane* lane);
+  bool Process(Lane* lane, FileResult& result);
+  // Shares the packet budget among the active lanes.
+  void SpreadPackets();
+  static void ExtractFeatures(Scheduler* scheduler, Lane* lane,
+                              const Scheduler::Byte* packet,
+                              Scheduler::Time timestamp);
+
+  Scheduler& scheduler_;
+  Scheduler::PoolId pool_id_;
+  int packet_budget_;
+  std::vector<std::shared_ptr<Lane>> lanes_;  // shared with the sinks
+  const std::vector<std::string>* paths_ = nullptr;
+  std::vector<FileResult>* results_ = nullptr;
+  std::string output_dir_;
+  std::atomic<int> next_file_{0};
+  std::atomic<int> active_lanes_{0};
+  std::atomic<bool> should_run_{true};
+  double wall_seconds_ = 0.0;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_BATCH_BATCHRUNNER_H_
@@ -0,0 +1,52 @@
+#ifndef ZAMT_BATCH_WAVREADER_H_
+#define ZAMT_BATCH_WAVREADER_H_
+
+/// Reads the samples of a WAV file as mono floats.
+/**
+ * Integer PCM of 16, 24 or 32 bits and 32 bit float samples are read,
+ * also in the extensible format. The channels are averaged, integers are
+ * scaled to [-1, 1).
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace zamt {
+
+class WavReader {
+ public:
+  WavReader() = default;
+  ~WavReader();
+
+  WavReader(const WavReader&) = delete;
+  WavReader& operator=(const WavReader&) = delete;
+
+  /// Returns false if the file is not a WAV file of a supported format.
+  bool Open(const char* path);
+  void Close();
+
+  /// Reads up to max_frames frames, returns how many were read (0 at the
+  /// end of the samples).
+  int Read(float* mono, int max_frames);
+
+  int sample_rate() const { return sample_rate_; }
+  int channels() const { return channels_; }
+  int64_t frames() const { return frames_; }
+
+ private:
+  float GetSample(const uint8_t* sample) const;
+
+  FILE* file_ = nullptr;
+  int sample_rate_ = 0;
+  int channels_ = 0;
+  int bytes_per_sample_ = 0;
+  bool is_float_ = false;
+  int64_t frames_ = 0;
+  int64_t frames_left_ = 0;
+  std::vector<uint8_t> buffer_;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_BATCH_WAVREADER_H_
@@ -0,0 +1,12 @@
+set(module_cpps
+  Batch.cpp
+  BatchRunner.cpp
+  WavReader.cpp
+)
+
+
+# 3rd party configuration
+
+set(module_includes)
+
+set(module_libs)
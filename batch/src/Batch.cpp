@@ -0,0 +1,156 @@
+#include "zamt/batch/Batch.h"
+
+#include "zamt/batch/BatchRunner.h"
+#include "zamt/core/Core.h"
+#include "zamt/core/Log.h"
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/core/Scheduler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace zamt {
+
+const char* Batch::kModuleLabel = "batch";
+const char* Batch::kInputParamStr = "-in";
+const char* Batch::kOutputParamStr = "-out";
+const char* Batch::kFilesAtOnceParamStr = "-files";
+
+ZAMT_MODULE_DEPENDS(Batch, Core);
+
+namespace {
+
+bool IsWavFile(const std::string& name) {
+  if (name.size() < 4) return false;
+  std::string extension = name.substr(name.size() - 4);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](char c) { return (char)tolower(c); });
+  return extension == ".wav";
+}
+
+}  // namespace
+
+Batch::Batch(int argc, const char* const* argv) : cli_(argc, argv) {
+  log_.reset(new Log(kModuleLabel, cli_));
+  if (cli_.HasParam(Core::kHelpParamStr)) {
+    PrintHelp();
+    return;
+  }
+  started_ = true;
+}
+
+Batch::~Batch() {
+  Shutdown(0);
+  if (thread_) thread_->join();
+}
+
+void Batch::Initialize(const ModuleCenter* mc) {
+  mc_ = mc;
+  if (!started_) return;
+  Core& core = mc_->Get<Core>();
+  const char* input = cli_.GetParam(kInputParamStr);
+  if (!input || !ListFiles(input, paths_) || paths_.empty()) {
+    log_->Message(Log::kError, "No audio files in ",
+                  input ? input : "(no input)");
+    core.Quit(Core::kExitCodeBadPipeline);
+    return;
+  }
+#ifndef ZAMT_MODULE_FEATURESTORE
+  if (cli_.GetParam(kOutputParamStr))
+    log_->Message(Log::kWarning, "Features are not stored in this build.");
+#endif
+  int lanes = cli_.GetNumParam(kFilesAtOnceParamStr);
+  if (lanes == CLIParameters::kNotFound) {
+    lanes = core.scheduler().GetNumberOfWorkers(Scheduler::kDefaultPool);
+  } else if (lanes < 1) {
+    log_->Message(Log::kError, "Bad number of files at once: ", lanes);
+    core.Quit(Core::kExitCodeBadPipeline);
+    return;
+  }
+  int max_lanes = BatchRunner::kMaxLanes;
+  if (lanes > max_lanes)
+    log_->Message(Log::kWarning, "At most ", max_lanes, " files at once.");
+  // a lane without files would only hold packets of the budget
+  lanes = std::min(std::min(lanes, max_lanes), (int)paths_.size());
+  runner_.reset(new BatchRunner(core.scheduler(), std::max(1, lanes)));
+  if (runner_->lanes() == 0) {
+    log_->Message(Log::kError, "Cannot register the sources of the files.");
+    core.Quit(Core::kExitCodeBadPipeline);
+    return;
+  }
+  log_->Message(paths_.size(), " files, ", runner_->lanes(), " at once");
+  core.RegisterForQuitEvent(
+      std::bind(&Batch::Shutdown, this, std::placeholders::_1));
+  thread_.reset(new std::thread(&Batch::Run, this));
+}
+
+bool Batch::ListFiles(const char* input, std::vector<std::string>& paths) {
+  struct stat input_stat;
+  if (stat(input, &input_stat) != 0) return false;
+  if (!S_ISDIR(input_stat.st_mode)) {
+    std::ifstream list(input);
+    std::string line;
+    while (std::getline(list, line)) {
+      if (!line.empty()) paths.push_back(line);
+    }
+    return !list.bad();
+  }
+  DIR* dir = opendir(input);
+  if (!dir) return false;
+  std::vector<std::string> found;
+  while (dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (IsWavFile(name)) found.push_back(std::string(input) + "/" + name);
+  }
+  closedir(dir);
+  std::sort(found.begin(), found.end());
+  paths.insert(paths.end(), found.begin(), found.end());
+  return true;
+}
+
+void Batch::Run() {
+  const char* output = cli_.GetParam(kOutputParamStr);
+  auto results = runner_->Run(paths_, output ? output : "");
+  double audio_seconds = 0.0;
+  int failed = 0;
+  char line[512];
+  for (auto& result : results) {
+    if (!result.ok) {
+      snprintf(line, sizeof(line), "%s: failed", result.path.c_str());
+      ++failed;
+    } else {
+      snprintf(line, sizeof(line), "%s: %.1f s audio in %.2f s, RTF %.4f",
+               result.path.c_str(), result.audio_seconds,
+               result.wall_seconds, result.real_time_factor());
+      audio_seconds += result.audio_seconds;
+    }
+    Log::Print(line);
+  }
+  double wall_seconds = runner_->wall_seconds();
+  snprintf(line, sizeof(line),
+           "%d files, %.1f s audio in %.2f s, RTF %.4f, %d failed",
+           (int)results.size(), audio_seconds, wall_seconds,
+           audio_seconds > 0.0 ? wall_seconds / audio_seconds : 0.0, failed);
+  Log::Print(line);
+  mc_->Get<Core>().Quit(failed ? Core::kExitCodeFilesFailed : 0);
+}
+
+void Batch::Shutdown(int /*exit_code*/) {
+  if (runner_) runner_->Stop();
+}
+
+void Batch::PrintHelp() {
+  Log::Print("ZAMT Feature Extraction of Audio Files");
+  Log::Print(" -inPath       Directory of WAV files or a list file of them.");
+#ifdef ZAMT_MODULE_FEATURESTORE
+  Log::Print(" -outDir       Stores the features of the files into Dir.");
+#endif
+  Log::Print(" -filesNum     Files processed at once (default: workers).");
+}
+
+}  // namespace zamt
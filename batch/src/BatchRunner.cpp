@@ -0,0 +1,240 @@
+#include "zamt/batch/BatchRunner.h"
+
+#include "zamt/batch/WavReader.h"
+
+#ifdef ZAMT_MODULE_FEATURESTORE
+#include "zamt/featurestore/FeatureFile.h"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace zamt {
+
+using clock = std::chrono::steady_clock;
+
+namespace {
+
+// Beside every packet, as the last packet of a file is not full.
+struct PacketMetadata {
+  int samples;
+};
+
+double SecondsSince(clock::time_point start) {
+  return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+}  // namespace
+
+struct BatchRunner::Lane {
+  Scheduler::SourceId source_id;
+  Scheduler::SourceHandle source;
+  int subscription_id = -1;
+  WavReader reader;
+  std::vector<float> samples;  // read for the next packet
+
+  std::mutex mtx;  // for the rest, the sink runs on the pool
+  std::condition_variable processed_cv;
+  int64_t packets_processed = 0;
+#ifdef ZAMT_MODULE_FEATURESTORE
+  bool storing = false;
+  FeatureFileWriter writer;
+#endif
+};
+
+BatchRunner::BatchRunner(Scheduler& scheduler, int lanes,
+                         Scheduler::PoolId pool_id)
+    : scheduler_(scheduler), pool_id_(pool_id) {
+  int workers = scheduler.GetNumberOfWorkers(pool_id);
+  if (lanes <= 0) lanes = std::max(1, workers);
+  if (lanes > kMaxLanes) lanes = kMaxLanes;
+  // at least two packets a lane: one is read while the other is analysed
+  packet_budget_ = std::max(workers * kPacketsPerWorker, 2 * lanes);
+  for (int i = 0; i < lanes; ++i) {
+    auto lane = std::make_shared<Lane>();
+    lane->source_id = scheduler.AllocateSourceId();
+    lane->source = scheduler.RegisterSource(
+        lane->source_id, kSamplesPerPacket * (int)sizeof(float),
+        packet_budget_, (int)sizeof(PacketMetadata));
+    if (!lane->source.valid()) break;  // the table is full
+    lane->samples.resize(kSamplesPerPacket);
+    Scheduler* scheduler_ptr = &scheduler;
+    std::shared_ptr<Lane> shared_lane = lane;
+    scheduler.SubscribeInOrder(
+        lane->source_id,
+        [scheduler_ptr, shared_lane](Scheduler::SourceId,
+                                     const Scheduler::Byte* packet,
+                                     Scheduler::Time timestamp) {
+          ExtractFeatures(scheduler_ptr, shared_lane.get(), packet,
+                          timestamp);
+        },
+        lane->subscription_id, pool_id);
+    lanes_.push_back(std::move(lane));
+  }
+}
+
+BatchRunner::~BatchRunner() {
+  for (auto& lane : lanes_)
+    scheduler_.Unsubscribe(lane->source_id, lane->subscription_id);
+}
+
+Scheduler::SourceId BatchRunner::GetSourceId(int lane) const {
+  return lanes_[(size_t)lane]->source_id;
+}
+
+std::string BatchRunner::GetFeaturePath(const std::string& path,
+                                        const std::string& output_dir) {
+  size_t slash = path.find_last_of('/');
+  std::string name =
+      slash == std::string::npos ? path : path.substr(slash + 1);
+  size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos && dot > 0) name.resize(dot);
+  return output_dir + "/" + name + ".zfs";
+}
+
+std::vector<BatchRunner::FileResult> BatchRunner::Run(
+    const std::vector<std::string>& paths, const std::string& output_dir) {
+  std::vector<FileResult> results(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) results[i].path = paths[i];
+  paths_ = &paths;
+  results_ = &results;
+  output_dir_ = output_dir;
+  next_file_ = 0;
+  int lanes = (int)std::min(lanes_.size(), paths.size());
+  active_lanes_ = lanes;
+  SpreadPackets();
+
+  clock::time_point start = clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < lanes; ++i)
+    threads.emplace_back(&BatchRunner::RunLane, this, lanes_[(size_t)i].get());
+  for (auto& thread : threads) thread.join();
+  wall_seconds_ = SecondsSince(start);
+  paths_ = nullptr;
+  results_ = nullptr;
+  return results;
+}
+
+void BatchRunner::RunLane(Lane* lane) {
+  for (;;) {
+    int file = next_file_++;
+    if (file >= (int)paths_->size() || !should_run_) break;
+    FileResult& result = (*results_)[(size_t)file];
+    clock::time_point start = clock::now();
+    result.ok = Process(lane, result);
+    result.wall_seconds = SecondsSince(start);
+  }
+  // the remaining lanes can have more packets in flight
+  active_lanes_--;
+  SpreadPackets();
+}
+
+bool BatchRunner::Process(Lane* lane, FileResult& result) {
+  WavReader& reader = lane->reader;
+  if (!reader.Open(result.path.c_str())) return false;
+  result.sample_rate = reader.sample_rate();
+  result.audio_seconds = (double)reader.frames() / reader.sample_rate();
+  bool ok = true;
+#ifdef ZAMT_MODULE_FEATURESTORE
+  if (!output_dir_.empty()) {
+    std::lock_guard<std::mutex> lock(lane->mtx);
+    std::string path = GetFeaturePath(result.path, output_dir_);
+    lane->storing = lane->writer.Open(
+        path.c_str(), kFeatures * (int)sizeof(float), true);
+    ok = lane->storing;
+  }
+#endif
+  int64_t submitted = 0;
+  {
+    std::lock_guard<std::mutex> lock(lane->mtx);
+    lane->packets_processed = 0;
+  }
+  double usec_per_sample = 1e6 / reader.sample_rate();
+  while (ok) {
+    int samples = reader.Read(lane->samples.data(), kSamplesPerPacket);
+    if (samples == 0) break;
+    Scheduler::Byte* packet;
+    while (!(packet = scheduler_.WaitForPacketForSubmission(
+                 lane->source, kWaitForSinksInMs))) {
+      if (!should_run_) break;
+    }
+    if (!packet) {
+      ok = false;
+      break;
+    }
+    std::copy(lane->samples.begin(), lane->samples.begin() + samples,
+              reinterpret_cast<float*>(packet));
+    reinterpret_cast<PacketMetadata*>(
+        scheduler_.GetPacketMetadata(lane->source, packet))
+        ->samples = samples;
+    auto timestamp = (Scheduler::Time)std::llround(
+        (double)result.samples * usec_per_sample);
+    scheduler_.SubmitPacket(lane->source, packet, timestamp);
+    result.samples += samples;
+    ++submitted;
+  }
+  reader.Close();
+
+  // the file is done when its last feature is
+  std::unique_lock<std::mutex> lock(lane->mtx);
+  while (lane->packets_processed != submitted) {
+    if (!should_run_) {
+      ok = false;
+      break;
+    }
+    int timeout_in_ms = kWaitForSinksInMs;
+    lane->processed_cv.wait_for(lock,
+                                std::chrono::milliseconds(timeout_in_ms));
+  }
+#ifdef ZAMT_MODULE_FEATURESTORE
+  if (lane->storing) {
+    lane->storing = false;
+    if (!lane->writer.Close()) ok = false;
+  }
+#endif
+  return ok;
+}
+
+void BatchRunner::SpreadPackets() {
+  int limit = packet_budget_ / std::max(1, active_lanes_.load());
+  for (auto& lane : lanes_) scheduler_.SetQueueLimit(lane->source, limit);
+}
+
+void BatchRunner::ExtractFeatures(Scheduler* scheduler, Lane* lane,
+                                  const Scheduler::Byte* packet,
+                                  Scheduler::Time timestamp) {
+  auto samples = reinterpret_cast<const float*>(packet);
+  int count = reinterpret_cast<const PacketMetadata*>(
+                  scheduler->GetPacketMetadata(lane->source, packet))
+                  ->samples;
+  float energy = 0.0f;
+  int crossings = 0;
+  for (int i = 0; i < count; ++i) {
+    energy += samples[i] * samples[i];
+    if (i > 0 && (samples[i - 1] < 0.0f) != (samples[i] < 0.0f)) ++crossings;
+  }
+  float features[kFeatures] = {
+      10.0f * std::log10(energy / (float)std::max(1, count) + 1e-10f),
+      (float)crossings / (float)std::max(1, count)};
+  scheduler->ReleasePacket(lane->source, packet);
+
+  std::lock_guard<std::mutex> lock(lane->mtx);
+#ifdef ZAMT_MODULE_FEATURESTORE
+  if (lane->storing) {
+    lane->writer.Append(timestamp,
+                        reinterpret_cast<const Scheduler::Byte*>(features));
+  }
+#else
+  (void)timestamp;
+  (void)features;
+#endif
+  lane->packets_processed++;
+  lane->processed_cv.notify_one();
+}
+
+}  // namespace zamt
@@ -0,0 +1,115 @@
+#include "zamt/batch/WavReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace zamt {
+
+namespace {
+
+const int kFormatPCM = 1;
+const int kFormatFloat = 3;
+const int kFormatExtensible = 0xFFFE;
+
+uint32_t GetU16(const uint8_t* bytes) {
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8;
+}
+
+uint32_t GetU32(const uint8_t* bytes) {
+  return GetU16(bytes) | GetU16(bytes + 2) << 16;
+}
+
+}  // namespace
+
+WavReader::~WavReader() { Close(); }
+
+bool WavReader::Open(const char* path) {
+  Close();
+  file_ = fopen(path, "rb");
+  if (!file_) return false;
+  uint8_t riff[12];
+  if (fread(riff, 1, sizeof(riff), file_) != sizeof(riff) ||
+      memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+    Close();
+    return false;
+  }
+  // chunks until the samples, the format comes first
+  bool has_format = false;
+  for (;;) {
+    uint8_t chunk[8];
+    if (fread(chunk, 1, sizeof(chunk), file_) != sizeof(chunk)) break;
+    long size = (long)GetU32(chunk + 4);
+    if (!memcmp(chunk, "fmt ", 4) && size >= 16 && size <= 64) {
+      uint8_t format[64];
+      if (fread(format, 1, (size_t)size, file_) != (size_t)size) break;
+      int tag = (int)GetU16(format);
+      // the subformat starts with the tag
+      if (tag == kFormatExtensible && size >= 26)
+        tag = (int)GetU16(format + 24);
+      channels_ = (int)GetU16(format + 2);
+      sample_rate_ = (int)GetU32(format + 4);
+      int bits = (int)GetU16(format + 14);
+      bytes_per_sample_ = bits / 8;
+      is_float_ = tag == kFormatFloat;
+      has_format =
+          channels_ > 0 && sample_rate_ > 0 && bits % 8 == 0 &&
+          ((tag == kFormatPCM && bits >= 16 && bits <= 32) ||
+           (is_float_ && bits == 32));
+      if (size % 2) fseek(file_, 1, SEEK_CUR);
+    } else if (!memcmp(chunk, "data", 4)) {
+      if (!has_format) break;
+      frames_ = size / (channels_ * bytes_per_sample_);
+      frames_left_ = frames_;
+      return true;
+    } else if (fseek(file_, size + size % 2, SEEK_CUR) != 0) {
+      break;
+    }
+  }
+  Close();
+  return false;
+}
+
+void WavReader::Close() {
+  if (file_) fclose(file_);
+  file_ = nullptr;
+  frames_ = 0;
+  frames_left_ = 0;
+}
+
+int WavReader::Read(float* mono, int max_frames) {
+  if (!file_ || frames_left_ == 0) return 0;
+  int frame_size = channels_ * bytes_per_sample_;
+  int frames = (int)std::min<int64_t>(max_frames, frames_left_);
+  buffer_.resize((size_t)(frames * frame_size));
+  frames = (int)(fread(buffer_.data(), (size_t)frame_size, (size_t)frames,
+                       file_));
+  // a cut file ends here
+  frames_left_ = frames ? frames_left_ - frames : 0;
+  float scale = 1.0f / (float)channels_;
+  const uint8_t* sample = buffer_.data();
+  for (int i = 0; i < frames; ++i) {
+    float sum = 0.0f;
+    for (int c = 0; c < channels_; ++c) {
+      sum += GetSample(sample);
+      sample += bytes_per_sample_;
+    }
+    mono[i] = sum * scale;
+  }
+  return frames;
+}
+
+float WavReader::GetSample(const uint8_t* sample) const {
+  if (is_float_) {
+    uint32_t bits = GetU32(sample);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+  // the most significant bytes into a 32 bit integer
+  uint32_t bits = 0;
+  for (int i = 0; i < bytes_per_sample_; ++i)
+    bits |= (uint32_t)sample[i] << (8 * (4 - bytes_per_sample_ + i));
+  return (float)(int32_t)bits * (1.0f / 2147483648.0f);
+}
+
+}  // namespace zamt
@@ -0,0 +1,98 @@
+#include "zamt/batch/BatchRunner.h"
+#include "zamt/core/TestSuite.h"
+#include "zamt/featurestore/FeatureFile.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace zamt;
+
+static const char* kOutputDir = "BatchRunnerTest.out";
+static const int kSampleRate = 8000;
+
+void PutU16(FILE* file, uint32_t value) {
+  fputc((int)(value & 0xFF), file);
+  fputc((int)(value >> 8 & 0xFF), file);
+}
+
+void PutU32(FILE* file, uint32_t value) {
+  PutU16(file, value & 0xFFFF);
+  PutU16(file, value >> 16);
+}
+
+// Writes a mono file of 16 bit samples at half of the full scale.
+void WriteWav(const std::string& path, int samples) {
+  FILE* file = fopen(path.c_str(), "wb");
+  ASSERT(file);
+  fwrite("RIFF", 1, 4, file);
+  PutU32(file, 36 + 2 * (uint32_t)samples);
+  fwrite("WAVEfmt ", 1, 8, file);
+  PutU32(file, 16);
+  PutU16(file, 1);
+  PutU16(file, 1);
+  PutU32(file, kSampleRate);
+  PutU32(file, 2 * kSampleRate);
+  PutU16(file, 2);
+  PutU16(file, 16);
+  fwrite("data", 1, 4, file);
+  PutU32(file, 2 * (uint32_t)samples);
+  for (int i = 0; i < samples; ++i) PutU16(file, 16384);
+  fclose(file);
+}
+
+void FilesAreAnalysedInLanes() {
+  const int lengths[] = {5000, 2048, 100, 30000, 1};
+  const int files = sizeof(lengths) / sizeof(lengths[0]);
+  mkdir(kOutputDir, 0755);
+  std::vector<std::string> paths;
+  for (int i = 0; i < files; ++i) {
+    paths.push_back("BatchRunnerTest" + std::to_string(i) + ".wav");
+    WriteWav(paths.back(), lengths[i]);
+  }
+  paths.push_back("NoSuchFile.wav");
+
+  Scheduler sch(2);
+  BatchRunner runner(sch, 2);
+  ASSERT(runner.lanes() == 2);
+  EXPECT(runner.GetSourceId(0) != runner.GetSourceId(1));
+  auto results = runner.Run(paths, kOutputDir);
+  ASSERT(results.size() == paths.size());
+  EXPECT(!results.back().ok);
+  for (int i = 0; i < files; ++i) {
+    const BatchRunner::FileResult& result = results[(size_t)i];
+    EXPECT(result.ok);
+    EXPECT(result.samples == lengths[i]);
+    EXPECT(result.audio_seconds == (double)lengths[i] / kSampleRate);
+
+    std::string path = BatchRunner::GetFeaturePath(paths[(size_t)i],
+                                                   kOutputDir);
+    FeatureFileReader reader;
+    ASSERT(reader.Open(path.c_str()));
+    int packets = (lengths[i] + BatchRunner::kSamplesPerPacket - 1) /
+                  BatchRunner::kSamplesPerPacket;
+    ASSERT(reader.rows() == packets);
+    for (int64_t row = 0; row < packets; ++row) {
+      EXPECT(reader.timestamp(row) ==
+             (Scheduler::Time)row * BatchRunner::kSamplesPerPacket * 1000000 /
+                 kSampleRate);
+      auto features = reinterpret_cast<const float*>(reader.row(row));
+      EXPECT(std::fabs(features[0] - 20.0f * std::log10(0.5f)) < 0.01f);
+      EXPECT(features[1] == 0.0f);
+    }
+    reader.Close();
+    remove(path.c_str());
+    remove(paths[(size_t)i].c_str());
+  }
+  EXPECT(runner.wall_seconds() > 0.0);
+  sch.Shutdown();
+  rmdir(kOutputDir);
+}
+
+TEST_BEGIN() {
+  FilesAreAnalysedInLanes();
+}
+TEST_END()
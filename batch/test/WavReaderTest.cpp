@@ -0,0 +1,115 @@
+#include "zamt/batch/WavReader.h"
+#include "zamt/core/TestSuite.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace zamt;
+
+static const char* kPath = "WavReaderTest.wav";
+
+void PutU16(FILE* file, uint32_t value) {
+  fputc((int)(value & 0xFF), file);
+  fputc((int)(value >> 8 & 0xFF), file);
+}
+
+void PutU32(FILE* file, uint32_t value) {
+  PutU16(file, value & 0xFFFF);
+  PutU16(file, value >> 16);
+}
+
+// Writes the header of a file with an extra chunk before the samples.
+void WriteHeader(FILE* file, int format, int channels, int bits,
+                 uint32_t frames) {
+  uint32_t data_size = frames * (uint32_t)(channels * bits / 8);
+  fwrite("RIFF", 1, 4, file);
+  PutU32(file, 4 + 24 + 10 + 8 + data_size);
+  fwrite("WAVE", 1, 4, file);
+  fwrite("fmt ", 1, 4, file);
+  PutU32(file, 16);
+  PutU16(file, (uint32_t)format);
+  PutU16(file, (uint32_t)channels);
+  PutU32(file, 8000);
+  PutU32(file, 8000 * (uint32_t)(channels * bits / 8));
+  PutU16(file, (uint32_t)(channels * bits / 8));
+  PutU16(file, (uint32_t)bits);
+  fwrite("LIST", 1, 4, file);
+  PutU32(file, 2);
+  PutU16(file, 0);
+  fwrite("data", 1, 4, file);
+  PutU32(file, data_size);
+}
+
+void StereoIntegersAreAveraged() {
+  FILE* file = fopen(kPath, "wb");
+  ASSERT(file);
+  const int frames = 3;
+  WriteHeader(file, 1, 2, 16, frames);
+  const int16_t samples[frames * 2] = {16384, 0, -32768, -32768, 100, -100};
+  for (int16_t sample : samples) PutU16(file, (uint16_t)sample);
+  fclose(file);
+
+  WavReader reader;
+  ASSERT(reader.Open(kPath));
+  EXPECT(reader.sample_rate() == 8000);
+  EXPECT(reader.channels() == 2);
+  EXPECT(reader.frames() == frames);
+  float mono[4];
+  EXPECT(reader.Read(mono, 2) == 2);
+  EXPECT(mono[0] == 0.25f);
+  EXPECT(mono[1] == -1.0f);
+  EXPECT(reader.Read(mono, 4) == 1);
+  EXPECT(mono[0] == 0.0f);
+  EXPECT(reader.Read(mono, 4) == 0);
+  reader.Close();
+  remove(kPath);
+}
+
+void FloatsAreRead() {
+  FILE* file = fopen(kPath, "wb");
+  ASSERT(file);
+  const int frames = 100;
+  WriteHeader(file, 3, 1, 32, frames);
+  for (int i = 0; i < frames; ++i) {
+    float sample = std::sin((float)i);
+    uint32_t bits;
+    memcpy(&bits, &sample, sizeof(bits));
+    PutU32(file, bits);
+  }
+  fclose(file);
+
+  WavReader reader;
+  ASSERT(reader.Open(kPath));
+  std::vector<float> mono(frames);
+  ASSERT(reader.Read(mono.data(), frames) == frames);
+  for (int i = 0; i < frames; ++i)
+    EXPECT(mono[(size_t)i] == std::sin((float)i));
+  reader.Close();
+  remove(kPath);
+}
+
+void OnlyWavFilesAreOpened() {
+  WavReader reader;
+  EXPECT(!reader.Open("NoSuchFile.wav"));
+  FILE* file = fopen(kPath, "wb");
+  ASSERT(file);
+  fputs("This is not a WAV file at all.", file);
+  fclose(file);
+  EXPECT(!reader.Open(kPath));
+  // 8 bit samples are not supported
+  file = fopen(kPath, "wb");
+  ASSERT(file);
+  WriteHeader(file, 1, 1, 8, 0);
+  fclose(file);
+  EXPECT(!reader.Open(kPath));
+  remove(kPath);
+}
+
+TEST_BEGIN() {
+  StereoIntegersAreAveraged();
+  FloatsAreRead();
+  OnlyWavFilesAreOpened();
+}
+TEST_END()
@@ -0,0 +1,17 @@
+set(this_module batch)
+
+
+set(other_modules
+  core
+  featurestore
+)
+
+set(test_cpps
+  WavReaderTest.cpp
+)
+AddTest(WavReaderTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  BatchRunnerTest.cpp
+)
+AddTest(BatchRunnerTest ${this_module} "${other_modules}" "${test_cpps}")
@@ -8,9 +8,10 @@ CMAKE_PROJECT="Ninja"
 
 BUILD_DEPS="cmake ninja-build binutils g++ llvm-dev clang clang-format"
 PULSEAUDIO_DEPS="libpulse-dev"
+ALSA_DEPS="libasound2-dev"
 GTKMM_DEPS="libgtkmm-3.0-dev"
 
-ALL_DEPS="$BUILD_DEPS $PULSEAUDIO_DEPS $GTKMM_DEPS"
+ALL_DEPS="$BUILD_DEPS $PULSEAUDIO_DEPS $ALSA_DEPS $GTKMM_DEPS"
 KEEPGOING=1
 USEASAN=ON
 
@@ -20,7 +20,7 @@ function(GetLibForTests used_modules)
 endfunction(GetLibForTests)
 
 function(AddTest test_name test_module other_modules test_sources)
-  set(used_modules ${test_module} ${other_nodules})
+  set(used_modules ${test_module} ${other_modules})
   GetLibForTests("${used_modules}")
   unset(cpp_sources)
   foreach(cpp ${test_sources})
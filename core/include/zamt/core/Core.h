@@ -5,6 +5,7 @@
 
 #include "zamt/core/CLIParameters.h"
 #include "zamt/core/Module.h"
+#include "zamt/core/PipelineConfig.h"
 
 #include <atomic>
 #include <condition_variable>
@@ -25,11 +26,16 @@ class Core : public Module {
   const static int kExitCodeHelp = 100;
   const static int kExitCodeSIGTERM = 101;
   const static int kExitCodeSIGINT = 102;
+  const static int kExitCodeBadPipeline = 103;
+  const static int kExitCodeFilesFailed = 104;
   const static int kExitCodeAudioProblem = 200;
 
   const static char* kModuleLabel;
   const static char* kHelpParamStr;
   const static char* kThreadsParamStr;
+  const static char* kPipelineParamStr;
+  /// Pipeline stages of this type are worker pools of the scheduler.
+  const static char* kPoolStageType;
 
 #ifdef TEST
   /// For testing purposes, simulate if the process only starts now
@@ -46,19 +52,24 @@ class Core : public Module {
   /// Blocks execution until someone calls Quit(), returns the exit code.
   int WaitForQuit();
   /// The given function is called immediately when quit is called before
-  /// core thread starts the shutdown process. Objects should not rely on
-  /// other objects existence after this point.
+  /// core thread starts the shutdown process, or at once if quit was called
+  /// already. Objects should not rely on other objects existence after this
+  /// point.
   void RegisterForQuitEvent(OnQuitCallback on_quit_callback);
 
   /// Get CLIParameters
   CLIParameters& cli() { return cli_; }
   /// Get the main Scheduler working in the system
   Scheduler& scheduler();
+  /// Get the pipeline loaded at startup, empty if none was given
+  const PipelineConfig& pipeline() const { return pipeline_; }
 
  private:
   const static int kNoExitCode = -999999;
 
   void PrintHelp();
+  // Returns false if a pool of the pipeline cannot be started.
+  bool AddPools();
 
   // These are system wide and shut every instance down in the current process.
   static std::atomic<int> exit_code_;
@@ -69,7 +80,10 @@ class Core : public Module {
   std::unique_ptr<Log> log_;
   CLIParameters cli_;
   std::unique_ptr<Scheduler> scheduler_;
+  PipelineConfig pipeline_;
+  std::mutex quit_callbacks_mutex_;  // modules initialize concurrently
   std::deque<OnQuitCallback> on_quit_callbacks_;
+  int quit_exit_code_ = kNoExitCode;  // guarded by quit_callbacks_mutex_
 };
 
 }  // namespace zamt
@@ -3,9 +3,20 @@
 
 #include "zamt/core/CLIParameters.h"
 
+#include <cstdio>
 #include <sstream>
 #include <string>
 /// Very simple handling of output to console.
+/**
+ * Logging never formats or prints on the calling thread: every thread puts
+ * its records into its own lock-free ring and a background thread formats
+ * and writes them in batches. A record keeps the raw number with a copy of
+ * the message and suffix (truncated to kMaxTextLength together), so any
+ * string can be logged without formatting. If the ring of a thread is full
+ * the record is dropped and counted.
+ * The same message is written at most kMaxRepeatsPerSecond times a second
+ * per Log label, the rest are counted and summarized.
+ */
 
 namespace zamt {
 
@@ -24,31 +35,65 @@ void stringify(std::ostream& stream, Arg&& arg, Args&&... args) {
 
 class Log {
  public:
+  enum Level { kError, kWarning, kInfo, kDebug };
+
   const static char* kVerboseParamStr;
+  const static char* kDebugParamStr;
+  const static int kMaxLabelLength = 32;
+  const static int kMaxTextLength = 120;
+  const static int kMaxRepeatsPerSecond = 10;
 
-  /// Label is prefixed to every log message. Set verbose mode.
+  /// Label is prefixed to every log message. Set verbose mode: warnings and
+  /// errors are logged by default, info with -v, debug with -vv.
   Log(const char* label, const CLIParameters& cli);
 
-  /// Unconditionally print message to console.
+  /// Unconditionally print message to console, after the pending logs.
   static void Print(const char* messa);
   /// Print help for verbose handling.
   static void PrintHelp4Verbose();
+  /// Wait until everything logged so far is written.
+  static void Flush();
+
+  bool IsEnabled(Level level) const { return level <= level_; }
+
+  /// Log info only if verbose mode is on, output message in nice log format.
+  void LogMessage(const char* msg) { LogMessage(kInfo, msg); }
+  void LogMessage(const char* msg, int num, const char* suffix = "") {
+    LogMessage(kInfo, msg, num, suffix);
+  }
+  void LogMessage(const char* msg, float num, const char* suffix = "") {
+    LogMessage(kInfo, msg, num, suffix);
+  }
 
-  /// Log only if verbose mode is on, output message in nice log format.
-  void LogMessage(const char* msg);
-  void LogMessage(const char* msg, int num, const char* suffix = "");
-  void LogMessage(const char* msg, float num, const char* suffix = "");
+  /// Log on the given level.
+  void LogMessage(Level level, const char* msg);
+  void LogMessage(Level level, const char* msg, int num,
+                  const char* suffix = "");
+  void LogMessage(Level level, const char* msg, float num,
+                  const char* suffix = "");
 
+  /// Formats on the calling thread, keep it off the hot paths.
   template <typename... Args>
-  void Message(Args&&... args) {
+  void Message(Level level, Args&&... args) {
+    if (!IsEnabled(level)) return;
     std::ostringstream stream;
     internal::stringify(stream, std::forward<Args>(args)...);
-    LogMessage(stream.str().c_str());
+    LogMessage(level, stream.str().c_str());
   }
 
+  template <typename... Args>
+  void Message(Args&&... args) {
+    Message(kInfo, std::forward<Args>(args)...);
+  }
+
+#ifdef TEST
+  /// Redirect the output, nullptr means stdout.
+  static void SetOutputForTest(FILE* output);
+#endif
+
  private:
-  const char* label_;
-  bool verbose_;
+  char label_[kMaxLabelLength];
+  Level level_;
 };
 
 }  // namespace zamt
@@ -13,6 +13,12 @@ class Module {
   Module(/*int argc, const char* const* argv*/) {}
   ~Module() {}
   void Initialize(const ModuleCenter*) {}
+  /// Called after all modules are initialized, so all sources are
+  /// registered: sinks of sources of other modules subscribe here.
+  void Connect(const ModuleCenter*) {}
+  /// Called after all modules are connected: sources which should not
+  /// submit before their sinks subscribed (e.g. replays) start here.
+  void Start(const ModuleCenter*) {}
 
   Module(const Module&) = delete;
   Module(Module&&) = delete;
@@ -9,10 +9,9 @@ namespace zamt {
 
 template <class ModuleClass>
 ModuleClass& ModuleCenter::Get() const {
-  size_t key = ModuleStub<ModuleClass>::GetId();
-  auto instanceIter = module_instances_.find(key);
-  assert(instanceIter != module_instances_.end());
-  return *static_cast<ModuleClass*>(instanceIter->second);
+  int index = ModuleStub<ModuleClass>::bootstrap_.index;
+  assert(index >= 0 && index < (int)module_instances_.size());
+  return *static_cast<ModuleClass*>(module_instances_[index]);
 }
 
 template <class ModuleClass>
@@ -20,13 +19,23 @@ size_t ModuleCenter::GetId() {
   return ModuleStub<ModuleClass>::GetId();
 }
 
+template <class ModuleClass, class... DependsOn>
+ModuleCenter::Dependencies<ModuleClass, DependsOn...>::Dependencies() {
+  size_t depends_on_keys[] = {ModuleStub<DependsOn>::GetId()...};
+  for (size_t depends_on_key : depends_on_keys)
+    AddDependency(ModuleStub<ModuleClass>::GetId(), depends_on_key);
+}
+
 template <class ModuleClass>
-ModuleCenter::ModuleBootstrap<ModuleClass>::ModuleBootstrap() : dummy(0) {
+ModuleCenter::ModuleBootstrap<ModuleClass>::ModuleBootstrap()
+    : index(module_num_) {
   assert(module_num_ < kMaxModulesNum);
   ModuleInitRecord& rec = module_inits_[module_num_];
   rec.key = ModuleStub<ModuleClass>::GetId();
   rec.create_function = &ModuleStub<ModuleClass>::Create;
   rec.init_function = &ModuleStub<ModuleClass>::Init;
+  rec.connect_function = &ModuleStub<ModuleClass>::Connect;
+  rec.start_function = &ModuleStub<ModuleClass>::Start;
   rec.destroy_function = &ModuleStub<ModuleClass>::Destroy;
   ++module_num_;
 }
@@ -48,6 +57,18 @@ void ModuleCenter::ModuleStub<ModuleClass>::Init(
   static_cast<ModuleClass*>(module)->Initialize(module_center);
 }
 
+template <class ModuleClass>
+void ModuleCenter::ModuleStub<ModuleClass>::Connect(
+    const ModuleCenter* module_center, Module* module) {
+  static_cast<ModuleClass*>(module)->Connect(module_center);
+}
+
+template <class ModuleClass>
+void ModuleCenter::ModuleStub<ModuleClass>::Start(
+    const ModuleCenter* module_center, Module* module) {
+  static_cast<ModuleClass*>(module)->Start(module_center);
+}
+
 template <class ModuleClass>
 void ModuleCenter::ModuleStub<ModuleClass>::Destroy(Module* instance) {
   delete static_cast<ModuleClass*>(instance);
@@ -9,15 +9,28 @@
  * the same life cycle as this object.
  * These instances can be accessed through this object.
  * Initialization is done in two stages propagating ModuleCenter in 2nd stage.
+ * Modules declare what they use with ZAMT_MODULE_DEPENDS so a module is
+ * created and initialized only after its dependencies, independent modules
+ * concurrently on a startup thread pool. Then all modules are connected and
+ * then started the same way (see Module), so sources named in a pipeline are
+ * found whichever module registers them. Each pass ends for all modules
+ * before the next one begins. Destruction is done in reverse.
  *
  * A module's presence can be detected by the symbol defined
  * ZAMT_MODULE_<uppercase module name>
  */
 
 #include <cstddef>
-#include <map>
+#include <functional>
+#include <vector>
 #include "zamt/core/Module.h"
 
+/// Declares in a module's .cpp that ModuleClass uses the listed modules.
+/// E.g. ZAMT_MODULE_DEPENDS(FourierTransform, Core, LiveAudio);
+#define ZAMT_MODULE_DEPENDS(ModuleClass, ...)                               \
+  static const ::zamt::ModuleCenter::Dependencies<ModuleClass, __VA_ARGS__> \
+      zamt_module_depends_##ModuleClass
+
 namespace zamt {
 
 class ModuleCenter {
@@ -39,6 +52,12 @@ class ModuleCenter {
   template <class ModuleClass>
   static size_t GetId();
 
+  /// Use through ZAMT_MODULE_DEPENDS
+  template <class ModuleClass, class... DependsOn>
+  struct Dependencies {
+    Dependencies();
+  };
+
 #ifdef TEST
   static int GetRegisteredModuleNumber() { return module_num_; }
 #endif
@@ -47,7 +66,7 @@ class ModuleCenter {
   template <class ModuleClass>
   struct ModuleBootstrap {
     ModuleBootstrap();
-    int dummy;
+    int index;  // to module_inits_ and module_instances_
   };
 
   template <class ModuleClass>
@@ -55,6 +74,8 @@ class ModuleCenter {
     static size_t GetId();
     static Module* Create(int argc, const char* const* argv);
     static void Init(const ModuleCenter* module_center, Module* module);
+    static void Connect(const ModuleCenter* module_center, Module* module);
+    static void Start(const ModuleCenter* module_center, Module* module);
     static void Destroy(Module* instance);
     static ModuleBootstrap<ModuleClass> bootstrap_;
   };
@@ -63,15 +84,40 @@ class ModuleCenter {
     size_t key;
     Module* (*create_function)(int argc, const char* const* argv);
     void (*init_function)(const ModuleCenter*, Module*);
+    void (*connect_function)(const ModuleCenter*, Module*);
+    void (*start_function)(const ModuleCenter*, Module*);
     void (*destroy_function)(Module*);
   };
 
+  struct DependencyRecord {
+    size_t key;
+    size_t depends_on_key;
+  };
+
+  using Dependents = std::vector<std::vector<int>>;
+
   static const int kMaxModulesNum = 64;
+  static const int kMaxDependenciesNum = 4 * kMaxModulesNum;
+
+  static int FindModule(size_t key);
+  static void AddDependency(size_t key, size_t depends_on_key);
+  // Module indices listing the modules depending on each.
+  static Dependents GetDependents();
+  // Returns how many modules wait for a dependency cycle, 0 if none.
+  static int CountModulesInCycles(const Dependents& dependents);
+  // Calls step for all modules, each only after the ones it depends on.
+  // Appends the order of completion to finished if given.
+  static void RunInDependencyOrder(const Dependents& dependents,
+                                   const std::function<void(int)>& step,
+                                   std::vector<int>* finished);
 
   static int module_num_;
   static ModuleInitRecord module_inits_[kMaxModulesNum];
+  static int dependency_num_;
+  static DependencyRecord dependencies_[kMaxDependenciesNum];
 
-  std::map<size_t, Module*> module_instances_;
+  std::vector<Module*> module_instances_;  // indexed as module_inits_
+  std::vector<int> creation_order_;
 };
 
 }  // namespace zamt
@@ -0,0 +1,55 @@
+#ifndef ZAMT_CORE_PIPELINECONFIG_H_
+#define ZAMT_CORE_PIPELINECONFIG_H_
+
+/// Description of the processing stages to set up at startup.
+/**
+ * The file has one stage on each line: its type, a unique name and
+ * parameters as key=value pairs. Text after '#' is a comment, e.g.
+ *
+ *   pool analysis threads=2
+ *   fft spectrum input=LiveAudio size=2048 queue=16 pool=analysis
+ *   fft onsets input=LiveAudio size=256
+ *
+ * Modules look up the stages of their type and connect them to the sources
+ * named by the parameters (see Scheduler::SetSourceName()), so several
+ * differently sized pipelines can run in one process and be changed without
+ * recompiling. Keys are defined by the modules.
+ */
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace zamt {
+
+class PipelineConfig {
+ public:
+  struct Stage {
+    /// Returns the value of key or nullptr if it is not given.
+    const char* GetParam(const char* key) const;
+    /// Returns the value of key as a number or default_value if not given.
+    int GetNumParam(const char* key, int default_value) const;
+
+    std::string type;
+    std::string name;
+    std::map<std::string, std::string> params;
+  };
+
+  /// Reads a file, returns false with the number of the bad line
+  /// (0 if the file cannot be read). Earlier stages are kept.
+  bool Load(const char* path, int& error_line);
+  bool Parse(std::istream& input, int& error_line);
+
+  /// Stages of the given type in the order of the file.
+  std::vector<const Stage*> GetStages(const char* type) const;
+
+  const std::vector<Stage>& stages() const { return stages_; }
+
+ private:
+  std::vector<Stage> stages_;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_CORE_PIPELINECONFIG_H_
@@ -0,0 +1,56 @@
+#ifndef ZAMT_CORE_QUEUETUNER_H_
+#define ZAMT_CORE_QUEUETUNER_H_
+
+/// Tunes the usable queue length of a scheduler source at runtime.
+/**
+ * A live source can not wait for its sinks, data is lost when no packet is
+ * free. A long queue survives load peaks of the sinks but adds latency when
+ * they fall behind. The tuner trades latency for throughput only while it
+ * is needed: the limit grows after overruns or sustained high occupancy,
+ * and shrinks back step by step down to a short queue when it is mostly
+ * idle. A safe start limit avoids losses before the load is known.
+ * Decisions are reported through the log.
+ * Packet size is fixed per source, so only the number of packets is tuned.
+ */
+
+#include "zamt/core/Scheduler.h"
+
+namespace zamt {
+
+class Log;
+
+class QueueTuner {
+ public:
+  const static int kHighOccupancyPercent = 75;
+  const static int kLowOccupancyPercent = 25;
+  const static int kIdlePeriodsBeforeShrink = 5;
+
+  /// Sets the queue limit of the source to start_limit, or to min_limit if
+  /// that is higher. Statistics are evaluated once in every period (in
+  /// microseconds).
+  QueueTuner(Scheduler* scheduler, Scheduler::SourceId source_id,
+             int min_limit, Scheduler::Time period, Log* log,
+             int start_limit = 0);
+
+  /// Call regularly from the source thread. Returns true if limit changed.
+  bool Update(Scheduler::Time now);
+
+  int limit() const { return limit_; }
+
+ private:
+  void ChangeLimit(int new_limit, const char* reason);
+
+  Scheduler* scheduler_;
+  Scheduler::SourceId source_id_;
+  Log* log_;
+  int min_limit_;
+  int max_limit_;
+  int limit_;
+  int idle_periods_ = 0;
+  Scheduler::Time period_;
+  Scheduler::Time period_start_ = 0;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_CORE_QUEUETUNER_H_
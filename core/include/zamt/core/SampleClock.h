@@ -0,0 +1,59 @@
+#ifndef ZAMT_CORE_SAMPLECLOCK_H_
+#define ZAMT_CORE_SAMPLECLOCK_H_
+
+/// Locks the sample clock of a device to the system clock.
+/**
+ * Sources count every sample they get from a device, so the position of a
+ * sample is exact while the system time measured when it arrives jitters
+ * with scheduling and buffering. A second order delay locked loop filters
+ * the (sample position, system time) pairs: it follows the phase and learns
+ * the real length of a sample period, so the time of any sample can be
+ * given without jitter and the drift of the device clock is estimated.
+ * A measurement too far from the prediction (e.g. after lost samples)
+ * restarts the loop from the new position.
+ * Not thread safe, the source thread owns it.
+ */
+
+#include "zamt/core/Scheduler.h"
+
+#include <cstdint>
+
+namespace zamt {
+
+class SampleClock {
+ public:
+  const static int kMaxErrorInUs = 20000;
+
+  explicit SampleClock(double bandwidth_hz = 0.1);
+
+  /// Starts over with the nominal sample rate. Call before Update().
+  void Reset(int sample_rate);
+
+  /// Feeds a measurement: the sample at position was captured at time.
+  void Update(uint64_t position, Scheduler::Time time);
+
+  /// Returns if at least one measurement was taken since Reset().
+  bool locked() const { return locked_; }
+
+  /// Filtered system time of the sample at position.
+  Scheduler::Time TimeOfSample(uint64_t position) const;
+
+  /// Filtered length of a sample period in microseconds.
+  double usec_per_sample() const { return usec_per_sample_; }
+
+  /// Sample clock speed relative to nominal in parts per million.
+  double drift_ppm() const;
+
+ private:
+  double bandwidth_hz_;
+  double nominal_usec_per_sample_ = 0.0;
+  double usec_per_sample_ = 0.0;
+  bool locked_ = false;
+  Scheduler::Time origin_ = 0;  // all times are relative to this
+  uint64_t base_position_ = 0;
+  double base_time_ = 0.0;  // filtered time of the sample at base_position_
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_CORE_SAMPLECLOCK_H_
@@ -4,6 +4,8 @@
 /// Does all job dispatching and scheduling in system.
 /**
  * The main thread is used as the UI thread, dedicated to do certain tasks.
+ * The UI thread's main loop can watch an event file descriptor which is
+ * signaled when UI tasks are waiting, so it never polls the UI queue.
  * Other worker threads are created according to the number of CPUs.
  * Sources produce packets which are submitted to subscribed sinks.
  * A packet submission means a work unit for each sink.
@@ -13,19 +15,43 @@
  * All buffers between sources and sinks contain a fixed number of packets
  * which are allocated at configuration time (RegisterSource()).
  * It is a scaling problem when the number of packets in any queue is too low.
- * If a sink needs to get packets in order, it has to wait with yield() for
- * earlier jobs to finish.
+ * Only a limited part of the allocated packets can be used at once, so the
+ * queue length (latency) of a source can be tuned at runtime.
+ * Tasks of a sink can run in parallel and out of order. A sink which keeps
+ * state between packets can subscribe in order instead: it gets the packets
+ * one by one in the order of submission, without waiting threads.
+ * A sink with a lot of work on a packet can share it with the idle workers
+ * of a pool by ParallelFor().
+ * Sources producing packets faster than they are consumed can submit several
+ * at once, and batch sinks get consecutive packets in one call, so locking,
+ * wakeups and calls are paid once per batch.
+ * Worker threads are grouped into named pools, each with its own task queue,
+ * so e.g. a slow analysis cannot delay a latency critical sink in another
+ * pool. Sources are shared by all pools: a packet is released after every
+ * sink released it, whichever pool it was processed in.
+ * A producer which is not real-time (e.g. an intermediate stage) can wait
+ * for a free packet, so it is throttled to the speed of its sinks instead of
+ * dropping data.
+ * Sources are never removed, RegisterSource() returns a handle of the source
+ * which makes the calls of the packet flow without any lookup or lock of the
+ * source table. Calls taking a SourceId look the handle up first, and do
+ * nothing (or return nullptr, 0 or an invalid subscription id of -1) for an
+ * id which is not registered.
  */
 
 #include <atomic>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace zamt {
@@ -35,10 +61,43 @@ class Scheduler {
   using Byte = uint8_t;
   using SourceId = size_t;
   using Time = uint64_t;
+  using PoolId = int;
   using SinkCallback = std::function<void(SourceId source_id,
                                           const Byte* packet, Time timestamp)>;
+  using BatchSinkCallback =
+      std::function<void(SourceId source_id, const Byte* const* packets,
+                         const Time* timestamps, int count)>;
+  using RangeCallback = std::function<void(int begin, int end)>;
 
-  /// Launches all worker threads. (worker_threads == 0 means autodetect)
+  /// Refers to a registered source, valid as long as the scheduler.
+  struct SourceHandle {
+    bool valid() const { return index >= 0; }
+
+    int index = -1;  // in the order of registration
+  };
+
+  /// Occupancy of the packet queue of a source.
+  struct QueueStats {
+    int capacity;     // packets allocated at registration
+    int limit;        // packets which can be in use at once
+    int in_use;       // acquired and not yet released by all sinks
+    int peak_in_use;  // highest in_use since the last reset
+    int overruns;     // failed GetPacketForSubmission() since the last reset
+  };
+
+  /// Source ids from here on are given by AllocateSourceId(). Modules
+  /// register with ModuleCenter::GetId(), which is an address and so does not
+  /// collide with the ids counted from here in practice.
+  const static SourceId kFirstAllocatedSourceId = 1 << 16;
+  /// Sources which can be registered in a scheduler.
+  const static int kMaxSources = 1024;
+
+  /// The pool of the workers created by the constructor.
+  const static PoolId kDefaultPool = 0;
+  const static char* kDefaultPoolName;
+
+  /// Launches all worker threads of the default pool.
+  /// (worker_threads == 0 means autodetect)
   Scheduler(int worker_threads = 0);
 
   /// Waits all threads to finish before destruction.
@@ -50,31 +109,107 @@ class Scheduler {
   Scheduler& operator=(Scheduler&&) = delete;
 
   /**
-   * Returns how many worker threads are created.
+   * Returns how many worker threads are created in a pool.
    * The original thread (the UI thread) is an extra thread in this regard.
    */
-  int GetNumberOfWorkers() const;
+  int GetNumberOfWorkers(PoolId pool_id = kDefaultPool) const;
+
+  /**
+   * Launches a new pool of worker threads with a unique name.
+   * If first_cpu is not negative, the workers are pinned to the CPUs from
+   * first_cpu on (as far as the system lets them).
+   * It is a slow operation done in configuration time.
+   */
+  PoolId AddPool(const std::string& name, int worker_threads,
+                 int first_cpu = -1);
+
+  /// Returns false if no pool has this name.
+  bool FindPool(const std::string& name, PoolId& pool_id) const;
 
   /**
    * Sources register the fixed packet size they produce
    * and the queue size used to transmit work units to sinks.
+   * Optionally a fixed size metadata block is kept beside each packet.
    * It is a slow operation done in configuration time.
+   * Returns an invalid handle if the id is registered already or there are
+   * kMaxSources sources.
    */
-  void RegisterSource(SourceId source_id, int packet_size,
-                      int packets_in_queue);
+  SourceHandle RegisterSource(SourceId source_id, int packet_size,
+                              int packets_in_queue, int metadata_size = 0);
+
+  /// Returns the handle of a registered source, e.g. for a sink, or an
+  /// invalid handle if the source is not registered.
+  SourceHandle GetSourceHandle(SourceId source_id) const;
+
+  /// Returns a new source id for a source which is not a module itself,
+  /// e.g. one of more stages in a module.
+  SourceId AllocateSourceId();
+
+  /**
+   * Sources can be named, so sinks can find them by a name coming from
+   * e.g. the pipeline configuration. A name belongs to one source.
+   * It is a slow operation done in configuration time.
+   */
+  void SetSourceName(SourceId source_id, const std::string& name);
+
+  /// Returns false if no source has this name.
+  bool FindSource(const std::string& name, SourceId& source_id) const;
 
   /// Returns the fixed packet size a source is using.
+  int GetPacketSize(SourceHandle source);
   int GetPacketSize(SourceId source_id);
 
+  /// Returns the size of the metadata block beside each packet (or 0).
+  int GetMetadataSize(SourceHandle source);
+  int GetMetadataSize(SourceId source_id);
+
+  /**
+   * Returns the metadata block of a packet, aligned like the packets.
+   * The source fills it before SubmitPacket(), sinks can read it
+   * until they release the packet.
+   */
+  Byte* GetPacketMetadata(SourceHandle source, const Byte* packet);
+  Byte* GetPacketMetadata(SourceId source_id, const Byte* packet);
+
+  /**
+   * Limits how many packets of the queue can be in use at once.
+   * The limit is clamped to [1, packets_in_queue], it is the whole queue
+   * after registration. Packets already in use are not affected.
+   */
+  void SetQueueLimit(SourceHandle source, int packets);
+  void SetQueueLimit(SourceId source_id, int packets);
+
+  /// Returns queue statistics, peak and overrun counters restart if asked.
+  QueueStats GetQueueStats(SourceHandle source, bool reset_counters = true);
+  QueueStats GetQueueStats(SourceId source_id, bool reset_counters = true);
+
   /**
    * A sink registers itself via a callback into its code to get all
    * data packets produced by a source.
-   * It can ask for its code to be run on the single UI thread.
+   * It can ask for its code to be run on the single UI thread,
+   * otherwise it is run by the workers of the given pool.
    * It is a slow operation done in configuration time.
    * The ID of the subscription is returned.
    */
   void Subscribe(SourceId source_id, SinkCallback sink_callback, bool on_UI,
-                 int& subscription_id);
+                 int& subscription_id, PoolId pool_id = kDefaultPool);
+
+  /**
+   * Like Subscribe() on a worker pool, but the sink is called for one packet
+   * at a time in the order of submission, so it can keep state between the
+   * packets without locking. A packet is passed over by the task of a later
+   * packet if the sink is still busy, no thread waits for the sink.
+   */
+  void SubscribeInOrder(SourceId source_id, SinkCallback sink_callback,
+                        int& subscription_id, PoolId pool_id = kDefaultPool);
+
+  /**
+   * Like SubscribeInOrder(), but the sink gets up to max_batch consecutive
+   * packets in one call, as many as were waiting for it.
+   */
+  void SubscribeBatch(SourceId source_id, BatchSinkCallback batch_callback,
+                      int max_batch, int& subscription_id,
+                      PoolId pool_id = kDefaultPool);
 
   /**
    * A sink no longer wants to get packets from a source.
@@ -84,56 +219,152 @@ class Scheduler {
   void Unsubscribe(SourceId source_id, int subscription_id);
 
   /// Caller source acquires a packet which can be loaded with data.
+  Byte* GetPacketForSubmission(SourceHandle source);
   Byte* GetPacketForSubmission(SourceId source_id);
 
+  /**
+   * Like GetPacketForSubmission(), but if the queue is full, it waits for a
+   * sink to release a packet up to timeout_in_ms. Returns nullptr on timeout
+   * or shutdown. Only for producers on their own threads: not for real-time
+   * sources, and not for sinks, as a waiting worker may hold up the very
+   * tasks which would release a packet.
+   */
+  Byte* WaitForPacketForSubmission(SourceHandle source, int timeout_in_ms);
+  Byte* WaitForPacketForSubmission(SourceId source_id, int timeout_in_ms);
+
   /// Packet is put into queue, all subscribed sinks will be assigned a task.
+  void SubmitPacket(SourceHandle source, Byte* packet, Time timestamp);
   void SubmitPacket(SourceId source_id, Byte* packet, Time timestamp);
 
+  /// Submits count packets in this order with one task queueing and wakeup
+  /// per subscription.
+  void SubmitPackets(SourceHandle source, Byte* const* packets,
+                     const Time* timestamps, int count);
+  void SubmitPackets(SourceId source_id, Byte* const* packets,
+                     const Time* timestamps, int count);
+
   /// The sink processed the data (earlier is better) and releases it.
+  void ReleasePacket(SourceHandle source, const Byte* packet);
   void ReleasePacket(SourceId source_id, const Byte* packet);
 
+  /// Releases count packets at once, e.g. a batch.
+  void ReleasePackets(SourceHandle source, const Byte* const* packets,
+                      int count);
+  void ReleasePackets(SourceId source_id, const Byte* const* packets,
+                      int count);
+
+  /**
+   * Splits [begin, end) into consecutive ranges of grain length (the last
+   * one may be shorter) and calls body for each range on the workers of
+   * the pool and on the calling thread. Returns after all ranges are done.
+   * Ranges are taken before any packet task, the caller takes ranges too,
+   * so it can be called from a sink on any pool even during shutdown.
+   */
+  void ParallelFor(int begin, int end, int grain, const RangeCallback& body,
+                   PoolId pool_id = kDefaultPool);
+
   /// Call from main thread or main loop! Returns if nothing to do
   /// or after one task was carried out. It never blocks.
   void DoUITaskStep();
 
+  /**
+   * Call from the main loop of the UI thread when the event of
+   * GetUITaskEventFd() is signaled. Carries out at most max_tasks tasks and
+   * returns their number. If there are tasks left, the event stays signaled,
+   * so the main loop can serve its other sources before it comes back.
+   */
+  int DoUITasks(int max_tasks);
+
+  /// Returns a file descriptor readable while UI tasks are waiting,
+  /// -1 if the system has no eventfd.
+  int GetUITaskEventFd() const { return UI_event_fd_; }
+
   /// Tells all threads to stop working and quit. Destructor waits for them.
   void Shutdown();
 
  protected:
+  struct Pool;
+
   /// Returns only on shutdown.
-  void DoWorkerTasks();
+  void DoWorkerTasks(Pool* pool);
 
   /**
    * The general task dispatcher of the scheduler where scheduling is done.
    * Only one UI thread can be present.
    */
-  void DispatchTasks(bool UI_thread_mode = true);
+  void DispatchTasks(Pool& pool, bool UI_thread_mode = true);
 
  private:
+  // Packets of an in order or batch subscription waiting for the sink
+  struct InOrderSink {
+    void Push(Byte* const* packets, const Time* timestamps, int count);
+    // Calls the sink for all pending packets unless it is already running.
+    void Drain(SourceId source_id);
+
+    SinkCallback sink_callback;        // or
+    BatchSinkCallback batch_callback;  // of up to max_batch packets
+    int max_batch = 1;
+    std::mutex mtx;
+    std::deque<std::pair<Byte*, Time>> pending;
+    bool running = false;
+    // Only used by the running sink
+    std::vector<const Byte*> batch_packets;
+    std::vector<Time> batch_timestamps;
+  };
+
+  // Ranges of one ParallelFor() call
+  struct ParallelJob {
+    // Calls the body for ranges until all are taken.
+    void Run();
+
+    const RangeCallback* body;  // valid until all ranges are done
+    int begin;
+    int end;
+    int grain;
+    int ranges;
+    std::atomic<int> next_range{0};
+    std::atomic<int> ranges_done{0};
+    std::mutex mtx;
+    std::condition_variable all_done;
+  };
+
   struct Subscription {
-    Subscription(SinkCallback _sink_callback, bool _on_UI);
+    Subscription(SinkCallback _sink_callback, bool _on_UI, Pool* _pool,
+                 std::shared_ptr<InOrderSink> _in_order);
 
     SinkCallback sink_callback;
     bool on_UI;
+    Pool* pool;  // of the workers if not on_UI
+    std::shared_ptr<InOrderSink> in_order;  // or nullptr
   };
 
   struct Source {
+    Source(SourceId _source_id, int _packet_size, int packets_in_queue,
+           int _metadata_size);
+
+    SourceId source_id;
     std::atomic_flag source_mtx_;
     int packet_size;
+    int queue_limit;
+    int peak_in_use;
+    int overruns;
     std::vector<int> free_packets;    // packet number
     std::vector<bool> packet_usages;  // true if used
     std::vector<int> packet_refcounts;
     std::vector<Byte> packet_buffer;  // concatenated packets
+    int metadata_size;
+    std::vector<Byte> metadata_buffer;  // concatenated metadata blocks
     std::vector<Subscription> subscriptions;
+    // Producers waiting for a packet to be released
+    std::atomic<int> waiting_producers{0};
+    std::mutex release_mtx;
+    std::condition_variable packet_released;
   };
 
-  struct SourceRef {
-    SourceRef(SourceId _source_id);
-    SourceRef(SourceId _source_id, int packet_size, int packets_in_queue);
-    bool operator<(const SourceRef& o) const;
-
-    SourceId source_id;
-    std::unique_ptr<Source> ptr;
+  // A slot is only filled once, the index is set last.
+  struct SourceIndexEntry {
+    std::atomic<SourceId> source_id{0};
+    std::atomic<int> index{-1};  // of the handle, -1 while the slot is free
   };
 
   struct Task {
@@ -151,29 +382,58 @@ class Scheduler {
     std::unique_ptr<Task> ptr;
   };
 
-  Source& GetSourceById(SourceId source_id);
+ protected:
+  struct Pool {
+    Pool(const std::string& _name);
+
+    std::string name;
+    std::priority_queue<TaskRef> tasks;
+    std::mutex queue_mtx;
+    std::condition_variable queue_cv;
+    std::vector<std::thread> workers;
+  };
 
-  // Locking of sources_ container
-  void WriteLockSources();
-  void WriteUnlockSources();
-  void ReadLockSources();
-  void ReadUnlockSources();
+ private:
+  void LaunchWorkers(Pool& pool, int worker_threads, int first_cpu);
+  static bool PinThread(std::thread& thread, int cpu);
+
+  Source& GetSource(SourceHandle source);
+  Byte* AcquirePacket(Source& src, bool count_overrun);
+  void SignalUITasks();
+  void ClearUITasksSignal();
+  // Wakes the producers waiting for the packets of the source.
+  static void NotifyWaitingProducers(Source& src);
+  Pool* GetPoolById(PoolId pool_id);
+  int AddSubscription(SourceId source_id, const Subscription& subscription);
+  int AddInOrderSubscription(SourceId source_id,
+                             std::shared_ptr<InOrderSink> in_order,
+                             PoolId pool_id);
+  static int GetPacketNum(const Source& src, const Byte* packet);
 
   // Locking of a single source's queue
   static void LockSource(Source& src);
   static void UnlockSource(Source& src);
 
-  std::vector<SourceRef> sources_;
-  std::priority_queue<TaskRef> tasks_for_workers_;
-  std::priority_queue<TaskRef> tasks_for_UI_;
-  std::vector<std::thread> workers_;
+  // Sources in the order of registration. Entries are only added, and the
+  // count is raised after the entry is set, so readers need no lock.
+  std::unique_ptr<std::atomic<Source*>[]> source_table_;
+  std::atomic<int> source_count_{0};
+  std::mutex sources_mtx_;  // serializes registrations
+  std::vector<std::unique_ptr<Source>> sources_;
+  // Open addressing table of the ids, half full at most so the probes stay
+  // short. Readers need no lock as slots are never changed once filled.
+  const static int kSourceIndexSize = 2 * kMaxSources;
+  static int GetFirstSourceIndexSlot(SourceId source_id);
+  std::unique_ptr<SourceIndexEntry[]> source_index_;
+  std::atomic<SourceId> next_allocated_source_id_{kFirstAllocatedSourceId};
+  mutable std::mutex source_names_mtx_;
+  std::map<std::string, SourceId> source_names_;
+  Pool UI_pool_;
+  int UI_event_fd_ = -1;
+  mutable std::mutex pools_mtx_;
+  std::vector<std::unique_ptr<Pool>> pools_;  // kDefaultPool 1st
 
   std::atomic<bool> shutdown_initiated_;
-  std::atomic<int> sources_semaphore_;
-  std::mutex worker_queue_mtx_;
-  std::condition_variable worker_queue_cv_;
-  std::mutex UI_queue_mtx_;
-  std::condition_variable UI_queue_cv_;
   static int max_spin_cycles_before_yield;
 };
 
@@ -4,6 +4,9 @@ set(module_cpps
   Log.cpp
   main.cpp
   ModuleCenter.cpp
+  PipelineConfig.cpp
+  QueueTuner.cpp
+  SampleClock.cpp
   Scheduler.cpp
   TestSuite.cpp
 )
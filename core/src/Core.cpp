@@ -37,6 +37,8 @@ namespace zamt {
 const char* Core::kModuleLabel = "core";
 const char* Core::kHelpParamStr = "-h";
 const char* Core::kThreadsParamStr = "-j";
+const char* Core::kPipelineParamStr = "-pipe";
+const char* Core::kPoolStageType = "pool";
 
 #ifdef TEST
 void Core::ReInitExitCode() {
@@ -66,6 +68,40 @@ Core::Core(int argc, const char* const* argv) : cli_(argc, argv) {
   scheduler_.reset(new Scheduler(workers));
   log_->LogMessage("Scheduler started with ", scheduler_->GetNumberOfWorkers(),
                    " threads.");
+
+  const char* pipeline_path = cli_.GetParam(kPipelineParamStr);
+  if (pipeline_path) {
+    int error_line;
+    if (!pipeline_.Load(pipeline_path, error_line)) {
+      log_->Message(Log::kError, "Cannot load pipeline ", pipeline_path,
+                    " at line ", error_line);
+      Quit(kExitCodeBadPipeline);
+      return;
+    }
+    log_->Message("Pipeline ", pipeline_path, " loaded with ",
+                  pipeline_.stages().size(), " stages.");
+    if (!AddPools()) {
+      Quit(kExitCodeBadPipeline);
+      return;
+    }
+  }
+}
+
+bool Core::AddPools() {
+  for (auto stage : pipeline_.GetStages(kPoolStageType)) {
+    int threads = stage->GetNumParam("threads", 1);
+    int first_cpu = stage->GetNumParam("cpu", -1);
+    Scheduler::PoolId pool_id;
+    if (threads < 1 || scheduler_->FindPool(stage->name, pool_id)) {
+      log_->Message(Log::kError, "Bad pool ", stage->name, " with ", threads,
+                    " threads");
+      return false;
+    }
+    scheduler_->AddPool(stage->name, threads, first_cpu);
+    log_->Message("Pool ", stage->name, " started with ", threads,
+                  " threads.");
+  }
+  return true;
 }
 
 Core::~Core() { log_->LogMessage("Stopping..."); }
@@ -74,7 +110,13 @@ void Core::Initialize(const ModuleCenter* mc) { mc_ = mc; }
 
 void Core::Quit(int exit_code) {
   log_->LogMessage("Shutdown initiated with exit code ", exit_code);
-  for (const auto& quit_cb : on_quit_callbacks_) {
+  std::deque<OnQuitCallback> quit_callbacks;
+  {
+    std::lock_guard<std::mutex> lock(quit_callbacks_mutex_);
+    quit_exit_code_ = exit_code;
+    quit_callbacks = on_quit_callbacks_;
+  }
+  for (const auto& quit_cb : quit_callbacks) {
     quit_cb(exit_code);
   }
   {
@@ -105,7 +147,17 @@ int Core::WaitForQuit() {
 }
 
 void Core::RegisterForQuitEvent(OnQuitCallback on_quit_callback) {
-  on_quit_callbacks_.push_back(on_quit_callback);
+  int exit_code;
+  {
+    std::lock_guard<std::mutex> lock(quit_callbacks_mutex_);
+    exit_code = quit_exit_code_;
+    if (exit_code == kNoExitCode) {
+      on_quit_callbacks_.push_back(on_quit_callback);
+      return;
+    }
+  }
+  // e.g. a bad pipeline quits before the modules are initialized
+  on_quit_callback(exit_code);
 }
 
 Scheduler& Core::scheduler() {
@@ -119,6 +171,8 @@ void Core::PrintHelp() {
   Log::Print(
       " -jNum          Set number of worker threads in scheduler."
       " 0 means autodetect (default).");
+  Log::Print(" -pipeFile      Set up the processing stages described in File.");
+  Log::Print(" Pipeline stages: pool Name threads=Num cpu=FirstCpuToPinTo");
 }
 
 std::atomic<int> Core::exit_code_(Core::kNoExitCode);
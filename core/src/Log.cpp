@@ -1,54 +1,356 @@
 #include "zamt/core/Log.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace zamt {
 
 const char* Log::kVerboseParamStr = "-v";
+const char* Log::kDebugParamStr = "-vv";
 
-Log::Log(const char* label, const CLIParameters& cli) {
-  const int kParamBufLength = 32;
-  label_ = label;
-  if (cli.HasParam(kVerboseParamStr)) {
-    verbose_ = true;
-    return;
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+const int kRingSize = 256;  // records per thread
+const int kWritePeriodInMs = 10;
+
+enum class NumType { kNone, kInt, kFloat };
+
+struct Record {
+  char label[Log::kMaxLabelLength];
+  Log::Level level;
+  NumType num_type;
+  const char* msg;     // points to text
+  const char* suffix;  // points to text after the message
+  union {
+    int i;
+    float f;
+  } num;
+  char text[Log::kMaxTextLength];
+};
+
+// Single producer (the owner thread), single consumer (the writer).
+struct Ring {
+  Record records[kRingSize];
+  std::atomic<uint32_t> head{0};  // next to write, owned by the producer
+  std::atomic<uint32_t> tail{0};  // next to read, owned by the writer
+  std::atomic<int64_t> lost{0};
+  std::atomic<bool> orphaned{false};  // the owner thread exited
+
+  Record* Begin() {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= (uint32_t)kRingSize) {
+      lost.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &records[h % kRingSize];
+  }
+  void Commit() {
+    head.store(head.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+};
+
+class Writer {
+ public:
+  Writer() : thread_(&Writer::Run, this) {}
+  ~Writer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_up_.notify_all();
+    thread_.join();
+  }
+
+  void Register(const std::shared_ptr<Ring>& ring) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.push_back(ring);
+  }
+
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // a whole pass started after the request
+    uint64_t target = passes_ + 2;
+    flush_requested_ = true;
+    wake_up_.notify_all();
+    pass_done_.wait(lock, [this, target]() { return passes_ >= target; });
+  }
+
+  void SetOutput(FILE* output) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_ = output;
+  }
+
+ private:
+  struct Repeats {
+    clock::time_point window_start;
+    int written = 0;
+    int64_t suppressed = 0;
+  };
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool stop = false;
+    while (!stop) {
+      wake_up_.wait_for(lock, std::chrono::milliseconds(kWritePeriodInMs),
+                        [this]() { return stopping_ || flush_requested_; });
+      stop = stopping_;
+      bool summarize = flush_requested_ || stop;
+      flush_requested_ = false;
+      std::vector<std::shared_ptr<Ring>> rings = rings_;
+      FILE* output = output_ ? output_ : stdout;
+      lock.unlock();
+      WritePending(rings, output, summarize);
+      lock.lock();
+      // rings of exited threads are dropped once read
+      for (size_t i = 0; i < rings_.size();) {
+        Ring& ring = *rings_[i];
+        if (ring.orphaned && ring.tail == ring.head) {
+          rings_[i] = rings_.back();
+          rings_.pop_back();
+        } else {
+          ++i;
+        }
+      }
+      passes_++;
+      pass_done_.notify_all();
+    }
+  }
+
+  void WritePending(const std::vector<std::shared_ptr<Ring>>& rings,
+                    FILE* output, bool summarize) {
+    clock::time_point now = clock::now();
+    batch_.clear();
+    for (const std::shared_ptr<Ring>& ring : rings) {
+      uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+      uint32_t head = ring->head.load(std::memory_order_acquire);
+      for (; tail != head; ++tail) {
+        const Record& record = ring->records[tail % kRingSize];
+        if (Allow(record, now)) Format(record);
+      }
+      ring->tail.store(tail, std::memory_order_release);
+      int64_t lost = ring->lost.exchange(0, std::memory_order_relaxed);
+      if (lost) {
+        char line[64];
+        snprintf(line, sizeof(line), "[log] %lld messages lost\n",
+                 (long long)lost);
+        batch_ += line;
+      }
+    }
+    Summarize(now, summarize);
+    if (batch_.empty()) return;
+    fwrite(batch_.data(), 1, batch_.size(), output);
+    fflush(output);
+  }
+
+  // Rate limiting by label and message (numbers excluded).
+  bool Allow(const Record& record, clock::time_point now) {
+    key_.assign(record.label);
+    key_ += '\n';
+    key_ += record.msg;
+    if (record.num_type != NumType::kNone) {
+      key_ += '\n';
+      key_ += record.suffix;
+    }
+    Repeats& repeats = repeats_[key_];
+    if (now - repeats.window_start >= std::chrono::seconds(1)) {
+      WriteSuppressed(key_, repeats);
+      repeats.window_start = now;
+      repeats.written = 0;
+    }
+    if (repeats.written >= Log::kMaxRepeatsPerSecond) {
+      repeats.suppressed++;
+      return false;
+    }
+    repeats.written++;
+    return true;
+  }
+
+  // Writes the counts of expired windows (all if forced) and forgets them.
+  void Summarize(clock::time_point now, bool force) {
+    for (auto it = repeats_.begin(); it != repeats_.end();) {
+      if (force || now - it->second.window_start >= std::chrono::seconds(1)) {
+        WriteSuppressed(it->first, it->second);
+        it = repeats_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void WriteSuppressed(const std::string& key, Repeats& repeats) {
+    if (!repeats.suppressed) return;
+    size_t label_end = key.find('\n');
+    size_t msg_end = key.find('\n', label_end + 1);
+    char line[64];
+    snprintf(line, sizeof(line), "] %lld more of: ",
+             (long long)repeats.suppressed);
+    batch_ += '[';
+    batch_.append(key, 0, label_end);
+    batch_ += line;
+    batch_.append(key, label_end + 1, msg_end - label_end - 1);
+    batch_ += '\n';
+    repeats.suppressed = 0;
+  }
+
+  void Format(const Record& record) {
+    char line[Log::kMaxLabelLength + 2 * Log::kMaxTextLength + 64];
+    const char* level = record.level == Log::kError
+                            ? "Error: "
+                            : record.level == Log::kWarning ? "Warning: " : "";
+    switch (record.num_type) {
+      case NumType::kNone:
+        snprintf(line, sizeof(line), "[%s] %s%s\n", record.label, level,
+                 record.msg);
+        break;
+      case NumType::kInt:
+        snprintf(line, sizeof(line), "[%s] %s%s%d%s\n", record.label, level,
+                 record.msg, record.num.i, record.suffix);
+        break;
+      case NumType::kFloat:
+        snprintf(line, sizeof(line), "[%s] %s%s%f%s\n", record.label, level,
+                 record.msg, (double)record.num.f, record.suffix);
+        break;
+    }
+    batch_ += line;
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wake_up_;
+  std::condition_variable pass_done_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  uint64_t passes_ = 0;
+  bool flush_requested_ = false;
+  bool stopping_ = false;
+  FILE* output_ = nullptr;
+
+  // Owned by the writer thread.
+  std::string batch_;
+  std::string key_;
+  std::map<std::string, Repeats> repeats_;
+
+  std::thread thread_;  // the last one, starts when the rest is ready
+};
+
+Writer& GetWriter() {
+  static Writer writer;
+  return writer;
+}
+
+struct RingHolder {
+  ~RingHolder() {
+    if (ring) ring->orphaned = true;
   }
+  std::shared_ptr<Ring> ring;
+};
+
+thread_local RingHolder ring_holder;
+
+Record* BeginRecord(const char* label, Log::Level level, NumType num_type,
+                    const char* msg, const char* suffix) {
+  if (!ring_holder.ring) {
+    ring_holder.ring = std::make_shared<Ring>();
+    GetWriter().Register(ring_holder.ring);
+  }
+  Record* record = ring_holder.ring->Begin();
+  if (!record) return nullptr;
+  strcpy(record->label, label);
+  record->level = level;
+  record->num_type = num_type;
+  // the caller may free them before they are written
+  const size_t text_length = Log::kMaxTextLength;
+  size_t msg_length = std::min(strlen(msg), text_length - 2);
+  memcpy(record->text, msg, msg_length);
+  record->text[msg_length] = '\0';
+  char* suffix_text = record->text + msg_length + 1;
+  size_t suffix_length =
+      std::min(strlen(suffix), text_length - msg_length - 2);
+  memcpy(suffix_text, suffix, suffix_length);
+  suffix_text[suffix_length] = '\0';
+  record->msg = record->text;
+  record->suffix = suffix_text;
+  return record;
+}
+
+}  // namespace
+
+Log::Log(const char* label, const CLIParameters& cli) {
+  const int kParamBufLength = kMaxLabelLength;
   assert(strlen(label) < kParamBufLength - 3);
+  strcpy(label_, label);
   char str[kParamBufLength];
+  strcpy(str, kDebugParamStr);
+  strcat(str, label);
+  if (cli.HasParam(kDebugParamStr) || cli.GetParam(str) != nullptr) {
+    level_ = kDebug;
+    return;
+  }
   strcpy(str, kVerboseParamStr);
   strcat(str, label);
-  if (cli.GetParam(str) != nullptr) {
-    verbose_ = true;
+  if (cli.HasParam(kVerboseParamStr) || cli.GetParam(str) != nullptr) {
+    level_ = kInfo;
     return;
   }
-  verbose_ = false;
+  level_ = kWarning;
 }
 
-void Log::Print(const char* messa) { printf("%s\n", messa); }
+void Log::Print(const char* messa) {
+  Flush();
+  printf("%s\n", messa);
+}
 
 void Log::PrintHelp4Verbose() {
   Print(" -v             Set verbose status information mode globally.");
   Print(" -vModuleName   Set verbose mode only in ModuleName.");
+  Print(" -vv            Set debug information mode globally.");
+  Print(" -vvModuleName  Set debug mode only in ModuleName.");
 }
 
-void Log::LogMessage(const char* msg) {
-  if (verbose_) {
-    printf("[%s] %s\n", label_, msg);
-  }
+void Log::Flush() { GetWriter().Flush(); }
+
+void Log::LogMessage(Level level, const char* msg) {
+  if (!IsEnabled(level)) return;
+  Record* record = BeginRecord(label_, level, NumType::kNone, msg, "");
+  if (!record) return;
+  ring_holder.ring->Commit();
 }
 
-void Log::LogMessage(const char* msg, int num, const char* suffix) {
-  if (verbose_) {
-    printf("[%s] %s%d%s\n", label_, msg, num, suffix);
-  }
+void Log::LogMessage(Level level, const char* msg, int num,
+                     const char* suffix) {
+  if (!IsEnabled(level)) return;
+  Record* record = BeginRecord(label_, level, NumType::kInt, msg, suffix);
+  if (!record) return;
+  record->num.i = num;
+  ring_holder.ring->Commit();
 }
 
-void Log::LogMessage(const char* msg, float num, const char* suffix) {
-  if (verbose_) {
-    printf("[%s] %s%f%s\n", label_, msg, (double)num, suffix);
-  }
+void Log::LogMessage(Level level, const char* msg, float num,
+                     const char* suffix) {
+  if (!IsEnabled(level)) return;
+  Record* record = BeginRecord(label_, level, NumType::kFloat, msg, suffix);
+  if (!record) return;
+  record->num.f = num;
+  ring_holder.ring->Commit();
+}
+
+#ifdef TEST
+void Log::SetOutputForTest(FILE* output) {
+  Flush();
+  GetWriter().SetOutput(output);
 }
+#endif
 
 }  // namespace zamt
@@ -1,33 +1,146 @@
 #include "zamt/core/ModuleCenter.h"
 
-#include <tuple>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
 
 namespace zamt {
 
-ModuleCenter::ModuleCenter(int argc, const char* const* argv) {
-  for (int i = 0; i < module_num_; ++i) {
-    ModuleInitRecord& rec = module_inits_[i];
-    Module* instance = (*rec.create_function)(argc, argv);
-    bool inserted;
-    std::tie(std::ignore, inserted) =
-        module_instances_.emplace(rec.key, instance);
-    assert(inserted);
-  }
-  for (int i = 0; i < module_num_; ++i) {
-    ModuleInitRecord& rec = module_inits_[i];
-    auto instanceIter = module_instances_.find(rec.key);
-    assert(instanceIter != module_instances_.end());
-    (*rec.init_function)(this, instanceIter->second);
+ModuleCenter::ModuleCenter(int argc, const char* const* argv)
+    : module_instances_(module_num_, nullptr) {
+  Dependents dependents = GetDependents();
+  int in_cycle = CountModulesInCycles(dependents);
+  if (in_cycle) {
+    // they would never become ready and the startup would hang
+    fprintf(stderr,
+            "ModuleCenter: %d modules wait for a dependency cycle, see "
+            "ZAMT_MODULE_DEPENDS\n",
+            in_cycle);
+    std::abort();
   }
+  RunInDependencyOrder(dependents,
+                       [this, argc, argv](int i) {
+                         module_instances_[i] =
+                             (*module_inits_[i].create_function)(argc, argv);
+                       },
+                       &creation_order_);
+  RunInDependencyOrder(dependents,
+                       [this](int i) {
+                         (*module_inits_[i].init_function)(
+                             this, module_instances_[i]);
+                       },
+                       nullptr);
+  RunInDependencyOrder(dependents,
+                       [this](int i) {
+                         (*module_inits_[i].connect_function)(
+                             this, module_instances_[i]);
+                       },
+                       nullptr);
+  RunInDependencyOrder(dependents,
+                       [this](int i) {
+                         (*module_inits_[i].start_function)(
+                             this, module_instances_[i]);
+                       },
+                       nullptr);
 }
 
 ModuleCenter::~ModuleCenter() {
+  for (auto i = creation_order_.rbegin(); i != creation_order_.rend(); ++i) {
+    (*module_inits_[*i].destroy_function)(module_instances_[*i]);
+  }
+}
+
+int ModuleCenter::FindModule(size_t key) {
   for (int i = 0; i < module_num_; ++i) {
-    ModuleInitRecord& rec = module_inits_[i];
-    auto instanceIter = module_instances_.find(rec.key);
-    assert(instanceIter != module_instances_.end());
-    (*rec.destroy_function)(instanceIter->second);
+    if (module_inits_[i].key == key) return i;
   }
+  return -1;
+}
+
+void ModuleCenter::AddDependency(size_t key, size_t depends_on_key) {
+  assert(dependency_num_ < kMaxDependenciesNum);
+  DependencyRecord& rec = dependencies_[dependency_num_];
+  rec.key = key;
+  rec.depends_on_key = depends_on_key;
+  ++dependency_num_;
+}
+
+ModuleCenter::Dependents ModuleCenter::GetDependents() {
+  Dependents dependents(module_num_);
+  for (int i = 0; i < dependency_num_; ++i) {
+    int module = FindModule(dependencies_[i].key);
+    int depends_on = FindModule(dependencies_[i].depends_on_key);
+    assert(module >= 0 && depends_on >= 0);
+    if (module == depends_on) continue;
+    std::vector<int>& list = dependents[depends_on];
+    if (std::find(list.begin(), list.end(), module) == list.end())
+      list.push_back(module);
+  }
+  return dependents;
+}
+
+int ModuleCenter::CountModulesInCycles(const Dependents& dependents) {
+  const int modules = (int)dependents.size();
+  std::vector<int> waiting_for(modules, 0);
+  for (const std::vector<int>& list : dependents) {
+    for (int module : list) ++waiting_for[module];
+  }
+  std::vector<int> order;
+  for (int i = 0; i < modules; ++i) {
+    if (waiting_for[i] == 0) order.push_back(i);
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    for (int module : dependents[order[i]]) {
+      if (--waiting_for[module] == 0) order.push_back(module);
+    }
+  }
+  // the ones never ready, also the dependents of a cycle
+  return modules - (int)order.size();
+}
+
+void ModuleCenter::RunInDependencyOrder(const Dependents& dependents,
+                                        const std::function<void(int)>& step,
+                                        std::vector<int>* finished) {
+  const int modules = (int)dependents.size();
+  std::vector<int> waiting_for(modules, 0);
+  for (const std::vector<int>& list : dependents) {
+    for (int module : list) ++waiting_for[module];
+  }
+  std::vector<int> ready;
+  for (int i = 0; i < modules; ++i) {
+    if (waiting_for[i] == 0) ready.push_back(i);
+  }
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  int done = 0;
+  auto run = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      cond_var.wait(lock, [&] { return !ready.empty() || done == modules; });
+      if (ready.empty()) return;
+      int module = ready.back();
+      ready.pop_back();
+      lock.unlock();
+      step(module);
+      lock.lock();
+      ++done;
+      if (finished) finished->push_back(module);
+      for (int dependent : dependents[module]) {
+        if (--waiting_for[dependent] == 0) ready.push_back(dependent);
+      }
+      cond_var.notify_all();
+    }
+  };
+
+  // The calling thread is part of the startup pool.
+  int threads = std::min<int>(modules, std::thread::hardware_concurrency());
+  std::vector<std::thread> helpers;
+  for (int i = 1; i < threads; ++i) helpers.emplace_back(run);
+  run();
+  for (std::thread& helper : helpers) helper.join();
 }
 
 int ModuleCenter::module_num_ = 0;
@@ -35,4 +148,9 @@ int ModuleCenter::module_num_ = 0;
 ModuleCenter::ModuleInitRecord
     ModuleCenter::module_inits_[ModuleCenter::kMaxModulesNum];
 
+int ModuleCenter::dependency_num_ = 0;
+
+ModuleCenter::DependencyRecord
+    ModuleCenter::dependencies_[ModuleCenter::kMaxDependenciesNum];
+
 }  // namespace zamt
@@ -0,0 +1,84 @@
+#include "zamt/core/PipelineConfig.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace zamt {
+
+namespace {
+bool HasStage(const std::vector<PipelineConfig::Stage>& stages,
+              const std::string& name) {
+  for (const PipelineConfig::Stage& stage : stages) {
+    if (stage.name == name) return true;
+  }
+  return false;
+}
+}  // namespace
+
+const char* PipelineConfig::Stage::GetParam(const char* key) const {
+  auto it = params.find(key);
+  if (it == params.end()) return nullptr;
+  return it->second.c_str();
+}
+
+int PipelineConfig::Stage::GetNumParam(const char* key,
+                                       int default_value) const {
+  const char* value = GetParam(key);
+  if (value == nullptr) return default_value;
+  return atoi(value);
+}
+
+bool PipelineConfig::Load(const char* path, int& error_line) {
+  std::ifstream file(path);
+  if (!file) {
+    error_line = 0;
+    return false;
+  }
+  return Parse(file, error_line);
+}
+
+bool PipelineConfig::Parse(std::istream& input, int& error_line) {
+  std::vector<Stage> parsed;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(input, line)) {
+    line_number++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    Stage stage;
+    if (!(words >> stage.type)) continue;  // empty line
+    if (!(words >> stage.name) || stage.name.find('=') != std::string::npos) {
+      error_line = line_number;
+      return false;
+    }
+    std::string param;
+    while (words >> param) {
+      size_t equal = param.find('=');
+      if (equal == 0 || equal == std::string::npos ||
+          !stage.params.emplace(param.substr(0, equal), param.substr(equal + 1))
+               .second) {
+        error_line = line_number;
+        return false;
+      }
+    }
+    if (HasStage(stages_, stage.name) || HasStage(parsed, stage.name)) {
+      error_line = line_number;
+      return false;
+    }
+    parsed.push_back(stage);
+  }
+  stages_.insert(stages_.end(), parsed.begin(), parsed.end());
+  return true;
+}
+
+std::vector<const PipelineConfig::Stage*> PipelineConfig::GetStages(
+    const char* type) const {
+  std::vector<const Stage*> found;
+  for (const Stage& stage : stages_) {
+    if (stage.type == type) found.push_back(&stage);
+  }
+  return found;
+}
+
+}  // namespace zamt
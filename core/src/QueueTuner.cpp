@@ -0,0 +1,61 @@
+#include "zamt/core/QueueTuner.h"
+
+#include "zamt/core/Log.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace zamt {
+
+QueueTuner::QueueTuner(Scheduler* scheduler, Scheduler::SourceId source_id,
+                       int min_limit, Scheduler::Time period, Log* log,
+                       int start_limit)
+    : scheduler_(scheduler),
+      source_id_(source_id),
+      log_(log),
+      period_(period) {
+  assert(scheduler_);
+  assert(log_);
+  assert(period_ > 0);
+  max_limit_ = scheduler_->GetQueueStats(source_id_).capacity;
+  min_limit_ = std::max(1, std::min(min_limit, max_limit_));
+  limit_ = std::max(min_limit_, std::min(start_limit, max_limit_));
+  scheduler_->SetQueueLimit(source_id_, limit_);
+  log_->LogMessage("Queue limit: ", limit_, " packets");
+}
+
+bool QueueTuner::Update(Scheduler::Time now) {
+  if (period_start_ == 0) period_start_ = now;
+  if (now - period_start_ < period_) return false;
+  period_start_ = now;
+
+  Scheduler::QueueStats stats = scheduler_->GetQueueStats(source_id_);
+  int old_limit = limit_;
+  if (stats.overruns > 0) {
+    idle_periods_ = 0;
+    ChangeLimit(limit_ * 2, "Queue overrun, limit raised to ");
+  } else if (stats.peak_in_use * 100 >= limit_ * kHighOccupancyPercent) {
+    idle_periods_ = 0;
+    ChangeLimit(limit_ + std::max(1, limit_ / 4),
+                "Queue nearly full, limit raised to ");
+  } else if (stats.peak_in_use * 100 <= limit_ * kLowOccupancyPercent) {
+    if (++idle_periods_ >= kIdlePeriodsBeforeShrink) {
+      idle_periods_ = 0;
+      ChangeLimit(limit_ - std::max(1, limit_ / 4),
+                  "Queue idle, limit lowered to ");
+    }
+  } else {
+    idle_periods_ = 0;
+  }
+  return limit_ != old_limit;
+}
+
+void QueueTuner::ChangeLimit(int new_limit, const char* reason) {
+  new_limit = std::max(min_limit_, std::min(new_limit, max_limit_));
+  if (new_limit == limit_) return;
+  limit_ = new_limit;
+  scheduler_->SetQueueLimit(source_id_, limit_);
+  log_->LogMessage(reason, limit_, " packets");
+}
+
+}  // namespace zamt
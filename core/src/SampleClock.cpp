@@ -0,0 +1,61 @@
+#include "zamt/core/SampleClock.h"
+
+#include <cassert>
+#include <cmath>
+
+namespace zamt {
+
+namespace {
+const double kPi = 3.14159265358979323846;
+}  // namespace
+
+SampleClock::SampleClock(double bandwidth_hz) : bandwidth_hz_(bandwidth_hz) {
+  assert(bandwidth_hz_ > 0.0);
+}
+
+void SampleClock::Reset(int sample_rate) {
+  assert(sample_rate > 0);
+  nominal_usec_per_sample_ = 1000000.0 / sample_rate;
+  usec_per_sample_ = nominal_usec_per_sample_;
+  locked_ = false;
+}
+
+void SampleClock::Update(uint64_t position, Scheduler::Time time) {
+  assert(nominal_usec_per_sample_ > 0.0);
+  if (locked_ && position > base_position_) {
+    double samples = (double)(position - base_position_);
+    double predicted = base_time_ + samples * usec_per_sample_;
+    double error = (double)(int64_t)(time - origin_) - predicted;
+    if (std::fabs(error) < kMaxErrorInUs) {
+      // Loop coefficients for the time passed since the last update,
+      // see F. Adriaensen: Using a DLL to filter time.
+      double omega = 2.0 * kPi * bandwidth_hz_ * samples * usec_per_sample_ /
+                     1000000.0;
+      if (omega > 1.0) omega = 1.0;  // keeps the loop stable on rare updates
+      base_time_ = predicted + std::sqrt(2.0) * omega * error;
+      base_position_ = position;
+      usec_per_sample_ += omega * omega * error / samples;
+      return;
+    }
+  }
+  if (locked_ && position <= base_position_) return;
+  origin_ = time;
+  base_position_ = position;
+  base_time_ = 0.0;
+  usec_per_sample_ = nominal_usec_per_sample_;
+  locked_ = true;
+}
+
+Scheduler::Time SampleClock::TimeOfSample(uint64_t position) const {
+  assert(locked_);
+  double offset = (double)position - (double)base_position_;
+  double time = base_time_ + offset * usec_per_sample_;
+  return origin_ + (Scheduler::Time)std::llround(time);
+}
+
+double SampleClock::drift_ppm() const {
+  if (nominal_usec_per_sample_ == 0.0) return 0.0;
+  return (nominal_usec_per_sample_ / usec_per_sample_ - 1.0) * 1000000.0;
+}
+
+}  // namespace zamt
@@ -2,88 +2,366 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <system_error>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 namespace zamt {
 
-Scheduler::Scheduler(int worker_threads) : shutdown_initiated_(false) {
-  size_t workers = (size_t)worker_threads;
-  if (workers == 0) workers = (size_t)std::thread::hardware_concurrency();
+const char* Scheduler::kDefaultPoolName = "default";
+
+Scheduler::Scheduler(int worker_threads)
+    : source_table_(new std::atomic<Source*>[kMaxSources]),
+      source_index_(new SourceIndexEntry[kSourceIndexSize]),
+      UI_pool_("UI"),
+      shutdown_initiated_(false) {
+  for (int i = 0; i < kMaxSources; ++i) {
+    source_table_[(size_t)i].store(nullptr, std::memory_order_relaxed);
+  }
+#ifdef __linux__
+  UI_event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+  int workers = worker_threads;
+  if (workers == 0) workers = (int)std::thread::hardware_concurrency();
   if (workers == 0) workers = 1;
-  sources_semaphore_.store((int)workers + 1, std::memory_order_release);
   if (workers == 1) {
     max_spin_cycles_before_yield = 4;
   }
-  workers_.reserve(workers);
-  while (workers-- > 0) {
-    workers_.emplace_back(&Scheduler::DoWorkerTasks, this);
-  }
+  pools_.emplace_back(new Pool(kDefaultPoolName));
+  LaunchWorkers(*pools_.back(), workers, -1);
 }
 
 Scheduler::~Scheduler() {
   if (!shutdown_initiated_.load(std::memory_order_acquire)) {
     Shutdown();
   }
-  for (std::thread& worker : workers_) {
-    try {
-      worker.join();
-    } catch (const std::system_error& e) {
+  for (auto& pool : pools_) {
+    for (std::thread& worker : pool->workers) {
+      try {
+        worker.join();
+      } catch (const std::system_error& e) {
+      }
+    }
+  }
+#ifdef __linux__
+  if (UI_event_fd_ >= 0) close(UI_event_fd_);
+#endif
+}
+
+int Scheduler::GetNumberOfWorkers(PoolId pool_id) const {
+  std::lock_guard<std::mutex> lock(pools_mtx_);
+  assert(pool_id >= 0 && pool_id < (PoolId)pools_.size());
+  return (int)pools_[(size_t)pool_id]->workers.size();
+}
+
+Scheduler::PoolId Scheduler::AddPool(const std::string& name,
+                                     int worker_threads, int first_cpu) {
+  assert(worker_threads > 0);
+  PoolId pool_id;
+  assert(!FindPool(name, pool_id));
+  std::lock_guard<std::mutex> lock(pools_mtx_);
+  pool_id = (PoolId)pools_.size();
+  pools_.emplace_back(new Pool(name));
+  LaunchWorkers(*pools_.back(), worker_threads, first_cpu);
+  return pool_id;
+}
+
+bool Scheduler::FindPool(const std::string& name, PoolId& pool_id) const {
+  std::lock_guard<std::mutex> lock(pools_mtx_);
+  for (size_t i = 0; i < pools_.size(); ++i) {
+    if (pools_[i]->name == name) {
+      pool_id = (PoolId)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Scheduler::LaunchWorkers(Pool& pool, int worker_threads, int first_cpu) {
+  pool.workers.reserve((size_t)worker_threads);
+  for (int i = 0; i < worker_threads; ++i) {
+    pool.workers.emplace_back(&Scheduler::DoWorkerTasks, this, &pool);
+    if (first_cpu >= 0) PinThread(pool.workers.back(), first_cpu + i);
+  }
+}
+
+bool Scheduler::PinThread(std::thread& thread, int cpu) {
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET((size_t)cpu, &cpus);
+  return pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t),
+                                &cpus) == 0;
+#else
+  (void)thread;
+  (void)cpu;
+  return false;
+#endif
+}
+
+Scheduler::SourceHandle Scheduler::RegisterSource(SourceId source_id,
+                                                  int packet_size,
+                                                  int packets_in_queue,
+                                                  int metadata_size) {
+  std::lock_guard<std::mutex> lock(sources_mtx_);
+  int index = (int)sources_.size();
+  if (index >= kMaxSources || GetSourceHandle(source_id).valid())
+    return SourceHandle();
+  sources_.emplace_back(
+      new Source(source_id, packet_size, packets_in_queue, metadata_size));
+  source_table_[(size_t)index].store(sources_.back().get(),
+                                     std::memory_order_release);
+  source_count_.store(index + 1, std::memory_order_release);
+  int slot = GetFirstSourceIndexSlot(source_id);
+  while (source_index_[(size_t)slot].index.load(std::memory_order_relaxed) >= 0)
+    slot = (slot + 1) % kSourceIndexSize;
+  SourceIndexEntry& entry = source_index_[(size_t)slot];
+  entry.source_id.store(source_id, std::memory_order_relaxed);
+  entry.index.store(index, std::memory_order_release);
+  SourceHandle handle;
+  handle.index = index;
+  return handle;
+}
+
+Scheduler::SourceHandle Scheduler::GetSourceHandle(SourceId source_id) const {
+  SourceHandle handle;
+  // ends at a free slot, the table is never full
+  for (int slot = GetFirstSourceIndexSlot(source_id);;
+       slot = (slot + 1) % kSourceIndexSize) {
+    const SourceIndexEntry& entry = source_index_[(size_t)slot];
+    int index = entry.index.load(std::memory_order_acquire);
+    if (index < 0) return handle;
+    if (entry.source_id.load(std::memory_order_relaxed) == source_id) {
+      handle.index = index;
+      return handle;
     }
   }
 }
 
-int Scheduler::GetNumberOfWorkers() const { return (int)workers_.size(); }
+int Scheduler::GetFirstSourceIndexSlot(SourceId source_id) {
+  // module ids are aligned addresses, allocated ones are consecutive
+  uint64_t hash = (uint64_t)source_id * 0x9E3779B97F4A7C15ull;
+  return (int)((hash >> 32) % kSourceIndexSize);
+}
+
+Scheduler::SourceId Scheduler::AllocateSourceId() {
+  return next_allocated_source_id_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Scheduler::SetSourceName(SourceId source_id, const std::string& name) {
+  std::lock_guard<std::mutex> lock(source_names_mtx_);
+  auto result = source_names_.emplace(name, source_id);
+  assert(result.second || result.first->second == source_id);
+  (void)result;
+}
 
-void Scheduler::RegisterSource(SourceId source_id, int packet_size,
-                               int packets_in_queue) {
-  WriteLockSources();
-  assert(std::is_sorted(sources_.begin(), sources_.end()));
-  assert(!std::binary_search(sources_.begin(), sources_.end(),
-                             SourceRef(source_id)));
-  sources_.emplace_back(source_id, packet_size, packets_in_queue);
-  std::sort(sources_.begin(), sources_.end());
-  WriteUnlockSources();
+bool Scheduler::FindSource(const std::string& name,
+                           SourceId& source_id) const {
+  std::lock_guard<std::mutex> lock(source_names_mtx_);
+  auto it = source_names_.find(name);
+  if (it == source_names_.end()) return false;
+  source_id = it->second;
+  return true;
+}
+
+int Scheduler::GetPacketSize(SourceHandle source) {
+  return GetSource(source).packet_size;
 }
 
 int Scheduler::GetPacketSize(SourceId source_id) {
-  return GetSourceById(source_id).packet_size;
+  SourceHandle source = GetSourceHandle(source_id);
+  return source.valid() ? GetPacketSize(source) : 0;
+}
+
+int Scheduler::GetMetadataSize(SourceHandle source) {
+  return GetSource(source).metadata_size;
+}
+
+int Scheduler::GetMetadataSize(SourceId source_id) {
+  SourceHandle source = GetSourceHandle(source_id);
+  return source.valid() ? GetMetadataSize(source) : 0;
+}
+
+Scheduler::Byte* Scheduler::GetPacketMetadata(SourceHandle source,
+                                              const Byte* packet) {
+  Source& src = GetSource(source);
+  assert(src.metadata_size > 0);
+  int packet_num =
+      static_cast<int>(packet - &src.packet_buffer[0]) / src.packet_size;
+  assert(packet_num >= 0 && packet_num < (int)src.packet_usages.size());
+  return &src.metadata_buffer[(size_t)packet_num *
+                              (size_t)src.metadata_size];
+}
+
+Scheduler::Byte* Scheduler::GetPacketMetadata(SourceId source_id,
+                                              const Byte* packet) {
+  SourceHandle source = GetSourceHandle(source_id);
+  return source.valid() ? GetPacketMetadata(source, packet) : nullptr;
+}
+
+void Scheduler::SetQueueLimit(SourceHandle source, int packets) {
+  Source& src = GetSource(source);
+  LockSource(src);
+  int capacity = (int)src.packet_usages.size();
+  src.queue_limit = std::max(1, std::min(packets, capacity));
+  UnlockSource(src);
+  NotifyWaitingProducers(src);
+}
+
+void Scheduler::SetQueueLimit(SourceId source_id, int packets) {
+  SourceHandle source = GetSourceHandle(source_id);
+  if (source.valid()) SetQueueLimit(source, packets);
+}
+
+Scheduler::QueueStats Scheduler::GetQueueStats(SourceHandle source,
+                                               bool reset_counters) {
+  Source& src = GetSource(source);
+  QueueStats stats;
+  LockSource(src);
+  stats.capacity = (int)src.packet_usages.size();
+  stats.limit = src.queue_limit;
+  stats.in_use = stats.capacity - (int)src.free_packets.size();
+  stats.peak_in_use = src.peak_in_use;
+  stats.overruns = src.overruns;
+  if (reset_counters) {
+    src.peak_in_use = stats.in_use;
+    src.overruns = 0;
+  }
+  UnlockSource(src);
+  return stats;
+}
+
+Scheduler::QueueStats Scheduler::GetQueueStats(SourceId source_id,
+                                               bool reset_counters) {
+  SourceHandle source = GetSourceHandle(source_id);
+  if (!source.valid()) return QueueStats();
+  return GetQueueStats(source, reset_counters);
 }
 
 void Scheduler::Subscribe(SourceId source_id, SinkCallback sink_callback,
-                          bool on_UI, int& subscription_id) {
-  Source& src = GetSourceById(source_id);
+                          bool on_UI, int& subscription_id, PoolId pool_id) {
+  subscription_id = AddSubscription(
+      source_id,
+      Subscription(sink_callback, on_UI, GetPoolById(pool_id), nullptr));
+}
+
+void Scheduler::SubscribeInOrder(SourceId source_id, SinkCallback sink_callback,
+                                 int& subscription_id, PoolId pool_id) {
+  auto in_order = std::make_shared<InOrderSink>();
+  in_order->sink_callback = sink_callback;
+  subscription_id = AddInOrderSubscription(source_id, in_order, pool_id);
+}
+
+void Scheduler::SubscribeBatch(SourceId source_id,
+                               BatchSinkCallback batch_callback, int max_batch,
+                               int& subscription_id, PoolId pool_id) {
+  assert(max_batch > 0);
+  auto in_order = std::make_shared<InOrderSink>();
+  in_order->batch_callback = batch_callback;
+  in_order->max_batch = max_batch;
+  in_order->batch_packets.reserve((size_t)max_batch);
+  in_order->batch_timestamps.reserve((size_t)max_batch);
+  subscription_id = AddInOrderSubscription(source_id, in_order, pool_id);
+}
+
+int Scheduler::AddInOrderSubscription(SourceId source_id,
+                                      std::shared_ptr<InOrderSink> in_order,
+                                      PoolId pool_id) {
+  // Tasks only trigger the sink, the packets are taken from in_order.
+  SinkCallback drain = [in_order](SourceId id, const Byte*, Time) {
+    in_order->Drain(id);
+  };
+  return AddSubscription(
+      source_id, Subscription(drain, false, GetPoolById(pool_id), in_order));
+}
+
+int Scheduler::AddSubscription(SourceId source_id,
+                               const Subscription& subscription) {
+  SourceHandle source = GetSourceHandle(source_id);
+  if (!source.valid()) return -1;
+  Source& src = GetSource(source);
   LockSource(src);
   auto& subs = src.subscriptions;
   size_t id = 0;
   while (id < subs.size()) {
     if (!subs[id].sink_callback) {
-      subs[id].sink_callback = sink_callback;
-      subs[id].on_UI = on_UI;
+      subs[id] = subscription;
       break;
     }
     id++;
   }
-  if (id == subs.size()) subs.emplace_back(sink_callback, on_UI);
+  if (id == subs.size()) subs.push_back(subscription);
   UnlockSource(src);
-  subscription_id = (int)id;
+  return (int)id;
 }
 
 void Scheduler::Unsubscribe(SourceId source_id, int subscription_id) {
-  Source& src = GetSourceById(source_id);
+  SourceHandle source = GetSourceHandle(source_id);
+  if (!source.valid()) return;
+  Source& src = GetSource(source);
   LockSource(src);
   auto& subs = src.subscriptions;
   assert(subscription_id >= 0 && subscription_id < (int)subs.size());
   subs[(size_t)subscription_id].sink_callback = nullptr;
+  // Pending tasks keep their sink to deliver the pending packets.
+  subs[(size_t)subscription_id].in_order = nullptr;
   UnlockSource(src);
 }
 
+Scheduler::Byte* Scheduler::GetPacketForSubmission(SourceHandle source) {
+  return AcquirePacket(GetSource(source), true);
+}
+
 Scheduler::Byte* Scheduler::GetPacketForSubmission(SourceId source_id) {
-  Source& src = GetSourceById(source_id);
+  SourceHandle source = GetSourceHandle(source_id);
+  return source.valid() ? GetPacketForSubmission(source) : nullptr;
+}
+
+Scheduler::Byte* Scheduler::WaitForPacketForSubmission(SourceHandle source,
+                                                      int timeout_in_ms) {
+  Source& src = GetSource(source);
+  Byte* packet = AcquirePacket(src, false);
+  if (packet) return packet;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeout_in_ms);
+  std::unique_lock<std::mutex> lock(src.release_mtx);
+  // Releasers notify after freeing a packet if they see a waiter, so a
+  // packet freed after the check below cannot be missed.
+  src.waiting_producers++;
+  while (!(packet = AcquirePacket(src, false)) &&
+         !shutdown_initiated_.load(std::memory_order_acquire)) {
+    if (src.packet_released.wait_until(lock, deadline) ==
+        std::cv_status::timeout) {
+      packet = AcquirePacket(src, true);
+      break;
+    }
+  }
+  src.waiting_producers--;
+  return packet;
+}
+
+Scheduler::Byte* Scheduler::WaitForPacketForSubmission(SourceId source_id,
+                                                      int timeout_in_ms) {
+  SourceHandle source = GetSourceHandle(source_id);
+  if (!source.valid()) return nullptr;
+  return WaitForPacketForSubmission(source, timeout_in_ms);
+}
+
+Scheduler::Byte* Scheduler::AcquirePacket(Source& src, bool count_overrun) {
   LockSource(src);
-  if (src.free_packets.empty()) {
+  int in_use = (int)(src.packet_usages.size() - src.free_packets.size());
+  if (src.free_packets.empty() || in_use >= src.queue_limit) {
+    if (count_overrun) src.overruns++;
     UnlockSource(src);
     return nullptr;
   }
+  if (in_use + 1 > src.peak_in_use) src.peak_in_use = in_use + 1;
   int packet_num = src.free_packets.back();
   assert(src.packet_refcounts.size() == src.packet_usages.size());
   assert(src.free_packets.size() <= src.packet_refcounts.size());
@@ -97,59 +375,80 @@ Scheduler::Byte* Scheduler::GetPacketForSubmission(SourceId source_id) {
   return &src.packet_buffer[(size_t)packet_num * (size_t)src.packet_size];
 }
 
+void Scheduler::SubmitPacket(SourceHandle source, Byte* packet,
+                             Time timestamp) {
+  SubmitPackets(source, &packet, &timestamp, 1);
+}
+
 void Scheduler::SubmitPacket(SourceId source_id, Byte* packet, Time timestamp) {
-  Source& src = GetSourceById(source_id);
-  int packet_num =
-      static_cast<int>(packet - &src.packet_buffer[0]) / src.packet_size;
+  SourceHandle source = GetSourceHandle(source_id);
+  if (source.valid()) SubmitPackets(source, &packet, &timestamp, 1);
+}
+
+void Scheduler::SubmitPackets(SourceHandle source, Byte* const* packets,
+                              const Time* timestamps, int count) {
+  assert(count > 0);
+  Source& src = GetSource(source);
   assert(src.packet_refcounts.size() == src.packet_usages.size());
-  assert(src.free_packets.size() < src.packet_refcounts.size());
-  assert(packet_num >= 0 && packet_num < (int)src.packet_refcounts.size());
-  assert(src.packet_usages[(size_t)packet_num] == true);
-  assert(src.packet_refcounts[(size_t)packet_num] == 0);
+  assert(src.free_packets.size() + (size_t)count <=
+         src.packet_refcounts.size());
+#ifndef NDEBUG
+  for (int i = 0; i < count; ++i) {
+    int packet_num = GetPacketNum(src, packets[i]);
+    assert(src.packet_usages[(size_t)packet_num] == true);
+    assert(src.packet_refcounts[(size_t)packet_num] == 0);
+  }
+#endif
 
   LockSource(src);
-  src.packet_refcounts[(size_t)packet_num] = 0;
-  int UI_subscribers = 0;
-  int normal_subscribers = 0;
+  // Each pool gets its own task, the refcount of the source covers them all.
   for (auto& subscription : src.subscriptions) {
-    if (subscription.sink_callback) {
-      if (subscription.on_UI)
-        UI_subscribers++;
-      else
-        normal_subscribers++;
+    if (!subscription.sink_callback) continue;
+    Pool& pool = subscription.on_UI ? UI_pool_ : *subscription.pool;
+    // Counted before any task can reach the packets
+    for (int i = 0; i < count; ++i)
+      ++src.packet_refcounts[(size_t)GetPacketNum(src, packets[i])];
+    int task_count = count;
+    bool UI_queue_was_empty = false;
+    if (subscription.in_order) {
+      // The source lock keeps the order of submission. One task drains
+      // all the packets pushed.
+      subscription.in_order->Push(packets, timestamps, count);
+      task_count = 1;
     }
-  }
-  if (UI_subscribers) {
-    std::lock_guard<std::mutex> lock(UI_queue_mtx_);
-    for (auto& subscription : src.subscriptions) {
-      if (subscription.sink_callback && subscription.on_UI) {
-        tasks_for_UI_.emplace(timestamp, source_id, subscription.sink_callback,
-                              packet);
-        ++src.packet_refcounts[(size_t)packet_num];
-      }
+    {
+      std::lock_guard<std::mutex> lock(pool.queue_mtx);
+      UI_queue_was_empty = subscription.on_UI && pool.tasks.empty();
+      for (int i = 0; i < task_count; ++i)
+        pool.tasks.emplace(timestamps[i], src.source_id,
+                           subscription.sink_callback, packets[i]);
     }
+    if (UI_queue_was_empty)
+      SignalUITasks();
+    else if (task_count == 1)
+      pool.queue_cv.notify_one();
+    else
+      pool.queue_cv.notify_all();
   }
-  if (normal_subscribers) {
-    std::lock_guard<std::mutex> lock(worker_queue_mtx_);
-    for (auto& subscription : src.subscriptions) {
-      if (subscription.sink_callback && !subscription.on_UI) {
-        tasks_for_workers_.emplace(timestamp, source_id,
-                                   subscription.sink_callback, packet);
-        ++src.packet_refcounts[(size_t)packet_num];
-      }
+  for (int i = 0; i < count; ++i) {
+    int packet_num = GetPacketNum(src, packets[i]);
+    if (src.packet_refcounts[(size_t)packet_num] == 0) {
+      src.free_packets.push_back(packet_num);
+      src.packet_usages[(size_t)packet_num] = false;
     }
   }
-  if (UI_subscribers) UI_queue_cv_.notify_one();
-  while (normal_subscribers--) worker_queue_cv_.notify_one();
-  if (src.packet_refcounts[(size_t)packet_num] == 0) {
-    src.free_packets.push_back(packet_num);
-    src.packet_usages[(size_t)packet_num] = false;
-  }
   UnlockSource(src);
+  NotifyWaitingProducers(src);
 }
 
-void Scheduler::ReleasePacket(SourceId source_id, const Byte* packet) {
-  Source& src = GetSourceById(source_id);
+void Scheduler::SubmitPackets(SourceId source_id, Byte* const* packets,
+                              const Time* timestamps, int count) {
+  SourceHandle source = GetSourceHandle(source_id);
+  if (source.valid()) SubmitPackets(source, packets, timestamps, count);
+}
+
+void Scheduler::ReleasePacket(SourceHandle source, const Byte* packet) {
+  Source& src = GetSource(source);
   int packet_num =
       static_cast<int>(packet - &src.packet_buffer[0]) / src.packet_size;
   assert(src.packet_refcounts.size() == src.packet_usages.size());
@@ -159,30 +458,129 @@ void Scheduler::ReleasePacket(SourceId source_id, const Byte* packet) {
   assert(src.packet_refcounts[(size_t)packet_num] > 0);
 
   LockSource(src);
-  if (--src.packet_refcounts[(size_t)packet_num] == 0) {
+  bool freed = --src.packet_refcounts[(size_t)packet_num] == 0;
+  if (freed) {
     src.free_packets.push_back(packet_num);
     src.packet_usages[(size_t)packet_num] = false;
   }
   UnlockSource(src);
+  if (freed) NotifyWaitingProducers(src);
+}
+
+void Scheduler::ReleasePacket(SourceId source_id, const Byte* packet) {
+  SourceHandle source = GetSourceHandle(source_id);
+  if (source.valid()) ReleasePacket(source, packet);
+}
+
+void Scheduler::ReleasePackets(SourceHandle source, const Byte* const* packets,
+                               int count) {
+  Source& src = GetSource(source);
+  LockSource(src);
+  for (int i = 0; i < count; ++i) {
+    int packet_num = GetPacketNum(src, packets[i]);
+    assert(src.packet_usages[(size_t)packet_num] == true);
+    assert(src.packet_refcounts[(size_t)packet_num] > 0);
+    if (--src.packet_refcounts[(size_t)packet_num] == 0) {
+      src.free_packets.push_back(packet_num);
+      src.packet_usages[(size_t)packet_num] = false;
+    }
+  }
+  UnlockSource(src);
+  NotifyWaitingProducers(src);
+}
+
+void Scheduler::ReleasePackets(SourceId source_id, const Byte* const* packets,
+                               int count) {
+  SourceHandle source = GetSourceHandle(source_id);
+  if (source.valid()) ReleasePackets(source, packets, count);
+}
+
+void Scheduler::ParallelFor(int begin, int end, int grain,
+                            const RangeCallback& body, PoolId pool_id) {
+  assert(grain > 0);
+  if (begin >= end) return;
+  auto job = std::make_shared<ParallelJob>();
+  job->body = &body;
+  job->begin = begin;
+  job->end = end;
+  job->grain = grain;
+  job->ranges = (end - begin + grain - 1) / grain;
+  Pool* pool = GetPoolById(pool_id);
+  int helpers = std::min(job->ranges - 1, (int)pool->workers.size());
+  if (helpers > 0) {
+    SinkCallback help = [job](SourceId, const Byte*, Time) { job->Run(); };
+    {
+      std::lock_guard<std::mutex> lock(pool->queue_mtx);
+      // The earliest timestamp, the packet of the caller is being processed.
+      for (int i = 0; i < helpers; ++i)
+        pool->tasks.emplace(0, 0, help, nullptr);
+    }
+    for (int i = 0; i < helpers; ++i) pool->queue_cv.notify_one();
+  }
+  job->Run();
+  std::unique_lock<std::mutex> lock(job->mtx);
+  job->all_done.wait(lock, [&job] { return job->ranges_done == job->ranges; });
+}
+
+void Scheduler::DoUITaskStep() { DispatchTasks(UI_pool_, true); }
+
+int Scheduler::DoUITasks(int max_tasks) {
+  // Tasks queued from now on are either run below or signaled again.
+  ClearUITasksSignal();
+  int done = 0;
+  for (; done < max_tasks; ++done) {
+    {
+      std::lock_guard<std::mutex> lock(UI_pool_.queue_mtx);
+      if (UI_pool_.tasks.empty()) break;
+    }
+    DispatchTasks(UI_pool_, true);  // the only consumer of the queue
+  }
+  std::lock_guard<std::mutex> lock(UI_pool_.queue_mtx);
+  if (!UI_pool_.tasks.empty()) SignalUITasks();
+  return done;
 }
 
-void Scheduler::DoUITaskStep() { DispatchTasks(true); }
+void Scheduler::SignalUITasks() {
+#ifdef __linux__
+  if (UI_event_fd_ < 0) return;
+  uint64_t one = 1;
+  ssize_t written = write(UI_event_fd_, &one, sizeof(one));
+  (void)written;  // only fails if the counter is full: signaled anyway
+#endif
+}
+
+void Scheduler::ClearUITasksSignal() {
+#ifdef __linux__
+  if (UI_event_fd_ < 0) return;
+  uint64_t counter;
+  ssize_t was_read = read(UI_event_fd_, &counter, sizeof(counter));
+  (void)was_read;  // fails if it was not signaled
+#endif
+}
 
 void Scheduler::Shutdown() {
-  {
-    std::lock_guard<std::mutex> lock(worker_queue_mtx_);
-    shutdown_initiated_.store(true, std::memory_order_release);
+  shutdown_initiated_.store(true, std::memory_order_release);
+  std::lock_guard<std::mutex> pools_lock(pools_mtx_);
+  for (auto& pool : pools_) {
+    // Waiters either see the flag or get the notification.
+    { std::lock_guard<std::mutex> lock(pool->queue_mtx); }
+    pool->queue_cv.notify_all();
+  }
+  UI_pool_.queue_cv.notify_all();
+  int sources = source_count_.load(std::memory_order_acquire);
+  for (int i = 0; i < sources; ++i) {
+    Source& src = *source_table_[(size_t)i].load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lock(src.release_mtx);
+    src.packet_released.notify_all();
   }
-  worker_queue_cv_.notify_all();
-  UI_queue_cv_.notify_all();
 }
 
-void Scheduler::DoWorkerTasks() { DispatchTasks(false); }
+void Scheduler::DoWorkerTasks(Pool* pool) { DispatchTasks(*pool, false); }
 
-void Scheduler::DispatchTasks(bool UI_thread_mode) {
-  auto& tasks = UI_thread_mode ? tasks_for_UI_ : tasks_for_workers_;
-  auto& mutex = UI_thread_mode ? UI_queue_mtx_ : worker_queue_mtx_;
-  auto& cond_var = UI_thread_mode ? UI_queue_cv_ : worker_queue_cv_;
+void Scheduler::DispatchTasks(Pool& pool, bool UI_thread_mode) {
+  auto& tasks = pool.tasks;
+  auto& mutex = pool.queue_mtx;
+  auto& cond_var = pool.queue_cv;
   while (!shutdown_initiated_.load(std::memory_order_acquire)) {
     SinkCallback sink_callback;
     SourceId source_id;
@@ -199,7 +597,7 @@ void Scheduler::DispatchTasks(bool UI_thread_mode) {
         const TaskRef& task_ref = tasks.top();
         Task& task = *task_ref.ptr;
         assert(task.sink_callback);
-        assert(task.packet);
+        // ParallelFor() tasks have no packet
         sink_callback = task.sink_callback;
         source_id = task.source_id;
         packet = task.packet;
@@ -214,35 +612,84 @@ void Scheduler::DispatchTasks(bool UI_thread_mode) {
   }
 }
 
+void Scheduler::InOrderSink::Push(Byte* const* packets, const Time* timestamps,
+                                  int count) {
+  std::lock_guard<std::mutex> lock(mtx);
+  for (int i = 0; i < count; ++i)
+    pending.emplace_back(packets[i], timestamps[i]);
+}
+
+void Scheduler::InOrderSink::Drain(SourceId source_id) {
+  std::unique_lock<std::mutex> lock(mtx);
+  if (running) return;  // the running task takes our packet as well
+  running = true;
+  while (!pending.empty()) {
+    if (batch_callback) {
+      batch_packets.clear();
+      batch_timestamps.clear();
+      while (!pending.empty() && (int)batch_packets.size() < max_batch) {
+        batch_packets.push_back(pending.front().first);
+        batch_timestamps.push_back(pending.front().second);
+        pending.pop_front();
+      }
+      lock.unlock();
+      batch_callback(source_id, batch_packets.data(), batch_timestamps.data(),
+                     (int)batch_packets.size());
+      lock.lock();
+      continue;
+    }
+    auto next = pending.front();
+    pending.pop_front();
+    lock.unlock();
+    sink_callback(source_id, next.first, next.second);
+    lock.lock();
+  }
+  running = false;
+}
+
+void Scheduler::ParallelJob::Run() {
+  int range;
+  while ((range = next_range.fetch_add(1)) < ranges) {
+    int range_begin = begin + range * grain;
+    (*body)(range_begin, std::min(end, range_begin + grain));
+    if (ranges_done.fetch_add(1) + 1 == ranges) {
+      std::lock_guard<std::mutex> lock(mtx);
+      all_done.notify_all();
+    }
+  }
+}
+
 Scheduler::Subscription::Subscription(SinkCallback _sink_callback,
-                                      bool _on_UI) {
+                                      bool _on_UI, Pool* _pool,
+                                      std::shared_ptr<InOrderSink> _in_order) {
   sink_callback = _sink_callback;
   on_UI = _on_UI;
+  pool = _pool;
+  in_order = _in_order;
 }
 
-Scheduler::SourceRef::SourceRef(SourceId _source_id) : source_id(_source_id) {}
-
-Scheduler::SourceRef::SourceRef(SourceId _source_id, int packet_size,
-                                int packets_in_queue)
-    : SourceRef(_source_id) {
-  assert(packet_size >= 0);
+Scheduler::Source::Source(SourceId _source_id, int _packet_size,
+                          int packets_in_queue, int _metadata_size)
+    : source_id(_source_id) {
+  assert(_packet_size >= 0);
   assert(packets_in_queue > 0);
-  ptr.reset(new Source());
-  ptr->source_mtx_.clear(std::memory_order_release);
-  ptr->packet_size = packet_size;
-  ptr->free_packets.reserve((size_t)packets_in_queue);
-  ptr->packet_usages.resize((size_t)packets_in_queue, false);
-  ptr->packet_refcounts.resize((size_t)packets_in_queue, 0);
-  ptr->packet_buffer.resize((size_t)packets_in_queue * (size_t)packet_size, 0);
+  assert(_metadata_size >= 0);
+  source_mtx_.clear(std::memory_order_release);
+  packet_size = _packet_size;
+  queue_limit = packets_in_queue;
+  peak_in_use = 0;
+  overruns = 0;
+  free_packets.reserve((size_t)packets_in_queue);
+  packet_usages.resize((size_t)packets_in_queue, false);
+  packet_refcounts.resize((size_t)packets_in_queue, 0);
+  packet_buffer.resize((size_t)packets_in_queue * (size_t)packet_size, 0);
+  metadata_size = _metadata_size;
+  metadata_buffer.resize((size_t)packets_in_queue * (size_t)metadata_size, 0);
   for (int i = packets_in_queue - 1; i >= 0; --i) {
-    ptr->free_packets.push_back(i);
+    free_packets.push_back(i);
   }
 }
 
-bool Scheduler::SourceRef::operator<(const SourceRef& o) const {
-  return source_id < o.source_id;
-}
-
 Scheduler::TaskRef::TaskRef(Time _timestamp, SourceId source_id,
                             SinkCallback sink_callback, Byte* packet) {
   timestamp = _timestamp;
@@ -252,59 +699,36 @@ Scheduler::TaskRef::TaskRef(Time _timestamp, SourceId source_id,
   ptr->packet = packet;
 }
 
+Scheduler::Pool::Pool(const std::string& _name) : name(_name) {}
+
 bool Scheduler::TaskRef::operator<(const TaskRef& o) const {
   return timestamp > o.timestamp;  // finish the earliest job first
 }
 
-Scheduler::Source& Scheduler::GetSourceById(SourceId source_id) {
-  ReadLockSources();
-  auto src_it =
-      std::lower_bound(sources_.begin(), sources_.end(), SourceRef(source_id));
-  assert(src_it != sources_.end() && src_it->source_id == source_id);
-  Source& src = *src_it->ptr;
-  ReadUnlockSources();
-  return src;
-}
-
-void Scheduler::WriteLockSources() {
-  int cycles_left = max_spin_cycles_before_yield;
-  int all_readers;
-  do {
-    if (--cycles_left == 0) {
-      std::this_thread::yield();
-      cycles_left = max_spin_cycles_before_yield;
-    }
-    all_readers = GetNumberOfWorkers() + 1;
-  } while (!sources_semaphore_.compare_exchange_weak(
-      all_readers, 0, std::memory_order_acq_rel));
+Scheduler::Pool* Scheduler::GetPoolById(PoolId pool_id) {
+  std::lock_guard<std::mutex> lock(pools_mtx_);
+  assert(pool_id >= 0 && pool_id < (PoolId)pools_.size());
+  return pools_[(size_t)pool_id].get();
 }
 
-void Scheduler::WriteUnlockSources() {
-  int all_readers = GetNumberOfWorkers() + 1;
-  sources_semaphore_.store(all_readers, std::memory_order_release);
+int Scheduler::GetPacketNum(const Source& src, const Byte* packet) {
+  int packet_num =
+      static_cast<int>(packet - &src.packet_buffer[0]) / src.packet_size;
+  assert(packet_num >= 0 && packet_num < (int)src.packet_refcounts.size());
+  return packet_num;
 }
 
-void Scheduler::ReadLockSources() {
-  int cycles_left = max_spin_cycles_before_yield;
-  int current_readers;
-  do {
-    if (--cycles_left == 0) {
-      std::this_thread::yield();
-      cycles_left = max_spin_cycles_before_yield;
-    }
-    current_readers = sources_semaphore_.load(std::memory_order_acquire);
-    if (current_readers <= 0) continue;
-    if (sources_semaphore_.compare_exchange_weak(
-            current_readers, current_readers - 1, std::memory_order_acq_rel)) {
-      break;
-    }
-  } while (1);
+Scheduler::Source& Scheduler::GetSource(SourceHandle source) {
+  assert(source.index >= 0 &&
+         source.index < source_count_.load(std::memory_order_acquire));
+  return *source_table_[(size_t)source.index].load(std::memory_order_acquire);
 }
 
-void Scheduler::ReadUnlockSources() {
-  int readers_left = sources_semaphore_.fetch_add(1, std::memory_order_acq_rel);
-  assert(readers_left <= GetNumberOfWorkers() + 1);
-  (void)readers_left;
+void Scheduler::NotifyWaitingProducers(Source& src) {
+  if (src.waiting_producers.load() == 0) return;
+  // The waiter is either before its last check or waiting already.
+  { std::lock_guard<std::mutex> lock(src.release_mtx); }
+  src.packet_released.notify_all();
 }
 
 void Scheduler::LockSource(Source& src) {
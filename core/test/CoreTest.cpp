@@ -75,11 +75,24 @@ void CanRegisterMemberFunction() {
   thr.join();
 }
 
+void LateRegistrationIsCalledAtOnce() {
+  ModuleCenter mc(sizeof(params) / sizeof(char*), params);
+  Core& core = mc.Get<zamt::Core>();
+  Core::ReInitExitCode();
+  core.Quit(97);
+  QuitClient qc;
+  core.RegisterForQuitEvent(
+      std::bind(&QuitClient::SetToExitCode, &qc, std::placeholders::_1));
+  EXPECT(qc.member_sets_to_exit_code == 97);
+  EXPECT(core.WaitForQuit() == 97);
+}
+
 TEST_BEGIN() {
   ShutsDownFromOtherThread();
   ShutsDownFromOtherThreadImmediately();
   ShutsDownForSignal(SIGINT);
   ShutsDownForSignal(SIGTERM);
   CanRegisterMemberFunction();
+  LateRegistrationIsCalledAtOnce();
 }
 TEST_END()
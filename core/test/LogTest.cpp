@@ -0,0 +1,130 @@
+#include "zamt/core/Log.h"
+#include "zamt/core/TestSuite.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace zamt;
+
+std::vector<std::string> ReadLines(FILE* file) {
+  std::vector<std::string> lines;
+  char line[512];
+  rewind(file);
+  while (fgets(line, sizeof(line), file)) lines.push_back(line);
+  return lines;
+}
+
+void LevelsFollowParams() {
+  const char* quiet[] = {"exec"};
+  Log log_quiet("test", CLIParameters(1, quiet));
+  EXPECT(log_quiet.IsEnabled(Log::kError));
+  EXPECT(log_quiet.IsEnabled(Log::kWarning));
+  EXPECT(!log_quiet.IsEnabled(Log::kInfo));
+
+  const char* verbose[] = {"exec", "-v"};
+  Log log_verbose("test", CLIParameters(2, verbose));
+  EXPECT(log_verbose.IsEnabled(Log::kInfo));
+  EXPECT(!log_verbose.IsEnabled(Log::kDebug));
+
+  const char* debug_test[] = {"exec", "-vvtest"};
+  Log log_test("test", CLIParameters(2, debug_test));
+  Log log_other("other", CLIParameters(2, debug_test));
+  EXPECT(log_test.IsEnabled(Log::kDebug));
+  EXPECT(!log_other.IsEnabled(Log::kInfo));
+}
+
+static const int threads = 4;
+static const int messages = 100;
+
+void KeepsOrderOfEachThread() {
+  FILE* output = tmpfile();
+  ASSERT(output);
+  Log::SetOutputForTest(output);
+  const char* params[] = {"exec", "-v"};
+  CLIParameters cli(2, params);
+  std::vector<std::thread> loggers;
+  for (int t = 0; t < threads; ++t) {
+    loggers.emplace_back([&cli, t]() {
+      Log log("order", cli);
+      for (int i = 0; i < messages; ++i) log.Message("thread ", t, " ", i);
+    });
+  }
+  for (std::thread& logger : loggers) logger.join();
+  Log::Flush();
+  Log::SetOutputForTest(nullptr);
+
+  int next[threads] = {};
+  int wrong = 0;
+  for (const std::string& line : ReadLines(output)) {
+    int t, i;
+    if (sscanf(line.c_str(), "[order] thread %d %d", &t, &i) != 2 || t < 0 ||
+        t >= threads || i != next[t]++)
+      wrong++;
+  }
+  EXPECT(wrong == 0);
+  for (int t = 0; t < threads; ++t) EXPECT(next[t] == messages);
+  fclose(output);
+}
+
+void LimitsRepeatedMessages() {
+  FILE* output = tmpfile();
+  ASSERT(output);
+  Log::SetOutputForTest(output);
+  const char* params[] = {"exec"};
+  Log log("repeat", CLIParameters(1, params));
+  const int repeats = Log::kMaxRepeatsPerSecond + 15;
+  for (int i = 0; i < repeats; ++i)
+    log.LogMessage(Log::kWarning, "Overrun ", i, " times");
+  log.LogMessage(Log::kError, "Different");
+  Log::Flush();
+  Log::SetOutputForTest(nullptr);
+
+  int written = 0;
+  int different = 0;
+  int summaries = 0;
+  for (const std::string& line : ReadLines(output)) {
+    if (line.find("[repeat] Warning: Overrun ") == 0) written++;
+    if (line == "[repeat] Error: Different\n") different++;
+    if (line == "[repeat] 15 more of: Overrun \n") summaries++;
+  }
+  EXPECT(written == Log::kMaxRepeatsPerSecond);
+  EXPECT(different == 1);
+  EXPECT(summaries == 1);
+  fclose(output);
+}
+
+void CopiesMessageAndSuffix() {
+  FILE* output = tmpfile();
+  ASSERT(output);
+  Log::SetOutputForTest(output);
+  const char* params[] = {"exec"};
+  Log log("copy", CLIParameters(1, params));
+  {
+    std::string msg = "Stage spectrum: ";
+    std::string suffix = " frames lost";
+    log.LogMessage(Log::kWarning, msg.c_str(), 7, suffix.c_str());
+    msg.assign(msg.size(), 'x');
+  }
+  std::string long_msg(2 * Log::kMaxTextLength, 'm');
+  log.LogMessage(Log::kWarning, long_msg.c_str(), 1.5f, " s");
+  Log::Flush();
+  Log::SetOutputForTest(nullptr);
+
+  std::vector<std::string> lines = ReadLines(output);
+  ASSERT(lines.size() == 2);
+  EXPECT(lines[0] == "[copy] Warning: Stage spectrum: 7 frames lost\n");
+  EXPECT(lines[1].size() < 2 * Log::kMaxTextLength);
+  EXPECT(lines[1].find("mmm1.500000\n") != std::string::npos);
+  fclose(output);
+}
+
+TEST_BEGIN() {
+  LevelsFollowParams();
+  KeepsOrderOfEachThread();
+  LimitsRepeatedMessages();
+  CopiesMessageAndSuffix();
+}
+TEST_END()
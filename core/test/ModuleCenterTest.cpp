@@ -12,10 +12,16 @@ class ModuleOne : public Module {
   }
   ~ModuleOne() { count--; }
   void Initialize(const ModuleCenter* mc) { mcenter = mc; }
+  // Even of the modules which depend on this one.
+  void Connect(const ModuleCenter* mc);
+  void Start(const ModuleCenter*) { started_after_connected = connected; }
 
   static int count;
   int data;
   const ModuleCenter* mcenter;
+  bool connected = false;
+  bool connected_after_all_initialized = false;
+  bool started_after_connected = false;
 };
 
 class ModuleTwo : public Module {
@@ -33,15 +39,63 @@ class ModuleTwo : public Module {
   const ModuleCenter* mcenter;
 };
 
+// Needs the others for both construction and initialization.
+class ModuleThree : public Module {
+ public:
+  ModuleThree(int, const char* const*) {
+    count++;
+    created_after_dependencies = ModuleOne::count > 0 && ModuleTwo::count > 0;
+  }
+  ~ModuleThree() {
+    count--;
+    if (ModuleOne::count == 0 || ModuleTwo::count == 0)
+      destroyed_after_dependencies = true;
+  }
+  void Initialize(const ModuleCenter* mc) {
+    initialized_after_dependencies = mc->Get<ModuleOne>().mcenter == mc &&
+                                     mc->Get<ModuleTwo>().mcenter == mc;
+  }
+
+  static int count;
+  static bool destroyed_after_dependencies;
+  bool created_after_dependencies;
+  bool initialized_after_dependencies = false;
+};
+
+ZAMT_MODULE_DEPENDS(ModuleThree, ModuleOne, ModuleTwo);
+
+void ModuleOne::Connect(const ModuleCenter* mc) {
+  connected = true;
+  connected_after_all_initialized =
+      mc->Get<ModuleThree>().initialized_after_dependencies;
+}
+
 int ModuleOne::count = 0;
 int ModuleTwo::count = 0;
+int ModuleThree::count = 0;
+bool ModuleThree::destroyed_after_dependencies = false;
 
 void RegisteredModuleNumberIsCorrect() {
-  ASSERT(ModuleCenter::GetRegisteredModuleNumber() == 2);
+  ASSERT(ModuleCenter::GetRegisteredModuleNumber() == 3);
 }
 
 void ModuleIdsAreUnique() {
   ASSERT(ModuleCenter::GetId<ModuleOne>() != ModuleCenter::GetId<ModuleTwo>());
+  ASSERT(ModuleCenter::GetId<ModuleOne>() !=
+         ModuleCenter::GetId<ModuleThree>());
+}
+
+void DependenciesAreRespected() {
+  {
+    ModuleCenter mc(0, nullptr);
+    EXPECT(ModuleThree::count == 1);
+    EXPECT(mc.Get<ModuleThree>().created_after_dependencies);
+    EXPECT(mc.Get<ModuleThree>().initialized_after_dependencies);
+    EXPECT(mc.Get<ModuleOne>().connected_after_all_initialized);
+    EXPECT(mc.Get<ModuleOne>().started_after_connected);
+  }
+  EXPECT(ModuleThree::count == 0);
+  EXPECT(!ModuleThree::destroyed_after_dependencies);
 }
 
 void AllModulesAreStartedAndStopped() {
@@ -96,5 +150,6 @@ TEST_BEGIN() {
   ModuleIdsAreUnique();
   AllModulesAreStartedAndStopped();
   MultipleModulesCanLiveTogether();
+  DependenciesAreRespected();
 }
 TEST_END()
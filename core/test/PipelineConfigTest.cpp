@@ -0,0 +1,65 @@
+#include "zamt/core/PipelineConfig.h"
+#include "zamt/core/TestSuite.h"
+
+#include <cstring>
+#include <sstream>
+
+using namespace zamt;
+
+void ParsesStages() {
+  std::istringstream input(
+      "# two analyses of the same audio\n"
+      "fft spectrum input=LiveAudio size=2048 queue=16\n"
+      "\n"
+      "  fft onsets input=LiveAudio size=256  # short one\n"
+      "pitch voice input=spectrum\n");
+  PipelineConfig config;
+  int error_line = -1;
+  ASSERT(config.Parse(input, error_line));
+  ASSERT(config.stages().size() == 3);
+  std::vector<const PipelineConfig::Stage*> ffts = config.GetStages("fft");
+  ASSERT(ffts.size() == 2);
+  EXPECT(ffts[0]->name == "spectrum");
+  EXPECT(ffts[1]->name == "onsets");
+  EXPECT(strcmp(ffts[0]->GetParam("input"), "LiveAudio") == 0);
+  EXPECT(ffts[0]->GetNumParam("size", 0) == 2048);
+  EXPECT(ffts[1]->GetNumParam("size", 0) == 256);
+  EXPECT(ffts[1]->GetNumParam("queue", 42) == 42);
+  EXPECT(ffts[1]->GetParam("queue") == nullptr);
+  EXPECT(config.GetStages("pitch").size() == 1);
+  EXPECT(config.GetStages("none").empty());
+}
+
+void RejectsBadLines() {
+  const char* bad_inputs[] = {
+      "fft\n",                               // no name
+      "fft a size=1\nfft a size=2\n",        // name used twice
+      "fft a size\n",                        // no value
+      "fft a =1\n",                          // no key
+      "fft a size=1 size=2\n",               // key given twice
+      "fft size=1\n",                        // no name
+  };
+  const int bad_lines[] = {1, 2, 1, 1, 1, 1};
+  for (size_t i = 0; i < sizeof(bad_lines) / sizeof(int); ++i) {
+    std::istringstream input(bad_inputs[i]);
+    PipelineConfig config;
+    int error_line = -1;
+    EXPECT(!config.Parse(input, error_line));
+    EXPECT(error_line == bad_lines[i]);
+    EXPECT(config.stages().empty());
+  }
+}
+
+void MissingFileIsAnError() {
+  PipelineConfig config;
+  int error_line = -1;
+  EXPECT(!config.Load("/nonexistent/zamt.pipe", error_line));
+  EXPECT(error_line == 0);
+}
+
+TEST_BEGIN() {
+  ParsesStages();
+  RejectsBadLines();
+  MissingFileIsAnError();
+}
+TEST_END()
@@ -0,0 +1,119 @@
+#include "zamt/core/CLIParameters.h"
+#include "zamt/core/Log.h"
+#include "zamt/core/QueueTuner.h"
+#include "zamt/core/Scheduler.h"
+#include "zamt/core/TestSuite.h"
+
+#include <vector>
+
+using namespace zamt;
+
+const char* params[] = {"exec"};
+static const Scheduler::Time period = 1000;
+
+void StartsFromMinimum() {
+  CLIParameters cli(sizeof(params) / sizeof(char*), params);
+  Log log("QueueTunerTest", cli);
+  Scheduler sch;
+  sch.RegisterSource(1, 16, 32);
+  QueueTuner tuner(&sch, 1, 4, period, &log);
+  EXPECT(tuner.limit() == 4);
+  EXPECT(sch.GetQueueStats(1).limit == 4);
+  sch.Shutdown();
+}
+
+void ShrinksFromStartLimit() {
+  CLIParameters cli(sizeof(params) / sizeof(char*), params);
+  Log log("QueueTunerTest", cli);
+  Scheduler sch;
+  sch.RegisterSource(1, 16, 32);
+  QueueTuner tuner(&sch, 1, 4, period, &log, 16);
+  EXPECT(tuner.limit() == 16);
+  EXPECT(sch.GetQueueStats(1).limit == 16);
+  Scheduler::Time now = 1;
+  tuner.Update(now);
+  int periods = 0;
+  while (tuner.limit() > 4 && periods < 100) {
+    sch.SubmitPacket(1, sch.GetPacketForSubmission(1), 0);
+    now += period;
+    tuner.Update(now);
+    periods++;
+  }
+  EXPECT(tuner.limit() == 4);
+  sch.Shutdown();
+}
+
+void GrowsOnOverrunUpToCapacity() {
+  CLIParameters cli(sizeof(params) / sizeof(char*), params);
+  Log log("QueueTunerTest", cli);
+  Scheduler sch;
+  sch.RegisterSource(1, 16, 12);
+  QueueTuner tuner(&sch, 1, 4, period, &log);
+  std::vector<Scheduler::Byte*> held;
+  Scheduler::Time now = 1;
+  EXPECT(!tuner.Update(now));
+  int expected_limits[] = {8, 12, 12};
+  for (int expected_limit : expected_limits) {
+    // slow sink: everything is kept until the queue overflows
+    while (Scheduler::Byte* p = sch.GetPacketForSubmission(1))
+      held.push_back(p);
+    EXPECT(!tuner.Update(now + period / 2));
+    now += period;
+    tuner.Update(now);
+    EXPECT(tuner.limit() == expected_limit);
+    EXPECT(sch.GetQueueStats(1).limit == expected_limit);
+  }
+  EXPECT(held.size() == 12);
+  sch.Shutdown();
+}
+
+void GrowsOnHighOccupancy() {
+  CLIParameters cli(sizeof(params) / sizeof(char*), params);
+  Log log("QueueTunerTest", cli);
+  Scheduler sch;
+  sch.RegisterSource(1, 16, 16);
+  QueueTuner tuner(&sch, 1, 8, period, &log);
+  Scheduler::Time now = 1;
+  tuner.Update(now);
+  for (int i = 0; i < 6; ++i) ASSERT(sch.GetPacketForSubmission(1));
+  now += period;
+  EXPECT(tuner.Update(now));
+  EXPECT(tuner.limit() == 10);
+  sch.Shutdown();
+}
+
+void ShrinksWhenIdle() {
+  CLIParameters cli(sizeof(params) / sizeof(char*), params);
+  Log log("QueueTunerTest", cli);
+  Scheduler sch;
+  sch.RegisterSource(1, 16, 16);
+  QueueTuner tuner(&sch, 1, 4, period, &log);
+  Scheduler::Time now = 1;
+  tuner.Update(now);
+  std::vector<Scheduler::Byte*> held;
+  while (Scheduler::Byte* p = sch.GetPacketForSubmission(1)) held.push_back(p);
+  now += period;
+  EXPECT(tuner.Update(now));
+  EXPECT(tuner.limit() == 8);
+  // no sinks, so submitted packets are free again at once
+  for (Scheduler::Byte* p : held) sch.SubmitPacket(1, p, 0);
+  int periods = 0;
+  while (tuner.limit() > 4 && periods < 100) {
+    sch.SubmitPacket(1, sch.GetPacketForSubmission(1), 0);
+    now += period;
+    tuner.Update(now);
+    periods++;
+  }
+  EXPECT(tuner.limit() == 4);
+  EXPECT(periods > QueueTuner::kIdlePeriodsBeforeShrink);
+  sch.Shutdown();
+}
+
+TEST_BEGIN() {
+  StartsFromMinimum();
+  ShrinksFromStartLimit();
+  GrowsOnOverrunUpToCapacity();
+  GrowsOnHighOccupancy();
+  ShrinksWhenIdle();
+}
+TEST_END()
@@ -0,0 +1,89 @@
+#include "zamt/core/SampleClock.h"
+#include "zamt/core/TestSuite.h"
+
+#include <cmath>
+#include <cstdint>
+
+using namespace zamt;
+
+static const int sample_rate = 48000;
+static const Scheduler::Time start_time = 1500000000000000ull;
+
+// Deterministic jitter in [-max_jitter, max_jitter] microseconds.
+static uint32_t rand_state = 1;
+int Jitter(int max_jitter) {
+  rand_state = rand_state * 1103515245u + 12345u;
+  return (int)((rand_state >> 8) % (uint32_t)(2 * max_jitter + 1)) -
+         max_jitter;
+}
+
+// The device clock runs at sample_rate * (1 + drift_ppm / 1e6).
+double TrueTime(uint64_t position, double drift_ppm) {
+  return (double)position * 1000000.0 /
+         ((double)sample_rate * (1.0 + drift_ppm / 1000000.0));
+}
+
+// Feeds fragments of varying size for the given seconds.
+uint64_t Run(SampleClock& clock, uint64_t position, double drift_ppm,
+             int seconds, int max_jitter) {
+  uint64_t end = position + (uint64_t)(seconds * sample_rate);
+  while (position < end) {
+    position += 256 + (uint64_t)(Jitter(128) + 128);
+    double now = TrueTime(position, drift_ppm) + Jitter(max_jitter);
+    clock.Update(position, start_time + (Scheduler::Time)std::llround(now));
+  }
+  return position;
+}
+
+double TimeError(const SampleClock& clock, uint64_t position,
+                 double drift_ppm) {
+  double filtered = (double)(clock.TimeOfSample(position) - start_time);
+  return filtered - TrueTime(position, drift_ppm);
+}
+
+void FirstMeasurementLocks() {
+  SampleClock clock;
+  clock.Reset(sample_rate);
+  EXPECT(!clock.locked());
+  clock.Update(1000, start_time);
+  ASSERT(clock.locked());
+  EXPECT(clock.TimeOfSample(1000) == start_time);
+  EXPECT(clock.TimeOfSample(1000 + sample_rate) == start_time + 1000000);
+  EXPECT(clock.drift_ppm() == 0.0);
+}
+
+void FiltersJitterAndFindsDrift() {
+  const double drift_ppm = 80.0;
+  SampleClock clock;
+  clock.Reset(sample_rate);
+  uint64_t position = Run(clock, 0, drift_ppm, 60, 500);
+  EXPECT(std::fabs(clock.drift_ppm() - drift_ppm) < 10.0);
+  double max_error = 0.0;
+  for (int i = 0; i < 10; ++i) {
+    position = Run(clock, position, drift_ppm, 1, 500);
+    double error = std::fabs(TimeError(clock, position, drift_ppm));
+    if (error > max_error) max_error = error;
+  }
+  // 10 times less than the jitter of the measurements
+  EXPECT(max_error < 50.0);
+}
+
+void RelocksAfterDiscontinuity() {
+  SampleClock clock;
+  clock.Reset(sample_rate);
+  uint64_t position = Run(clock, 0, 0.0, 5, 100);
+  // samples are lost, the counter does not know about them
+  Scheduler::Time jump = 1000000;
+  position += 1000;
+  Scheduler::Time now =
+      start_time + (Scheduler::Time)std::llround(TrueTime(position, 0.0));
+  clock.Update(position, now + jump);
+  EXPECT(clock.TimeOfSample(position) == now + jump);
+}
+
+TEST_BEGIN() {
+  FirstMeasurementLocks();
+  FiltersJitterAndFindsDrift();
+  RelocksAfterDiscontinuity();
+}
+TEST_END()
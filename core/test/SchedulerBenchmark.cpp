@@ -0,0 +1,115 @@
+#include "zamt/core/Scheduler.h"
+#include "zamt/core/TestSuite.h"
+
+#include <chrono>
+#include <vector>
+
+/// Compares the cost of a packet through plain and in order subscriptions,
+/// by source ids or handles, and in batches.
+
+using namespace zamt;
+
+static const int packets = 20000;
+static const int queue_length = 64;
+
+static std::atomic<int> packets_arrived;
+
+void Sink(void* schp, Scheduler::SourceId source_id,
+          const Scheduler::Byte* packet, Scheduler::Time) {
+  Scheduler& sch = *static_cast<Scheduler*>(schp);
+  packets_arrived++;
+  sch.ReleasePacket(source_id, packet);
+}
+
+void SinkWithHandle(void* schp, Scheduler::SourceHandle source,
+                    const Scheduler::Byte* packet) {
+  Scheduler& sch = *static_cast<Scheduler*>(schp);
+  packets_arrived++;
+  sch.ReleasePacket(source, packet);
+}
+
+// Returns the time of a packet from submission to release in usecs.
+double MeasureUsecsPerPacket(bool in_order, bool by_handle) {
+  packets_arrived = 0;
+  Scheduler sch(4);
+  Scheduler::SourceHandle source = sch.RegisterSource(1, 64, queue_length);
+  int subscription_id;
+  Scheduler::SinkCallback sink;
+  if (by_handle)
+    sink = std::bind(&SinkWithHandle, &sch, source, std::placeholders::_2);
+  else
+    sink = std::bind(&Sink, &sch, std::placeholders::_1,
+                     std::placeholders::_2, std::placeholders::_3);
+  if (in_order)
+    sch.SubscribeInOrder(1, sink, subscription_id);
+  else
+    sch.Subscribe(1, sink, false, subscription_id);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < packets; ++i) {
+    uint8_t* p;
+    if (by_handle) {
+      while (!(p = sch.GetPacketForSubmission(source)))
+        std::this_thread::yield();
+      sch.SubmitPacket(source, p, (Scheduler::Time)i);
+    } else {
+      while (!(p = sch.GetPacketForSubmission(1))) std::this_thread::yield();
+      sch.SubmitPacket(1, p, (Scheduler::Time)i);
+    }
+  }
+  while (packets_arrived != packets) std::this_thread::yield();
+  auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+  sch.Shutdown();
+  EXPECT(packets_arrived == packets);
+  return (double)usecs / packets;
+}
+
+void BatchSink(void* schp, Scheduler::SourceHandle source,
+               const Scheduler::Byte* const* packets, int count) {
+  Scheduler& sch = *static_cast<Scheduler*>(schp);
+  packets_arrived += count;
+  sch.ReleasePackets(source, packets, count);
+}
+
+// Like MeasureUsecsPerPacket() with packets submitted and sunk in batches.
+double MeasureBatchUsecsPerPacket(int batch) {
+  packets_arrived = 0;
+  Scheduler sch(4);
+  Scheduler::SourceHandle source = sch.RegisterSource(1, 64, queue_length);
+  int subscription_id;
+  sch.SubscribeBatch(1,
+                     std::bind(&BatchSink, &sch, source, std::placeholders::_2,
+                               std::placeholders::_4),
+                     batch, subscription_id);
+  std::vector<uint8_t*> batch_packets((size_t)batch);
+  std::vector<Scheduler::Time> timestamps((size_t)batch);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < packets; i += batch) {
+    for (int j = 0; j < batch; ++j) {
+      while (!(batch_packets[(size_t)j] = sch.GetPacketForSubmission(source)))
+        std::this_thread::yield();
+      timestamps[(size_t)j] = (Scheduler::Time)(i + j);
+    }
+    sch.SubmitPackets(source, batch_packets.data(), timestamps.data(), batch);
+  }
+  while (packets_arrived != packets) std::this_thread::yield();
+  auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+  sch.Shutdown();
+  EXPECT(packets_arrived == packets);
+  return (double)usecs / packets;
+}
+
+TEST_BEGIN() {
+  double plain = MeasureUsecsPerPacket(false, false);
+  double in_order = MeasureUsecsPerPacket(true, false);
+  double by_handle = MeasureUsecsPerPacket(false, true);
+  double batches = MeasureBatchUsecsPerPacket(8);
+  printf("Plain subscription: %.3f usecs/packet\n", plain);
+  printf("In order subscription: %.3f usecs/packet\n", in_order);
+  printf("Plain subscription by handle: %.3f usecs/packet\n", by_handle);
+  printf("Batches of 8 by handle: %.3f usecs/packet\n", batches);
+}
+TEST_END()
@@ -1,6 +1,13 @@
 #include "zamt/core/Scheduler.h"
 #include "zamt/core/TestSuite.h"
 
+#include <chrono>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#endif
+
 using namespace zamt;
 
 static const int packets_to_arrive = (int)sizeof(long) * 8 - 2;
@@ -89,8 +96,148 @@ void OutOfBufferGivesNull() {
   sch.Shutdown();
 }
 
+void QueueLimitIsRespected() {
+  Scheduler sch;
+  sch.RegisterSource(1, 16, 4);
+  Scheduler::QueueStats stats = sch.GetQueueStats(1);
+  EXPECT(stats.capacity == 4 && stats.limit == 4 && stats.in_use == 0);
+  sch.SetQueueLimit(1, 2);
+  uint8_t* p1 = sch.GetPacketForSubmission(1);
+  uint8_t* p2 = sch.GetPacketForSubmission(1);
+  ASSERT(p1 && p2);
+  EXPECT(!sch.GetPacketForSubmission(1));
+  stats = sch.GetQueueStats(1);
+  EXPECT(stats.limit == 2 && stats.in_use == 2);
+  EXPECT(stats.peak_in_use == 2 && stats.overruns == 1);
+  stats = sch.GetQueueStats(1);
+  EXPECT(stats.overruns == 0);
+  sch.SetQueueLimit(1, 100);
+  EXPECT(sch.GetQueueStats(1).limit == 4);
+  EXPECT(sch.GetPacketForSubmission(1));
+  sch.Shutdown();
+}
+
+void WaitingProducerIsThrottled() {
+  Scheduler sch(2);
+  sch.RegisterSource(1, 16, 1);
+  int subscription_id;
+  std::atomic<int> released(0);
+  sch.Subscribe(1,
+                [&sch, &released](Scheduler::SourceId source_id,
+                                  const Scheduler::Byte* packet,
+                                  Scheduler::Time) {
+                  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                  released++;
+                  sch.ReleasePacket(source_id, packet);
+                },
+                false, subscription_id);
+  // The single packet is reused as soon as the slow sink releases it.
+  for (int i = 0; i < 5; ++i) {
+    uint8_t* p = sch.WaitForPacketForSubmission(1, 10000);
+    ASSERT(p);
+    EXPECT(released == i);
+    sch.SubmitPacket(1, p, (Scheduler::Time)i);
+  }
+  EXPECT(sch.GetQueueStats(1).overruns == 0);
+  // Nothing is released while the packet is held.
+  uint8_t* p = sch.WaitForPacketForSubmission(1, 10000);
+  ASSERT(p);
+  EXPECT(!sch.WaitForPacketForSubmission(1, 10));
+  EXPECT(sch.GetQueueStats(1).overruns == 1);
+  sch.Shutdown();
+}
+
+struct Metadata {
+  uint64_t position;
+  double rate;
+};
+
+void MetadataTravelsWithPacket() {
+  Scheduler sch;
+  sch.RegisterSource(1, 16, 4, (int)sizeof(Metadata));
+  EXPECT(sch.GetMetadataSize(1) == (int)sizeof(Metadata));
+  uint8_t* p1 = sch.GetPacketForSubmission(1);
+  uint8_t* p2 = sch.GetPacketForSubmission(1);
+  ASSERT(p1 && p2);
+  Metadata* m1 = reinterpret_cast<Metadata*>(sch.GetPacketMetadata(1, p1));
+  Metadata* m2 = reinterpret_cast<Metadata*>(sch.GetPacketMetadata(1, p2));
+  EXPECT(m1 != m2);
+  EXPECT((size_t)m1 % alignof(Metadata) == 0);
+  EXPECT((size_t)m2 % alignof(Metadata) == 0);
+  m1->position = 1;
+  m2->position = 2;
+  // sinks may look it up by the start of the packet only
+  EXPECT(reinterpret_cast<Metadata*>(sch.GetPacketMetadata(1, p1))->position ==
+         1);
+  EXPECT(reinterpret_cast<Metadata*>(sch.GetPacketMetadata(1, p2))->position ==
+         2);
+  sch.SubmitPacket(1, p1, 0);
+  sch.SubmitPacket(1, p2, 0);
+  sch.Shutdown();
+}
+
 static std::atomic<long> packets_arrived;
 
+void HandlesReferToTheirSources() {
+  Scheduler sch;
+  Scheduler::SourceHandle handle3 = sch.RegisterSource(3, 30, 1);
+  Scheduler::SourceHandle handle1 = sch.RegisterSource(1, 10, 2);
+  EXPECT(!Scheduler::SourceHandle().valid());
+  ASSERT(handle1.valid() && handle3.valid());
+  EXPECT(handle1.index != handle3.index);
+  EXPECT(sch.GetSourceHandle(1).index == handle1.index);
+  EXPECT(sch.GetSourceHandle(3).index == handle3.index);
+  EXPECT(sch.GetPacketSize(handle1) == 10);
+  EXPECT(sch.GetPacketSize(handle3) == 30);
+  uint8_t* p = sch.GetPacketForSubmission(handle3);
+  ASSERT(p);
+  EXPECT(sch.GetPacketForSubmission(3) == nullptr);
+  sch.SubmitPacket(handle3, p, 0);  // no sinks, released at once
+  EXPECT(sch.GetQueueStats(3).in_use == 0);
+  sch.Shutdown();
+}
+
+void BadSourcesGiveInvalidHandles() {
+  Scheduler sch;
+  EXPECT(!sch.GetSourceHandle(1).valid());
+  ASSERT(sch.RegisterSource(1, 10, 2).valid());
+  EXPECT(!sch.RegisterSource(1, 10, 2).valid());
+  EXPECT(sch.GetPacketSize(sch.GetSourceHandle(1)) == 10);
+  EXPECT(sch.GetPacketSize(2) == 0 && sch.GetMetadataSize(2) == 0);
+  EXPECT(sch.GetPacketForSubmission(2) == nullptr);
+  EXPECT(sch.WaitForPacketForSubmission(2, 1) == nullptr);
+  EXPECT(sch.GetQueueStats(2).capacity == 0);
+  sch.SetQueueLimit(2, 1);
+  sch.SubmitPacket(2, nullptr, 0);
+  sch.ReleasePacket(2, nullptr);
+  std::vector<Scheduler::SourceId> ids;
+  for (int i = 1; i < Scheduler::kMaxSources; ++i) {
+    ids.push_back(sch.AllocateSourceId());
+    ASSERT(sch.RegisterSource(ids.back(), 4 + i, 1).valid());
+  }
+  EXPECT(!sch.RegisterSource(sch.AllocateSourceId(), 4, 1).valid());
+  for (int i = 1; i < Scheduler::kMaxSources; ++i)
+    EXPECT(sch.GetPacketSize(ids[(size_t)i - 1]) == 4 + i);
+  sch.Shutdown();
+}
+
+void SourcesCanBeFoundByName() {
+  Scheduler sch;
+  Scheduler::SourceId first = sch.AllocateSourceId();
+  Scheduler::SourceId second = sch.AllocateSourceId();
+  EXPECT(first >= Scheduler::kFirstAllocatedSourceId);
+  EXPECT(second != first);
+  sch.RegisterSource(1, 16, 4);
+  sch.RegisterSource(first, 16, 4);
+  sch.SetSourceName(1, "audio");
+  sch.SetSourceName(first, "spectrum");
+  Scheduler::SourceId found = 0;
+  EXPECT(sch.FindSource("spectrum", found) && found == first);
+  EXPECT(sch.FindSource("audio", found) && found == 1);
+  EXPECT(!sch.FindSource("pitch", found));
+  sch.Shutdown();
+}
+
 void CheckPackets(void* schp, Scheduler::SourceId source_id,
                   const Scheduler::Byte* packet, Scheduler::Time timestamp) {
   Scheduler& sch = *static_cast<Scheduler*>(schp);
@@ -148,6 +295,39 @@ void SinkGetsAllPacketsSentOnUIThread() {
 
 static std::atomic<long> packets_arrived2;
 
+#ifdef __linux__
+bool UIEventIsSignaled(Scheduler& sch, int timeout_in_ms) {
+  pollfd event{sch.GetUITaskEventFd(), POLLIN, 0};
+  return poll(&event, 1, timeout_in_ms) == 1;
+}
+
+void UITasksAreSignaled() {
+  packets_arrived = 0;
+  Scheduler sch;
+  ASSERT(sch.GetUITaskEventFd() >= 0);
+  sch.RegisterSource(1, 1024, packets_to_arrive);
+  int subscription_id;
+  sch.Subscribe(1,
+                std::bind(&CheckPackets, &sch, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                true, subscription_id);
+  EXPECT(!UIEventIsSignaled(sch, 0));
+  for (int i = 0; i < 3; ++i) {
+    uint8_t* p = sch.GetPacketForSubmission(1);
+    p[0] = (uint8_t)i;
+    sch.SubmitPacket(1, p, (Scheduler::Time)i * 1000);
+  }
+  EXPECT(UIEventIsSignaled(sch, 1000));
+  // Tasks left for the next turn of the main loop keep the event signaled.
+  EXPECT(sch.DoUITasks(2) == 2);
+  EXPECT(UIEventIsSignaled(sch, 0));
+  EXPECT(sch.DoUITasks(2) == 1);
+  EXPECT(!UIEventIsSignaled(sch, 0));
+  EXPECT(packets_arrived == 7);
+  sch.Shutdown();
+}
+#endif
+
 void CheckPackets2(void* schp, Scheduler::SourceId source_id,
                    const Scheduler::Byte* packet, Scheduler::Time timestamp) {
   Scheduler& sch = *static_cast<Scheduler*>(schp);
@@ -300,6 +480,219 @@ void SourceSinkChainWorks() {
   ASSERT(packets_arrived3 == (1l << packets_to_arrive) - 1);
 }
 
+static std::atomic<int> pool_packets_arrived;
+static std::atomic<int> other_packets_arrived;
+static std::thread::id pool_worker;
+static std::atomic<bool> pool_worker_seen_elsewhere;
+
+void CountPoolPacket(void* schp, Scheduler::SourceId source_id,
+                     const Scheduler::Byte* packet, Scheduler::Time) {
+  Scheduler& sch = *static_cast<Scheduler*>(schp);
+  if (pool_packets_arrived == 0) pool_worker = std::this_thread::get_id();
+  EXPECT(pool_worker == std::this_thread::get_id());
+  pool_packets_arrived++;
+  sch.ReleasePacket(source_id, packet);
+}
+
+void CountOtherPacket(void* schp, Scheduler::SourceId source_id,
+                      const Scheduler::Byte* packet, Scheduler::Time) {
+  Scheduler& sch = *static_cast<Scheduler*>(schp);
+  if (pool_packets_arrived > 0 && pool_worker == std::this_thread::get_id())
+    pool_worker_seen_elsewhere = true;
+  other_packets_arrived++;
+  sch.ReleasePacket(source_id, packet);
+}
+
+void PoolsShareThePackets() {
+  pool_packets_arrived = 0;
+  other_packets_arrived = 0;
+  pool_worker_seen_elsewhere = false;
+  Scheduler sch(2);
+  Scheduler::PoolId pool = sch.AddPool("isolated", 1);
+  Scheduler::PoolId found;
+  ASSERT(sch.FindPool("isolated", found));
+  EXPECT(found == pool);
+  EXPECT(sch.FindPool(Scheduler::kDefaultPoolName, found));
+  EXPECT(found == Scheduler::kDefaultPool);
+  EXPECT(!sch.FindPool("none", found));
+  EXPECT(sch.GetNumberOfWorkers(pool) == 1);
+  EXPECT(sch.GetNumberOfWorkers() == 2);
+
+  // One packet only: it comes back when both pools released it.
+  sch.RegisterSource(1, 16, 1);
+  int subscription_id1, subscription_id2;
+  sch.Subscribe(1,
+                std::bind(&CountPoolPacket, &sch, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                false, subscription_id1, pool);
+  sch.Subscribe(1,
+                std::bind(&CountOtherPacket, &sch, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                false, subscription_id2);
+  for (int i = 0; i < packets_to_arrive; ++i) {
+    uint8_t* p;
+    while (!(p = sch.GetPacketForSubmission(1))) std::this_thread::yield();
+    EXPECT(pool_packets_arrived == i && other_packets_arrived == i);
+    sch.SubmitPacket(1, p, (Scheduler::Time)i);
+  }
+  while (pool_packets_arrived != packets_to_arrive ||
+         other_packets_arrived != packets_to_arrive)
+    std::this_thread::yield();
+  sch.Shutdown();
+  EXPECT(!pool_worker_seen_elsewhere);
+}
+
+static int next_in_order;
+static std::atomic<bool> in_order_sink_busy;
+static std::atomic<int> in_order_packets_arrived;
+
+void CheckInOrder(void* schp, Scheduler::SourceId source_id,
+                  const Scheduler::Byte* packet, Scheduler::Time timestamp) {
+  Scheduler& sch = *static_cast<Scheduler*>(schp);
+  EXPECT(!in_order_sink_busy.exchange(true));
+  int num = (int)packet[0];
+  EXPECT(num == next_in_order);
+  EXPECT(timestamp == (Scheduler::Time)num * 1000);
+  next_in_order = num + 1;
+  for (int i = 0; i < 9; ++i) std::this_thread::yield();
+  in_order_sink_busy = false;
+  in_order_packets_arrived++;
+  sch.ReleasePacket(source_id, packet);
+}
+
+void InOrderSinkGetsPacketsInOrder() {
+  next_in_order = 0;
+  in_order_sink_busy = false;
+  in_order_packets_arrived = 0;
+  Scheduler sch(4);
+  sch.RegisterSource(1, 16, packets_to_arrive);
+  int subscription_id;
+  sch.SubscribeInOrder(1,
+                       std::bind(&CheckInOrder, &sch, std::placeholders::_1,
+                                 std::placeholders::_2, std::placeholders::_3),
+                       subscription_id);
+  for (int i = 0; i < packets_to_arrive; ++i) {
+    uint8_t* p = sch.GetPacketForSubmission(1);
+    ASSERT(p);
+    p[0] = (uint8_t)i;
+    sch.SubmitPacket(1, p, (Scheduler::Time)i * 1000);
+  }
+  while (in_order_packets_arrived != packets_to_arrive)
+    std::this_thread::yield();
+  sch.Shutdown();
+  EXPECT(next_in_order == packets_to_arrive);
+}
+
+static int next_in_batch;
+static int batches_arrived;
+static std::atomic<int> batch_packets_arrived;
+static std::atomic<int> plain_packets_arrived;
+
+void CheckBatch(void* schp, Scheduler::SourceId source_id,
+                const Scheduler::Byte* const* packets,
+                const Scheduler::Time* timestamps, int count) {
+  Scheduler& sch = *static_cast<Scheduler*>(schp);
+  EXPECT(count > 0 && count <= 4);
+  for (int i = 0; i < count; ++i) {
+    int num = (int)packets[i][0];
+    EXPECT(num == next_in_batch);
+    EXPECT(timestamps[i] == (Scheduler::Time)num * 1000);
+    next_in_batch = num + 1;
+  }
+  batches_arrived++;
+  sch.ReleasePackets(source_id, packets, count);
+  batch_packets_arrived += count;
+}
+
+void BatchSinkGetsConsecutivePackets() {
+  next_in_batch = 0;
+  batches_arrived = 0;
+  batch_packets_arrived = 0;
+  plain_packets_arrived = 0;
+  Scheduler sch(4);
+  sch.RegisterSource(1, 16, 8);
+  int batch_subscription_id, subscription_id;
+  sch.SubscribeBatch(1,
+                     std::bind(&CheckBatch, &sch, std::placeholders::_1,
+                               std::placeholders::_2, std::placeholders::_3,
+                               std::placeholders::_4),
+                     4, batch_subscription_id);
+  sch.Subscribe(1,
+                [&sch](Scheduler::SourceId source_id,
+                       const Scheduler::Byte* packet, Scheduler::Time) {
+                  sch.ReleasePacket(source_id, packet);
+                  plain_packets_arrived++;
+                },
+                false, subscription_id);
+  uint8_t* packets[8];
+  Scheduler::Time timestamps[8];
+  for (int i = 0; i < 8; ++i) {
+    packets[i] = sch.GetPacketForSubmission(1);
+    ASSERT(packets[i]);
+    packets[i][0] = (uint8_t)i;
+    timestamps[i] = (Scheduler::Time)i * 1000;
+  }
+  sch.SubmitPackets(1, packets, timestamps, 8);
+  while (batch_packets_arrived != 8 || plain_packets_arrived != 8)
+    std::this_thread::yield();
+  // All the packets were waiting for the single task of the batch sink.
+  EXPECT(batches_arrived == 2);
+  EXPECT(next_in_batch == 8);
+  // Every packet is released.
+  for (int i = 0; i < 8; ++i) EXPECT(sch.GetPacketForSubmission(1));
+  sch.Shutdown();
+}
+
+void ParallelForCoversTheRange() {
+  Scheduler sch(3);
+  const int size = 1000;
+  std::vector<std::atomic<int>> calls(size);
+  for (auto& count : calls) count = 0;
+  std::atomic<int> ranges(0);
+  sch.ParallelFor(10, size, 64, [&calls, &ranges](int begin, int end) {
+    EXPECT(end - begin <= 64);
+    for (int i = begin; i < end; ++i) calls[(size_t)i]++;
+    ranges++;
+  });
+  EXPECT(ranges == 16);
+  for (int i = 0; i < size; ++i) EXPECT(calls[(size_t)i] == (i >= 10));
+  sch.ParallelFor(5, 5, 1, [](int, int) { EXPECT(false); });
+  sch.Shutdown();
+}
+
+static std::atomic<int> parallel_sums_done;
+
+void SumInParallel(void* schp, Scheduler::SourceId source_id,
+                   const Scheduler::Byte* packet, Scheduler::Time) {
+  Scheduler& sch = *static_cast<Scheduler*>(schp);
+  std::atomic<int> sum(0);
+  sch.ParallelFor(0, 100, 7, [&sum](int begin, int end) {
+    for (int i = begin; i < end; ++i) sum += i;
+  });
+  EXPECT(sum == 4950);
+  parallel_sums_done++;
+  sch.ReleasePacket(source_id, packet);
+}
+
+void ParallelForWorksInSinks() {
+  parallel_sums_done = 0;
+  // Every worker may wait in ParallelFor() at the same time.
+  Scheduler sch(2);
+  sch.RegisterSource(1, 16, packets_to_arrive);
+  int subscription_id;
+  sch.Subscribe(1,
+                std::bind(&SumInParallel, &sch, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                false, subscription_id);
+  for (int i = 0; i < packets_to_arrive; ++i) {
+    uint8_t* p = sch.GetPacketForSubmission(1);
+    ASSERT(p);
+    sch.SubmitPacket(1, p, (Scheduler::Time)i);
+  }
+  while (parallel_sums_done != packets_to_arrive) std::this_thread::yield();
+  sch.Shutdown();
+}
+
 TEST_BEGIN() {
   RunsWellEmpty();
   RunsWellWithoutShutdown();
@@ -307,10 +700,24 @@ TEST_BEGIN() {
   SourceWithoutSinks();
   QueueWorksAfterUnsubscribe();
   OutOfBufferGivesNull();
+  QueueLimitIsRespected();
+  WaitingProducerIsThrottled();
+  MetadataTravelsWithPacket();
+  HandlesReferToTheirSources();
+  BadSourcesGiveInvalidHandles();
+  SourcesCanBeFoundByName();
   SinkGetsAllPacketsSent();
   SinkGetsAllPacketsSentOnUIThread();
+#ifdef __linux__
+  UITasksAreSignaled();
+#endif
   AllSinksGetAllPackets();
   MultipleSourcesWithOneSink();
   SourceSinkChainWorks();
+  PoolsShareThePackets();
+  InOrderSinkGetsPacketsInOrder();
+  BatchSinkGetsConsecutivePackets();
+  ParallelForCoversTheRange();
+  ParallelForWorksInSinks();
 }
 TEST_END()
@@ -14,11 +14,36 @@ set(test_cpps
 )
 AddTest(CoreTest ${this_module} "${other_modules}" "${test_cpps}")
 
+set(test_cpps
+  LogTest.cpp
+)
+AddTest(LogTest ${this_module} "${other_modules}" "${test_cpps}")
+
 set(test_cpps
   ModuleCenterTest.cpp
 )
 AddTest(ModuleCenterTest ${this_module} "${other_modules}" "${test_cpps}")
 
+set(test_cpps
+  PipelineConfigTest.cpp
+)
+AddTest(PipelineConfigTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  QueueTunerTest.cpp
+)
+AddTest(QueueTunerTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  SampleClockTest.cpp
+)
+AddTest(SampleClockTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  SchedulerBenchmark.cpp
+)
+AddTest(SchedulerBenchmark ${this_module} "${other_modules}" "${test_cpps}")
+
 set(test_cpps
   SchedulerTest.cpp
 )
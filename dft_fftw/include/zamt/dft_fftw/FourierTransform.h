@@ -3,6 +3,7 @@
 
 #include <complex>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "zamt/core/CLIParameters.h"
@@ -12,40 +13,63 @@
 #include "zamt/core/ModuleCenter.h"
 #include "zamt/core/Scheduler.h"
 
+#if defined(ZAMT_MODULE_LIVEAUDIO_PULSE)
 #include "zamt/liveaudio_pulse/LiveAudio.h"
+#elif defined(ZAMT_MODULE_LIVEAUDIO_ALSA)
+#include "zamt/liveaudio_alsa/LiveAudio.h"
+#endif
 
 namespace zamt {
 
 namespace dft_fftw {
 namespace internal {
-struct SubscriptionInfo {
-  Scheduler::SourceId source_id;
-  int subscription_id;
-};
-
-struct FFTW_Wrapper;
+struct Stage;
 }  // namespace internal
 
+/// Transforms audio in stages, each stage is a source of spectra.
+/**
+ * Stages come from the pipeline configuration (type "fft"), by default one
+ * transform is done for every audio packet. A stage collects mono samples
+ * of its input and transforms the last size samples in every hop samples.
+ * The first stage is the source of the module id, the others get their own
+ * ids, every stage output is named after the stage.
+ * A transform can be split into parts computed by the workers of the pool
+ * of the stage together, large ones are split by default.
+ */
 class FourierTransform : public Module {
   std::string module_name;
 
  public:
+  const static char* kStageType;
+  const static char* kVisualizeSpectrumStr;
+  const static int kSpectrogramHistory = 600;  // columns shown
+  const static int kDefaultQueueLength = 42;   // chosen by 2 fair dice rolls
+  const static int kSplitSize = 16384;  // transforms split from this size on
+
   FourierTransform(int argc, const char* const* argv);
-  ~FourierTransform() = default;
+  ~FourierTransform();
 
   void Initialize(const ModuleCenter* module_center);
 
  private:
-  void PrintHelp() { Log::Print("ZAMT Discrete Fourier-transform with FFTW"); }
+  void PrintHelp();
+#if defined(ZAMT_MODULE_LIVEAUDIO_PULSE) || defined(ZAMT_MODULE_LIVEAUDIO_ALSA)
+  // Returns false if the stage cannot be set up.
+  bool AddStage(const ModuleCenter* module_center, const std::string& name,
+                const std::string& input, int size, int hop, int queue,
+                const std::string& pool, int parts);
+  void ProcessPacket(internal::Stage& stage, Scheduler::SourceId id,
+                     const Scheduler::Byte* packet, Scheduler::Time timestamp);
+  void Transform(internal::Stage& stage, Scheduler::Time timestamp);
+#endif
 
   std::atomic_bool should_run_dft{false};
-  dft_fftw::internal::SubscriptionInfo subscription;
 
   CLIParameters cli;
   Log log;
   Scheduler* scheduler = nullptr;
 
-  std::unique_ptr<internal::FFTW_Wrapper> worker = nullptr;
+  std::vector<std::unique_ptr<internal::Stage>> stages;
 };
 
 }  // namespace dft_fftw
@@ -0,0 +1,57 @@
+#ifndef ZAMT_DFT_FFTW_REALFFT_H_
+#define ZAMT_DFT_FFTW_REALFFT_H_
+
+/// Transforms of real samples of one size with FFTW, for other modules.
+/**
+ * The forward and the inverse transform are planned once on buffers owned
+ * by the object, so a transform allocates nothing. Plans are measured, a
+ * size planned before in the process (e.g. by a "fft" stage) is planned
+ * from the wisdom FFTW gathered then.
+ * The planner of FFTW is not thread safe while modules are initialized
+ * concurrently, so plans are made and destroyed under planner_mutex(), as
+ * the stages of FourierTransform do.
+ */
+
+#include <complex>
+#include <memory>
+#include <mutex>
+
+namespace zamt {
+namespace dft_fftw {
+
+class RealFFT {
+ public:
+  explicit RealFFT(int size);
+  ~RealFFT();
+
+  RealFFT(const RealFFT&) = delete;
+  RealFFT& operator=(const RealFFT&) = delete;
+
+  int size() const { return size_; }
+  int bins() const { return size_ / 2 + 1; }
+
+  /// size() samples, the input of Forward() and the output of Inverse().
+  float* samples() { return samples_; }
+  /// bins() bins, the output of Forward() and the input of Inverse().
+  std::complex<float>* spectrum() { return spectrum_; }
+
+  void Forward();
+  /// Unnormalized: the samples come back multiplied by size().
+  /// The bins are overwritten.
+  void Inverse();
+
+  static std::mutex& planner_mutex();
+
+ private:
+  struct Plans;
+
+  int size_;
+  float* samples_ = nullptr;
+  std::complex<float>* spectrum_ = nullptr;
+  std::unique_ptr<Plans> plans_;
+};
+
+}  // namespace dft_fftw
+}  // namespace zamt
+
+#endif  // ZAMT_DFT_FFTW_REALFFT_H_
@@ -0,0 +1,58 @@
+#ifndef ZAMT_DFT_FFTW_SPLITFFT_H_
+#define ZAMT_DFT_FFTW_SPLITFFT_H_
+
+/// Transform of real samples split into parts run by the workers of a pool.
+/**
+ * The transform is split by decimation in time: each of the parts
+ * transforms every parts-th sample, then each bin is combined from the
+ * bins of the parts with twiddle factors. Both steps run in parallel with
+ * Scheduler::ParallelFor(), so a large transform is done in a fraction of
+ * the time on an idle pool. One part is a plain RealFFT.
+ * The size need not be a power of two, only a multiple of the parts.
+ */
+
+#include "zamt/core/Scheduler.h"
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+namespace zamt {
+namespace dft_fftw {
+
+class RealFFT;
+
+class SplitFFT {
+ public:
+  const static int kCombinedBinsPerTask = 1024;
+
+  SplitFFT(int size, int parts);
+  ~SplitFFT();
+
+  SplitFFT(const SplitFFT&) = delete;
+  SplitFFT& operator=(const SplitFFT&) = delete;
+
+  int size() const { return size_; }
+  int parts() const { return parts_; }
+  int bins() const { return size_ / 2 + 1; }
+
+  /// Transforms size() samples into bins() bins on the workers of the pool.
+  /// Not reentrant: the parts are transformed in buffers of the object.
+  void Transform(const float* samples, std::complex<float>* bins,
+                 Scheduler& scheduler,
+                 Scheduler::PoolId pool = Scheduler::kDefaultPool);
+
+ private:
+  // Bin of a part, also above the ones computed for the real input.
+  std::complex<float> GetPartBin(int part, int bin) const;
+
+  int size_;
+  int parts_;
+  std::vector<std::unique_ptr<RealFFT>> transforms_;  // size / parts each
+  std::vector<std::complex<float>> twiddles_;  // exp(-2*pi*i*k/size)
+};
+
+}  // namespace dft_fftw
+}  // namespace zamt
+
+#endif  // ZAMT_DFT_FFTW_SPLITFFT_H_
@@ -1,9 +1,13 @@
 set(module_headers
   FourierTransform.h
+  RealFFT.h
+  SplitFFT.h
 )
 
 set(module_cpps
   FourierTransform.cpp
+  RealFFT.cpp
+  SplitFFT.cpp
 )
 
 
@@ -1,78 +1,64 @@
 #include "zamt/dft_fftw/FourierTransform.h"
+#include "zamt/dft_fftw/SplitFFT.h"
 
 #include <algorithm>
 #include <chrono>
 #include <complex>
+#include <mutex>
 
 #include <cassert>
+#include <cmath>
 #include <cstring>
 
-#include <fftw3.h>
+#ifdef ZAMT_MODULE_VIS_GTK
+#include "zamt/vis_gtk/Spectrogram.h"
+#include "zamt/vis_gtk/Visualization.h"
+#endif
 
 namespace zamt {
 namespace dft_fftw {
 namespace internal {
 
-struct fftwf_complex_allocator : std::allocator<fftwf_complex> {
-  fftwf_complex* allocate(std::size_t size) {
-    return reinterpret_cast<fftwf_complex*>(
-        fftwf_malloc(sizeof(fftwf_complex) * size));
-  }
-
-  void deallocate(fftw_complex* ptr, std::size_t /*size*/) { fftw_free(ptr); }
-};
-
-using input_t = std::vector<float>;
-using output_t = std::vector<std::complex<float>>;
-
-struct FFTW_Wrapper {
-  std::size_t size;
-
-  input_t input;
-  std::vector<fftwf_complex, fftwf_complex_allocator> output;
-
-  fftwf_plan plan;
-
-  FFTW_Wrapper(std::size_t);
-  ~FFTW_Wrapper();
-
-  void addData(input_t input);
-  void addPartialData(input_t input);
-  output_t transform();
+struct Stage {
+  std::string name;
+  Scheduler::SourceId input;
+  Scheduler::SourceId output;
+  Scheduler::SourceHandle inputSource;
+  Scheduler::SourceHandle outputSource;
+  int subscriptionId = 0;
+  std::size_t size;  // samples in a transform
+  std::size_t hop;   // samples between transforms
+  std::size_t resultCount;
+
+  std::mutex mutex;  // guards the stage against quitting
+  std::unique_ptr<SplitFFT> fft;
+  Scheduler::PoolId pool;  // of the parts of the transform
+  std::vector<float> window;  // mono samples collected for the next one
+  std::vector<std::complex<float>> spectrum;  // of the last transform
+  std::size_t filled = 0;
+  uint64_t nextSample = 0;  // expected first sample of the next packet
+  int transformsLost = 0;   // result queue was full
+  std::string lostMessage;  // logged then without formatting
+
+#ifdef ZAMT_MODULE_VIS_GTK
+  std::unique_ptr<Spectrogram> spectrogram;
+  std::vector<float> power;  // of the last transform, for the spectrogram
+#endif
 };
 
-FFTW_Wrapper::FFTW_Wrapper(std::size_t sampleSize)
-    : size(sampleSize),
-      input(size),
-      output(size / 2 + 1),
-      plan(fftwf_plan_dft_r2c_1d(static_cast<int>(size), input.data(),
-                                 output.data(), FFTW_MEASURE)) {}
-
-FFTW_Wrapper::~FFTW_Wrapper() { fftwf_destroy_plan(plan); }
-
-void FFTW_Wrapper::addData(input_t data) {
-  assert(data.size() == size);
-  input = data;
-}
-
-void FFTW_Wrapper::addPartialData(input_t /*data*/) {
-  // TODO: append to `input`
-}
-
-output_t FFTW_Wrapper::transform() {
-  fftwf_execute(plan);
-  output_t tmp;
-  tmp.reserve(size / 2 + 1);
-  for (auto& item : output) {
-    tmp.emplace_back(item[0], item[1]);
-  }
-  return tmp;
-}
-
 }  // namespace internal
 
 using clock = std::chrono::high_resolution_clock;
 
+const char* FourierTransform::kStageType = "fft";
+const char* FourierTransform::kVisualizeSpectrumStr = "-sFourierTransform";
+
+#ifdef ZAMT_MODULE_VIS_GTK
+ZAMT_MODULE_DEPENDS(FourierTransform, Core, LiveAudio, Visualization);
+#else
+ZAMT_MODULE_DEPENDS(FourierTransform, Core, LiveAudio);
+#endif
+
 FourierTransform::FourierTransform(int argc, const char* const* argv)
     : module_name("dft_fftw"), cli(argc, argv), log(module_name.c_str(), cli) {
   log.LogMessage("Starting...");
@@ -83,74 +69,232 @@ FourierTransform::FourierTransform(int argc, const char* const* argv)
   should_run_dft.store(true);
 }
 
+FourierTransform::~FourierTransform() = default;
+
+void FourierTransform::PrintHelp() {
+  Log::Print("ZAMT Discrete Fourier-transform with FFTW");
+  Log::Print(
+      " Pipeline stages: fft Name input=Source size=Samples hop=Samples "
+      "queue=Packets pool=Pool parts=Num");
+#ifdef ZAMT_MODULE_VIS_GTK
+  Log::Print(" -sFourierTransform  Shows the spectrogram of the transforms.");
+#endif
+}
+
 void FourierTransform::Initialize(const ModuleCenter* module_center) {
   if (!should_run_dft) return;
 
   log.Message("Initialize...");
-  scheduler = &module_center->Get<Core>().scheduler();
+  Core& core = module_center->Get<Core>();
+  scheduler = &core.scheduler();
+
+#if defined(ZAMT_MODULE_LIVEAUDIO_PULSE) || defined(ZAMT_MODULE_LIVEAUDIO_ALSA)
+  LiveAudio::SampleFormat format =
+      module_center->Get<LiveAudio>().sample_format();
+  assert(format.is_float && format.channels == LiveAudio::kChannels);
+  (void)format;
+
+  auto configured = core.pipeline().GetStages(kStageType);
+  bool ok = true;
+  if (configured.empty()) {
+    // one transform for every audio packet
+    int sampleCount =
+        scheduler->GetPacketSize(module_center->GetId<LiveAudio>()) /
+        static_cast<int>(sizeof(LiveAudio::StereoSample));
+    ok = AddStage(module_center, "FourierTransform", LiveAudio::kSourceName,
+                  sampleCount, sampleCount, kDefaultQueueLength,
+                  Scheduler::kDefaultPoolName, 0);
+  }
+  for (auto stage : configured) {
+    int size = stage->GetNumParam("size", 0);
+    const char* input = stage->GetParam("input");
+    const char* pool = stage->GetParam("pool");
+    ok = ok && AddStage(module_center, stage->name,
+                        input ? input : LiveAudio::kSourceName, size,
+                        stage->GetNumParam("hop", size),
+                        stage->GetNumParam("queue", kDefaultQueueLength),
+                        pool ? pool : Scheduler::kDefaultPoolName,
+                        stage->GetNumParam("parts", 0));
+  }
+  if (!ok) {
+    core.Quit(Core::kExitCodeBadPipeline);
+    return;
+  }
+
+#ifdef ZAMT_MODULE_VIS_GTK
+  core.RegisterForQuitEvent([this](int) {
+    for (auto& stage : stages) {
+      std::lock_guard<std::mutex> lock(stage->mutex);
+      stage->spectrogram.reset();
+    }
+  });
+#endif
+#endif
+}
 
-#ifdef ZAMT_MODULE_LIVEAUDIO_PULSE
+#if defined(ZAMT_MODULE_LIVEAUDIO_PULSE) || defined(ZAMT_MODULE_LIVEAUDIO_ALSA)
+bool FourierTransform::AddStage(const ModuleCenter* module_center,
+                                const std::string& name,
+                                const std::string& input, int size, int hop,
+                                int queue, const std::string& pool,
+                                int parts) {
   auto audio = module_center->GetId<LiveAudio>();
-  int subscriptionId = 0;
-  log.Message("subscriptionId = ", subscriptionId);
-  subscription = {audio, subscriptionId};
-
-  auto packetSize = scheduler->GetPacketSize(audio);
-  std::size_t sampleCount =
-      static_cast<std::size_t>(packetSize) / sizeof(LiveAudio::StereoSample);
-  log.Message("packetSize = ", packetSize, ", sampleCount = ", sampleCount);
-  worker = std::make_unique<internal::FFTW_Wrapper>(sampleCount);
-
-  auto self_id = module_center->GetId<FourierTransform>();
-
-  worker->addData(internal::input_t(sampleCount));
-  auto test_transform = worker->transform();
-  // auto resultCount = sampleCount / 2 + 1;
-  auto resultCount = test_transform.size();
-
-  scheduler->Subscribe(
-      audio,
-      [=](auto id, auto packet, auto /*time*/) {
-        static Scheduler::Time timestamp = 0;
-
-        auto castedPacket =
-            reinterpret_cast<const LiveAudio::StereoSample*>(packet);
-
-        internal::input_t transformResult;
-        transformResult.reserve(sampleCount);
-        std::transform(castedPacket, castedPacket + sampleCount,
-                       std::back_inserter(transformResult),
-                       [](LiveAudio::StereoSample sample) {
-                         return static_cast<float>(sample.left + sample.right) /
-                                2.0f;
-                       });
-
-        scheduler->ReleasePacket(id, packet);
-
-        worker->addData(transformResult);
-        auto result = worker->transform();
-        assert(result.size() == resultCount);
-
-        auto resultPacket = reinterpret_cast<std::complex<float>*>(
-            scheduler->GetPacketForSubmission(self_id));
-        assert(resultPacket);
-
-        memcpy(resultPacket, result.data(),
-               result.size() * sizeof(std::complex<float>));
-
-        scheduler->SubmitPacket(
-            self_id, reinterpret_cast<Scheduler::Byte*>(resultPacket),
-            timestamp++);
+  Scheduler::SourceId inputId;
+  if (!scheduler->FindSource(input, inputId) || inputId != audio) {
+    log.Message(Log::kError, "Stage ", name, ": input ", input,
+                " is not an audio source");
+    return false;
+  }
+  Scheduler::PoolId poolId;
+  if (!scheduler->FindPool(pool, poolId)) {
+    log.Message(Log::kError, "Stage ", name, ": no pool ", pool);
+    return false;
+  }
+  if (size < 2 || hop < 1 || hop > size || queue < 1) {
+    log.Message(Log::kError, "Stage ", name, ": bad size ", size, ", hop ",
+                hop, " or queue ", queue);
+    return false;
+  }
+  if (parts == 0) {
+    // large transforms are shared by the workers, in up to 8 parts
+    parts = 1;
+    int workers = scheduler->GetNumberOfWorkers(poolId);
+    while (size >= kSplitSize && parts * 2 <= std::min(8, workers) &&
+           size % (parts * 2) == 0) {
+      parts *= 2;
+    }
+  }
+  if (parts < 1 || size % parts != 0 || size / parts < 2) {
+    log.Message(Log::kError, "Stage ", name, ": size ", size,
+                " cannot be split into ", parts, " parts");
+    return false;
+  }
+
+  auto stage = std::make_unique<internal::Stage>();
+  stage->name = name;
+  stage->lostMessage = "Result queue of " + name + " is full, ";
+  stage->input = inputId;
+  stage->inputSource = scheduler->GetSourceHandle(inputId);
+  if (!stage->inputSource.valid()) {
+    log.Message(Log::kError, "Stage ", name, ": input ", input,
+                " is not registered");
+    return false;
+  }
+  // the first stage is the module itself
+  stage->output = stages.empty() ? module_center->GetId<FourierTransform>()
+                                 : scheduler->AllocateSourceId();
+  stage->size = static_cast<std::size_t>(size);
+  stage->hop = static_cast<std::size_t>(hop);
+  stage->fft = std::make_unique<SplitFFT>(size, parts);
+  stage->pool = poolId;
+  stage->window.resize(stage->size);
+  stage->resultCount = stage->size / 2 + 1;
+  stage->spectrum.resize(stage->resultCount);
+  log.Message("Stage ", name, ": input ", input, ", size ", size, ", hop ",
+              hop, ", pool ", pool, ", parts ", parts, ", source id ",
+              stage->output);
+
+  stage->outputSource = scheduler->RegisterSource(
+      stage->output,
+      static_cast<int>(sizeof(std::complex<float>) * stage->resultCount),
+      queue);
+  if (!stage->outputSource.valid()) {
+    log.Message(Log::kError, "Stage ", name, ": cannot register source ",
+                stage->output);
+    return false;
+  }
+  scheduler->SetSourceName(stage->output, name);
+
+#ifdef ZAMT_MODULE_VIS_GTK
+  if (cli.HasParam(kVisualizeSpectrumStr)) {
+    stage->spectrogram = std::make_unique<Spectrogram>(
+        module_center, stage->name.c_str(),
+        static_cast<int>(stage->resultCount), kSpectrogramHistory);
+    stage->power.resize(stage->resultCount);
+  }
+#endif
+
+  internal::Stage* stagePtr = stage.get();
+  stages.push_back(std::move(stage));
+  // the window is built from consecutive packets
+  scheduler->SubscribeInOrder(
+      inputId,
+      [this, stagePtr](auto id, auto packet, auto time) {
+        ProcessPacket(*stagePtr, id, packet, time);
       },
-      false, subscriptionId);
-  log.Message("audio source = ", audio, ", self id = ", self_id);
-  scheduler->RegisterSource(
-      self_id, static_cast<int>(sizeof(std::complex<float>) * resultCount),
-      42 /*random number, chosen by 2 fair dice rolls*/);
+      stagePtr->subscriptionId, poolId);
+  return true;
+}
+
+void FourierTransform::ProcessPacket(internal::Stage& stage,
+                                     Scheduler::SourceId /*id*/,
+                                     const Scheduler::Byte* packet,
+                                     Scheduler::Time timestamp) {
+  auto samples = reinterpret_cast<const LiveAudio::StereoSample*>(packet);
+  std::size_t sampleCount = static_cast<std::size_t>(
+      scheduler->GetPacketSize(stage.inputSource) /
+      static_cast<int>(sizeof(LiveAudio::StereoSample)));
+  auto metadata = reinterpret_cast<const LiveAudio::PacketMetadata*>(
+      scheduler->GetPacketMetadata(stage.inputSource, packet));
+
+  std::lock_guard<std::mutex> lock(stage.mutex);
+  if (metadata->first_sample != stage.nextSample) {
+    // lost packets, start collecting again
+    stage.filled = 0;
+  }
+  stage.nextSample = metadata->first_sample + sampleCount;
+  for (std::size_t i = 0; i < sampleCount; ++i) {
+    stage.window[stage.filled++] = (samples[i].left + samples[i].right) * 0.5f;
+    if (stage.filled < stage.size) continue;
+    // labeled by the time of the first sample in the window
+    double offset = (static_cast<double>(i + 1) -
+                     static_cast<double>(stage.size)) *
+                    metadata->usec_per_sample;
+    Transform(stage, timestamp + static_cast<Scheduler::Time>(
+                                     std::llround(offset)));
+    std::copy(stage.window.begin() + static_cast<std::ptrdiff_t>(stage.hop),
+              stage.window.end(), stage.window.begin());
+    stage.filled = stage.size - stage.hop;
+  }
+  scheduler->ReleasePacket(stage.inputSource, packet);
+}
+
+void FourierTransform::Transform(internal::Stage& stage,
+                                 Scheduler::Time timestamp) {
+  stage.fft->Transform(stage.window.data(), stage.spectrum.data(), *scheduler,
+                       stage.pool);
+
+#ifdef ZAMT_MODULE_VIS_GTK
+  if (stage.spectrogram) {
+    // a full scale sine is 0 dB
+    float scale = 4.0f / static_cast<float>(stage.size * stage.size);
+    std::transform(stage.spectrum.begin(), stage.spectrum.end(),
+                   stage.power.begin(),
+                   [scale](std::complex<float> bin) {
+                     return std::norm(bin) * scale;
+                   });
+    stage.spectrogram->AddColumn(stage.power.data());
+  }
 #endif
 
-  // core.RegisterForQuitEvent([this](auto exit_code) {  });
+  // not waiting for the sinks: they may be queued behind this worker
+  auto resultPacket = reinterpret_cast<std::complex<float>*>(
+      scheduler->GetPacketForSubmission(stage.outputSource));
+  if (!resultPacket) {
+    ++stage.transformsLost;
+    log.LogMessage(Log::kWarning, stage.lostMessage.c_str(),
+                   stage.transformsLost, " transforms lost!");
+    return;
+  }
+
+  memcpy(resultPacket, stage.spectrum.data(),
+         stage.resultCount * sizeof(std::complex<float>));
+
+  scheduler->SubmitPacket(stage.outputSource,
+                          reinterpret_cast<Scheduler::Byte*>(resultPacket),
+                          timestamp);
 }
+#endif
 
 }  // namespace dft_fftw
 }  // namespace zamt
@@ -0,0 +1,57 @@
+#include "zamt/dft_fftw/RealFFT.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <fftw3.h>
+
+namespace zamt {
+namespace dft_fftw {
+
+static_assert(sizeof(std::complex<float>) == sizeof(fftwf_complex), "");
+
+struct RealFFT::Plans {
+  fftwf_plan forward;
+  fftwf_plan inverse;
+};
+
+RealFFT::RealFFT(int size) : size_(size), plans_(new Plans) {
+  assert(size >= 2);
+  samples_ =
+      static_cast<float*>(fftwf_malloc(sizeof(float) * (std::size_t)size));
+  spectrum_ = static_cast<std::complex<float>*>(
+      fftwf_malloc(sizeof(fftwf_complex) * (std::size_t)bins()));
+  auto bins = reinterpret_cast<fftwf_complex*>(spectrum_);
+  {
+    std::lock_guard<std::mutex> lock(planner_mutex());
+    plans_->forward =
+        fftwf_plan_dft_r2c_1d(size, samples_, bins, FFTW_MEASURE);
+    plans_->inverse =
+        fftwf_plan_dft_c2r_1d(size, bins, samples_, FFTW_MEASURE);
+  }
+  // measuring overwrote them
+  memset(samples_, 0, sizeof(float) * (std::size_t)size);
+  memset(bins, 0, sizeof(fftwf_complex) * (std::size_t)this->bins());
+}
+
+RealFFT::~RealFFT() {
+  {
+    std::lock_guard<std::mutex> lock(planner_mutex());
+    fftwf_destroy_plan(plans_->forward);
+    fftwf_destroy_plan(plans_->inverse);
+  }
+  fftwf_free(samples_);
+  fftwf_free(spectrum_);
+}
+
+void RealFFT::Forward() { fftwf_execute(plans_->forward); }
+
+void RealFFT::Inverse() { fftwf_execute(plans_->inverse); }
+
+std::mutex& RealFFT::planner_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+}  // namespace dft_fftw
+}  // namespace zamt
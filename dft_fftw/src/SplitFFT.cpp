@@ -0,0 +1,75 @@
+#include "zamt/dft_fftw/SplitFFT.h"
+
+#include "zamt/dft_fftw/RealFFT.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace zamt {
+namespace dft_fftw {
+
+SplitFFT::SplitFFT(int size, int parts) : size_(size), parts_(parts) {
+  assert(parts > 0 && size % parts == 0 && size / parts >= 2);
+  for (int part = 0; part < parts; ++part)
+    transforms_.push_back(std::unique_ptr<RealFFT>(new RealFFT(size / parts)));
+  if (parts == 1) return;
+  const double pi = std::acos(-1.0);
+  twiddles_.reserve((std::size_t)size);
+  for (int k = 0; k < size; ++k) {
+    auto twiddle = std::polar(1.0, -2.0 * pi * k / size);
+    twiddles_.emplace_back((float)twiddle.real(), (float)twiddle.imag());
+  }
+}
+
+SplitFFT::~SplitFFT() {}
+
+void SplitFFT::Transform(const float* samples, std::complex<float>* bins,
+                         Scheduler& scheduler, Scheduler::PoolId pool) {
+  if (parts_ == 1) {
+    RealFFT& transform = *transforms_[0];
+    memcpy(transform.samples(), samples, (std::size_t)size_ * sizeof(float));
+    transform.Forward();
+    memcpy(bins, transform.spectrum(),
+           (std::size_t)this->bins() * sizeof(std::complex<float>));
+    return;
+  }
+  int part_size = size_ / parts_;
+  scheduler.ParallelFor(
+      0, parts_, 1,
+      [&](int begin, int end) {
+        for (int part = begin; part < end; ++part) {
+          RealFFT& transform = *transforms_[(std::size_t)part];
+          float* part_samples = transform.samples();
+          for (int m = 0; m < part_size; ++m)
+            part_samples[m] = samples[part + parts_ * m];
+          transform.Forward();
+        }
+      },
+      pool);
+  scheduler.ParallelFor(
+      0, this->bins(), kCombinedBinsPerTask,
+      [&](int begin, int end) {
+        for (int k = begin; k < end; ++k) {
+          std::complex<float> bin = GetPartBin(0, k);
+          for (int part = 1; part < parts_; ++part) {
+            bin += twiddles_[(std::size_t)((part * k) % size_)] *
+                   GetPartBin(part, k);
+          }
+          bins[k] = bin;
+        }
+      },
+      pool);
+}
+
+std::complex<float> SplitFFT::GetPartBin(int part, int bin) const {
+  RealFFT& transform = *transforms_[(std::size_t)part];
+  int part_size = transform.size();
+  bin %= part_size;
+  if (bin <= part_size / 2) return transform.spectrum()[bin];
+  // the transform of real samples is conjugate symmetric
+  return std::conj(transform.spectrum()[part_size - bin]);
+}
+
+}  // namespace dft_fftw
+}  // namespace zamt
@@ -0,0 +1,49 @@
+#include "zamt/core/Scheduler.h"
+#include "zamt/core/TestSuite.h"
+#include "zamt/dft_fftw/SplitFFT.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <vector>
+
+using namespace zamt;
+using namespace zamt::dft_fftw;
+
+// The parts run on the workers, compared with the transform in one part.
+void SplitIsSameAsWhole(Scheduler& scheduler, int size) {
+  std::mt19937 random((unsigned)size);
+  std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+  std::vector<float> samples((size_t)size);
+  for (float& sample : samples) sample = noise(random);
+
+  SplitFFT whole(size, 1);
+  std::vector<std::complex<float>> expected((size_t)whole.bins());
+  whole.Transform(samples.data(), expected.data(), scheduler);
+  float peak = 0.0f;
+  for (std::complex<float> bin : expected) peak = std::max(peak, std::abs(bin));
+
+  for (int parts : {2, 3, 4, 8}) {
+    if (size % parts != 0) continue;
+    SplitFFT split(size, parts);
+    ASSERT(split.bins() == whole.bins());
+    std::vector<std::complex<float>> bins((size_t)split.bins());
+    // twice, the buffers of the parts are reused
+    for (int i = 0; i < 2; ++i) {
+      split.Transform(samples.data(), bins.data(), scheduler);
+      float error = 0.0f;
+      for (size_t k = 0; k < bins.size(); ++k)
+        error = std::max(error, std::abs(bins[k] - expected[k]));
+      EXPECT(error < 2e-5f * peak);
+    }
+  }
+}
+
+TEST_BEGIN() {
+  Scheduler scheduler(4);
+  SplitIsSameAsWhole(scheduler, 4096);
+  SplitIsSameAsWhole(scheduler, 6000);
+  scheduler.Shutdown();
+}
+TEST_END()
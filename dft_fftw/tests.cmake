@@ -0,0 +1,13 @@
+set(this_module dft_fftw)
+
+
+# the module is built with an audio input
+set(other_modules
+  core
+  liveaudio_pulse
+)
+
+set(test_cpps
+  SplitFFTTest.cpp
+)
+AddTest(SplitFFTTest ${this_module} "${other_modules}" "${test_cpps}")
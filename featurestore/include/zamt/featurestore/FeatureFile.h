@@ -0,0 +1,138 @@
+#ifndef ZAMT_FEATURESTORE_FEATUREFILE_H_
+#define ZAMT_FEATURESTORE_FEATUREFILE_H_
+
+/// Columnar file of fixed size feature frames (e.g. spectra) with timestamps.
+/**
+ * The file is a header followed by blocks of rows. Each block stores the
+ * timestamps of its rows in one column, then the rows with a fixed stride
+ * (16 byte aligned), so a timestamp search touches only timestamps and a
+ * frame can be used in place with SIMD loads.
+ * Headers and blocks are multiples of kAlignment, so the writer can bypass
+ * the page cache (O_DIRECT) with its aligned block buffers, written out by
+ * its own thread. The number of rows is put in the header on Close(); a file
+ * which was not closed is valid up to its last full block.
+ * The reader maps the file to memory: rows are read without copying, any
+ * row is reached directly by its index, and by time in constant time too
+ * when the frames come at a regular rate (as a transform's hop).
+ */
+
+#include "zamt/core/Scheduler.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zamt {
+
+struct FeatureFileHeader {
+  char magic[8];
+  uint32_t row_size;        // bytes of a frame
+  uint32_t row_stride;      // bytes between the frames in a block
+  uint32_t rows_per_block;
+  uint32_t block_size;      // bytes
+  uint64_t rows;            // 0 until closed
+};
+
+class FeatureFileWriter {
+ public:
+  using Byte = Scheduler::Byte;
+  using Time = Scheduler::Time;
+
+  const static char* kMagic;  // 8 bytes, version included
+  const static int kAlignment = 4096;  // of blocks in memory and in the file
+  const static int kRowAlignment = 16;
+  const static int kTargetBlockSize = 1 << 20;  // bytes written at once
+
+  FeatureFileWriter() = default;
+  ~FeatureFileWriter();
+
+  FeatureFileWriter(const FeatureFileWriter&) = delete;
+  FeatureFileWriter& operator=(const FeatureFileWriter&) = delete;
+
+  /// Creates the file (truncating it) and starts the writer thread.
+  /// With direct_io, the page cache is bypassed if the file system can.
+  bool Open(const char* path, int row_size, bool direct_io = false);
+
+  /// Copies a frame into the next row. Timestamps should not decrease.
+  void Append(Time timestamp, const Byte* row);
+
+  /// Writes out all rows and the header, then closes the file.
+  /// Returns false if anything could not be written.
+  bool Close();
+
+  int64_t rows() const { return rows_; }
+  bool direct_io() const { return direct_io_; }
+
+ private:
+  struct AlignedFree {
+    void operator()(Byte* buffer) const;
+  };
+  using Block = std::unique_ptr<Byte, AlignedFree>;
+
+  Block AllocateBlock();
+  void HandOverBlock();
+  bool WriteHeader();
+  void RunWriter();
+
+  int fd_ = -1;
+  bool direct_io_ = false;
+  FeatureFileHeader header_;
+  int64_t rows_ = 0;
+  Block block_;  // being filled
+  int block_rows_ = 0;
+  int64_t blocks_ = 0;
+
+  std::mutex blocks_mtx_;
+  std::condition_variable blocks_cv_;
+  std::deque<std::pair<Block, int64_t>> full_blocks_;  // with file offsets
+  std::vector<Block> spare_blocks_;
+  bool closing_ = false;
+  bool failed_ = false;
+  std::unique_ptr<std::thread> writer_;
+};
+
+class FeatureFileReader {
+ public:
+  using Byte = Scheduler::Byte;
+  using Time = Scheduler::Time;
+
+  FeatureFileReader() = default;
+  ~FeatureFileReader();
+
+  FeatureFileReader(const FeatureFileReader&) = delete;
+  FeatureFileReader& operator=(const FeatureFileReader&) = delete;
+
+  /// Maps a feature file to memory, returns false if it is not one.
+  bool Open(const char* path);
+  void Close();
+
+  int row_size() const { return (int)header_.row_size; }
+  int64_t rows() const { return rows_; }
+
+  Time timestamp(int64_t row) const;
+  /// Points into the mapped file, 16 byte aligned.
+  const Byte* row(int64_t row) const;
+
+  /// Returns the last row not later than time, -1 if all are later.
+  /// Guesses by the average rate of the rows, so it is constant time for
+  /// regular frames.
+  int64_t FindRow(Time time) const;
+
+ private:
+  const Byte* GetBlock(int64_t row) const;
+
+  const Byte* data_ = nullptr;  // mapped file
+  size_t size_ = 0;
+  FeatureFileHeader header_;
+  size_t rows_offset_ = 0;  // in a block
+  int64_t rows_ = 0;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_FEATURESTORE_FEATUREFILE_H_
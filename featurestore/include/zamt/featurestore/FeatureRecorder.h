@@ -0,0 +1,60 @@
+#ifndef ZAMT_FEATURESTORE_FEATURERECORDER_H_
+#define ZAMT_FEATURESTORE_FEATURERECORDER_H_
+
+/// Stores the packets of a source (e.g. spectra) as rows of a feature file.
+/**
+ * The recorder is an in order sink of the source, so the rows are in the
+ * order of submission and are found by the packet timestamps later.
+ * A packet is copied into the block being filled and released at once; the
+ * blocks are written out by the thread of the feature file.
+ */
+
+#include "zamt/core/Scheduler.h"
+#include "zamt/featurestore/FeatureFile.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace zamt {
+
+class FeatureRecorder {
+ public:
+  FeatureRecorder(Scheduler& scheduler, Scheduler::SourceId source_id);
+  ~FeatureRecorder();
+
+  FeatureRecorder(const FeatureRecorder&) = delete;
+  FeatureRecorder& operator=(const FeatureRecorder&) = delete;
+
+  /// Creates the file and subscribes to the source on the given pool.
+  bool Start(const char* path, bool direct_io = false,
+             Scheduler::PoolId pool_id = Scheduler::kDefaultPool);
+
+  /// Unsubscribes and writes out the stored rows.
+  /// Returns false if anything could not be written.
+  bool Stop();
+
+  int64_t recorded() const;
+
+ private:
+  // Shared with the sink callback as pending tasks may outlive a Stop().
+  struct State {
+    std::mutex mtx;
+    bool recording = false;
+    FeatureFileWriter writer;
+  };
+
+  static void Store(Scheduler* scheduler, Scheduler::SourceHandle source,
+                    State* state, const Scheduler::Byte* packet,
+                    Scheduler::Time timestamp);
+
+  Scheduler& scheduler_;
+  Scheduler::SourceId source_id_;
+  Scheduler::SourceHandle source_;
+  std::shared_ptr<State> state_;
+  int subscription_id_ = -1;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_FEATURESTORE_FEATURERECORDER_H_
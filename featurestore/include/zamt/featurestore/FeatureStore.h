@@ -0,0 +1,55 @@
+#ifndef ZAMT_FEATURESTORE_FEATURESTORE_H_
+#define ZAMT_FEATURESTORE_FEATURESTORE_H_
+
+/// Stores sources into feature files, set up by the pipeline.
+/**
+ * Pipeline stages of type "store" store the packets of their input source
+ * as rows of a feature file until quit, e.g. the spectra of the transform
+ * to look them up by time later without copying them:
+ *
+ *   store spectra input=FourierTransform file=spectra.zfs direct=1
+ *
+ * With direct=1 the file is written past the page cache where supported.
+ * Stores subscribe in Connect, when the sources of every module are
+ * registered, so their input can be a stage of any module (e.g. nn or a
+ * replay).
+ */
+
+#include "zamt/core/CLIParameters.h"
+#include "zamt/core/Module.h"
+
+#include <memory>
+#include <vector>
+
+namespace zamt {
+
+class FeatureRecorder;
+class Log;
+
+class FeatureStore : public Module {
+ public:
+  const static char* kModuleLabel;
+  const static char* kStoreStageType;
+
+  FeatureStore(int argc, const char* const* argv);
+  ~FeatureStore();
+
+  void Initialize(const ModuleCenter* mc);
+  void Connect(const ModuleCenter* mc);
+
+ private:
+  // Returns false if the stages cannot be set up.
+  bool AddStores();
+  void Shutdown(int exit_code);
+  void PrintHelp();
+
+  CLIParameters cli_;
+  std::unique_ptr<Log> log_;
+  const ModuleCenter* mc_ = nullptr;
+  bool started_ = false;
+  std::vector<std::unique_ptr<FeatureRecorder>> recorders_;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_FEATURESTORE_FEATURESTORE_H_
@@ -0,0 +1,269 @@
+#include "zamt/featurestore/FeatureFile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zamt {
+
+const char* FeatureFileWriter::kMagic = "ZAMTFEA1";
+
+namespace {
+
+const int kTimestampsAlignment = 64;
+const int kMaxGuessSteps = 2;  // then binary search
+
+size_t Align(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+// Where the rows start in a block after the column of timestamps.
+size_t GetRowsOffset(uint32_t rows_per_block) {
+  return Align(rows_per_block * sizeof(uint64_t), kTimestampsAlignment);
+}
+
+}  // namespace
+
+void FeatureFileWriter::AlignedFree::operator()(Byte* buffer) const {
+  free(buffer);
+}
+
+FeatureFileWriter::~FeatureFileWriter() { Close(); }
+
+bool FeatureFileWriter::Open(const char* path, int row_size, bool direct_io) {
+  assert(fd_ < 0 && row_size > 0);
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  direct_io_ = false;
+#ifdef O_DIRECT
+  if (direct_io) {
+    fd_ = open(path, flags | O_DIRECT, 0644);
+    // e.g. tmpfs does not support it
+    direct_io_ = fd_ >= 0;
+  }
+#else
+  (void)direct_io;
+#endif
+  if (fd_ < 0) fd_ = open(path, flags, 0644);
+  if (fd_ < 0) return false;
+
+  memset(&header_, 0, sizeof(header_));
+  memcpy(header_.magic, kMagic, sizeof(header_.magic));
+  header_.row_size = (uint32_t)row_size;
+  header_.row_stride = (uint32_t)Align((size_t)row_size, kRowAlignment);
+  size_t row_bytes = sizeof(uint64_t) + header_.row_stride;
+  header_.rows_per_block =
+      (uint32_t)std::max<size_t>(1, kTargetBlockSize / row_bytes);
+  header_.block_size = (uint32_t)Align(
+      GetRowsOffset(header_.rows_per_block) +
+          (size_t)header_.rows_per_block * header_.row_stride,
+      kAlignment);
+  rows_ = 0;
+  blocks_ = 0;
+  block_rows_ = 0;
+  closing_ = false;
+  failed_ = false;
+  if (!WriteHeader()) {
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  block_ = AllocateBlock();
+  writer_.reset(new std::thread(&FeatureFileWriter::RunWriter, this));
+  return true;
+}
+
+void FeatureFileWriter::Append(Time timestamp, const Byte* row) {
+  assert(fd_ >= 0);
+  Byte* block = block_.get();
+  uint64_t stamp = timestamp;
+  memcpy(block + (size_t)block_rows_ * sizeof(uint64_t), &stamp,
+         sizeof(stamp));
+  memcpy(block + GetRowsOffset(header_.rows_per_block) +
+             (size_t)block_rows_ * header_.row_stride,
+         row, header_.row_size);
+  ++rows_;
+  if (++block_rows_ == (int)header_.rows_per_block) HandOverBlock();
+}
+
+bool FeatureFileWriter::Close() {
+  if (fd_ < 0) return true;
+  if (block_rows_) HandOverBlock();
+  {
+    std::lock_guard<std::mutex> lock(blocks_mtx_);
+    closing_ = true;
+  }
+  blocks_cv_.notify_one();
+  writer_->join();
+  writer_.reset();
+  header_.rows = (uint64_t)rows_;
+  bool ok = !failed_ && WriteHeader();
+  if (close(fd_) != 0) ok = false;
+  fd_ = -1;
+  block_.reset();
+  spare_blocks_.clear();
+  return ok;
+}
+
+FeatureFileWriter::Block FeatureFileWriter::AllocateBlock() {
+  void* buffer = nullptr;
+  int error = posix_memalign(&buffer, kAlignment, header_.block_size);
+  assert(error == 0);
+  (void)error;
+  // padding is written as well
+  memset(buffer, 0, header_.block_size);
+  return Block(static_cast<Byte*>(buffer));
+}
+
+void FeatureFileWriter::HandOverBlock() {
+  int64_t offset = kAlignment + blocks_ * (int64_t)header_.block_size;
+  Block next;
+  {
+    std::lock_guard<std::mutex> lock(blocks_mtx_);
+    full_blocks_.emplace_back(std::move(block_), offset);
+    if (!spare_blocks_.empty()) {
+      next = std::move(spare_blocks_.back());
+      spare_blocks_.pop_back();
+    }
+  }
+  blocks_cv_.notify_one();
+  ++blocks_;
+  block_rows_ = 0;
+  block_ = next ? std::move(next) : AllocateBlock();
+}
+
+bool FeatureFileWriter::WriteHeader() {
+  Block buffer;
+  {
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kAlignment, kAlignment) != 0) return false;
+    buffer.reset(static_cast<Byte*>(memory));
+  }
+  memset(buffer.get(), 0, kAlignment);
+  memcpy(buffer.get(), &header_, sizeof(header_));
+  return pwrite(fd_, buffer.get(), kAlignment, 0) == kAlignment;
+}
+
+void FeatureFileWriter::RunWriter() {
+  std::unique_lock<std::mutex> lock(blocks_mtx_);
+  for (;;) {
+    blocks_cv_.wait(lock, [this] { return closing_ || !full_blocks_.empty(); });
+    if (full_blocks_.empty()) return;  // closing
+    auto block = std::move(full_blocks_.front());
+    full_blocks_.pop_front();
+    lock.unlock();
+    ssize_t written = pwrite(fd_, block.first.get(), header_.block_size,
+                             (off_t)block.second);
+    bool ok = written == (ssize_t)header_.block_size;
+    // the unused rows of a reused block are zeros again
+    memset(block.first.get(), 0, header_.block_size);
+    lock.lock();
+    if (!ok) failed_ = true;
+    spare_blocks_.push_back(std::move(block.first));
+  }
+}
+
+FeatureFileReader::~FeatureFileReader() { Close(); }
+
+bool FeatureFileReader::Open(const char* path) {
+  assert(!data_);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat file_stat;
+  bool ok = fstat(fd, &file_stat) == 0 &&
+            (size_t)file_stat.st_size >= FeatureFileWriter::kAlignment;
+  if (ok) {
+    size_ = (size_t)file_stat.st_size;
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ok = data != MAP_FAILED;
+    if (ok) data_ = static_cast<const Byte*>(data);
+  }
+  close(fd);  // the mapping stays
+  if (!ok) return false;
+
+  memcpy(&header_, data_, sizeof(header_));
+  rows_offset_ = GetRowsOffset(header_.rows_per_block);
+  if (memcmp(header_.magic, FeatureFileWriter::kMagic, sizeof(header_.magic)) ||
+      header_.row_size == 0 ||
+      header_.row_stride % FeatureFileWriter::kRowAlignment ||
+      header_.row_stride < header_.row_size || header_.rows_per_block == 0 ||
+      header_.block_size % FeatureFileWriter::kAlignment ||
+      header_.block_size <
+          rows_offset_ + (size_t)header_.rows_per_block * header_.row_stride) {
+    Close();
+    return false;
+  }
+  int64_t blocks =
+      (int64_t)((size_ - FeatureFileWriter::kAlignment) / header_.block_size);
+  int64_t full_rows = blocks * header_.rows_per_block;
+  // without the count only the full blocks are known to be written
+  rows_ = header_.rows ? std::min((int64_t)header_.rows, full_rows)
+                       : full_rows;
+  return true;
+}
+
+void FeatureFileReader::Close() {
+  if (!data_) return;
+  munmap(const_cast<Byte*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  rows_ = 0;
+}
+
+FeatureFileReader::Time FeatureFileReader::timestamp(int64_t row) const {
+  const Byte* block = GetBlock(row);
+  uint64_t stamp;
+  memcpy(&stamp,
+         block + (size_t)(row % header_.rows_per_block) * sizeof(uint64_t),
+         sizeof(stamp));
+  return stamp;
+}
+
+const FeatureFileReader::Byte* FeatureFileReader::row(int64_t row) const {
+  return GetBlock(row) + rows_offset_ +
+         (size_t)(row % header_.rows_per_block) * header_.row_stride;
+}
+
+int64_t FeatureFileReader::FindRow(Time time) const {
+  if (rows_ == 0 || time < timestamp(0)) return -1;
+  Time first = timestamp(0);
+  Time last = timestamp(rows_ - 1);
+  if (time >= last) return rows_ - 1;
+  // first <= time < last from here on
+  int64_t guess = (int64_t)((double)(time - first) / (double)(last - first) *
+                            (double)(rows_ - 1));
+  guess = std::max<int64_t>(0, std::min(guess, rows_ - 2));
+  for (int step = 0; step < kMaxGuessSteps; ++step) {
+    if (timestamp(guess) > time) {
+      --guess;
+    } else if (timestamp(guess + 1) <= time) {
+      ++guess;
+    } else {
+      return guess;
+    }
+  }
+  // irregular frames: the last row not later than time, within [low, high)
+  int64_t low = 0;
+  int64_t high = rows_ - 1;
+  while (high - low > 1) {
+    int64_t middle = low + (high - low) / 2;
+    if (timestamp(middle) <= time)
+      low = middle;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+const FeatureFileReader::Byte* FeatureFileReader::GetBlock(int64_t row) const {
+  assert(data_ && row >= 0 && row < rows_);
+  return data_ + FeatureFileWriter::kAlignment +
+         (size_t)(row / header_.rows_per_block) * header_.block_size;
+}
+
+}  // namespace zamt
@@ -0,0 +1,66 @@
+#include "zamt/featurestore/FeatureRecorder.h"
+
+#include <cassert>
+
+namespace zamt {
+
+FeatureRecorder::FeatureRecorder(Scheduler& scheduler,
+                                 Scheduler::SourceId source_id)
+    : scheduler_(scheduler),
+      source_id_(source_id),
+      source_(scheduler.GetSourceHandle(source_id)),
+      state_(std::make_shared<State>()) {}
+
+FeatureRecorder::~FeatureRecorder() { Stop(); }
+
+bool FeatureRecorder::Start(const char* path, bool direct_io,
+                            Scheduler::PoolId pool_id) {
+  assert(subscription_id_ < 0);
+  if (!source_.valid()) return false;
+  {
+    std::lock_guard<std::mutex> lock(state_->mtx);
+    if (!state_->writer.Open(path, scheduler_.GetPacketSize(source_),
+                             direct_io))
+      return false;
+    state_->recording = true;
+  }
+  Scheduler* scheduler = &scheduler_;
+  Scheduler::SourceHandle source = source_;
+  std::shared_ptr<State> state = state_;
+  scheduler_.SubscribeInOrder(
+      source_id_,
+      [scheduler, source, state](Scheduler::SourceId,
+                                 const Scheduler::Byte* packet,
+                                 Scheduler::Time timestamp) {
+        Store(scheduler, source, state.get(), packet, timestamp);
+      },
+      subscription_id_, pool_id);
+  return true;
+}
+
+bool FeatureRecorder::Stop() {
+  if (subscription_id_ < 0) return true;
+  scheduler_.Unsubscribe(source_id_, subscription_id_);
+  subscription_id_ = -1;
+  std::lock_guard<std::mutex> lock(state_->mtx);
+  state_->recording = false;
+  return state_->writer.Close();
+}
+
+int64_t FeatureRecorder::recorded() const {
+  std::lock_guard<std::mutex> lock(state_->mtx);
+  return state_->writer.rows();
+}
+
+void FeatureRecorder::Store(Scheduler* scheduler,
+                            Scheduler::SourceHandle source, State* state,
+                            const Scheduler::Byte* packet,
+                            Scheduler::Time timestamp) {
+  {
+    std::lock_guard<std::mutex> lock(state->mtx);
+    if (state->recording) state->writer.Append(timestamp, packet);
+  }
+  scheduler->ReleasePacket(source, packet);
+}
+
+}  // namespace zamt
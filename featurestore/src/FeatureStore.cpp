@@ -0,0 +1,85 @@
+#include "zamt/featurestore/FeatureStore.h"
+
+#include "zamt/core/Core.h"
+#include "zamt/core/Log.h"
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/core/Scheduler.h"
+#include "zamt/featurestore/FeatureRecorder.h"
+
+namespace zamt {
+
+const char* FeatureStore::kModuleLabel = "featurestore";
+const char* FeatureStore::kStoreStageType = "store";
+
+ZAMT_MODULE_DEPENDS(FeatureStore, Core);
+
+FeatureStore::FeatureStore(int argc, const char* const* argv)
+    : cli_(argc, argv) {
+  log_.reset(new Log(kModuleLabel, cli_));
+  if (cli_.HasParam(Core::kHelpParamStr)) {
+    PrintHelp();
+    return;
+  }
+  started_ = true;
+}
+
+FeatureStore::~FeatureStore() { Shutdown(0); }
+
+void FeatureStore::Initialize(const ModuleCenter* mc) { mc_ = mc; }
+
+void FeatureStore::Connect(const ModuleCenter*) {
+  if (!started_) return;
+  Core& core = mc_->Get<Core>();
+  if (!AddStores()) {
+    core.Quit(Core::kExitCodeBadPipeline);
+    return;
+  }
+  if (recorders_.empty()) return;
+  core.RegisterForQuitEvent(
+      std::bind(&FeatureStore::Shutdown, this, std::placeholders::_1));
+}
+
+bool FeatureStore::AddStores() {
+  Core& core = mc_->Get<Core>();
+  Scheduler& scheduler = core.scheduler();
+  for (auto stage : core.pipeline().GetStages(kStoreStageType)) {
+    const char* input = stage->GetParam("input");
+    const char* file = stage->GetParam("file");
+    bool direct_io = stage->GetNumParam("direct", 0) != 0;
+    Scheduler::SourceId source_id;
+    if (!input || !scheduler.FindSource(input, source_id)) {
+      log_->Message(Log::kError, "Store ", stage->name, ": no input ",
+                    input ? input : "(none)");
+      return false;
+    }
+    std::unique_ptr<FeatureRecorder> recorder(
+        new FeatureRecorder(scheduler, source_id));
+    if (!file || !recorder->Start(file, direct_io)) {
+      log_->Message(Log::kError, "Store ", stage->name, ": cannot create ",
+                    file ? file : "(no file)");
+      return false;
+    }
+    log_->Message("Store ", stage->name, ": ", input, " into ", file);
+    recorders_.push_back(std::move(recorder));
+  }
+  return true;
+}
+
+void FeatureStore::Shutdown(int /*exit_code*/) {
+  for (auto& recorder : recorders_) {
+    int64_t rows = recorder->recorded();
+    if (recorder->Stop()) {
+      log_->Message("Stored ", rows, " frames.");
+    } else {
+      log_->Message(Log::kError, "Storing failed after ", rows, " frames!");
+    }
+  }
+  recorders_.clear();
+}
+
+void FeatureStore::PrintHelp() {
+  Log::Print("ZAMT Feature Store");
+  Log::Print(" Pipeline stages: store Name input=Source file=Path direct=0|1");
+}
+
+}  // namespace zamt
@@ -0,0 +1,138 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/featurestore/FeatureFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace zamt;
+
+static const char* kPath = "FeatureFileTest.zfs";
+
+void FillRow(uint8_t* row, int size, int num) {
+  for (int i = 0; i < size; ++i) row[i] = (uint8_t)(num + i);
+}
+
+// Writes rows numbered by their index with timestamps of index * 10.
+void WriteRows(int row_size, int rows, bool direct_io) {
+  FeatureFileWriter writer;
+  ASSERT(writer.Open(kPath, row_size, direct_io));
+  std::vector<uint8_t> row((size_t)row_size);
+  for (int i = 0; i < rows; ++i) {
+    FillRow(row.data(), row_size, i);
+    writer.Append((Scheduler::Time)i * 10, row.data());
+  }
+  EXPECT(writer.rows() == rows);
+  ASSERT(writer.Close());
+}
+
+void CheckRows(const FeatureFileReader& reader, int rows) {
+  int row_size = reader.row_size();
+  ASSERT(reader.rows() == rows);
+  std::vector<uint8_t> row((size_t)row_size);
+  for (int i = 0; i < rows; ++i) {
+    FillRow(row.data(), row_size, i);
+    EXPECT(reader.timestamp(i) == (Scheduler::Time)i * 10);
+    EXPECT(memcmp(reader.row(i), row.data(), (size_t)row_size) == 0);
+    EXPECT((uintptr_t)reader.row(i) % FeatureFileWriter::kRowAlignment == 0);
+  }
+}
+
+void RowsAreReadBack() {
+  WriteRows(5, 3, false);
+  FeatureFileReader reader;
+  ASSERT(reader.Open(kPath));
+  EXPECT(reader.row_size() == 5);
+  CheckRows(reader, 3);
+  reader.Close();
+  remove(kPath);
+}
+
+void BlocksAreWrittenInOrder() {
+  // Several blocks are handed over to the writer thread, the last one
+  // partially filled. The page cache may be bypassed.
+  const int row_size = 4000;
+  const int rows = 3 * FeatureFileWriter::kTargetBlockSize / row_size;
+  WriteRows(row_size, rows, true);
+  FeatureFileReader reader;
+  ASSERT(reader.Open(kPath));
+  CheckRows(reader, rows);
+  reader.Close();
+  remove(kPath);
+}
+
+void RowsAreFoundByTime() {
+  const int rows = 1000;
+  WriteRows(16, rows, false);
+  FeatureFileReader reader;
+  ASSERT(reader.Open(kPath));
+  EXPECT(reader.FindRow(0) == 0);
+  EXPECT(reader.FindRow(9) == 0);
+  EXPECT(reader.FindRow(10) == 1);
+  EXPECT(reader.FindRow(5555) == 555);
+  EXPECT(reader.FindRow(rows * 10) == rows - 1);
+  reader.Close();
+
+  // Irregular timestamps: a burst of rows at the start.
+  FeatureFileWriter writer;
+  ASSERT(writer.Open(kPath, 16));
+  uint8_t row[16] = {};
+  for (int i = 0; i < 100; ++i) writer.Append(1000 + (Scheduler::Time)i, row);
+  for (int i = 1; i <= 10; ++i)
+    writer.Append(1000 + (Scheduler::Time)i * 1000, row);
+  ASSERT(writer.Close());
+  ASSERT(reader.Open(kPath));
+  EXPECT(reader.FindRow(999) == -1);
+  EXPECT(reader.FindRow(1050) == 50);
+  EXPECT(reader.FindRow(2500) == 100);
+  EXPECT(reader.FindRow(6000) == 104);
+  reader.Close();
+  remove(kPath);
+}
+
+void UnclosedFileIsValidUpToLastBlock() {
+  const int row_size = 4000;
+  const int rows = 3 * FeatureFileWriter::kTargetBlockSize / row_size;
+  WriteRows(row_size, rows, false);
+  // Clears the number of rows and drops the partial last block, as if the
+  // writer had not been closed.
+  int fd = open(kPath, O_RDWR);
+  ASSERT(fd >= 0);
+  FeatureFileHeader header;
+  ASSERT(pread(fd, &header, sizeof(header), 0) == sizeof(header));
+  header.rows = 0;
+  ASSERT(pwrite(fd, &header, sizeof(header), 0) == sizeof(header));
+  off_t size = lseek(fd, 0, SEEK_END);
+  ASSERT(ftruncate(fd, size - header.block_size) == 0);
+  close(fd);
+
+  FeatureFileReader reader;
+  ASSERT(reader.Open(kPath));
+  EXPECT(reader.rows() == rows - rows % (int)header.rows_per_block);
+  CheckRows(reader, (int)reader.rows());
+  reader.Close();
+  remove(kPath);
+}
+
+void OnlyFeatureFilesAreOpened() {
+  FeatureFileReader reader;
+  EXPECT(!reader.Open("NoSuchFeatures.zfs"));
+  FILE* file = fopen(kPath, "wb");
+  ASSERT(file);
+  fputs("This is not a feature file at all.", file);
+  fclose(file);
+  EXPECT(!reader.Open(kPath));
+  remove(kPath);
+}
+
+TEST_BEGIN() {
+  RowsAreReadBack();
+  BlocksAreWrittenInOrder();
+  RowsAreFoundByTime();
+  UnclosedFileIsValidUpToLastBlock();
+  OnlyFeatureFilesAreOpened();
+}
+TEST_END()
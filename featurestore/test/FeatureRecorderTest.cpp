@@ -0,0 +1,45 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/featurestore/FeatureRecorder.h"
+
+#include <cstdio>
+#include <thread>
+
+using namespace zamt;
+
+static const char* kPath = "FeatureRecorderTest.zfs";
+static const int kFrames = 20;
+static const int kFrameSize = 24;
+
+void StoredFramesAreReadBack() {
+  Scheduler sch(2);
+  sch.RegisterSource(1, kFrameSize, 4);
+  FeatureRecorder recorder(sch, 1);
+  ASSERT(recorder.Start(kPath));
+  for (int i = 0; i < kFrames; ++i) {
+    uint8_t* p;
+    while (!(p = sch.WaitForPacketForSubmission(1, 1000)))
+      std::this_thread::yield();
+    for (int j = 0; j < kFrameSize; ++j) p[j] = (uint8_t)(i + j);
+    sch.SubmitPacket(1, p, (Scheduler::Time)i * 100);
+  }
+  while (recorder.recorded() != kFrames) std::this_thread::yield();
+  ASSERT(recorder.Stop());
+  sch.Shutdown();
+
+  FeatureFileReader reader;
+  ASSERT(reader.Open(kPath));
+  EXPECT(reader.row_size() == kFrameSize);
+  ASSERT(reader.rows() == kFrames);
+  for (int i = 0; i < kFrames; ++i) {
+    EXPECT(reader.timestamp(i) == (Scheduler::Time)i * 100);
+    EXPECT(reader.row(i)[kFrameSize - 1] == (uint8_t)(i + kFrameSize - 1));
+  }
+  EXPECT(reader.FindRow(1050) == 10);
+  reader.Close();
+  remove(kPath);
+}
+
+TEST_BEGIN() {
+  StoredFramesAreReadBack();
+}
+TEST_END()
@@ -0,0 +1,16 @@
+set(this_module featurestore)
+
+
+set(other_modules
+  core
+)
+
+set(test_cpps
+  FeatureFileTest.cpp
+)
+AddTest(FeatureFileTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  FeatureRecorderTest.cpp
+)
+AddTest(FeatureRecorderTest ${this_module} "${other_modules}" "${test_cpps}")
@@ -0,0 +1,132 @@
+#ifndef ZAMT_LIVEAUDIO_ALSA_LIVEAUDIO_H_
+#define ZAMT_LIVEAUDIO_ALSA_LIVEAUDIO_H_
+
+/// This LiveAudio implementation reads an ALSA PCM device directly.
+/// It is an alternative of liveaudio_pulse with the same interface, built
+/// for lowest latency. Memory mapped access is used when the device supports
+/// it, so periods are copied straight from the device ring buffer into the
+/// scheduler packets without any intermediate buffer.
+/// Any ALSA PCM name can be used, so the snd-aloop loopback ("hw:Loopback,1")
+/// or the "null" device makes testing possible without real hardware.
+/// Own thread is used to interact with audio library for skipless recording.
+
+#include "zamt/core/CLIParameters.h"
+#include "zamt/core/Module.h"
+#include "zamt/core/SampleClock.h"
+#include "zamt/core/Scheduler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+typedef struct _snd_pcm snd_pcm_t;
+
+namespace zamt {
+
+class Log;
+class QueueTuner;
+class Scheduler;
+
+class LiveAudio : public Module {
+ public:
+  using Sample = float;
+  struct StereoSample {
+    Sample left;
+    Sample right;
+  };
+
+  /// Describes the packets published by this source on the scheduler.
+  struct SampleFormat {
+    int sample_rate;  // 0 until the device is configured
+    int channels;
+    int bytes_per_sample;
+    bool is_float;  // normalized to [-1.0, 1.0]
+  };
+
+  /// Beside every packet, see Scheduler::GetPacketMetadata().
+  /// Packet timestamps come from the sample counter locked to system time.
+  struct PacketMetadata {
+    uint64_t first_sample;   // position of the 1st sample since start
+    double usec_per_sample;  // measured, the time of any sample follows
+    double drift_ppm;        // speed of the device clock to the nominal
+  };
+
+  const static char* kModuleLabel;
+  const static char* kSourceName;  // in the scheduler
+  const static char* kDefaultDevice;
+  const static char* kDeviceListParamStr;
+  const static char* kDeviceSelectParamStr;
+  const static char* kLatencyParamStr;
+  const static char* kSampleRateParamStr;
+  const static int kChannels = 2;  // stereo
+  const static int kMaxLatencyForHardwareBufferInMs = 200;
+  const static int kMinQueueLatencyInMs = 50;    // shortest tuned queue
+  const static int kMaxQueueLatencyInMs = 1000;  // allocated packets
+  const static int kOverallLatencyInMs = 10;
+  const static int kDefaultSampleRate = 44100;
+
+  static_assert(sizeof(Sample) * kChannels == sizeof(StereoSample), "");
+
+  LiveAudio(int argc, const char* const* argv);
+  ~LiveAudio();
+
+  void Initialize(const ModuleCenter* mc);
+  void Shutdown(int exit_code);
+  bool WasStarted() const { return (bool)audio_loop_; }
+  int sample_rate() const { return sample_rate_; }
+  int requested_overall_latency() const { return requested_overall_latency_; }
+  SampleFormat sample_format() const;
+
+ private:
+  const static int kWatchDogMilliseconds = 500;
+  const static int kQueueTuningPeriodInMs = 1000;
+
+  // Returns false if the source cannot be registered.
+  bool SetupSource();
+  void RunMainLoop();
+  bool OpenDevice();
+  void CloseDevice();
+  void ListDevices();
+  bool Recover(int err);
+  void ReadMapped();
+  void ReadCopied();
+  StereoSample* AcquirePacket();
+  void SkipFrames(long frames);  // snd_pcm_sframes_t
+  void PacketFilled(int frames);
+  void SubmitOpenPacket();
+  void PrintHelp();
+  static Scheduler::Time CurrentTime();
+
+  CLIParameters cli_;
+  std::unique_ptr<Log> log_;
+  std::unique_ptr<QueueTuner> queue_tuner_;
+  const ModuleCenter* mc_ = nullptr;
+  Scheduler* scheduler_ = nullptr;
+  Scheduler::SourceId scheduler_id_;
+  Scheduler::SourceHandle source_;  // of scheduler_id_
+  const char* device_name_;
+  bool list_devices_ = false;
+  int requested_overall_latency_;
+  int requested_sample_rate_ = kDefaultSampleRate;
+  int submit_buffer_size_ = 0;  // stereo samples, also the period size
+  std::atomic<int> sample_rate_{0};
+  Scheduler::Time last_timestamp_ = 0;  // in microseconds
+  SampleClock clock_;
+  uint64_t samples_captured_ = 0;  // lost ones included
+
+  // The packet being filled, kept open between periods.
+  StereoSample* open_packet_ = nullptr;
+  int open_packet_filled_ = 0;
+  uint64_t open_packet_first_sample_ = 0;
+
+  std::atomic<bool> audio_loop_should_run_;
+  std::unique_ptr<std::thread> audio_loop_;
+  snd_pcm_t* pcm_ = nullptr;
+  bool mapped_access_ = false;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_LIVEAUDIO_ALSA_LIVEAUDIO_H_
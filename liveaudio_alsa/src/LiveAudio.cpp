@@ -0,0 +1,423 @@
+#include "zamt/liveaudio_alsa/LiveAudio.h"
+
+#include "zamt/core/CLIParameters.h"
+#include "zamt/core/Core.h"
+#include "zamt/core/Log.h"
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/core/QueueTuner.h"
+
+#include <alsa/asoundlib.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace zamt {
+
+const char* LiveAudio::kModuleLabel = "liveaudio_alsa";
+const char* LiveAudio::kSourceName = "LiveAudio";
+const char* LiveAudio::kDefaultDevice = "default";
+const char* LiveAudio::kDeviceListParamStr = "-al";
+const char* LiveAudio::kDeviceSelectParamStr = "-ad";
+const char* LiveAudio::kLatencyParamStr = "-at";
+const char* LiveAudio::kSampleRateParamStr = "-ar";
+
+ZAMT_MODULE_DEPENDS(LiveAudio, Core);
+
+LiveAudio::LiveAudio(int argc, const char* const* argv)
+    : cli_(argc, argv), device_name_(kDefaultDevice),
+      audio_loop_should_run_(false) {
+  log_.reset(new Log(kModuleLabel, cli_));
+  log_->LogMessage("Starting...");
+  if (cli_.HasParam(Core::kHelpParamStr)) {
+    PrintHelp();
+    return;
+  }
+  scheduler_id_ = ModuleCenter::GetId<LiveAudio>();
+  if (cli_.HasParam(kDeviceListParamStr)) {
+    list_devices_ = true;
+  } else {
+    const char* device = cli_.GetParam(kDeviceSelectParamStr);
+    if (device != nullptr && *device != '\0') device_name_ = device;
+  }
+  int req_sample_rate = cli_.GetNumParam(kSampleRateParamStr);
+  if (req_sample_rate != CLIParameters::kNotFound)
+    requested_sample_rate_ = req_sample_rate;
+  int req_latency = cli_.GetNumParam(kLatencyParamStr);
+  if (req_latency != CLIParameters::kNotFound) {
+    requested_overall_latency_ = req_latency;
+  } else {
+    int exact_latency = requested_sample_rate_ * kOverallLatencyInMs / 1000;
+    requested_overall_latency_ = exact_latency;
+  }
+  audio_loop_should_run_.store(true, std::memory_order_release);
+}
+
+LiveAudio::~LiveAudio() {
+  if (!WasStarted()) return;
+  log_->LogMessage("Waiting for audio thread to stop...");
+  audio_loop_->join();
+  log_->LogMessage("Audio thread stopped.");
+}
+
+void LiveAudio::Initialize(const ModuleCenter* mc) {
+  mc_ = mc;
+  if (!audio_loop_should_run_.load(std::memory_order_acquire)) return;
+
+  Core& core = mc_->Get<Core>();
+  scheduler_ = &core.scheduler();
+  if (!SetupSource()) {
+    core.Quit(Core::kExitCodeAudioProblem);
+    return;
+  }
+  log_->LogMessage("Launching audio thread...");
+  audio_loop_.reset(new std::thread(&LiveAudio::RunMainLoop, this));
+  // stops the thread at once if quit already
+  core.RegisterForQuitEvent(
+      std::bind(&LiveAudio::Shutdown, this, std::placeholders::_1));
+}
+
+void LiveAudio::Shutdown(int /*exit_code*/) {
+  log_->LogMessage("Stopping...");
+  if (!WasStarted()) return;
+  audio_loop_should_run_.store(false, std::memory_order_release);
+}
+
+LiveAudio::SampleFormat LiveAudio::sample_format() const {
+  SampleFormat format;
+  format.sample_rate = sample_rate_.load(std::memory_order_acquire);
+  format.channels = kChannels;
+  format.bytes_per_sample = (int)sizeof(Sample);
+  format.is_float = true;
+  return format;
+}
+
+bool LiveAudio::SetupSource() {
+  // Same heuristic as in liveaudio_pulse, but here the submit buffer size is
+  // also the period size asked from the device.
+  log_->LogMessage("Requested overall latency: ", requested_overall_latency_,
+                   " samples");
+  submit_buffer_size_ = 65536;
+  while (submit_buffer_size_ > requested_overall_latency_ >> 1)
+    submit_buffer_size_ >>= 1;
+  log_->LogMessage("Submit buffer size: ", submit_buffer_size_, " samples");
+  int queue_capacity = requested_sample_rate_ * kMaxQueueLatencyInMs / 1000 /
+                           submit_buffer_size_ +
+                       1;
+  log_->LogMessage("Queue capacity: ", queue_capacity, " packets");
+  assert(scheduler_);
+  source_ = scheduler_->RegisterSource(
+      scheduler_id_, submit_buffer_size_ * (int)sizeof(StereoSample),
+      queue_capacity, (int)sizeof(PacketMetadata));
+  if (!source_.valid()) {
+    log_->LogMessage(Log::kError, "Cannot register the audio source.");
+    return false;
+  }
+  scheduler_->SetSourceName(scheduler_id_, kSourceName);
+  int min_queue_limit = requested_sample_rate_ * kMinQueueLatencyInMs /
+                            1000 / submit_buffer_size_ +
+                        1;
+  // as long as the queue was before tuning, until the load of the sinks
+  // shows that a shorter one is enough
+  int start_queue_limit = requested_sample_rate_ *
+                              kMaxLatencyForHardwareBufferInMs / 1000 /
+                              submit_buffer_size_ +
+                          1;
+  queue_tuner_.reset(new QueueTuner(
+      scheduler_, scheduler_id_, min_queue_limit,
+      kQueueTuningPeriodInMs * 1000, log_.get(), start_queue_limit));
+  return true;
+}
+
+void LiveAudio::RunMainLoop() {
+  log_->LogMessage("Audio mainloop starting up...");
+  if (list_devices_) {
+    ListDevices();
+    audio_loop_should_run_.store(false, std::memory_order_release);
+    mc_->Get<Core>().Quit(Core::kExitCodeAudioProblem);
+    return;
+  }
+  if (!OpenDevice()) {
+    CloseDevice();
+    audio_loop_should_run_.store(false, std::memory_order_release);
+    mc_->Get<Core>().Quit(Core::kExitCodeAudioProblem);
+    return;
+  }
+
+  while (audio_loop_should_run_.load(std::memory_order_acquire)) {
+    queue_tuner_->Update(CurrentTime());
+    int err = snd_pcm_wait(pcm_, kWatchDogMilliseconds);
+    if (err == 0) continue;  // timeout, check if we should still run
+    if (err < 0) {
+      if (!Recover(err)) break;
+      continue;
+    }
+    if (mapped_access_)
+      ReadMapped();
+    else
+      ReadCopied();
+  }
+
+  log_->LogMessage("Audio mainloop stopping...");
+  CloseDevice();
+}
+
+bool LiveAudio::OpenDevice() {
+  log_->Message("Opening ALSA capture device ", device_name_, "...");
+  int err = snd_pcm_open(&pcm_, device_name_, SND_PCM_STREAM_CAPTURE, 0);
+  if (err < 0) {
+    pcm_ = nullptr;
+    log_->Message(Log::kError, "Cannot open device: ", snd_strerror(err));
+    return false;
+  }
+
+  snd_pcm_hw_params_t* hw_params = nullptr;
+  err = snd_pcm_hw_params_malloc(&hw_params);
+  assert(err == 0);
+  err = snd_pcm_hw_params_any(pcm_, hw_params);
+  assert(err >= 0);
+  mapped_access_ = snd_pcm_hw_params_set_access(
+                       pcm_, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+  if (!mapped_access_) {
+    log_->LogMessage("Memory mapped access is not supported, using reads.");
+    err = snd_pcm_hw_params_set_access(pcm_, hw_params,
+                                       SND_PCM_ACCESS_RW_INTERLEAVED);
+  }
+  if (err >= 0)
+    err =
+        snd_pcm_hw_params_set_format(pcm_, hw_params, SND_PCM_FORMAT_FLOAT_LE);
+  if (err >= 0)
+    err = snd_pcm_hw_params_set_channels(pcm_, hw_params, kChannels);
+  unsigned int rate = (unsigned int)requested_sample_rate_;
+  if (err >= 0)
+    err = snd_pcm_hw_params_set_rate_near(pcm_, hw_params, &rate, nullptr);
+  snd_pcm_uframes_t period_size = (snd_pcm_uframes_t)submit_buffer_size_;
+  if (err >= 0)
+    err = snd_pcm_hw_params_set_period_size_near(pcm_, hw_params,
+                                                 &period_size, nullptr);
+  snd_pcm_uframes_t buffer_size = std::max(
+      (snd_pcm_uframes_t)rate * kMaxLatencyForHardwareBufferInMs / 1000,
+      period_size * 2);
+  if (err >= 0)
+    err = snd_pcm_hw_params_set_buffer_size_near(pcm_, hw_params, &buffer_size);
+  if (err >= 0) err = snd_pcm_hw_params(pcm_, hw_params);
+  snd_pcm_hw_params_free(hw_params);
+  if (err < 0) {
+    log_->Message(Log::kError,
+                  "Device does not support float stereo capture: ",
+                  snd_strerror(err), " (try a plughw: device)");
+    return false;
+  }
+
+  snd_pcm_sw_params_t* sw_params = nullptr;
+  err = snd_pcm_sw_params_malloc(&sw_params);
+  assert(err == 0);
+  err = snd_pcm_sw_params_current(pcm_, sw_params);
+  if (err >= 0)
+    err = snd_pcm_sw_params_set_avail_min(pcm_, sw_params, period_size);
+  if (err >= 0) err = snd_pcm_sw_params(pcm_, sw_params);
+  snd_pcm_sw_params_free(sw_params);
+  if (err < 0) {
+    log_->Message(Log::kError, "Cannot set software parameters: ",
+                  snd_strerror(err));
+    return false;
+  }
+
+  int sample_rate = (int)rate;
+  clock_.Reset(sample_rate);
+  log_->LogMessage("Sample rate: ", sample_rate, "Hz");
+  log_->LogMessage("Hardware buffer size: ", (int)buffer_size, " samples");
+  log_->LogMessage("Hardware period size: ", (int)period_size, " samples");
+  sample_rate_.store(sample_rate, std::memory_order_release);
+
+  err = snd_pcm_start(pcm_);
+  if (err < 0) {
+    log_->Message(Log::kError, "Cannot start capture: ", snd_strerror(err));
+    return false;
+  }
+  return true;
+}
+
+void LiveAudio::CloseDevice() {
+  if (pcm_) {
+    snd_pcm_drop(pcm_);
+    snd_pcm_close(pcm_);
+    pcm_ = nullptr;
+  }
+}
+
+void LiveAudio::ListDevices() {
+  Log::Print("List of ALSA PCM devices:");
+  void** hints = nullptr;
+  if (snd_device_name_hint(-1, "pcm", &hints) < 0) return;
+  for (void** hint = hints; *hint != nullptr; ++hint) {
+    char* name = snd_device_name_get_hint(*hint, "NAME");
+    char* io = snd_device_name_get_hint(*hint, "IOID");
+    if (name && (io == nullptr || strcmp(io, "Input") == 0)) {
+      Log::Print(name);
+    }
+    free(name);
+    free(io);
+  }
+  snd_device_name_free_hint(hints);
+  Log::Print("End of ALSA PCM devices.");
+}
+
+bool LiveAudio::Recover(int err) {
+  log_->Message(Log::kWarning, "Capture problem, recovering: ",
+                snd_strerror(err));
+  if (open_packet_) {
+    // Samples are lost, pad the packet with silence to keep timing.
+    memset(open_packet_ + open_packet_filled_, 0,
+           (size_t)(submit_buffer_size_ - open_packet_filled_) *
+               sizeof(StereoSample));
+    PacketFilled(submit_buffer_size_ - open_packet_filled_);
+  }
+  // It is unknown how many samples are lost, the clock has to relock.
+  clock_.Reset(sample_rate_);
+  err = snd_pcm_recover(pcm_, err, 1);
+  if (err >= 0) err = snd_pcm_start(pcm_);
+  if (err < 0) {
+    log_->Message(Log::kError, "Cannot recover: ", snd_strerror(err));
+    audio_loop_should_run_.store(false, std::memory_order_release);
+    mc_->Get<Core>().Quit(Core::kExitCodeAudioProblem);
+    return false;
+  }
+  return true;
+}
+
+void LiveAudio::ReadMapped() {
+  snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_);
+  if (avail < 0) {
+    Recover((int)avail);
+    return;
+  }
+  // The last available frame was captured just now.
+  clock_.Update(samples_captured_ + (uint64_t)avail, CurrentTime());
+  while (avail > 0) {
+    StereoSample* packet = AcquirePacket();
+    if (packet == nullptr) {
+      SkipFrames(avail);
+      return;
+    }
+    snd_pcm_uframes_t frames = (snd_pcm_uframes_t)std::min(
+        avail, (snd_pcm_sframes_t)(submit_buffer_size_ - open_packet_filled_));
+    const snd_pcm_channel_area_t* areas = nullptr;
+    snd_pcm_uframes_t offset = 0;
+    int err = snd_pcm_mmap_begin(pcm_, &areas, &offset, &frames);
+    if (err < 0) {
+      Recover(err);
+      return;
+    }
+    // Interleaved stereo: one area describes the whole frame.
+    assert(areas[0].step == sizeof(StereoSample) * 8);
+    const char* period = (const char*)areas[0].addr + areas[0].first / 8 +
+                         offset * sizeof(StereoSample);
+    memcpy(packet + open_packet_filled_, period,
+           (size_t)frames * sizeof(StereoSample));
+    snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm_, offset, frames);
+    if (committed < 0 || (snd_pcm_uframes_t)committed != frames) {
+      Recover(committed < 0 ? (int)committed : -EPIPE);
+      return;
+    }
+    avail -= committed;
+    PacketFilled((int)frames);
+  }
+}
+
+void LiveAudio::ReadCopied() {
+  snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_);
+  if (avail < 0) {
+    Recover((int)avail);
+    return;
+  }
+  // The last available frame was captured just now.
+  clock_.Update(samples_captured_ + (uint64_t)avail, CurrentTime());
+  while (avail > 0) {
+    StereoSample* packet = AcquirePacket();
+    if (packet == nullptr) {
+      SkipFrames(avail);
+      return;
+    }
+    snd_pcm_uframes_t frames = (snd_pcm_uframes_t)std::min(
+        avail, (snd_pcm_sframes_t)(submit_buffer_size_ - open_packet_filled_));
+    snd_pcm_sframes_t read =
+        snd_pcm_readi(pcm_, packet + open_packet_filled_, frames);
+    if (read < 0) {
+      Recover((int)read);
+      return;
+    }
+    avail -= read;
+    PacketFilled((int)read);
+  }
+}
+
+LiveAudio::StereoSample* LiveAudio::AcquirePacket() {
+  if (open_packet_) return open_packet_;
+  assert(scheduler_);
+  open_packet_ =
+      (StereoSample*)scheduler_->GetPacketForSubmission(source_);
+  if (open_packet_ == nullptr) {
+    // drop data and signal error
+    log_->LogMessage(Log::kWarning, "Buffer overrun, data lost!!!");
+    return nullptr;
+  }
+  open_packet_filled_ = 0;
+  open_packet_first_sample_ = samples_captured_;
+  return open_packet_;
+}
+
+void LiveAudio::SkipFrames(snd_pcm_sframes_t frames) {
+  snd_pcm_sframes_t skipped =
+      snd_pcm_forward(pcm_, (snd_pcm_uframes_t)frames);
+  if (skipped > 0) samples_captured_ += (uint64_t)skipped;
+}
+
+void LiveAudio::PacketFilled(int frames) {
+  assert(open_packet_);
+  open_packet_filled_ += frames;
+  samples_captured_ += (uint64_t)frames;
+  assert(open_packet_filled_ <= submit_buffer_size_);
+  if (open_packet_filled_ == submit_buffer_size_) SubmitOpenPacket();
+}
+
+void LiveAudio::SubmitOpenPacket() {
+  Scheduler::Time timestamp = clock_.TimeOfSample(open_packet_first_sample_);
+  // only a clock restart can step back
+  if (timestamp <= last_timestamp_) timestamp = last_timestamp_ + 1;
+  last_timestamp_ = timestamp;
+  PacketMetadata* metadata = (PacketMetadata*)scheduler_->GetPacketMetadata(
+      source_, (Scheduler::Byte*)open_packet_);
+  metadata->first_sample = open_packet_first_sample_;
+  metadata->usec_per_sample = clock_.usec_per_sample();
+  metadata->drift_ppm = clock_.drift_ppm();
+  scheduler_->SubmitPacket(source_, (Scheduler::Byte*)open_packet_,
+                           timestamp);
+  open_packet_ = nullptr;
+  open_packet_filled_ = 0;
+}
+
+void LiveAudio::PrintHelp() {
+  Log::Print("ZAMT Live Audio Module using ALSA input");
+  Log::Print(
+      " -arNum         Set requested sample rate to Num Hz instead of the"
+      " default 44100Hz.");
+  Log::Print(
+      " -atNum         Set requested latency to Num samples instead of the"
+      " automatic setting putting latency to 10ms.");
+  Log::Print(" -al            List all available ALSA PCM devices.");
+  Log::Print(
+      " -adName        Use the Name ALSA PCM device (e.g. hw:Loopback,1 or"
+      " null) instead of the default one.");
+}
+
+Scheduler::Time LiveAudio::CurrentTime() {
+  return (Scheduler::Time)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::high_resolution_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace zamt
@@ -0,0 +1,62 @@
+#include "zamt/core/Core.h"
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/core/Scheduler.h"
+#include "zamt/core/TestSuite.h"
+#include "zamt/liveaudio_alsa/LiveAudio.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace zamt;
+
+static const int packets_to_arrive = 8;
+static std::atomic<int> packets_arrived;
+static std::atomic<int> packet_size_mismatches;
+static std::atomic<int> broken_metadata;
+
+void CountPackets(Scheduler* sch, Scheduler::SourceId source_id,
+                  const Scheduler::Byte* packet, Scheduler::Time) {
+  if (sch->GetPacketSize(source_id) % (int)sizeof(LiveAudio::StereoSample))
+    packet_size_mismatches++;
+  const LiveAudio::PacketMetadata* metadata =
+      reinterpret_cast<const LiveAudio::PacketMetadata*>(
+          sch->GetPacketMetadata(source_id, packet));
+  if (!(metadata->usec_per_sample > 0.0)) broken_metadata++;
+  packets_arrived++;
+  sch->ReleasePacket(source_id, packet);
+}
+
+void CapturesFromNullDevice() {
+  packets_arrived = 0;
+  packet_size_mismatches = 0;
+  broken_metadata = 0;
+  const char* params[] = {"exec", "-adnull"};
+  ModuleCenter mc(sizeof(params) / sizeof(char*), params);
+  Core& core = mc.Get<Core>();
+  Core::ReInitExitCode();
+  LiveAudio& la = mc.Get<LiveAudio>();
+  ASSERT(la.WasStarted());
+  Scheduler& sch = core.scheduler();
+  Scheduler::SourceId source_id = ModuleCenter::GetId<LiveAudio>();
+  int subscription_id;
+  sch.Subscribe(source_id,
+                std::bind(&CountPackets, &sch, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                false, subscription_id);
+  for (int i = 0; i < 500 && packets_arrived < packets_to_arrive; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  sch.Unsubscribe(source_id, subscription_id);
+  EXPECT(packets_arrived >= packets_to_arrive);
+  EXPECT(packet_size_mismatches == 0);
+  EXPECT(broken_metadata == 0);
+  EXPECT(la.sample_format().sample_rate > 0);
+  EXPECT(la.sample_format().is_float);
+  core.Quit(0);
+  EXPECT(core.WaitForQuit() == 0);
+  // null device never blocks, audio thread leaves the scheduler quickly
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+TEST_BEGIN() { CapturesFromNullDevice(); }
+TEST_END()
@@ -0,0 +1,11 @@
+set(this_module liveaudio_alsa)
+
+
+set(other_modules
+  core
+)
+
+set(test_cpps
+  LiveAudioTest.cpp
+)
+AddTest(LiveAudioAlsaTest ${this_module} "${other_modules}" "${test_cpps}")
@@ -6,9 +6,12 @@
 /// is also supported so other software generated input can also be used live.
 /// The idea is to test how the system works in a realistic environment.
 /// Own thread is used to interact with audio library for skipless recording.
+/// Samples are captured as 32 bit floats so PulseAudio hands over the full
+/// resolution of the device and consumers get float packets directly.
 
 #include "zamt/core/CLIParameters.h"
 #include "zamt/core/Module.h"
+#include "zamt/core/SampleClock.h"
 #include "zamt/core/Scheduler.h"
 
 #include <atomic>
@@ -36,18 +39,36 @@ void stream_read_callback(pa_stream* p, size_t nbytes, void* userdata);
 namespace zamt {
 
 class Log;
+class QueueTuner;
 class RawAudioVisualizer;
 class Scheduler;
 
 class LiveAudio : public Module {
  public:
-  using Sample = int16_t;
+  using Sample = float;
   struct StereoSample {
     Sample left;
     Sample right;
   };
 
+  /// Describes the packets published by this source on the scheduler.
+  struct SampleFormat {
+    int sample_rate;  // 0 until the stream is connected
+    int channels;
+    int bytes_per_sample;
+    bool is_float;  // normalized to [-1.0, 1.0]
+  };
+
+  /// Beside every packet, see Scheduler::GetPacketMetadata().
+  /// Packet timestamps come from the sample counter locked to system time.
+  struct PacketMetadata {
+    uint64_t first_sample;   // position of the 1st sample since start
+    double usec_per_sample;  // measured, the time of any sample follows
+    double drift_ppm;        // speed of the device clock to the nominal
+  };
+
   const static char* kModuleLabel;
+  const static char* kSourceName;  // in the scheduler
   const static char* kApplicationName;
   const static char* kApplicationID;
   const static char* kMediaRole;
@@ -58,6 +79,8 @@ class LiveAudio : public Module {
   const static char* kVisualizeRawAudioStr;
   const static int kChannels = 2;  // stereo
   const static int kMaxLatencyForHardwareBufferInMs = 200;
+  const static int kMinQueueLatencyInMs = 50;    // shortest tuned queue
+  const static int kMaxQueueLatencyInMs = 1000;  // allocated packets
   const static int kOverallLatencyInMs = 10;
   const static int kDefaultSampleRate = 44100;
 
@@ -71,12 +94,23 @@ class LiveAudio : public Module {
   bool WasStarted() const { return (bool)audio_loop_; }
   int sample_rate() const { return sample_rate_; }
   int requested_overall_latency() const { return requested_overall_latency_; }
+  SampleFormat sample_format() const;
+
+#ifdef TEST
+  /// Registers the source on the given scheduler without connecting to
+  /// PulseAudio, so fragments can be fed in through ProcessFragmentForTest().
+  void InitializeForTest(Scheduler* scheduler);
+  void ProcessFragmentForTest(const StereoSample* buffer, int samples) {
+    ProcessFragment(buffer, samples);
+  }
+  int submit_buffer_size() const { return submit_buffer_size_; }
+#endif
 
  private:
   const static int kWatchDogSeconds = 3;
   const static int kDefaultDeviceSelected = -1;
   const static int kDeviceListSelected = -2;
-  const static int kUSecPerSampleShift = 8;
+  const static int kQueueTuningPeriodInMs = 1000;
 
   friend void zamt_liveaudio_internal::context_notify_callback(pa_context* c,
                                                                void* userdata);
@@ -91,26 +125,35 @@ class LiveAudio : public Module {
   bool HadNormalOpen() const { return sample_rate_ != 0; }
   void RunMainLoop();
   void OpenStream(const char* source_name);
-  void ProcessFragment(StereoSample* buffer, int samples);
+  // Returns false if the source cannot be registered.
+  bool SetupSource();
+  void ProcessFragment(const StereoSample* buffer, int samples);
+  void SubmitOpenPacket();
   void PrintHelp();
+  static Scheduler::Time CurrentTime();
 
   CLIParameters cli_;
   std::unique_ptr<Log> log_;
+  std::unique_ptr<QueueTuner> queue_tuner_;
   const ModuleCenter* mc_ = nullptr;
   Scheduler* scheduler_ = nullptr;
   Scheduler::SourceId scheduler_id_;
+  Scheduler::SourceHandle source_;  // of scheduler_id_
   int selected_device_ = kDefaultDeviceSelected;
   int requested_overall_latency_;
   int requested_sample_rate_ = kDefaultSampleRate;
   int submit_buffer_size_ = 0;  // stereo samples
   int hw_fragment_size_ = 0;    // stereo samples
-  int sample_rate_ = 0;
-  unsigned int usec_per_sample_shl_ = 0;
+  std::atomic<int> sample_rate_{0};
   Scheduler::Time last_timestamp_ = 0;  // in microseconds
+  SampleClock clock_;
+  uint64_t samples_captured_ = 0;  // lost ones included
   int hw_latency_in_us_ = 0;
 
-  StereoSample* sample_buffer_ = nullptr;
-  int sample_buffer_filled_ = 0;
+  // The packet being filled, kept open between fragments.
+  StereoSample* open_packet_ = nullptr;
+  int open_packet_filled_ = 0;
+  uint64_t open_packet_first_sample_ = 0;
 
   std::atomic<bool> audio_loop_should_run_;
   std::unique_ptr<std::thread> audio_loop_;
@@ -119,7 +162,9 @@ class LiveAudio : public Module {
   pa_context* context_ = nullptr;
   pa_stream* stream_ = nullptr;
 
+#ifdef ZAMT_MODULE_VIS_GTK
   std::unique_ptr<RawAudioVisualizer> visualizer_;
+#endif
 };
 
 }  // namespace zamt
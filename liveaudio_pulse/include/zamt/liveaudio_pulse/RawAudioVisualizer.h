@@ -4,10 +4,13 @@
 #ifdef ZAMT_MODULE_VIS_GTK
 
 #include <atomic>
-#include <vector>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 
 #include "zamt/core/Scheduler.h"
 #include "zamt/liveaudio_pulse/LiveAudio.h"
+#include "zamt/vis_gtk/TripleBuffer.h"
 #include "zamt/vis_gtk/Visualization.h"
 
 namespace zamt {
@@ -15,42 +18,78 @@ namespace zamt {
 class ModuleCenter;
 class Visualization;
 
+/// Shows the latest audio and the capture statistics of LiveAudio.
+/// It is a sink of LiveAudio packets on the UI thread, which gets them one at
+/// a time in order, so the audio thread only submits. Packets are coalesced
+/// into snapshots published at the frame rate of Visualization, the
+/// rendering thread draws the latest one.
 class RawAudioVisualizer {
  public:
   const static char* kVisualizationTitle;
   const static int kVisualizationWidth = 640;
   const static int kVisualizationHeight = 480;
   const static int kVisualizationBufferSize = 512;
+  const static float kMinLevelDb;  // bottom of the level meter in dBFS
 
+  /// Subscribes to LiveAudio packets.
   RawAudioVisualizer(const ModuleCenter* mc);
+  /// Unsubscribes, packets still queued for it are only released.
   ~RawAudioVisualizer();
 
-  void Show(LiveAudio::StereoSample* packet, int stereo_samples,
+ private:
+  // Outlives the visualizer in the queued tasks and serializes them.
+  struct Gate {
+    std::mutex mutex;
+    RawAudioVisualizer* visualizer;
+  };
+
+  static void ProcessPacket(const std::shared_ptr<Gate>& gate,
+                            Scheduler* scheduler, Scheduler::SourceId source_id,
+                            const Scheduler::Byte* packet,
+                            Scheduler::Time timestamp);
+  void Show(const LiveAudio::StereoSample* packet, int stereo_samples,
             Scheduler::Time timestamp);
 
- private:
-  void UpdateStatistics(LiveAudio::StereoSample* packet, int stereo_samples,
-                        Scheduler::Time timestamp);
-  void ClearStatistics(int& max_latency_us, int& min_latency_us,
-                       int& avg_latency_us, int& buffers, int& samples,
-                       float& rms_db);
-  void UpdateBuffer(LiveAudio::StereoSample* packet, int stereo_samples);
+  struct Snapshot {
+    LiveAudio::Sample center[kVisualizationBufferSize] = {};
+    LiveAudio::Sample side[kVisualizationBufferSize] = {};
+    int buffer_position = 0;
+    // totals since start
+    int64_t buffers = 0;
+    int64_t samples = 0;
+    int64_t sum_latency_us = 0;
+    double sample_square_sum = 0.0;
+    // since the last drawn frame
+    int max_latency_us = -99999999;
+    int min_latency_us = 99999999;
+  };
+
+  void UpdateStatistics(const LiveAudio::StereoSample* packet,
+                        int stereo_samples, Scheduler::Time timestamp);
+  void ClearStatistics(const Snapshot& snapshot, int& max_latency_us,
+                       int& min_latency_us, int& avg_latency_us, int& buffers,
+                       int& samples, float& rms_db);
+  void UpdateBuffer(const LiveAudio::StereoSample* packet, int stereo_samples);
   void Draw(const Cairo::RefPtr<Cairo::Context>& cctx, int width, int height);
 
   const ModuleCenter* mc_;
   int window_id_;
-  int buffer_position_;
-  std::atomic_flag buffer_mutex_ = ATOMIC_FLAG_INIT;
-  std::vector<LiveAudio::Sample> center_buffer_;
-  std::vector<LiveAudio::Sample> side_buffer_;
-
-  std::atomic_flag statistics_mutex_ = ATOMIC_FLAG_INIT;
-  int max_latency_us_ = -99999999;
-  int min_latency_us_ = 99999999;
-  int buffers_in_stat_ = 0;
-  int samples_in_stat_ = 0;
-  int64_t sum_latency_us_ = 0;
-  double sample_square_sum_ = 0.0;
+  Scheduler* scheduler_;
+  Scheduler::SourceId source_id_;
+  int subscription_id_;
+  std::shared_ptr<Gate> gate_;
+  Scheduler::Time frame_period_us_ = 0;
+
+  // Owned by the sink, guarded by the gate.
+  Snapshot current_;
+  int frames_drawn_seen_ = 0;
+  Scheduler::Time last_published_ = 0;
+
+  TripleBuffer<Snapshot> snapshots_;
+  std::atomic<int> frames_drawn_{0};
+
+  // Owned by the rendering thread, totals at the last drawn frame.
+  Snapshot drawn_;
 };
 
 }  // namespace zamt
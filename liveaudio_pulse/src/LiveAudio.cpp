@@ -4,6 +4,7 @@
 #include "zamt/core/Core.h"
 #include "zamt/core/Log.h"
 #include "zamt/core/ModuleCenter.h"
+#include "zamt/core/QueueTuner.h"
 #include "zamt/liveaudio_pulse/RawAudioVisualizer.h"
 
 #include <pulse/context.h>
@@ -23,6 +24,9 @@
 
 namespace zamt_liveaudio_internal {
 
+const pa_sample_format_t kSampleFormat = PA_SAMPLE_FLOAT32LE;
+static_assert(sizeof(zamt::LiveAudio::Sample) == 4, "Sample must be float32");
+
 void context_notify_callback(pa_context* c, void* userdata) {
   zamt::LiveAudio* la = (zamt::LiveAudio*)userdata;
   assert(c == la->context_);
@@ -30,7 +34,8 @@ void context_notify_callback(pa_context* c, void* userdata) {
   if (la->HadNormalOpen()) return;
   pa_context_state_t ctxst = pa_context_get_state(la->context_);
   if (ctxst == PA_CONTEXT_FAILED || ctxst == PA_CONTEXT_TERMINATED) {
-    la->log_->LogMessage("PulseAudio context opening failed.");
+    la->log_->LogMessage(zamt::Log::kError,
+                         "PulseAudio context opening failed.");
     // la->log_->LogMessage(pa_strerror(pa_context_errno(la->context_)));
     la->audio_loop_should_run_.store(false, std::memory_order_release);
     pa_mainloop_quit(la->mainloop_, 1);
@@ -98,7 +103,8 @@ void stream_notify_callback(pa_stream* p, void* userdata) {
   if (la->HadNormalOpen()) return;
   pa_stream_state_t strst = pa_stream_get_state(la->stream_);
   if (strst == PA_STREAM_FAILED || strst == PA_STREAM_TERMINATED) {
-    la->log_->LogMessage("PulseAudio stream opening failed.");
+    la->log_->LogMessage(zamt::Log::kError,
+                         "PulseAudio stream opening failed.");
     la->audio_loop_should_run_.store(false, std::memory_order_release);
     pa_mainloop_quit(la->mainloop_, 1);
     la->mc_->Get<zamt::Core>().Quit(zamt::Core::kExitCodeAudioProblem);
@@ -110,22 +116,22 @@ void stream_notify_callback(pa_stream* p, void* userdata) {
     const pa_sample_spec* sample_spec = pa_stream_get_sample_spec(la->stream_);
     assert(sample_spec);
     assert(sample_spec->channels == zamt::LiveAudio::kChannels);
-    assert(sample_spec->format == PA_SAMPLE_S16LE);
-    la->sample_rate_ = (int)sample_spec->rate;
-    la->usec_per_sample_shl_ =
-        (1000000u << zamt::LiveAudio::kUSecPerSampleShift) /
-        (unsigned)la->sample_rate_;
+    assert(sample_spec->format == kSampleFormat);
+    int sample_rate = (int)sample_spec->rate;
+    la->clock_.Reset(sample_rate);
+    const int kFrameBytes = (int)sizeof(zamt::LiveAudio::StereoSample);
     const pa_buffer_attr* buffer_attr = pa_stream_get_buffer_attr(la->stream_);
     assert(buffer_attr);
-    la->hw_fragment_size_ =
-        (int)buffer_attr->fragsize / zamt::LiveAudio::kChannels;
-    la->log_->LogMessage("Sample rate: ", la->sample_rate_, "Hz");
-    la->log_->LogMessage(
-        "Total hardware buffer size: ",
-        (int)buffer_attr->maxlength / zamt::LiveAudio::kChannels, " samples");
+    la->hw_fragment_size_ = (int)buffer_attr->fragsize / kFrameBytes;
+    la->log_->Message("Sample format: ",
+                      pa_sample_format_to_string(sample_spec->format));
+    la->log_->LogMessage("Sample rate: ", sample_rate, "Hz");
+    la->log_->LogMessage("Total hardware buffer size: ",
+                         (int)buffer_attr->maxlength / kFrameBytes, " samples");
     la->log_->LogMessage(
         "Average hardware fragment size: ", la->hw_fragment_size_, " samples");
-    la->hw_latency_in_us_ = 1000000 * la->hw_fragment_size_ / la->sample_rate_;
+    la->hw_latency_in_us_ = 1000000 * la->hw_fragment_size_ / sample_rate;
+    la->sample_rate_.store(sample_rate, std::memory_order_release);
   }
 }
 
@@ -144,7 +150,7 @@ void stream_read_callback(pa_stream* p, size_t nbytes, void* userdata) {
     if (bytes_in_buf == 0) return;
     assert((int)bytes_in_buf % (int)sizeof(zamt::LiveAudio::StereoSample) == 0);
     la->ProcessFragment(
-        (zamt::LiveAudio::StereoSample*)data,
+        (const zamt::LiveAudio::StereoSample*)data,
         (int)bytes_in_buf / (int)sizeof(zamt::LiveAudio::StereoSample));
     err = pa_stream_drop(la->stream_);
     assert(err == 0);
@@ -157,6 +163,7 @@ void stream_read_callback(pa_stream* p, size_t nbytes, void* userdata) {
 namespace zamt {
 
 const char* LiveAudio::kModuleLabel = "liveaudio_pulse";
+const char* LiveAudio::kSourceName = "LiveAudio";
 const char* LiveAudio::kApplicationName = "ZAMT";
 const char* LiveAudio::kApplicationID = "zamt";
 const char* LiveAudio::kMediaRole = "music";
@@ -166,6 +173,12 @@ const char* LiveAudio::kLatencyParamStr = "-at";
 const char* LiveAudio::kSampleRateParamStr = "-ar";
 const char* LiveAudio::kVisualizeRawAudioStr = "-sLiveAudio";
 
+#ifdef ZAMT_MODULE_VIS_GTK
+ZAMT_MODULE_DEPENDS(LiveAudio, Core, Visualization);
+#else
+ZAMT_MODULE_DEPENDS(LiveAudio, Core);
+#endif
+
 LiveAudio::LiveAudio(int argc, const char* const* argv)
     : cli_(argc, argv), audio_loop_should_run_(false) {
   log_.reset(new Log(kModuleLabel, cli_));
@@ -200,43 +213,46 @@ LiveAudio::~LiveAudio() {
   log_->LogMessage("Waiting for audio thread to stop...");
   audio_loop_->join();
   log_->LogMessage("Audio thread stopped.");
-  if (sample_buffer_) delete[] sample_buffer_;
 }
 
 void LiveAudio::Initialize(const ModuleCenter* mc) {
   mc_ = mc;
   if (!audio_loop_should_run_.load(std::memory_order_acquire)) return;
 
-  // Heuristic to find power of 2 submit buffer size and hw latency so overall
-  // stays below limit and hw buffer is preferably larger
-  log_->LogMessage("Requested overall latency: ", requested_overall_latency_,
-                   " samples");
-  submit_buffer_size_ = 65536;
-  while (submit_buffer_size_ > requested_overall_latency_ >> 1)
-    submit_buffer_size_ >>= 1;
-  hw_fragment_size_ = requested_overall_latency_ - submit_buffer_size_;
-  assert(hw_fragment_size_ >= submit_buffer_size_);
-  log_->LogMessage("Requested hardware latency: ", hw_fragment_size_,
-                   " samples");
-  log_->LogMessage("Submit buffer size: ", submit_buffer_size_, " samples");
-  int queue_capacity = requested_sample_rate_ *
-                           kMaxLatencyForHardwareBufferInMs / 1000 /
-                           submit_buffer_size_ +
-                       1;
-  log_->LogMessage("Queue capacity: ", queue_capacity, " packets");
-
-  sample_buffer_ = new StereoSample[static_cast<unsigned long>(submit_buffer_size_)];
-  assert(sample_buffer_);
-
   Core& core = mc_->Get<Core>();
-  core.RegisterForQuitEvent(
-      std::bind(&LiveAudio::Shutdown, this, std::placeholders::_1));
   scheduler_ = &core.scheduler();
-  scheduler_->RegisterSource(scheduler_id_,
-                             submit_buffer_size_ * (int)sizeof(StereoSample),
-                             queue_capacity);
+  if (!SetupSource()) {
+    core.Quit(Core::kExitCodeAudioProblem);
+    return;
+  }
   log_->LogMessage("Launching audio thread...");
   audio_loop_.reset(new std::thread(&LiveAudio::RunMainLoop, this));
+  // stops the thread at once if quit already
+  core.RegisterForQuitEvent(
+      std::bind(&LiveAudio::Shutdown, this, std::placeholders::_1));
+}
+
+#ifdef TEST
+void LiveAudio::InitializeForTest(Scheduler* scheduler) {
+  assert(audio_loop_should_run_.load(std::memory_order_acquire));
+  scheduler_ = scheduler;
+  bool registered = SetupSource();
+  assert(registered);
+  (void)registered;
+  int sample_rate = requested_sample_rate_;
+  clock_.Reset(sample_rate);
+  hw_latency_in_us_ = 1000000 * hw_fragment_size_ / sample_rate;
+  sample_rate_.store(sample_rate, std::memory_order_release);
+}
+#endif
+
+LiveAudio::SampleFormat LiveAudio::sample_format() const {
+  SampleFormat format;
+  format.sample_rate = sample_rate_.load(std::memory_order_acquire);
+  format.channels = kChannels;
+  format.bytes_per_sample = (int)sizeof(Sample);
+  format.is_float = true;
+  return format;
 }
 
 void LiveAudio::Shutdown(int /*exit_code*/) {
@@ -272,6 +288,7 @@ void LiveAudio::RunMainLoop() {
 #endif
 
   while (audio_loop_should_run_.load(std::memory_order_acquire)) {
+    queue_tuner_->Update(CurrentTime());
     err = pa_mainloop_prepare(mainloop_, PA_MSEC_PER_SEC * kWatchDogSeconds);
     assert(err >= 0);
     err = pa_mainloop_poll(mainloop_);
@@ -280,7 +297,9 @@ void LiveAudio::RunMainLoop() {
   }
 
   log_->LogMessage("Audio mainloop stopping...");
+#ifdef ZAMT_MODULE_VIS_GTK
   visualizer_.reset(nullptr);
+#endif
 
   if (stream_) {
     pa_stream_disconnect(stream_);
@@ -298,7 +317,9 @@ void LiveAudio::RunMainLoop() {
 void LiveAudio::OpenStream(const char* source_name) {
   log_->LogMessage("Opening source stream...");
   pa_sample_spec sample_spec;
-  sample_spec.format = PA_SAMPLE_S16LE;
+  // PulseAudio converts from any device format, so the full bit depth of
+  // S24/S32 devices is kept and no integer to float conversion is left for us.
+  sample_spec.format = zamt_liveaudio_internal::kSampleFormat;
   sample_spec.rate = (uint32_t)requested_sample_rate_;
   sample_spec.channels = kChannels;
   pa_channel_map channel_map;
@@ -316,11 +337,11 @@ void LiveAudio::OpenStream(const char* source_name) {
   pa_buffer_attr buffer_attr;
   int hw_buffer_size =
       requested_sample_rate_ * kMaxLatencyForHardwareBufferInMs / 1000;
-  buffer_attr.maxlength = (uint32_t)hw_buffer_size * kChannels;
+  buffer_attr.maxlength = (uint32_t)hw_buffer_size * sizeof(StereoSample);
   buffer_attr.tlength = (uint32_t)-1;
   buffer_attr.prebuf = (uint32_t)-1;
   buffer_attr.minreq = (uint32_t)-1;
-  buffer_attr.fragsize = (uint32_t)hw_fragment_size_ * kChannels;
+  buffer_attr.fragsize = (uint32_t)hw_fragment_size_ * sizeof(StereoSample);
   pa_stream_flags_t flags = (pa_stream_flags_t)(
       PA_STREAM_AUTO_TIMING_UPDATE | PA_STREAM_INTERPOLATE_TIMING |
       PA_STREAM_NOT_MONOTONIC | PA_STREAM_ADJUST_LATENCY);
@@ -330,19 +351,15 @@ void LiveAudio::OpenStream(const char* source_name) {
   (void)err;
 }
 
-void LiveAudio::ProcessFragment(StereoSample* buffer, int samples) {
-  Scheduler::Time current_time =
-      (Scheduler::Time)std::chrono::duration_cast<std::chrono::microseconds>(
-          std::chrono::high_resolution_clock::now().time_since_epoch())
-          .count();
-  assert(sample_buffer_);
-  assert(sample_buffer_filled_ >= 0 &&
-         sample_buffer_filled_ < submit_buffer_size_);
+void LiveAudio::ProcessFragment(const StereoSample* buffer, int samples) {
+  Scheduler::Time current_time = CurrentTime();
+  assert(open_packet_filled_ >= 0 && open_packet_filled_ < submit_buffer_size_);
   assert(samples > 0);
   if (!audio_loop_should_run_.load(std::memory_order_acquire)) return;
   pa_usec_t latency;
   int is_negative;
-  int err = pa_stream_get_latency(stream_, &latency, &is_negative);
+  int err = 1;
+  if (stream_) err = pa_stream_get_latency(stream_, &latency, &is_negative);
   if (err) {
     // fake it (this may be the 1st buffer and no timing update was done)
     assert(hw_latency_in_us_ > 0);
@@ -354,71 +371,101 @@ void LiveAudio::ProcessFragment(StereoSample* buffer, int samples) {
     buffer_timestamp = current_time + latency;
   else
     buffer_timestamp = current_time - latency;
-  assert(usec_per_sample_shl_ > 0);
+  // The 1st sample of the fragment was captured at buffer_timestamp.
+  clock_.Update(samples_captured_, buffer_timestamp);
 
+  // Samples go straight into the packet which stays open between fragments.
   assert(scheduler_);
   while (samples > 0) {
-    int free_left_in_buffer = submit_buffer_size_ - sample_buffer_filled_;
-    assert(free_left_in_buffer > 0);
-
-    if (samples >= free_left_in_buffer) {
-      StereoSample* packet =
-          (StereoSample*)scheduler_->GetPacketForSubmission(scheduler_id_);
-      assert(packet);
-      if (packet == nullptr) {
+    if (open_packet_ == nullptr) {
+      open_packet_ =
+          (StereoSample*)scheduler_->GetPacketForSubmission(source_);
+      if (open_packet_ == nullptr) {
         // drop buffer and signal error
-        log_->LogMessage("Buffer overrun, data lost!!!");
+        log_->LogMessage(Log::kWarning, "Buffer overrun, data lost!!!");
+        samples_captured_ += (uint64_t)samples;
         return;
       }
+      open_packet_first_sample_ = samples_captured_;
+    }
 
-      if (sample_buffer_filled_ > 0) {
-        memcpy(packet, sample_buffer_,
-               (size_t)sample_buffer_filled_ * sizeof(StereoSample));
-      }
-      if (buffer)
-        memcpy(packet + sample_buffer_filled_, buffer,
-               (size_t)free_left_in_buffer * sizeof(StereoSample));
-      else
-        memset(packet + sample_buffer_filled_, 0,
-               (size_t)free_left_in_buffer * sizeof(StereoSample));
-      samples -= free_left_in_buffer;
-      assert(samples >= 0);
-      buffer += free_left_in_buffer;
-
-      Scheduler::Time timestamp =
-          buffer_timestamp -
-          ((Scheduler::Time)sample_buffer_filled_ * usec_per_sample_shl_ >>
-           kUSecPerSampleShift);
-      if (timestamp <= last_timestamp_) timestamp = last_timestamp_ + 1;
-      last_timestamp_ = timestamp;
-
-#ifdef ZAMT_MODULE_VIS_GTK
-      if (visualizer_) {
-        visualizer_->Show(packet, submit_buffer_size_, timestamp);
-      }
-#endif
-
-      scheduler_->SubmitPacket(scheduler_id_, (Scheduler::Byte*)packet,
-                               timestamp);
-
-      buffer_timestamp +=
-          ((Scheduler::Time)free_left_in_buffer * usec_per_sample_shl_ >>
-           kUSecPerSampleShift);
-      sample_buffer_filled_ = 0;
+    int free_left_in_packet = submit_buffer_size_ - open_packet_filled_;
+    assert(free_left_in_packet > 0);
+    int copied = samples < free_left_in_packet ? samples : free_left_in_packet;
+    if (buffer) {
+      memcpy(open_packet_ + open_packet_filled_, buffer,
+             (size_t)copied * sizeof(StereoSample));
+      buffer += copied;
     } else {
-      if (buffer)
-        memcpy(sample_buffer_ + sample_buffer_filled_, buffer,
-               (size_t)samples * sizeof(StereoSample));
-      else
-        memset(sample_buffer_ + sample_buffer_filled_, 0,
-               (size_t)samples * sizeof(StereoSample));
-      sample_buffer_filled_ += samples;
-      assert(sample_buffer_filled_ < submit_buffer_size_);
-      break;
+      memset(open_packet_ + open_packet_filled_, 0,
+             (size_t)copied * sizeof(StereoSample));
     }
+    samples -= copied;
+    samples_captured_ += (uint64_t)copied;
+    open_packet_filled_ += copied;
+    if (open_packet_filled_ == submit_buffer_size_) SubmitOpenPacket();
   }
 }
 
+void LiveAudio::SubmitOpenPacket() {
+  Scheduler::Time timestamp = clock_.TimeOfSample(open_packet_first_sample_);
+  // only a clock restart can step back
+  if (timestamp <= last_timestamp_) timestamp = last_timestamp_ + 1;
+  last_timestamp_ = timestamp;
+  PacketMetadata* metadata = (PacketMetadata*)scheduler_->GetPacketMetadata(
+      source_, (Scheduler::Byte*)open_packet_);
+  metadata->first_sample = open_packet_first_sample_;
+  metadata->usec_per_sample = clock_.usec_per_sample();
+  metadata->drift_ppm = clock_.drift_ppm();
+  scheduler_->SubmitPacket(source_, (Scheduler::Byte*)open_packet_,
+                           timestamp);
+  open_packet_ = nullptr;
+  open_packet_filled_ = 0;
+}
+
+bool LiveAudio::SetupSource() {
+  // Heuristic to find power of 2 submit buffer size and hw latency so overall
+  // stays below limit and hw buffer is preferably larger
+  log_->LogMessage("Requested overall latency: ", requested_overall_latency_,
+                   " samples");
+  submit_buffer_size_ = 65536;
+  while (submit_buffer_size_ > requested_overall_latency_ >> 1)
+    submit_buffer_size_ >>= 1;
+  hw_fragment_size_ = requested_overall_latency_ - submit_buffer_size_;
+  assert(hw_fragment_size_ >= submit_buffer_size_);
+  log_->LogMessage("Requested hardware latency: ", hw_fragment_size_,
+                   " samples");
+  log_->LogMessage("Submit buffer size: ", submit_buffer_size_, " samples");
+  // All packets for the longest queue are allocated, the tuner decides how
+  // many of them can be used depending on how fast the sinks are.
+  int queue_capacity = requested_sample_rate_ * kMaxQueueLatencyInMs / 1000 /
+                           submit_buffer_size_ +
+                       1;
+  log_->LogMessage("Queue capacity: ", queue_capacity, " packets");
+  assert(scheduler_);
+  source_ = scheduler_->RegisterSource(
+      scheduler_id_, submit_buffer_size_ * (int)sizeof(StereoSample),
+      queue_capacity, (int)sizeof(PacketMetadata));
+  if (!source_.valid()) {
+    log_->LogMessage(Log::kError, "Cannot register the audio source.");
+    return false;
+  }
+  scheduler_->SetSourceName(scheduler_id_, kSourceName);
+  int min_queue_limit = requested_sample_rate_ * kMinQueueLatencyInMs /
+                            1000 / submit_buffer_size_ +
+                        1;
+  // as long as the queue was before tuning, until the load of the sinks
+  // shows that a shorter one is enough
+  int start_queue_limit = requested_sample_rate_ *
+                              kMaxLatencyForHardwareBufferInMs / 1000 /
+                              submit_buffer_size_ +
+                          1;
+  queue_tuner_.reset(new QueueTuner(
+      scheduler_, scheduler_id_, min_queue_limit,
+      kQueueTuningPeriodInMs * 1000, log_.get(), start_queue_limit));
+  return true;
+}
+
 void LiveAudio::PrintHelp() {
   Log::Print("ZAMT Live Audio Module using PulseAudio input");
   Log::Print(
@@ -437,4 +484,10 @@ void LiveAudio::PrintHelp() {
 #endif
 }
 
+Scheduler::Time LiveAudio::CurrentTime() {
+  return (Scheduler::Time)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::high_resolution_clock::now().time_since_epoch())
+      .count();
+}
+
 }  // namespace zamt
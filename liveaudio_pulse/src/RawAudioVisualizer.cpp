@@ -2,37 +2,76 @@
 
 #ifdef ZAMT_MODULE_VIS_GTK
 
+#include "zamt/core/Core.h"
 #include "zamt/core/ModuleCenter.h"
 
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <functional>
 
 namespace zamt {
 
 const char* RawAudioVisualizer::kVisualizationTitle = "Audio In";
+const float RawAudioVisualizer::kMinLevelDb = -96.0f;
 
-RawAudioVisualizer::RawAudioVisualizer(const ModuleCenter* mc)
-    : mc_(mc),
-      center_buffer_(kVisualizationBufferSize, 0),
-      side_buffer_(kVisualizationBufferSize, 0) {
+RawAudioVisualizer::RawAudioVisualizer(const ModuleCenter* mc) : mc_(mc) {
   assert(mc_);
-  buffer_position_ = 0;
   Visualization& vis = mc_->Get<Visualization>();
   vis.OpenWindow(kVisualizationTitle, kVisualizationWidth, kVisualizationHeight,
                  window_id_);
+  int fps = vis.activations_per_second();
+  if (fps > 0) frame_period_us_ = (Scheduler::Time)(1000000 / fps);
+  scheduler_ = &mc_->Get<Core>().scheduler();
+  source_id_ = ModuleCenter::GetId<LiveAudio>();
+  gate_ = std::make_shared<Gate>();
+  gate_->visualizer = this;
+  scheduler_->Subscribe(
+      source_id_,
+      std::bind(&RawAudioVisualizer::ProcessPacket, gate_, scheduler_,
+                std::placeholders::_1, std::placeholders::_2,
+                std::placeholders::_3),
+      true, subscription_id_);
 }
 
 RawAudioVisualizer::~RawAudioVisualizer() {
   assert(mc_);
+  scheduler_->Unsubscribe(source_id_, subscription_id_);
+  {
+    std::lock_guard<std::mutex> lock(gate_->mutex);
+    gate_->visualizer = nullptr;
+  }
   Visualization& vis = mc_->Get<Visualization>();
   vis.CloseWindow(window_id_);
 }
 
-void RawAudioVisualizer::Show(LiveAudio::StereoSample* packet,
+void RawAudioVisualizer::ProcessPacket(const std::shared_ptr<Gate>& gate,
+                                       Scheduler* scheduler,
+                                       Scheduler::SourceId source_id,
+                                       const Scheduler::Byte* packet,
+                                       Scheduler::Time timestamp) {
+  {
+    std::lock_guard<std::mutex> lock(gate->mutex);
+    if (gate->visualizer) {
+      int stereo_samples = scheduler->GetPacketSize(source_id) /
+                           (int)sizeof(LiveAudio::StereoSample);
+      gate->visualizer->Show(
+          reinterpret_cast<const LiveAudio::StereoSample*>(packet),
+          stereo_samples, timestamp);
+    }
+  }
+  scheduler->ReleasePacket(source_id, packet);
+}
+
+void RawAudioVisualizer::Show(const LiveAudio::StereoSample* packet,
                               int stereo_samples, Scheduler::Time timestamp) {
   UpdateStatistics(packet, stereo_samples, timestamp);
   UpdateBuffer(packet, stereo_samples);
+  // coalesce packets to the frame rate
+  if (timestamp - last_published_ < frame_period_us_) return;
+  last_published_ = timestamp;
+  snapshots_.write_buffer() = current_;
+  snapshots_.Publish();
   Visualization& vis = mc_->Get<Visualization>();
   vis.QueryRender(
       window_id_,
@@ -40,85 +79,86 @@ void RawAudioVisualizer::Show(LiveAudio::StereoSample* packet,
                 std::placeholders::_2, std::placeholders::_3));
 }
 
-void RawAudioVisualizer::UpdateStatistics(LiveAudio::StereoSample* packet,
-                                          int stereo_samples,
-                                          Scheduler::Time timestamp) {
-  while (statistics_mutex_.test_and_set(std::memory_order_acquire))
-    ;
-  buffers_in_stat_++;
+void RawAudioVisualizer::UpdateStatistics(
+    const LiveAudio::StereoSample* packet, int stereo_samples,
+    Scheduler::Time timestamp) {
+  int frames_drawn = frames_drawn_.load(std::memory_order_acquire);
+  if (frames_drawn != frames_drawn_seen_) {
+    // extremes are shown per frame
+    frames_drawn_seen_ = frames_drawn;
+    current_.max_latency_us = -99999999;
+    current_.min_latency_us = 99999999;
+  }
+  current_.buffers++;
   Scheduler::Time current_time =
       (Scheduler::Time)std::chrono::duration_cast<std::chrono::microseconds>(
           std::chrono::high_resolution_clock::now().time_since_epoch())
           .count();
   int64_t latency = (int64_t)(current_time - timestamp);
-  sum_latency_us_ += latency;
-  if (latency < (int64_t)min_latency_us_) min_latency_us_ = (int)latency;
-  if (latency > (int64_t)max_latency_us_) max_latency_us_ = (int)latency;
+  current_.sum_latency_us += latency;
+  if (latency < (int64_t)current_.min_latency_us)
+    current_.min_latency_us = (int)latency;
+  if (latency > (int64_t)current_.max_latency_us)
+    current_.max_latency_us = (int)latency;
   for (int i = 0; i < stereo_samples; ++i) {
-    int mono_sample = (packet[i].left + packet[i].right) >> 1;
-    sample_square_sum_ += mono_sample * mono_sample;
-    samples_in_stat_++;
+    double mono_sample = (packet[i].left + packet[i].right) * 0.5;
+    current_.sample_square_sum += mono_sample * mono_sample;
   }
-  statistics_mutex_.clear(std::memory_order_release);
+  current_.samples += stereo_samples;
 }
 
-void RawAudioVisualizer::ClearStatistics(int& max_latency_us,
+void RawAudioVisualizer::ClearStatistics(const Snapshot& snapshot,
+                                         int& max_latency_us,
                                          int& min_latency_us,
                                          int& avg_latency_us, int& buffers,
                                          int& samples, float& rms_db) {
-  while (statistics_mutex_.test_and_set(std::memory_order_acquire))
-    ;
-  max_latency_us = max_latency_us_;
-  max_latency_us_ = -99999999;
-  min_latency_us = min_latency_us_;
-  min_latency_us_ = 99999999;
-  buffers = buffers_in_stat_;
-  buffers_in_stat_ = 0;
-  samples = samples_in_stat_;
-  samples_in_stat_ = 0;
-  avg_latency_us = (int)(sum_latency_us_ / (buffers ? buffers : 1));
-  sum_latency_us_ = 0;
-  rms_db =
-      (float)log10(sqrt(sample_square_sum_ / (samples ? samples : 1))) * 20.0f;
-  sample_square_sum_ = 0.0;
-  statistics_mutex_.clear(std::memory_order_release);
+  max_latency_us = snapshot.max_latency_us;
+  min_latency_us = snapshot.min_latency_us;
+  buffers = (int)(snapshot.buffers - drawn_.buffers);
+  samples = (int)(snapshot.samples - drawn_.samples);
+  avg_latency_us = (int)((snapshot.sum_latency_us - drawn_.sum_latency_us) /
+                         (buffers ? buffers : 1));
+  double square_sum = snapshot.sample_square_sum - drawn_.sample_square_sum;
+  rms_db = (float)log10(sqrt(square_sum / (samples ? samples : 1))) * 20.0f;
+  drawn_.buffers = snapshot.buffers;
+  drawn_.samples = snapshot.samples;
+  drawn_.sum_latency_us = snapshot.sum_latency_us;
+  drawn_.sample_square_sum = snapshot.sample_square_sum;
+  frames_drawn_.fetch_add(1, std::memory_order_release);
 }
 
-void RawAudioVisualizer::UpdateBuffer(LiveAudio::StereoSample* packet,
+void RawAudioVisualizer::UpdateBuffer(const LiveAudio::StereoSample* packet,
                                       int stereo_samples) {
-  while (buffer_mutex_.test_and_set(std::memory_order_acquire))
-    ;
+  int position = current_.buffer_position;
   for (int i = 0; i < stereo_samples; ++i) {
-    LiveAudio::Sample center =
-        (LiveAudio::Sample)((packet[i].left + packet[i].right) >> 1);
-    LiveAudio::Sample side =
-        (LiveAudio::Sample)((packet[i].left - packet[i].right) >> 1);
-    center_buffer_[(size_t)buffer_position_] = center;
-    side_buffer_[(size_t)buffer_position_] = side;
-    if (++buffer_position_ >= kVisualizationBufferSize) buffer_position_ = 0;
+    LiveAudio::Sample center = (packet[i].left + packet[i].right) * 0.5f;
+    LiveAudio::Sample side = (packet[i].left - packet[i].right) * 0.5f;
+    current_.center[position] = center;
+    current_.side[position] = side;
+    if (++position >= kVisualizationBufferSize) position = 0;
   }
-  buffer_mutex_.clear(std::memory_order_release);
+  current_.buffer_position = position;
 }
 
 void RawAudioVisualizer::Draw(const Cairo::RefPtr<Cairo::Context>& cctx,
                               int width, int height) {
   float middle = (float)(height >> 1);
-  float value_coef = (float)height / 65536.0f;
+  float value_coef = middle;  // samples are in [-1.0, 1.0]
   float center[kVisualizationBufferSize];
   float side[kVisualizationBufferSize];
-  while (buffer_mutex_.test_and_set(std::memory_order_acquire))
-    ;
-  int pos = buffer_position_;
+  snapshots_.Update();
+  const Snapshot& snapshot = snapshots_.read_buffer();
+  int pos = snapshot.buffer_position;
   for (int i = 0; i < kVisualizationBufferSize; ++i) {
-    center[(size_t)i] = middle + center_buffer_[(size_t)pos] * value_coef;
-    side[(size_t)i] = middle + side_buffer_[(size_t)pos] * value_coef;
+    center[(size_t)i] = middle + snapshot.center[pos] * value_coef;
+    side[(size_t)i] = middle + snapshot.side[pos] * value_coef;
     if (++pos >= kVisualizationBufferSize) pos = 0;
   }
-  buffer_mutex_.clear(std::memory_order_release);
 
   int max_latency, min_latency, avg_latency, buffers, samples;
   float rms;
-  ClearStatistics(max_latency, min_latency, avg_latency, buffers, samples, rms);
+  ClearStatistics(snapshot, max_latency, min_latency, avg_latency, buffers,
+                  samples, rms);
 
   cctx->save();
   cctx->set_source_rgb(0.0, 0.0, 0.0);
@@ -142,7 +182,8 @@ void RawAudioVisualizer::Draw(const Cairo::RefPtr<Cairo::Context>& cctx,
     cctx->line_to(x, center[(size_t)i]);
   cctx->stroke();
 
-  float rms_bar = rms / 100 * (float)(height >> 1);
+  float rms_bar = (rms - kMinLevelDb) / -kMinLevelDb * middle;
+  if (!(rms_bar > 0.0f)) rms_bar = 0.0f;
   cctx->set_source_rgba(1.0, 1.0, 0.0, 0.75);
   cctx->rectangle(4, middle - rms_bar, 40, rms_bar * 2);
   cctx->fill();
@@ -164,7 +205,7 @@ void RawAudioVisualizer::Draw(const Cairo::RefPtr<Cairo::Context>& cctx,
   sprintf(str, "Samples %d", samples);
   cctx->move_to(64, 100);
   cctx->show_text(str);
-  sprintf(str, "SPL %.2f db", (double)rms);
+  sprintf(str, "Level %.2f dBFS", (double)rms);
   cctx->move_to(64, 120);
   cctx->show_text(str);
 
@@ -0,0 +1,165 @@
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/core/Scheduler.h"
+#include "zamt/core/TestSuite.h"
+#include "zamt/liveaudio_pulse/LiveAudio.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace zamt;
+
+// -at441 gives 128 sample packets at 44100Hz
+const char* params[] = {"exec", "-at441"};
+static const int packet_samples = 128;
+static const int packets_to_arrive = 40;
+
+static std::atomic<long> packets_arrived;
+static std::atomic<int> broken_packets;
+static Scheduler::Time packet_timestamps[packets_to_arrive];
+
+void CheckRamp(Scheduler* sch, Scheduler::SourceId source_id,
+               const Scheduler::Byte* packet, Scheduler::Time timestamp) {
+  const LiveAudio::StereoSample* samples =
+      reinterpret_cast<const LiveAudio::StereoSample*>(packet);
+  int first = (int)samples[0].left;
+  int num = first / packet_samples;
+  const LiveAudio::PacketMetadata* metadata =
+      reinterpret_cast<const LiveAudio::PacketMetadata*>(
+          sch->GetPacketMetadata(source_id, packet));
+  if (first % packet_samples != 0 || num >= packets_to_arrive ||
+      metadata->first_sample != (uint64_t)first) {
+    broken_packets++;
+  } else {
+    for (int i = 0; i < packet_samples; ++i) {
+      if (samples[i].left != (float)(first + i) ||
+          samples[i].right != -(float)(first + i)) {
+        broken_packets++;
+        break;
+      }
+    }
+    packet_timestamps[num] = timestamp;
+    packets_arrived.fetch_or(1l << num);
+  }
+  sch->ReleasePacket(source_id, packet);
+}
+
+void FeedRamp(LiveAudio& la, const std::vector<int>& fragment_sizes) {
+  int next = 0;
+  size_t fragment = 0;
+  while (next < packets_to_arrive * packet_samples) {
+    int size = fragment_sizes[fragment++ % fragment_sizes.size()];
+    if (next + size > packets_to_arrive * packet_samples)
+      size = packets_to_arrive * packet_samples - next;
+    std::vector<LiveAudio::StereoSample> buffer((size_t)size);
+    for (auto& sample : buffer) {
+      sample.left = (float)next;
+      sample.right = -(float)next;
+      next++;
+    }
+    la.ProcessFragmentForTest(buffer.data(), size);
+  }
+}
+
+void FragmentsFillPacketsInOrder(const std::vector<int>& fragment_sizes) {
+  packets_arrived = 0;
+  broken_packets = 0;
+  Scheduler sch;
+  LiveAudio la(sizeof(params) / sizeof(char*), params);
+  la.InitializeForTest(&sch);
+  ASSERT(la.submit_buffer_size() == packet_samples);
+  Scheduler::SourceId source_id = ModuleCenter::GetId<LiveAudio>();
+  // all packets are fed at once, none of them should be dropped
+  sch.SetQueueLimit(source_id, packets_to_arrive);
+  int subscription_id;
+  sch.Subscribe(source_id,
+                std::bind(&CheckRamp, &sch, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                false, subscription_id);
+  FeedRamp(la, fragment_sizes);
+  while (packets_arrived != (1l << packets_to_arrive) - 1 &&
+         broken_packets == 0)
+    std::this_thread::yield();
+  sch.Shutdown();
+  EXPECT(broken_packets == 0);
+  ASSERT(packets_arrived == (1l << packets_to_arrive) - 1);
+  for (int i = 1; i < packets_to_arrive; ++i) {
+    EXPECT(packet_timestamps[i - 1] < packet_timestamps[i]);
+  }
+}
+
+static std::atomic<int> silent_packets;
+
+void CheckSilence(Scheduler* sch, Scheduler::SourceId source_id,
+                  const Scheduler::Byte* packet, Scheduler::Time) {
+  const LiveAudio::StereoSample* samples =
+      reinterpret_cast<const LiveAudio::StereoSample*>(packet);
+  bool silent = true;
+  for (int i = 0; i < packet_samples; ++i) {
+    if (samples[i].left != 0.0f || samples[i].right != 0.0f) silent = false;
+  }
+  if (silent) silent_packets++;
+  sch->ReleasePacket(source_id, packet);
+}
+
+void HolesBecomeSilence() {
+  silent_packets = 0;
+  Scheduler sch;
+  LiveAudio la(sizeof(params) / sizeof(char*), params);
+  la.InitializeForTest(&sch);
+  Scheduler::SourceId source_id = ModuleCenter::GetId<LiveAudio>();
+  int subscription_id;
+  sch.Subscribe(source_id,
+                std::bind(&CheckSilence, &sch, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                false, subscription_id);
+  la.ProcessFragmentForTest(nullptr, 100);
+  la.ProcessFragmentForTest(nullptr, 3 * packet_samples - 100);
+  while (silent_packets != 3) std::this_thread::yield();
+  sch.Shutdown();
+}
+
+// the queue tuner starts from the shortest queue
+static const int queue_capacity =
+    LiveAudio::kDefaultSampleRate * LiveAudio::kMinQueueLatencyInMs / 1000 /
+        packet_samples +
+    1;
+static const Scheduler::Byte* kept_packets[queue_capacity];
+static std::atomic<int> packets_kept;
+
+void KeepPacket(Scheduler::SourceId, const Scheduler::Byte* packet,
+                Scheduler::Time) {
+  int num = packets_kept++;
+  if (num < queue_capacity) kept_packets[num] = packet;
+}
+
+void OverrunDropsData() {
+  packets_kept = 0;
+  Scheduler sch;
+  LiveAudio la(sizeof(params) / sizeof(char*), params);
+  la.InitializeForTest(&sch);
+  Scheduler::SourceId source_id = ModuleCenter::GetId<LiveAudio>();
+  int subscription_id;
+  sch.Subscribe(source_id, &KeepPacket, false, subscription_id);
+  std::vector<LiveAudio::StereoSample> buffer(packet_samples *
+                                              (queue_capacity + 10));
+  la.ProcessFragmentForTest(buffer.data(), (int)buffer.size());
+  while (packets_kept < queue_capacity) std::this_thread::yield();
+  EXPECT(packets_kept == queue_capacity);
+  EXPECT(sch.GetPacketForSubmission(source_id) == nullptr);
+  for (int i = 0; i < queue_capacity; ++i)
+    sch.ReleasePacket(source_id, kept_packets[i]);
+  la.ProcessFragmentForTest(buffer.data(), packet_samples);
+  while (packets_kept < queue_capacity + 1) std::this_thread::yield();
+  sch.Shutdown();
+}
+
+TEST_BEGIN() {
+  FragmentsFillPacketsInOrder({packet_samples});
+  FragmentsFillPacketsInOrder({1, 7, 300, 64, 64, 5, 1000});
+  FragmentsFillPacketsInOrder({packet_samples - 1, packet_samples + 1});
+  FragmentsFillPacketsInOrder({packets_to_arrive * packet_samples});
+  HolesBecomeSilence();
+  OverrunDropsData();
+}
+TEST_END()
@@ -2,9 +2,10 @@ set(this_module liveaudio_pulse)
 
 
 set(other_modules
+  core
 )
 
 set(test_cpps
+  LiveAudioTest.cpp
 )
-#AddTest(SomeTest ${this_module} "${other_modules}" "${test_cpps}")
-
+AddTest(LiveAudioPulseTest ${this_module} "${other_modules}" "${test_cpps}")
@@ -3,8 +3,14 @@
 set(zamt_modules
   core
   liveaudio_pulse
+  liveaudio_alsa
   vis_gtk
   dft_fftw
+  recorder
+  featurestore
+  batch
+  nn_infer
+  pitch_yin
   # vis_vulkan
 )
 
@@ -20,6 +26,12 @@ if(liveaudio_pulse_on GREATER -1)
   pkg_check_modules(PulseAudio REQUIRED IMPORTED_TARGET libpulse)
 endif()
 
+# If missing: sudo apt install libasound2-dev
+list(FIND zamt_modules liveaudio_alsa liveaudio_alsa_on)
+if(liveaudio_alsa_on GREATER -1)
+  pkg_check_modules(ALSA REQUIRED IMPORTED_TARGET alsa)
+endif()
+
 # If missing: sudo apt install libgtkmm-3.0-dev
 list(FIND zamt_modules vis_gtk vis_gtk_on)
 if(vis_gtk_on GREATER -1)
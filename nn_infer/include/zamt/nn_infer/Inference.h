@@ -0,0 +1,73 @@
+#ifndef ZAMT_NN_INFER_INFERENCE_H_
+#define ZAMT_NN_INFER_INFERENCE_H_
+
+/// Runs neural network models on the frames of sources, set up by the
+/// pipeline.
+/**
+ * Pipeline stages of type "nn" load a model (see ModelFile.h) and run it on
+ * every packet of their input, e.g. note or onset activations from spectra:
+ *
+ *   fft spectrum input=LiveAudio size=2048 hop=512
+ *   nn notes input=spectrum model=notes.znn pool=analysis
+ *
+ * The input of the model is the log magnitude log(1 + |X|) of the complex
+ * bins of a spectrum, or the packet as floats with features=raw. The output
+ * frames are a new source named after the stage, with the timestamps of the
+ * input. The frames are processed in order as a stream (convolutions see
+ * the frames before), several at once if the stage fell behind.
+ */
+
+#include "zamt/core/CLIParameters.h"
+#include "zamt/core/Module.h"
+#include "zamt/core/Scheduler.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zamt {
+
+class Log;
+
+namespace nn_infer {
+
+struct Stage;
+
+class Inference : public Module {
+ public:
+  const static char* kModuleLabel;
+  const static char* kStageType;
+  const static int kDefaultQueueLength = 16;
+
+  Inference(int argc, const char* const* argv);
+  ~Inference();
+
+  void Initialize(const ModuleCenter* mc);
+  void Connect(const ModuleCenter* mc);
+
+ private:
+  // Returns false if the stage cannot be set up. The output is registered
+  // when initialized, the input is subscribed when connected.
+  bool AddStage(const std::string& name, const char* model, bool spectrum,
+                int queue);
+  bool ConnectStage(const std::shared_ptr<Stage>& stage, const char* input,
+                    const char* pool);
+  // Static as pending tasks of the sinks may outlive the module.
+  static void ProcessFrames(Scheduler* scheduler, Stage* stage,
+                            const Scheduler::Byte* const* packets,
+                            const Scheduler::Time* timestamps, int count);
+  void Shutdown(int exit_code);
+  void PrintHelp();
+
+  CLIParameters cli_;
+  std::unique_ptr<Log> log_;
+  const ModuleCenter* mc_ = nullptr;
+  Scheduler* scheduler_ = nullptr;
+  bool started_ = false;
+  std::vector<std::shared_ptr<Stage>> stages_;
+};
+
+}  // namespace nn_infer
+}  // namespace zamt
+
+#endif  // ZAMT_NN_INFER_INFERENCE_H_
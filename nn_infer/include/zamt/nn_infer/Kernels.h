@@ -0,0 +1,63 @@
+#ifndef ZAMT_NN_INFER_KERNELS_H_
+#define ZAMT_NN_INFER_KERNELS_H_
+
+/// Matrix kernels of the inference engine.
+/**
+ * Weights are float, half float or 8 bit integers scaled per row; they are
+ * converted while they are loaded, so smaller weights mean less memory
+ * traffic. Rows and frames are padded to kColumnAlignment values and
+ * aligned to kBufferAlignment bytes, so the loops have no remainder.
+ * On x86 the AVX2 / FMA / F16C kernels are chosen at runtime if the CPU
+ * has them, otherwise a portable version is used.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace zamt {
+namespace nn_infer {
+
+enum class WeightType : uint32_t { kFloat32 = 0, kFloat16 = 1, kInt8 = 2 };
+
+const int kColumnAlignment = 32;  // values
+const int kBufferAlignment = 64;  // bytes
+
+/// Returns the bytes of a weight.
+int GetWeightSize(WeightType type);
+
+/// Returns the number of values padded to kColumnAlignment.
+int GetPaddedSize(int values);
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+
+/// A rows x columns matrix with an optional bias.
+struct Matrix {
+  WeightType type;
+  const void* data;     // rows of columns (padded) weights
+  const float* scales;  // of the rows, for kInt8 only
+  const float* bias;    // or nullptr
+  int rows;
+  int columns;  // padded
+};
+
+/**
+ * Multiplies frames: y[f][r] = row r of m * x[f] + bias[r] for f < frames.
+ * Frames are x_stride and y_stride values apart. The padding of y frames
+ * after the rows is set to 0, so y can be the input of the next matrix.
+ */
+void MatMul(const Matrix& m, const float* x, int x_stride, int frames,
+            float* y, int y_stride);
+
+/// Returns if the SIMD kernels are used.
+bool HasSimdKernels();
+
+#ifdef TEST
+/// Uses the portable kernels (or the fastest ones again).
+void ForcePortableKernels(bool portable);
+#endif
+
+}  // namespace nn_infer
+}  // namespace zamt
+
+#endif  // ZAMT_NN_INFER_KERNELS_H_
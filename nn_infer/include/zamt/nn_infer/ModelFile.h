@@ -0,0 +1,74 @@
+#ifndef ZAMT_NN_INFER_MODELFILE_H_
+#define ZAMT_NN_INFER_MODELFILE_H_
+
+/// Binary format of the models of the inference engine.
+/**
+ * A model file is a ModelHeader and the layers one after the other, all
+ * little endian. A layer is a LayerHeader, the weights (outputs rows of
+ * kernel * inputs values, see WeightType), the float scales of the rows
+ * for kInt8 weights, then the float biases of the outputs.
+ * A causal convolution sees the frames t - (kernel - 1) * dilation, ...,
+ * t - dilation, t of its input: the inputs of a row are in this order.
+ * A dense layer is a convolution of one frame.
+ */
+
+#include "zamt/nn_infer/Kernels.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace zamt {
+namespace nn_infer {
+
+enum class LayerType : uint32_t { kDense = 0, kCausalConv = 1 };
+enum class Activation : uint32_t {
+  kLinear = 0,
+  kReLU = 1,
+  kSigmoid = 2,
+  kTanh = 3
+};
+
+struct ModelHeader {
+  char magic[8];
+  uint32_t input_size;
+  uint32_t layers;
+};
+
+struct LayerHeader {
+  uint32_t type;         // LayerType
+  uint32_t activation;   // Activation
+  uint32_t weight_type;  // WeightType
+  uint32_t inputs;
+  uint32_t outputs;
+  uint32_t kernel;    // frames
+  uint32_t dilation;  // frames between the ones seen
+  uint32_t reserved;
+};
+
+const char kModelMagic[] = "ZAMTNN01";
+const int kMaxLayerSize = 1 << 16;  // inputs or outputs
+const int kMaxKernel = 64;
+const int kMaxDilation = 64;
+
+/// A layer with float weights, stored in its weight type.
+struct LayerSpec {
+  LayerType type = LayerType::kDense;
+  Activation activation = Activation::kLinear;
+  WeightType weight_type = WeightType::kFloat32;
+  int inputs = 0;
+  int outputs = 0;
+  int kernel = 1;
+  int dilation = 1;
+  std::vector<float> weights;  // outputs rows of kernel * inputs
+  std::vector<float> bias;     // outputs
+};
+
+/// Writes a model, e.g. converted from a training framework.
+/// Integer weights get the scale of the largest one of their row.
+bool WriteModel(const char* path, int input_size,
+                const std::vector<LayerSpec>& layers);
+
+}  // namespace nn_infer
+}  // namespace zamt
+
+#endif  // ZAMT_NN_INFER_MODELFILE_H_
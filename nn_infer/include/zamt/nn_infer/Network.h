@@ -0,0 +1,89 @@
+#ifndef ZAMT_NN_INFER_NETWORK_H_
+#define ZAMT_NN_INFER_NETWORK_H_
+
+/// Runs a model of dense layers and causal convolutions frame by frame.
+/**
+ * All memory is planned when the model is loaded: the weights, two frame
+ * buffers the layers write in turn, the gathered inputs of a convolution
+ * and the history of past input frames each convolution needs. Processing
+ * allocates nothing, and a stream of frames can be fed one by one or in
+ * groups (which share the loads of the weights) with the same result.
+ */
+
+#include "zamt/nn_infer/Kernels.h"
+#include "zamt/nn_infer/ModelFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace zamt {
+namespace nn_infer {
+
+class Network {
+ public:
+  const static int kMaxFrames = 8;  // processed at once
+
+  Network() = default;
+  ~Network();
+
+  Network(const Network&) = delete;
+  Network& operator=(const Network&) = delete;
+
+  /// Returns false if the file is not a valid model.
+  bool Load(const char* path);
+
+  int input_size() const { return input_size_; }
+  int output_size() const { return output_size_; }
+  /// Bytes of all the memory planned.
+  size_t memory_size() const { return memory_size_; }
+
+  /// Processes the next frames of the stream, frames are input_size and
+  /// output_size floats one after the other.
+  void Process(const float* inputs, int frames, float* outputs);
+
+  /// Starts a new stream: the frames before are zeros.
+  void Reset();
+
+ private:
+  struct Layer {
+    LayerType type;
+    Activation activation;
+    int inputs;
+    int outputs;
+    int kernel;
+    int dilation;
+    Matrix matrix;
+    float* history = nullptr;  // ring of past input frames
+    int history_frames = 0;
+    int history_position = 0;  // of the oldest frame
+  };
+
+  struct AlignedFree {
+    void operator()(uint8_t* memory) const;
+  };
+
+  void ProcessBlock(const float* inputs, int frames, float* outputs);
+  // Copies the frames a convolution sees into gathered_.
+  void Gather(const Layer& layer, const float* input, int input_stride,
+              int frames);
+  static void Remember(Layer& layer, const float* input, int input_stride,
+                       int frames);
+  static void Activate(Activation activation, float* values, int count);
+
+  int input_size_ = 0;
+  int output_size_ = 0;
+  std::vector<Layer> layers_;
+  std::unique_ptr<uint8_t, AlignedFree> memory_;
+  size_t memory_size_ = 0;
+  float* buffers_[2] = {nullptr, nullptr};
+  int buffer_stride_ = 0;
+  float* gathered_ = nullptr;
+  int gathered_stride_ = 0;
+};
+
+}  // namespace nn_infer
+}  // namespace zamt
+
+#endif  // ZAMT_NN_INFER_NETWORK_H_
@@ -0,0 +1,13 @@
+set(module_cpps
+  Inference.cpp
+  Kernels.cpp
+  ModelFile.cpp
+  Network.cpp
+)
+
+
+# 3rd party configuration
+
+set(module_includes)
+
+set(module_libs)
@@ -0,0 +1,222 @@
+#include "zamt/nn_infer/Inference.h"
+
+#include "zamt/core/Core.h"
+#include "zamt/core/Log.h"
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/nn_infer/Network.h"
+
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstring>
+
+namespace zamt {
+namespace nn_infer {
+
+struct Stage {
+  std::string name;
+  Scheduler::SourceId input;
+  Scheduler::SourceHandle input_source;
+  Scheduler::SourceId output;
+  Scheduler::SourceHandle output_source;
+  int subscription_id = -1;
+  bool spectrum;  // log magnitudes of complex bins, or raw floats
+  Network network;
+  // planned with the network, so a frame needs no allocation
+  std::vector<float> inputs;
+  std::vector<float> outputs;
+  std::vector<Scheduler::Byte*> packets;
+  std::atomic<int64_t> frames_lost{0};
+};
+
+const char* Inference::kModuleLabel = "nn_infer";
+const char* Inference::kStageType = "nn";
+
+ZAMT_MODULE_DEPENDS(Inference, Core);
+
+Inference::Inference(int argc, const char* const* argv) : cli_(argc, argv) {
+  log_.reset(new Log(kModuleLabel, cli_));
+  if (cli_.HasParam(Core::kHelpParamStr)) {
+    PrintHelp();
+    return;
+  }
+  started_ = true;
+}
+
+Inference::~Inference() { Shutdown(0); }
+
+void Inference::Initialize(const ModuleCenter* mc) {
+  mc_ = mc;
+  if (!started_) return;
+  Core& core = mc_->Get<Core>();
+  scheduler_ = &core.scheduler();
+  for (auto stage : core.pipeline().GetStages(kStageType)) {
+    const char* features = stage->GetParam("features");
+    bool spectrum = !features || strcmp(features, "raw") != 0;
+    if (!AddStage(stage->name, stage->GetParam("model"), spectrum,
+                  stage->GetNumParam("queue", kDefaultQueueLength))) {
+      started_ = false;
+      core.Quit(Core::kExitCodeBadPipeline);
+      return;
+    }
+  }
+  if (stages_.empty()) return;
+  core.RegisterForQuitEvent(
+      std::bind(&Inference::Shutdown, this, std::placeholders::_1));
+}
+
+// The inputs may be stages of modules initialized concurrently.
+void Inference::Connect(const ModuleCenter*) {
+  if (!started_) return;
+  Core& core = mc_->Get<Core>();
+  auto stages = core.pipeline().GetStages(kStageType);
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    if (!ConnectStage(stages_[i], stages[i]->GetParam("input"),
+                      stages[i]->GetParam("pool"))) {
+      core.Quit(Core::kExitCodeBadPipeline);
+      return;
+    }
+  }
+}
+
+bool Inference::AddStage(const std::string& name, const char* model,
+                         bool spectrum, int queue) {
+  auto stage = std::make_shared<Stage>();
+  stage->name = name;
+  stage->spectrum = spectrum;
+  if (!model || !stage->network.Load(model)) {
+    log_->Message(Log::kError, "Stage ", name, ": cannot load model ",
+                  model ? model : "(none)");
+    return false;
+  }
+  if (queue < 1) {
+    log_->Message(Log::kError, "Stage ", name, ": bad queue ", queue);
+    return false;
+  }
+  int frame_size = stage->network.input_size();
+  stage->inputs.resize((size_t)(Network::kMaxFrames * frame_size));
+  stage->outputs.resize(
+      (size_t)(Network::kMaxFrames * stage->network.output_size()));
+  stage->packets.resize(Network::kMaxFrames);
+  stage->output = scheduler_->AllocateSourceId();
+  stage->output_source = scheduler_->RegisterSource(
+      stage->output, stage->network.output_size() * (int)sizeof(float), queue);
+  if (!stage->output_source.valid()) {
+    log_->Message(Log::kError, "Stage ", name, ": cannot register source ",
+                  stage->output);
+    return false;
+  }
+  scheduler_->SetSourceName(stage->output, name);
+  log_->Message("Stage ", name, ": model ", model, ", ",
+                stage->network.input_size(), " -> ",
+                stage->network.output_size(), ", ",
+                stage->network.memory_size() / 1024, " KiB",
+                HasSimdKernels() ? ", SIMD" : "");
+  stages_.push_back(std::move(stage));
+  return true;
+}
+
+bool Inference::ConnectStage(const std::shared_ptr<Stage>& stage,
+                             const char* input, const char* pool) {
+  const std::string& name = stage->name;
+  if (!input || !scheduler_->FindSource(input, stage->input)) {
+    log_->Message(Log::kError, "Stage ", name, ": no input ",
+                  input ? input : "(none)");
+    return false;
+  }
+  Scheduler::PoolId pool_id = Scheduler::kDefaultPool;
+  if (pool && !scheduler_->FindPool(pool, pool_id)) {
+    log_->Message(Log::kError, "Stage ", name, ": no pool ", pool);
+    return false;
+  }
+  stage->input_source = scheduler_->GetSourceHandle(stage->input);
+  if (!stage->input_source.valid()) {
+    log_->Message(Log::kError, "Stage ", name, ": input ", input,
+                  " is not registered");
+    return false;
+  }
+  int packet_size = scheduler_->GetPacketSize(stage->input_source);
+  int frame_size =
+      stage->spectrum ? packet_size / (int)sizeof(std::complex<float>)
+                      : packet_size / (int)sizeof(float);
+  if (frame_size != stage->network.input_size()) {
+    log_->Message(Log::kError, "Stage ", name, ": frames of ", frame_size,
+                  " values for a model of ", stage->network.input_size(),
+                  " inputs");
+    return false;
+  }
+  log_->Message("Stage ", name, ": input ", input);
+
+  Scheduler* scheduler = scheduler_;
+  std::shared_ptr<Stage> shared_stage = stage;
+  // the convolutions need the frames in order, late ones come in batches
+  scheduler_->SubscribeBatch(
+      stage->input,
+      [scheduler, shared_stage](Scheduler::SourceId,
+                                const Scheduler::Byte* const* packets,
+                                const Scheduler::Time* timestamps,
+                                int count) {
+        ProcessFrames(scheduler, shared_stage.get(), packets, timestamps,
+                      count);
+      },
+      Network::kMaxFrames, stage->subscription_id, pool_id);
+  return true;
+}
+
+void Inference::ProcessFrames(Scheduler* scheduler, Stage* stage_ptr,
+                              const Scheduler::Byte* const* packets,
+                              const Scheduler::Time* timestamps, int count) {
+  Stage& stage = *stage_ptr;
+  int input_size = stage.network.input_size();
+  for (int i = 0; i < count; ++i) {
+    float* frame = &stage.inputs[(size_t)(i * input_size)];
+    if (stage.spectrum) {
+      auto bins = reinterpret_cast<const std::complex<float>*>(packets[i]);
+      for (int bin = 0; bin < input_size; ++bin)
+        frame[bin] = std::log1p(std::abs(bins[bin]));
+    } else {
+      memcpy(frame, packets[i], (size_t)input_size * sizeof(float));
+    }
+  }
+  scheduler->ReleasePackets(stage.input_source, packets, count);
+  stage.network.Process(stage.inputs.data(), count, stage.outputs.data());
+
+  // not waiting for the sinks: they may be queued behind this worker
+  int output_size = stage.network.output_size();
+  int ready = 0;
+  while (ready < count) {
+    Scheduler::Byte* packet =
+        scheduler->GetPacketForSubmission(stage.output_source);
+    if (!packet) break;
+    memcpy(packet, &stage.outputs[(size_t)(ready * output_size)],
+           (size_t)output_size * sizeof(float));
+    stage.packets[(size_t)ready++] = packet;
+  }
+  stage.frames_lost += count - ready;
+  if (ready)
+    scheduler->SubmitPackets(stage.output_source, stage.packets.data(),
+                              timestamps, ready);
+}
+
+void Inference::Shutdown(int /*exit_code*/) {
+  for (auto& stage : stages_) {
+    // not connected if the pipeline failed
+    if (stage->subscription_id >= 0)
+      scheduler_->Unsubscribe(stage->input, stage->subscription_id);
+    if (stage->frames_lost) {
+      log_->LogMessage(Log::kWarning, ("Stage " + stage->name + ": ").c_str(),
+                       (int)stage->frames_lost,
+                       " frames lost, result queue full!");
+    }
+  }
+  stages_.clear();
+}
+
+void Inference::PrintHelp() {
+  Log::Print("ZAMT Neural Network Inference");
+  Log::Print(" Pipeline stages: nn Name input=Source model=Path "
+             "features=spectrum|raw queue=Packets pool=Pool");
+}
+
+}  // namespace nn_infer
+}  // namespace zamt
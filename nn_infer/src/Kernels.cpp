@@ -0,0 +1,256 @@
+#include "zamt/nn_infer/Kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ZAMT_NN_INFER_X86
+#define ZAMT_NN_INFER_AVX2 __attribute__((target("avx2,fma,f16c")))
+#include <immintrin.h>
+#endif
+
+namespace zamt {
+namespace nn_infer {
+
+namespace {
+
+const int kFramesAtOnce = 4;  // share the loads of a row
+
+bool DetectSimdKernels() {
+#ifdef ZAMT_NN_INFER_X86
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+         __builtin_cpu_supports("f16c");
+#else
+  return false;
+#endif
+}
+
+bool use_simd_kernels = DetectSimdKernels();
+
+template <WeightType T>
+float LoadWeight(const void* row, int i);
+
+template <>
+float LoadWeight<WeightType::kFloat32>(const void* row, int i) {
+  return static_cast<const float*>(row)[i];
+}
+
+template <>
+float LoadWeight<WeightType::kFloat16>(const void* row, int i) {
+  return HalfToFloat(static_cast<const uint16_t*>(row)[i]);
+}
+
+template <>
+float LoadWeight<WeightType::kInt8>(const void* row, int i) {
+  return static_cast<const int8_t*>(row)[i];
+}
+
+// Sums of the row times each frame, in 8 lanes the compiler can vectorize.
+template <WeightType T>
+void PortableDots(int frames, const void* row, const float* x, int x_stride,
+                  int columns, float* sums) {
+  for (int f = 0; f < frames; ++f) {
+    const float* frame = x + f * x_stride;
+    float lanes[8] = {};
+    for (int i = 0; i < columns; i += 8) {
+      for (int j = 0; j < 8; ++j)
+        lanes[j] += LoadWeight<T>(row, i + j) * frame[i + j];
+    }
+    sums[f] = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+              ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+  }
+}
+
+#ifdef ZAMT_NN_INFER_X86
+template <WeightType T>
+struct Avx2Weights;
+
+template <>
+struct Avx2Weights<WeightType::kFloat32> {
+  ZAMT_NN_INFER_AVX2 static __m256 Load(const void* row, int i) {
+    return _mm256_load_ps(static_cast<const float*>(row) + i);
+  }
+};
+
+template <>
+struct Avx2Weights<WeightType::kFloat16> {
+  ZAMT_NN_INFER_AVX2 static __m256 Load(const void* row, int i) {
+    return _mm256_cvtph_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(
+        static_cast<const uint16_t*>(row) + i)));
+  }
+};
+
+template <>
+struct Avx2Weights<WeightType::kInt8> {
+  ZAMT_NN_INFER_AVX2 static __m256 Load(const void* row, int i) {
+    return _mm256_cvtepi32_ps(
+        _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(
+            static_cast<const int8_t*>(row) + i))));
+  }
+};
+
+ZAMT_NN_INFER_AVX2 float Sum(__m256 lanes) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(lanes),
+                          _mm256_extractf128_ps(lanes, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+  return _mm_cvtss_f32(sum);
+}
+
+// Two accumulators a frame hide the latency of the multiply-adds.
+template <WeightType T, int F>
+ZAMT_NN_INFER_AVX2 void Avx2Dots(const void* row, const float* x,
+                                 int x_stride, int columns, float* sums) {
+  __m256 even[F];
+  __m256 odd[F];
+  for (int f = 0; f < F; ++f) even[f] = odd[f] = _mm256_setzero_ps();
+  for (int i = 0; i < columns; i += 16) {
+    __m256 weights0 = Avx2Weights<T>::Load(row, i);
+    __m256 weights1 = Avx2Weights<T>::Load(row, i + 8);
+    for (int f = 0; f < F; ++f) {
+      const float* frame = x + f * x_stride + i;
+      even[f] = _mm256_fmadd_ps(weights0, _mm256_load_ps(frame), even[f]);
+      odd[f] = _mm256_fmadd_ps(weights1, _mm256_load_ps(frame + 8), odd[f]);
+    }
+  }
+  for (int f = 0; f < F; ++f) sums[f] = Sum(_mm256_add_ps(even[f], odd[f]));
+}
+#endif
+
+template <WeightType T>
+void Dots(int frames, const void* row, const float* x, int x_stride,
+          int columns, float* sums) {
+#ifdef ZAMT_NN_INFER_X86
+  if (use_simd_kernels) {
+    switch (frames) {
+      case 1:
+        return Avx2Dots<T, 1>(row, x, x_stride, columns, sums);
+      case 2:
+        return Avx2Dots<T, 2>(row, x, x_stride, columns, sums);
+      case 3:
+        return Avx2Dots<T, 3>(row, x, x_stride, columns, sums);
+      default:
+        return Avx2Dots<T, kFramesAtOnce>(row, x, x_stride, columns, sums);
+    }
+  }
+#endif
+  PortableDots<T>(frames, row, x, x_stride, columns, sums);
+}
+
+template <WeightType T>
+void MatMulOf(const Matrix& m, const float* x, int x_stride, int frames,
+              float* y, int y_stride) {
+  size_t row_size = (size_t)m.columns * (size_t)GetWeightSize(T);
+  for (int first = 0; first < frames; first += kFramesAtOnce) {
+    int block = std::min(kFramesAtOnce, frames - first);
+    const float* x_block = x + first * x_stride;
+    float* y_block = y + first * y_stride;
+    for (int r = 0; r < m.rows; ++r) {
+      const void* row = static_cast<const uint8_t*>(m.data) + r * row_size;
+      float sums[kFramesAtOnce];
+      Dots<T>(block, row, x_block, x_stride, m.columns, sums);
+      float scale = T == WeightType::kInt8 ? m.scales[r] : 1.0f;
+      float bias = m.bias ? m.bias[r] : 0.0f;
+      for (int f = 0; f < block; ++f)
+        y_block[f * y_stride + r] = sums[f] * scale + bias;
+    }
+    for (int f = 0; f < block; ++f) {
+      std::fill(y_block + f * y_stride + m.rows, y_block + (f + 1) * y_stride,
+                0.0f);
+    }
+  }
+}
+
+}  // namespace
+
+int GetWeightSize(WeightType type) {
+  switch (type) {
+    case WeightType::kFloat32:
+      return 4;
+    case WeightType::kFloat16:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+int GetPaddedSize(int values) {
+  return (values + kColumnAlignment - 1) / kColumnAlignment *
+         kColumnAlignment;
+}
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = bits >> 16 & 0x8000;
+  uint32_t float_exponent = bits >> 23 & 0xFF;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if (float_exponent == 0xFF)  // infinity or NaN
+    return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+  int exponent = (int)float_exponent - 127 + 15;
+  if (exponent >= 31) return (uint16_t)(sign | 0x7C00);
+  uint32_t half;
+  uint32_t rest;
+  uint32_t halfway;
+  if (exponent <= 0) {
+    // subnormal, rounded to 0 below half of the smallest one
+    if (exponent < -10) return (uint16_t)sign;
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    half = sign | mantissa >> shift;
+    rest = mantissa & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  } else {
+    half = sign | (uint32_t)exponent << 10 | mantissa >> 13;
+    rest = mantissa & 0x1FFF;
+    halfway = 0x1000;
+  }
+  // to nearest even, a carry moves into the exponent as it should
+  if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+  return (uint16_t)half;
+}
+
+float HalfToFloat(uint16_t half) {
+  uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+  uint32_t exponent = (uint32_t)half >> 10 & 0x1F;
+  uint32_t mantissa = half & 0x3FFu;
+  uint32_t bits;
+  if (exponent == 0) {
+    float value = (float)mantissa * (1.0f / 16777216.0f);  // 2^-24
+    return sign ? -value : value;
+  } else if (exponent == 31) {
+    bits = sign | 0x7F800000 | mantissa << 13;
+  } else {
+    bits = sign | (exponent + 127 - 15) << 23 | mantissa << 13;
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void MatMul(const Matrix& m, const float* x, int x_stride, int frames,
+            float* y, int y_stride) {
+  switch (m.type) {
+    case WeightType::kFloat32:
+      return MatMulOf<WeightType::kFloat32>(m, x, x_stride, frames, y,
+                                            y_stride);
+    case WeightType::kFloat16:
+      return MatMulOf<WeightType::kFloat16>(m, x, x_stride, frames, y,
+                                            y_stride);
+    case WeightType::kInt8:
+      return MatMulOf<WeightType::kInt8>(m, x, x_stride, frames, y,
+                                         y_stride);
+  }
+}
+
+bool HasSimdKernels() { return use_simd_kernels; }
+
+#ifdef TEST
+void ForcePortableKernels(bool portable) {
+  use_simd_kernels = !portable && DetectSimdKernels();
+}
+#endif
+
+}  // namespace nn_infer
+}  // namespace zamt
@@ -0,0 +1,81 @@
+#include "zamt/nn_infer/ModelFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace zamt {
+namespace nn_infer {
+
+namespace {
+
+bool WriteLayer(FILE* file, const LayerSpec& layer) {
+  LayerHeader header;
+  header.type = (uint32_t)layer.type;
+  header.activation = (uint32_t)layer.activation;
+  header.weight_type = (uint32_t)layer.weight_type;
+  header.inputs = (uint32_t)layer.inputs;
+  header.outputs = (uint32_t)layer.outputs;
+  header.kernel = (uint32_t)layer.kernel;
+  header.dilation = (uint32_t)layer.dilation;
+  header.reserved = 0;
+  size_t columns = (size_t)(layer.kernel * layer.inputs);
+  size_t rows = (size_t)layer.outputs;
+  if (layer.weights.size() != rows * columns || layer.bias.size() != rows ||
+      fwrite(&header, sizeof(header), 1, file) != 1)
+    return false;
+  bool ok = true;
+  switch (layer.weight_type) {
+    case WeightType::kFloat32:
+      ok = fwrite(layer.weights.data(), sizeof(float), rows * columns,
+                  file) == rows * columns;
+      break;
+    case WeightType::kFloat16: {
+      std::vector<uint16_t> halves(layer.weights.size());
+      std::transform(layer.weights.begin(), layer.weights.end(),
+                     halves.begin(), FloatToHalf);
+      ok = fwrite(halves.data(), sizeof(uint16_t), halves.size(), file) ==
+           halves.size();
+      break;
+    }
+    case WeightType::kInt8: {
+      std::vector<int8_t> integers(layer.weights.size());
+      std::vector<float> scales(rows);
+      for (size_t r = 0; r < rows; ++r) {
+        const float* row = &layer.weights[r * columns];
+        float largest = 0.0f;
+        for (size_t i = 0; i < columns; ++i)
+          largest = std::max(largest, std::fabs(row[i]));
+        scales[r] = largest > 0.0f ? largest / 127.0f : 1.0f;
+        for (size_t i = 0; i < columns; ++i) {
+          integers[r * columns + i] =
+              (int8_t)std::lround(row[i] / scales[r]);
+        }
+      }
+      ok = fwrite(integers.data(), 1, integers.size(), file) ==
+               integers.size() &&
+           fwrite(scales.data(), sizeof(float), rows, file) == rows;
+      break;
+    }
+  }
+  return ok && fwrite(layer.bias.data(), sizeof(float), rows, file) == rows;
+}
+
+}  // namespace
+
+bool WriteModel(const char* path, int input_size,
+                const std::vector<LayerSpec>& layers) {
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+  ModelHeader header;
+  memcpy(header.magic, kModelMagic, sizeof(header.magic));
+  header.input_size = (uint32_t)input_size;
+  header.layers = (uint32_t)layers.size();
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (const LayerSpec& layer : layers) ok = ok && WriteLayer(file, layer);
+  return fclose(file) == 0 && ok;
+}
+
+}  // namespace nn_infer
+}  // namespace zamt
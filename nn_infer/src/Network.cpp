@@ -0,0 +1,267 @@
+#include "zamt/nn_infer/Network.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace zamt {
+namespace nn_infer {
+
+namespace {
+
+const uint32_t kMaxLayers = 256;
+
+size_t Align(size_t size) {
+  return (size + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+}
+
+bool ReadFile(const char* path, std::vector<uint8_t>& data) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  bool ok = fseek(file, 0, SEEK_END) == 0;
+  long size = ok ? ftell(file) : -1;
+  ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+  if (ok) {
+    data.resize((size_t)size);
+    ok = fread(data.data(), 1, data.size(), file) == data.size();
+  }
+  fclose(file);
+  return ok;
+}
+
+bool IsValid(const LayerHeader& header, int inputs) {
+  int outputs = (int)header.outputs;
+  int kernel = (int)header.kernel;
+  return header.type <= (uint32_t)LayerType::kCausalConv &&
+         header.activation <= (uint32_t)Activation::kTanh &&
+         header.weight_type <= (uint32_t)WeightType::kInt8 &&
+         (int)header.inputs == inputs && outputs > 0 &&
+         outputs <= kMaxLayerSize && kernel > 0 && kernel <= kMaxKernel &&
+         (header.type == (uint32_t)LayerType::kCausalConv || kernel == 1) &&
+         header.dilation > 0 && (int)header.dilation <= kMaxDilation;
+}
+
+}  // namespace
+
+void Network::AlignedFree::operator()(uint8_t* memory) const { free(memory); }
+
+Network::~Network() = default;
+
+bool Network::Load(const char* path) {
+  std::vector<uint8_t> data;
+  if (!ReadFile(path, data) || data.size() < sizeof(ModelHeader)) return false;
+  ModelHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  if (memcmp(header.magic, kModelMagic, sizeof(header.magic)) ||
+      header.input_size == 0 || (int)header.input_size > kMaxLayerSize ||
+      header.layers == 0 || header.layers > kMaxLayers)
+    return false;
+
+  // plans the memory while checking the layers
+  std::vector<LayerHeader> headers(header.layers);
+  std::vector<size_t> file_offsets(header.layers);
+  std::vector<size_t> offsets(header.layers);
+  size_t offset = sizeof(header);
+  size_t planned = 0;
+  int size = (int)header.input_size;
+  int buffer_stride = GetPaddedSize(size);
+  int gathered_stride = 0;
+  for (size_t i = 0; i < headers.size(); ++i) {
+    LayerHeader& layer = headers[i];
+    if (data.size() < offset + sizeof(layer)) return false;
+    memcpy(&layer, &data[offset], sizeof(layer));
+    if (!IsValid(layer, size)) return false;
+    offset += sizeof(layer);
+    file_offsets[i] = offset;
+    offsets[i] = planned;
+    size_t rows = layer.outputs;
+    size_t columns = (size_t)layer.kernel * layer.inputs;
+    size_t weight_size = (size_t)GetWeightSize((WeightType)layer.weight_type);
+    bool scaled = layer.weight_type == (uint32_t)WeightType::kInt8;
+    offset += rows * columns * weight_size +
+              (scaled ? rows : 0) * sizeof(float) + rows * sizeof(float);
+    if (offset > data.size()) return false;
+    planned += Align(rows * (size_t)GetPaddedSize((int)columns) *
+                     weight_size) +
+               2 * Align(rows * sizeof(float)) +
+               Align((size_t)(layer.kernel - 1) * layer.dilation *
+                     layer.inputs * sizeof(float));
+    if (layer.type == (uint32_t)LayerType::kCausalConv)
+      gathered_stride = std::max(gathered_stride, GetPaddedSize((int)columns));
+    size = (int)layer.outputs;
+    buffer_stride = std::max(buffer_stride, GetPaddedSize(size));
+  }
+  if (offset != data.size()) return false;
+  size_t buffers_offset = planned;
+  planned += 2 * Align((size_t)(kMaxFrames * buffer_stride) * sizeof(float));
+  size_t gathered_offset = planned;
+  planned += Align((size_t)(kMaxFrames * gathered_stride) * sizeof(float));
+
+  void* memory = nullptr;
+  if (posix_memalign(&memory, kBufferAlignment, planned) != 0) return false;
+  memset(memory, 0, planned);
+  memory_.reset(static_cast<uint8_t*>(memory));
+  memory_size_ = planned;
+  uint8_t* base = memory_.get();
+  buffer_stride_ = buffer_stride;
+  buffers_[0] = reinterpret_cast<float*>(base + buffers_offset);
+  buffers_[1] = reinterpret_cast<float*>(
+      base + buffers_offset +
+      Align((size_t)(kMaxFrames * buffer_stride) * sizeof(float)));
+  gathered_stride_ = gathered_stride;
+  gathered_ = reinterpret_cast<float*>(base + gathered_offset);
+
+  // copies the weights into padded rows
+  layers_.clear();
+  for (size_t i = 0; i < headers.size(); ++i) {
+    const LayerHeader& header_of_layer = headers[i];
+    Layer layer;
+    layer.type = (LayerType)header_of_layer.type;
+    layer.activation = (Activation)header_of_layer.activation;
+    layer.inputs = (int)header_of_layer.inputs;
+    layer.outputs = (int)header_of_layer.outputs;
+    layer.kernel = (int)header_of_layer.kernel;
+    layer.dilation = (int)header_of_layer.dilation;
+    WeightType type = (WeightType)header_of_layer.weight_type;
+    size_t rows = (size_t)layer.outputs;
+    size_t columns = (size_t)(layer.kernel * layer.inputs);
+    size_t weight_size = (size_t)GetWeightSize(type);
+    size_t padded_row = (size_t)GetPaddedSize((int)columns) * weight_size;
+
+    uint8_t* planned_layer = base + offsets[i];
+    const uint8_t* stored = &data[file_offsets[i]];
+    for (size_t r = 0; r < rows; ++r) {
+      memcpy(planned_layer + r * padded_row, stored + r * columns * weight_size,
+             columns * weight_size);
+    }
+    stored += rows * columns * weight_size;
+    planned_layer += Align(rows * padded_row);
+    float* scales = reinterpret_cast<float*>(planned_layer);
+    if (type == WeightType::kInt8) {
+      memcpy(scales, stored, rows * sizeof(float));
+      stored += rows * sizeof(float);
+    }
+    planned_layer += Align(rows * sizeof(float));
+    float* bias = reinterpret_cast<float*>(planned_layer);
+    memcpy(bias, stored, rows * sizeof(float));
+    planned_layer += Align(rows * sizeof(float));
+    layer.history = reinterpret_cast<float*>(planned_layer);
+    layer.history_frames = (layer.kernel - 1) * layer.dilation;
+
+    layer.matrix.type = type;
+    layer.matrix.data = base + offsets[i];
+    layer.matrix.scales = type == WeightType::kInt8 ? scales : nullptr;
+    layer.matrix.bias = bias;
+    layer.matrix.rows = layer.outputs;
+    layer.matrix.columns = GetPaddedSize((int)columns);
+    layers_.push_back(layer);
+  }
+  input_size_ = (int)header.input_size;
+  output_size_ = size;
+  return true;
+}
+
+void Network::Process(const float* inputs, int frames, float* outputs) {
+  for (int first = 0; first < frames; first += kMaxFrames) {
+    int block = std::min(frames - first, (int)kMaxFrames);
+    ProcessBlock(inputs + first * input_size_, block,
+                 outputs + first * output_size_);
+  }
+}
+
+void Network::Reset() {
+  for (Layer& layer : layers_) {
+    std::fill(layer.history,
+              layer.history + layer.history_frames * layer.inputs, 0.0f);
+    layer.history_position = 0;
+  }
+}
+
+void Network::ProcessBlock(const float* inputs, int frames, float* outputs) {
+  float* input = buffers_[0];
+  for (int f = 0; f < frames; ++f) {
+    float* frame = input + f * buffer_stride_;
+    std::copy(inputs + f * input_size_, inputs + (f + 1) * input_size_,
+              frame);
+    std::fill(frame + input_size_, frame + buffer_stride_, 0.0f);
+  }
+  int current = 0;
+  for (Layer& layer : layers_) {
+    const float* x = buffers_[current];
+    float* y = buffers_[1 - current];
+    if (layer.type == LayerType::kCausalConv) {
+      Gather(layer, x, buffer_stride_, frames);
+      MatMul(layer.matrix, gathered_, gathered_stride_, frames, y,
+             buffer_stride_);
+      Remember(layer, x, buffer_stride_, frames);
+    } else {
+      MatMul(layer.matrix, x, buffer_stride_, frames, y, buffer_stride_);
+    }
+    for (int f = 0; f < frames; ++f)
+      Activate(layer.activation, y + f * buffer_stride_, layer.outputs);
+    current = 1 - current;
+  }
+  for (int f = 0; f < frames; ++f) {
+    const float* frame = buffers_[current] + f * buffer_stride_;
+    std::copy(frame, frame + output_size_, outputs + f * output_size_);
+  }
+}
+
+void Network::Gather(const Layer& layer, const float* input,
+                     int input_stride, int frames) {
+  int columns = layer.kernel * layer.inputs;
+  for (int f = 0; f < frames; ++f) {
+    float* gathered = gathered_ + f * gathered_stride_;
+    for (int tap = 0; tap < layer.kernel; ++tap) {
+      int back = (layer.kernel - 1 - tap) * layer.dilation;
+      const float* seen;
+      if (back <= f) {
+        seen = input + (f - back) * input_stride;
+      } else {
+        // before this block, 1 is the newest frame of the history
+        int age = back - f;
+        int position = (layer.history_position + layer.history_frames - age) %
+                       layer.history_frames;
+        seen = layer.history + position * layer.inputs;
+      }
+      std::copy(seen, seen + layer.inputs, gathered + tap * layer.inputs);
+    }
+    // the padding may hold the inputs of another layer
+    std::fill(gathered + columns, gathered + layer.matrix.columns, 0.0f);
+  }
+}
+
+void Network::Remember(Layer& layer, const float* input, int input_stride,
+                       int frames) {
+  if (layer.history_frames == 0) return;
+  int first = std::max(0, frames - layer.history_frames);
+  for (int f = first; f < frames; ++f) {
+    const float* frame = input + f * input_stride;
+    std::copy(frame, frame + layer.inputs,
+              layer.history + layer.history_position * layer.inputs);
+    layer.history_position =
+        (layer.history_position + 1) % layer.history_frames;
+  }
+}
+
+void Network::Activate(Activation activation, float* values, int count) {
+  switch (activation) {
+    case Activation::kLinear:
+      break;
+    case Activation::kReLU:
+      for (int i = 0; i < count; ++i) values[i] = std::max(0.0f, values[i]);
+      break;
+    case Activation::kSigmoid:
+      for (int i = 0; i < count; ++i)
+        values[i] = 1.0f / (1.0f + std::exp(-values[i]));
+      break;
+    case Activation::kTanh:
+      for (int i = 0; i < count; ++i) values[i] = std::tanh(values[i]);
+      break;
+  }
+}
+
+}  // namespace nn_infer
+}  // namespace zamt
@@ -0,0 +1,75 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/nn_infer/ModelFile.h"
+#include "zamt/nn_infer/Network.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/// Frames per second on one core of a note model on the bins of a 2048
+/// sample transform, by weight type and frames processed at once.
+
+using namespace zamt;
+using namespace zamt::nn_infer;
+
+static const char* kPath = "InferenceBenchmark.znn";
+static const int kBins = 1025;
+static const int kNotes = 88;
+static const int kFrames = 400;
+
+LayerSpec MakeLayer(LayerType type, Activation activation, WeightType weights,
+                    int inputs, int outputs, int kernel, int dilation) {
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> uniform(-0.1f, 0.1f);
+  LayerSpec layer;
+  layer.type = type;
+  layer.activation = activation;
+  layer.weight_type = weights;
+  layer.inputs = inputs;
+  layer.outputs = outputs;
+  layer.kernel = kernel;
+  layer.dilation = dilation;
+  layer.weights.resize((size_t)(outputs * kernel * inputs));
+  for (float& weight : layer.weights) weight = uniform(random);
+  layer.bias.assign((size_t)outputs, 0.0f);
+  return layer;
+}
+
+double MeasureFramesPerSecond(WeightType weights, int frames_at_once) {
+  std::vector<LayerSpec> layers;
+  layers.push_back(MakeLayer(LayerType::kCausalConv, Activation::kReLU,
+                             weights, kBins, 256, 3, 1));
+  layers.push_back(MakeLayer(LayerType::kCausalConv, Activation::kReLU,
+                             weights, 256, 256, 3, 2));
+  layers.push_back(MakeLayer(LayerType::kDense, Activation::kSigmoid,
+                             weights, 256, kNotes, 1, 1));
+  ASSERT(WriteModel(kPath, kBins, layers));
+  Network network;
+  ASSERT(network.Load(kPath));
+  remove(kPath);
+  std::vector<float> inputs((size_t)(frames_at_once * kBins), 0.5f);
+  std::vector<float> outputs((size_t)(frames_at_once * kNotes));
+  auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < kFrames; frame += frames_at_once)
+    network.Process(inputs.data(), frames_at_once, outputs.data());
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  EXPECT(outputs[0] > 0.0f && outputs[0] < 1.0f);
+  return kFrames / seconds;
+}
+
+TEST_BEGIN() {
+  printf("%s kernels\n", HasSimdKernels() ? "SIMD" : "Portable");
+  const char* names[] = {"float", "half float", "int8"};
+  const WeightType types[] = {WeightType::kFloat32, WeightType::kFloat16,
+                              WeightType::kInt8};
+  for (int i = 0; i < 3; ++i) {
+    for (int frames_at_once : {1, Network::kMaxFrames}) {
+      printf("%s weights, %d frames at once: %.0f frames/s\n", names[i],
+             frames_at_once, MeasureFramesPerSecond(types[i], frames_at_once));
+    }
+  }
+}
+TEST_END()
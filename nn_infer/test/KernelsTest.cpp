@@ -0,0 +1,124 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/nn_infer/Kernels.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace zamt;
+using namespace zamt::nn_infer;
+
+// Memory aligned for the kernels, zeroed.
+struct AlignedBuffer {
+  explicit AlignedBuffer(size_t size) {
+    void* memory = nullptr;
+    ASSERT(posix_memalign(&memory, kBufferAlignment, size) == 0);
+    memset(memory, 0, size);
+    data = static_cast<uint8_t*>(memory);
+  }
+  ~AlignedBuffer() { free(data); }
+  float* floats() { return reinterpret_cast<float*>(data); }
+
+  uint8_t* data;
+};
+
+void HalfFloatsAreRounded() {
+  EXPECT(FloatToHalf(1.0f) == 0x3C00);
+  EXPECT(FloatToHalf(-2.0f) == 0xC000);
+  EXPECT(HalfToFloat(0x3C00) == 1.0f);
+  EXPECT(HalfToFloat(FloatToHalf(65504.0f)) == 65504.0f);
+  EXPECT(std::isinf(HalfToFloat(FloatToHalf(1e6f))));
+  EXPECT(HalfToFloat(FloatToHalf(1e-9f)) == 0.0f);
+  // subnormal: 2^-24 is the smallest
+  EXPECT(HalfToFloat(FloatToHalf(std::ldexp(3.0f, -24))) ==
+         std::ldexp(3.0f, -24));
+  for (float value = -3.0f; value < 3.0f; value += 0.0137f) {
+    float rounded = HalfToFloat(FloatToHalf(value));
+    EXPECT(std::fabs(rounded - value) <= std::fabs(value) / 2048.0f);
+  }
+}
+
+void CheckMatMul(WeightType type, int frames) {
+  const int rows = 37;
+  const int columns = 70;
+  const int padded = GetPaddedSize(columns);
+  const int y_stride = GetPaddedSize(rows);
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+  // the weights as the kernel sees them
+  std::vector<double> weights((size_t)(rows * columns));
+  AlignedBuffer data((size_t)(rows * padded * GetWeightSize(type)));
+  std::vector<float> scales((size_t)rows);
+  std::vector<float> bias((size_t)rows);
+  for (int r = 0; r < rows; ++r) {
+    scales[(size_t)r] = 0.01f * (float)(r + 1);
+    bias[(size_t)r] = uniform(random);
+    for (int i = 0; i < columns; ++i) {
+      float weight = uniform(random);
+      size_t index = (size_t)(r * padded + i);
+      double& used = weights[(size_t)(r * columns + i)];
+      if (type == WeightType::kFloat32) {
+        data.floats()[index] = weight;
+        used = weight;
+      } else if (type == WeightType::kFloat16) {
+        uint16_t half = FloatToHalf(weight);
+        reinterpret_cast<uint16_t*>(data.data)[index] = half;
+        used = HalfToFloat(half);
+      } else {
+        auto integer = (int8_t)std::lround(weight * 127.0f);
+        reinterpret_cast<int8_t*>(data.data)[index] = integer;
+        used = integer * (double)scales[(size_t)r];
+      }
+    }
+  }
+  Matrix matrix;
+  matrix.type = type;
+  matrix.data = data.data;
+  matrix.scales = type == WeightType::kInt8 ? scales.data() : nullptr;
+  matrix.bias = bias.data();
+  matrix.rows = rows;
+  matrix.columns = padded;
+
+  AlignedBuffer x((size_t)(frames * padded) * sizeof(float));
+  for (int f = 0; f < frames; ++f) {
+    for (int i = 0; i < columns; ++i)
+      x.floats()[f * padded + i] = uniform(random);
+  }
+  AlignedBuffer y((size_t)(frames * y_stride) * sizeof(float));
+  for (int i = 0; i < frames * y_stride; ++i) y.floats()[i] = 1.0f;
+  MatMul(matrix, x.floats(), padded, frames, y.floats(), y_stride);
+  for (int f = 0; f < frames; ++f) {
+    for (int r = 0; r < rows; ++r) {
+      double expected = bias[(size_t)r];
+      for (int i = 0; i < columns; ++i) {
+        expected += weights[(size_t)(r * columns + i)] *
+                    x.floats()[f * padded + i];
+      }
+      EXPECT(std::fabs(y.floats()[f * y_stride + r] - expected) < 1e-4);
+    }
+    for (int r = rows; r < y_stride; ++r)
+      EXPECT(y.floats()[f * y_stride + r] == 0.0f);
+  }
+}
+
+void MatricesAreMultiplied() {
+  const WeightType types[] = {WeightType::kFloat32, WeightType::kFloat16,
+                              WeightType::kInt8};
+  // the SIMD kernels if the CPU has them, then the portable ones
+  for (bool portable : {false, true}) {
+    ForcePortableKernels(portable);
+    for (WeightType type : types) {
+      for (int frames = 1; frames <= 9; ++frames) CheckMatMul(type, frames);
+    }
+  }
+  ForcePortableKernels(false);
+}
+
+TEST_BEGIN() {
+  HalfFloatsAreRounded();
+  MatricesAreMultiplied();
+}
+TEST_END()
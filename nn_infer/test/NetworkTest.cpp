@@ -0,0 +1,169 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/nn_infer/ModelFile.h"
+#include "zamt/nn_infer/Network.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace zamt;
+using namespace zamt::nn_infer;
+
+static const char* kPath = "NetworkTest.znn";
+static const int kInputs = 5;
+static const int kFrames = 20;
+
+LayerSpec MakeLayer(LayerType type, Activation activation,
+                    WeightType weight_type, int inputs, int outputs,
+                    int kernel, int dilation, std::mt19937& random) {
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  LayerSpec layer;
+  layer.type = type;
+  layer.activation = activation;
+  layer.weight_type = weight_type;
+  layer.inputs = inputs;
+  layer.outputs = outputs;
+  layer.kernel = kernel;
+  layer.dilation = dilation;
+  layer.weights.resize((size_t)(outputs * kernel * inputs));
+  for (float& weight : layer.weights) weight = uniform(random);
+  layer.bias.resize((size_t)outputs);
+  for (float& bias : layer.bias) bias = uniform(random);
+  return layer;
+}
+
+// Causal convolutions, then a dense layer in all weight types.
+std::vector<LayerSpec> MakeLayers() {
+  std::mt19937 random(7);
+  std::vector<LayerSpec> layers;
+  layers.push_back(MakeLayer(LayerType::kCausalConv, Activation::kReLU,
+                             WeightType::kFloat32, kInputs, 7, 3, 2, random));
+  layers.push_back(MakeLayer(LayerType::kCausalConv, Activation::kTanh,
+                             WeightType::kFloat16, 7, 40, 2, 1, random));
+  layers.push_back(MakeLayer(LayerType::kDense, Activation::kSigmoid,
+                             WeightType::kInt8, 40, 3, 1, 1, random));
+  return layers;
+}
+
+// Returns the weights as the file keeps them.
+std::vector<double> GetStoredWeights(const LayerSpec& layer) {
+  size_t columns = (size_t)(layer.kernel * layer.inputs);
+  std::vector<double> weights(layer.weights.size());
+  for (size_t r = 0; r < (size_t)layer.outputs; ++r) {
+    const float* row = &layer.weights[r * columns];
+    float largest = 0.0f;
+    for (size_t i = 0; i < columns; ++i)
+      largest = std::max(largest, std::fabs(row[i]));
+    for (size_t i = 0; i < columns; ++i) {
+      double& weight = weights[r * columns + i];
+      if (layer.weight_type == WeightType::kFloat16) {
+        weight = HalfToFloat(FloatToHalf(row[i]));
+      } else if (layer.weight_type == WeightType::kInt8) {
+        float scale = largest / 127.0f;
+        weight = (double)std::lround(row[i] / scale) * scale;
+      } else {
+        weight = row[i];
+      }
+    }
+  }
+  return weights;
+}
+
+// Computes the outputs of the whole stream at once, zeros before it.
+std::vector<double> ComputeOutputs(const std::vector<LayerSpec>& layers,
+                                   const std::vector<float>& inputs) {
+  std::vector<double> frames(inputs.begin(), inputs.end());
+  int size = kInputs;
+  for (const LayerSpec& layer : layers) {
+    std::vector<double> weights = GetStoredWeights(layer);
+    std::vector<double> outputs((size_t)(kFrames * layer.outputs));
+    for (int t = 0; t < kFrames; ++t) {
+      for (int o = 0; o < layer.outputs; ++o) {
+        double sum = layer.bias[(size_t)o];
+        for (int tap = 0; tap < layer.kernel; ++tap) {
+          int seen = t - (layer.kernel - 1 - tap) * layer.dilation;
+          if (seen < 0) continue;
+          for (int i = 0; i < size; ++i) {
+            sum += weights[(size_t)((o * layer.kernel + tap) * size + i)] *
+                   frames[(size_t)(seen * size + i)];
+          }
+        }
+        if (layer.activation == Activation::kReLU) sum = std::max(0.0, sum);
+        if (layer.activation == Activation::kTanh) sum = std::tanh(sum);
+        if (layer.activation == Activation::kSigmoid)
+          sum = 1.0 / (1.0 + std::exp(-sum));
+        outputs[(size_t)(t * layer.outputs + o)] = sum;
+      }
+    }
+    frames.swap(outputs);
+    size = layer.outputs;
+  }
+  return frames;
+}
+
+void StreamIsProcessedLikeAWhole() {
+  std::vector<LayerSpec> layers = MakeLayers();
+  ASSERT(WriteModel(kPath, kInputs, layers));
+  Network network;
+  ASSERT(network.Load(kPath));
+  EXPECT(network.input_size() == kInputs);
+  ASSERT(network.output_size() == 3);
+  EXPECT(network.memory_size() > 0);
+
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  std::vector<float> inputs((size_t)(kFrames * kInputs));
+  for (float& input : inputs) input = uniform(random);
+  std::vector<double> expected = ComputeOutputs(layers, inputs);
+
+  // frame by frame, in groups of 3 and all at once
+  for (int group : {1, 3, kFrames}) {
+    network.Reset();
+    std::vector<float> outputs((size_t)(kFrames * 3));
+    for (int first = 0; first < kFrames; first += group) {
+      int frames = std::min(group, kFrames - first);
+      network.Process(&inputs[(size_t)(first * kInputs)], frames,
+                      &outputs[(size_t)(first * 3)]);
+    }
+    for (size_t i = 0; i < outputs.size(); ++i)
+      EXPECT(std::fabs(outputs[i] - expected[i]) < 1e-4);
+  }
+  remove(kPath);
+}
+
+void OnlyValidModelsAreLoaded() {
+  Network network;
+  EXPECT(!network.Load("NoSuchModel.znn"));
+  FILE* file = fopen(kPath, "wb");
+  ASSERT(file);
+  fputs("This is not a model at all.", file);
+  fclose(file);
+  EXPECT(!network.Load(kPath));
+
+  // the layers do not fit together
+  std::vector<LayerSpec> layers = MakeLayers();
+  ASSERT(WriteModel(kPath, kInputs + 1, layers));
+  EXPECT(!network.Load(kPath));
+
+  // cut
+  ASSERT(WriteModel(kPath, kInputs, layers));
+  EXPECT(network.Load(kPath));
+  FILE* model = fopen(kPath, "rb");
+  ASSERT(model);
+  fseek(model, 0, SEEK_END);
+  long size = ftell(model);
+  fclose(model);
+  ASSERT(truncate(kPath, size - 1) == 0);
+  EXPECT(!network.Load(kPath));
+  remove(kPath);
+}
+
+TEST_BEGIN() {
+  StreamIsProcessedLikeAWhole();
+  OnlyValidModelsAreLoaded();
+}
+TEST_END()
@@ -0,0 +1,21 @@
+set(this_module nn_infer)
+
+
+set(other_modules
+  core
+)
+
+set(test_cpps
+  InferenceBenchmark.cpp
+)
+AddTest(InferenceBenchmark ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  KernelsTest.cpp
+)
+AddTest(KernelsTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  NetworkTest.cpp
+)
+AddTest(NetworkTest ${this_module} "${other_modules}" "${test_cpps}")
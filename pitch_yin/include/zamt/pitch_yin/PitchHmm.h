@@ -0,0 +1,81 @@
+#ifndef ZAMT_PITCH_YIN_PITCHHMM_H_
+#define ZAMT_PITCH_YIN_PITCHHMM_H_
+
+/// Smooths the pYIN candidates of frames into a pitch track online.
+/**
+ * A hidden Markov model of pitch bins (kCentsPerBin wide on the log scale
+ * of the periods) each voiced or unvoiced, as in pYIN: the pitch moves at
+ * most kMaxStepInBins from frame to frame, more likely by small steps, and
+ * the voicing rarely switches. A voiced state is observed with the
+ * probability of the candidates in its bin, an unvoiced one with the
+ * probability left.
+ * Viterbi decoding runs frame by frame: the best path to the newest frame
+ * is traced back lag frames, and the state it passes then is the decision
+ * for that frame. Paths rarely differ so far back, so the decisions are
+ * those of decoding the whole track with a latency of lag frames and a
+ * fixed cost per frame.
+ */
+
+#include "zamt/core/Scheduler.h"
+#include "zamt/pitch_yin/Yin.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace zamt {
+namespace pitch_yin {
+
+struct PitchDecision {
+  Scheduler::Time time;  // of the frame
+  float period;          // in samples, 0 if unvoiced
+  float probability;     // of the frame being voiced
+};
+
+class PitchHmm {
+ public:
+  const static int kCentsPerBin = 20;
+  const static int kMaxStepInBins = 12;  // from frame to frame
+
+  PitchHmm(float min_period, float max_period, int lag);
+
+  int bins() const { return bins_; }
+  int lag() const { return lag_; }
+
+  /// Adds the candidates of the next frame. Returns true with the decision
+  /// for the frame lag frames before, false for the first lag frames.
+  bool Step(const PitchCandidate* candidates, int count,
+            Scheduler::Time time, PitchDecision& decision);
+
+  /// Starts a new track, the undecided frames are dropped.
+  void Reset() { frames_ = 0; }
+
+ private:
+  struct Frame {
+    Scheduler::Time time;
+    float probability;  // of being voiced
+    std::vector<PitchCandidate> candidates;
+  };
+
+  int GetBin(float period) const;
+  void Observe(const Frame& frame);
+  void Advance(int* backpointers);
+  void Decide(int state, const Frame& frame, PitchDecision& decision) const;
+
+  float min_period_;
+  int bins_;
+  int lag_;
+  int64_t frames_ = 0;
+  std::vector<float> log_steps_;  // of pitch steps by their size
+  std::vector<float> observed_;   // log probabilities, voiced states first
+  std::vector<float> scores_;     // of the best paths to the states
+  std::vector<float> next_scores_;
+  std::vector<float> best_voicing_;  // per target voicing and bin
+  std::vector<int> best_voicing_state_;
+  std::vector<Frame> frames_ring_;  // the last lag + 1 frames
+  std::vector<int> backpointers_;   // of the last lag + 1 frames
+};
+
+}  // namespace pitch_yin
+}  // namespace zamt
+
+#endif  // ZAMT_PITCH_YIN_PITCHHMM_H_
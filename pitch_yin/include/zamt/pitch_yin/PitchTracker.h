@@ -0,0 +1,91 @@
+#ifndef ZAMT_PITCH_YIN_PITCHTRACKER_H_
+#define ZAMT_PITCH_YIN_PITCHTRACKER_H_
+
+/// Tracks the pitch of monophonic audio, set up by the pipeline.
+/**
+ * Pipeline stages of type "pitch" collect mono samples of the audio input
+ * and analyse the last size samples every hop samples with YIN (see
+ * Yin.h), for the pitches between fmin and fmax Hz. E.g. for a voice:
+ *
+ *   pitch voice size=2048 hop=256 fmin=60 fmax=1000 lag=8
+ *
+ * By default (method=pyin) the pYIN candidates of the frames are smoothed
+ * by Viterbi decoding (see PitchHmm.h), deciding a frame lag frames later;
+ * method=yin takes the period of every frame as YIN does.
+ * Every frame gives a Pitch packet on a new source named after the stage,
+ * with the timestamp of the first sample of the frame.
+ */
+
+#include "zamt/core/CLIParameters.h"
+#include "zamt/core/Module.h"
+#include "zamt/core/Scheduler.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zamt {
+
+class Log;
+
+namespace pitch_yin {
+
+struct Stage;
+
+class PitchTracker : public Module {
+ public:
+  /// The packets of the stages.
+  struct Pitch {
+    float f0_hz;       // 0 if unvoiced
+    float confidence;  // of being voiced (pYIN) or of the period (YIN)
+  };
+
+  const static char* kModuleLabel;
+  const static char* kStageType;
+  const static int kDefaultSize = 2048;  // samples
+  const static int kDefaultHop = 256;
+  const static int kDefaultMinFrequency = 60;  // Hz
+  const static int kDefaultMaxFrequency = 1000;
+  const static int kDefaultLag = 8;  // frames
+  const static int kDefaultQueueLength = 64;
+
+  PitchTracker(int argc, const char* const* argv);
+  ~PitchTracker();
+
+  void Initialize(const ModuleCenter* mc);
+
+ private:
+  struct StageParams {
+    int size;
+    int hop;
+    int min_frequency;
+    int max_frequency;
+    int lag;
+    bool probabilistic;
+    int queue;
+  };
+
+  // Returns false if the stage cannot be set up.
+  bool AddStage(const std::string& name, const char* input,
+                const StageParams& params, const char* pool);
+  // Static as pending tasks of the sinks may outlive the module.
+  static void ProcessPacket(Scheduler* scheduler, Stage* stage,
+                            const Scheduler::Byte* packet,
+                            Scheduler::Time timestamp);
+  static void AnalyseFrame(Scheduler* scheduler, Stage& stage,
+                           Scheduler::Time timestamp, double usec_per_sample);
+  void Shutdown(int exit_code);
+  void PrintHelp();
+
+  CLIParameters cli_;
+  std::unique_ptr<Log> log_;
+  const ModuleCenter* mc_ = nullptr;
+  Scheduler* scheduler_ = nullptr;
+  bool started_ = false;
+  std::vector<std::shared_ptr<Stage>> stages_;
+};
+
+}  // namespace pitch_yin
+}  // namespace zamt
+
+#endif  // ZAMT_PITCH_YIN_PITCHTRACKER_H_
@@ -0,0 +1,83 @@
+#ifndef ZAMT_PITCH_YIN_YIN_H_
+#define ZAMT_PITCH_YIN_YIN_H_
+
+/// YIN analysis of the period of frames of mono samples.
+/**
+ * The difference function of a frame d(tau) = sum (x[j] - x[j + tau])^2
+ * over the first W = size - max_period - 1 samples expands into the energy
+ * of the window, the energy of the shifted window (from prefix sums) and
+ * the correlation of the window with the frame. The correlation comes from
+ * three real transforms of the frame size, so a frame costs O(N log N)
+ * instead of O(N * max_period).
+ * The cumulative mean normalized difference (CMNDF) is then searched for
+ * the period as by de Cheveigne and Kawahara (YIN), or for the candidates
+ * of probabilistic YIN (Mauch and Dixon): every dip gets the probability
+ * of the thresholds which would choose it, the thresholds distributed by a
+ * beta distribution with a mean of 0.1.
+ */
+
+#include "zamt/dft_fftw/RealFFT.h"
+
+#include <complex>
+#include <vector>
+
+namespace zamt {
+namespace pitch_yin {
+
+struct PitchCandidate {
+  float period;       // in samples, interpolated between the lags
+  float probability;  // of the frame having this period
+};
+
+class YinAnalyzer {
+ public:
+  const static int kThresholds = 100;  // of pYIN, 0.01 to 1.00
+
+  /// Periods from min_period to max_period samples are searched in frames
+  /// of size samples; a period fits into the frame twice.
+  YinAnalyzer(int size, int min_period, int max_period);
+
+  int size() const { return size_; }
+  int min_period() const { return min_period_; }
+  int max_period() const { return max_period_; }
+
+  /// Computes the difference function of a frame of size() samples.
+  void Analyse(const float* frame);
+
+  /// Of the last frame, for the lags up to max_period() + 1.
+  const float* difference() const { return difference_.data(); }
+  const float* normalized_difference() const { return normalized_.data(); }
+
+  /// YIN: the first dip of the CMNDF under the threshold, the probability
+  /// is 1 - CMNDF. If there is none, false is returned with a period of 0
+  /// and the probability of the deepest dip.
+  bool GetPeriod(PitchCandidate& pitch, float threshold = 0.1f) const;
+
+  /// pYIN: returns the number of candidates put into candidates (room for
+  /// kThresholds), the probability of the frame being unvoiced is left.
+  int GetCandidates(PitchCandidate* candidates) const;
+
+#ifdef TEST
+  /// The difference function by its definition, for comparison.
+  void AnalyseNaively(const float* frame);
+#endif
+
+ private:
+  void Normalize();
+  float Interpolate(int lag) const;
+
+  int size_;
+  int min_period_;
+  int max_period_;
+  int window_;  // samples compared with the shifted ones
+  dft_fftw::RealFFT fft_;
+  std::vector<std::complex<float>> frame_bins_;
+  std::vector<double> energies_;  // prefix sums of the squared samples
+  std::vector<float> difference_;
+  std::vector<float> normalized_;
+};
+
+}  // namespace pitch_yin
+}  // namespace zamt
+
+#endif  // ZAMT_PITCH_YIN_YIN_H_
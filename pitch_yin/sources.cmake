@@ -0,0 +1,12 @@
+set(module_cpps
+  PitchHmm.cpp
+  PitchTracker.cpp
+  Yin.cpp
+)
+
+
+# 3rd party configuration
+
+set(module_includes)
+
+set(module_libs)
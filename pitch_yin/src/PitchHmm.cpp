@@ -0,0 +1,161 @@
+#include "zamt/pitch_yin/PitchHmm.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace zamt {
+namespace pitch_yin {
+
+namespace {
+
+const float kSwitchProbability = 0.01f;  // of the voicing between frames
+const float kYinTrust = 0.5f;  // share of the candidates in the observation
+const float kMinProbability = 1e-9f;  // of observations, for finite logs
+
+}  // namespace
+
+PitchHmm::PitchHmm(float min_period, float max_period, int lag)
+    : min_period_(min_period),
+      bins_((int)std::floor(std::log2(max_period / min_period) * 1200.0f /
+                            kCentsPerBin) +
+            1),
+      lag_(lag),
+      log_steps_(kMaxStepInBins + 1),
+      observed_((size_t)(2 * bins_)),
+      scores_((size_t)(2 * bins_)),
+      next_scores_((size_t)(2 * bins_)),
+      best_voicing_((size_t)(2 * bins_)),
+      best_voicing_state_((size_t)(2 * bins_)),
+      frames_ring_((size_t)lag + 1),
+      backpointers_((size_t)((lag + 1) * 2 * bins_)) {
+  assert(min_period > 0.0f && max_period >= min_period && lag >= 0);
+  // triangular, the weights of the steps up and down sum up to 1
+  float total = (float)((kMaxStepInBins + 1) * (kMaxStepInBins + 1));
+  for (int step = 0; step <= kMaxStepInBins; ++step)
+    log_steps_[(size_t)step] =
+        std::log((float)(kMaxStepInBins + 1 - step) / total);
+  for (Frame& frame : frames_ring_)
+    frame.candidates.reserve(YinAnalyzer::kThresholds);
+}
+
+bool PitchHmm::Step(const PitchCandidate* candidates, int count,
+                    Scheduler::Time time, PitchDecision& decision) {
+  assert(count <= YinAnalyzer::kThresholds);
+  int64_t current = frames_++;
+  size_t states = (size_t)(2 * bins_);
+  size_t slot = (size_t)(current % (lag_ + 1));
+  Frame& frame = frames_ring_[slot];
+  frame.time = time;
+  frame.candidates.assign(candidates, candidates + count);
+  frame.probability = 0.0f;
+  for (int i = 0; i < count; ++i)
+    frame.probability += candidates[i].probability;
+  frame.probability = std::min(frame.probability, 1.0f);
+  Observe(frame);
+  if (current == 0) {
+    scores_ = observed_;
+  } else {
+    Advance(&backpointers_[slot * states]);
+  }
+  if (current < lag_) return false;
+
+  int state = (int)(std::max_element(scores_.begin(), scores_.end()) -
+                    scores_.begin());
+  for (int64_t frame_back = current; frame_back > current - lag_;
+       --frame_back) {
+    size_t back_slot = (size_t)(frame_back % (lag_ + 1));
+    state = backpointers_[back_slot * states + (size_t)state];
+  }
+  Decide(state, frames_ring_[(size_t)((current - lag_) % (lag_ + 1))],
+         decision);
+  return true;
+}
+
+int PitchHmm::GetBin(float period) const {
+  long bin = std::lround(std::log2(period / min_period_) * 1200.0f /
+                         kCentsPerBin);
+  return (int)std::max(0L, std::min(bin, (long)bins_ - 1));
+}
+
+void PitchHmm::Observe(const Frame& frame) {
+  auto voiced_end = observed_.begin() + bins_;
+  std::fill(observed_.begin(), voiced_end, 0.0f);
+  for (const PitchCandidate& candidate : frame.candidates)
+    observed_[(size_t)GetBin(candidate.period)] +=
+        kYinTrust * candidate.probability;
+  float log_none = std::log(kMinProbability);
+  for (auto it = observed_.begin(); it != voiced_end; ++it)
+    *it = *it > kMinProbability ? std::log(*it) : log_none;
+  float unvoiced = (1.0f - kYinTrust * frame.probability) / (float)bins_;
+  std::fill(voiced_end, observed_.end(),
+            std::log(std::max(unvoiced, kMinProbability)));
+}
+
+void PitchHmm::Advance(int* backpointers) {
+  const float stay = std::log(1.0f - kSwitchProbability);
+  const float change = std::log(kSwitchProbability);
+  // the better voicing to come from into each bin, by the target voicing
+  for (int unvoiced = 0; unvoiced < 2; ++unvoiced) {
+    for (int bin = 0; bin < bins_; ++bin) {
+      float from_voiced = scores_[(size_t)bin] + (unvoiced ? change : stay);
+      float from_unvoiced =
+          scores_[(size_t)(bins_ + bin)] + (unvoiced ? stay : change);
+      size_t index = (size_t)(unvoiced * bins_ + bin);
+      best_voicing_[index] = std::max(from_voiced, from_unvoiced);
+      best_voicing_state_[index] =
+          from_voiced >= from_unvoiced ? bin : bins_ + bin;
+    }
+  }
+  float top = -std::numeric_limits<float>::infinity();
+  for (int unvoiced = 0; unvoiced < 2; ++unvoiced) {
+    const float* best = &best_voicing_[(size_t)(unvoiced * bins_)];
+    const int* best_state = &best_voicing_state_[(size_t)(unvoiced * bins_)];
+    int first_state = unvoiced * bins_;
+    for (int bin = 0; bin < bins_; ++bin) {
+      int low = std::max(0, bin - kMaxStepInBins);
+      int high = std::min(bins_ - 1, bin + kMaxStepInBins);
+      int from = low;
+      float score = -std::numeric_limits<float>::infinity();
+      for (int source = low; source <= high; ++source) {
+        float path = best[source] + log_steps_[(size_t)std::abs(bin - source)];
+        if (path > score) {
+          score = path;
+          from = source;
+        }
+      }
+      int state = first_state + bin;
+      score += observed_[(size_t)state];
+      next_scores_[(size_t)state] = score;
+      backpointers[state] = best_state[from];
+      top = std::max(top, score);
+    }
+  }
+  // relative to the best path, so the scores stay in range
+  for (float& score : next_scores_) score -= top;
+  scores_.swap(next_scores_);
+}
+
+void PitchHmm::Decide(int state, const Frame& frame,
+                      PitchDecision& decision) const {
+  decision.time = frame.time;
+  decision.probability = frame.probability;
+  decision.period = 0.0f;
+  if (state >= bins_) return;  // unvoiced
+  // the strongest candidate in the bin, or the middle of the bin
+  decision.period =
+      min_period_ * std::exp2((float)(state * kCentsPerBin) / 1200.0f);
+  float strongest = 0.0f;
+  for (const PitchCandidate& candidate : frame.candidates) {
+    if (candidate.probability > strongest &&
+        GetBin(candidate.period) == state) {
+      strongest = candidate.probability;
+      decision.period = candidate.period;
+    }
+  }
+}
+
+}  // namespace pitch_yin
+}  // namespace zamt
@@ -0,0 +1,250 @@
+#include "zamt/pitch_yin/PitchTracker.h"
+
+#include "zamt/core/Core.h"
+#include "zamt/core/Log.h"
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/pitch_yin/PitchHmm.h"
+#include "zamt/pitch_yin/Yin.h"
+
+#if defined(ZAMT_MODULE_LIVEAUDIO_PULSE)
+#include "zamt/liveaudio_pulse/LiveAudio.h"
+#elif defined(ZAMT_MODULE_LIVEAUDIO_ALSA)
+#include "zamt/liveaudio_alsa/LiveAudio.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace zamt {
+namespace pitch_yin {
+
+struct Stage {
+  std::string name;
+  Scheduler::SourceId input;
+  Scheduler::SourceHandle input_source;
+  Scheduler::SourceId output;
+  Scheduler::SourceHandle output_source;
+  int subscription_id = -1;
+  int hop;
+  std::unique_ptr<YinAnalyzer> yin;
+  std::unique_ptr<PitchHmm> hmm;  // none for plain YIN
+  std::vector<PitchCandidate> candidates;
+  std::vector<float> window;  // mono samples collected for the next frame
+  int filled = 0;
+  uint64_t next_sample = 0;  // expected first sample of the next packet
+  std::atomic<int64_t> frames_lost{0};
+};
+
+const char* PitchTracker::kModuleLabel = "pitch_yin";
+const char* PitchTracker::kStageType = "pitch";
+
+ZAMT_MODULE_DEPENDS(PitchTracker, Core, LiveAudio);
+
+PitchTracker::PitchTracker(int argc, const char* const* argv)
+    : cli_(argc, argv) {
+  log_.reset(new Log(kModuleLabel, cli_));
+  if (cli_.HasParam(Core::kHelpParamStr)) {
+    PrintHelp();
+    return;
+  }
+  started_ = true;
+}
+
+PitchTracker::~PitchTracker() { Shutdown(0); }
+
+void PitchTracker::Initialize(const ModuleCenter* mc) {
+  mc_ = mc;
+  if (!started_) return;
+  Core& core = mc_->Get<Core>();
+  scheduler_ = &core.scheduler();
+  for (auto stage : core.pipeline().GetStages(kStageType)) {
+    StageParams params;
+    params.size = stage->GetNumParam("size", kDefaultSize);
+    params.hop = stage->GetNumParam("hop", kDefaultHop);
+    params.min_frequency = stage->GetNumParam("fmin", kDefaultMinFrequency);
+    params.max_frequency = stage->GetNumParam("fmax", kDefaultMaxFrequency);
+    params.lag = stage->GetNumParam("lag", kDefaultLag);
+    const char* method = stage->GetParam("method");
+    params.probabilistic = !method || strcmp(method, "yin") != 0;
+    params.queue = stage->GetNumParam("queue", kDefaultQueueLength);
+    const char* input = stage->GetParam("input");
+    if (!AddStage(stage->name, input ? input : LiveAudio::kSourceName,
+                  params, stage->GetParam("pool"))) {
+      core.Quit(Core::kExitCodeBadPipeline);
+      return;
+    }
+  }
+  if (stages_.empty()) return;
+  core.RegisterForQuitEvent(
+      std::bind(&PitchTracker::Shutdown, this, std::placeholders::_1));
+}
+
+bool PitchTracker::AddStage(const std::string& name, const char* input,
+                            const StageParams& params, const char* pool) {
+  auto stage = std::make_shared<Stage>();
+  stage->name = name;
+  if (!scheduler_->FindSource(input, stage->input) ||
+      stage->input != mc_->GetId<LiveAudio>()) {
+    log_->Message(Log::kError, "Stage ", name, ": input ", input,
+                  " is not an audio source");
+    return false;
+  }
+  Scheduler::PoolId pool_id = Scheduler::kDefaultPool;
+  if (pool && !scheduler_->FindPool(pool, pool_id)) {
+    log_->Message(Log::kError, "Stage ", name, ": no pool ", pool);
+    return false;
+  }
+  // the sample rate may not be known yet, the packets tell the exact one
+  int sample_rate = mc_->Get<LiveAudio>().sample_rate();
+  if (sample_rate == 0) sample_rate = LiveAudio::kDefaultSampleRate;
+  if (params.min_frequency < 1 ||
+      params.max_frequency <= params.min_frequency) {
+    log_->Message(Log::kError, "Stage ", name, ": bad frequencies ",
+                  params.min_frequency, " - ", params.max_frequency);
+    return false;
+  }
+  int min_period = std::max(2, sample_rate / params.max_frequency);
+  int max_period =
+      (sample_rate + params.min_frequency - 1) / params.min_frequency;
+  if (params.size < 2 * (max_period + 1) || params.hop < 1 ||
+      params.hop > params.size || params.lag < 0 || params.queue < 1) {
+    log_->Message(Log::kError, "Stage ", name, ": bad size ", params.size,
+                  " (", 2 * (max_period + 1), " needed), hop ", params.hop,
+                  ", lag ", params.lag, " or queue ", params.queue);
+    return false;
+  }
+  stage->input_source = scheduler_->GetSourceHandle(stage->input);
+  if (!stage->input_source.valid()) {
+    log_->Message(Log::kError, "Stage ", name, ": input ", input,
+                  " is not registered");
+    return false;
+  }
+  stage->hop = params.hop;
+  stage->yin.reset(new YinAnalyzer(params.size, min_period, max_period));
+  if (params.probabilistic) {
+    stage->hmm.reset(
+        new PitchHmm((float)min_period, (float)max_period, params.lag));
+    stage->candidates.resize(YinAnalyzer::kThresholds);
+  }
+  stage->window.resize((size_t)params.size);
+  stage->output = scheduler_->AllocateSourceId();
+  stage->output_source = scheduler_->RegisterSource(
+      stage->output, (int)sizeof(Pitch), params.queue);
+  if (!stage->output_source.valid()) {
+    log_->Message(Log::kError, "Stage ", name, ": cannot register source ",
+                  stage->output);
+    return false;
+  }
+  scheduler_->SetSourceName(stage->output, name);
+  log_->Message("Stage ", name, ": input ", input, ", size ", params.size,
+                ", hop ", params.hop, ", periods ", min_period, " - ",
+                max_period, ", ", params.probabilistic ? "pYIN" : "YIN",
+                ", lag ", params.lag);
+
+  Stage* stage_ptr = stage.get();
+  std::shared_ptr<Stage> shared_stage = stage;
+  Scheduler* scheduler = scheduler_;
+  stages_.push_back(std::move(stage));
+  // the frames are built from consecutive packets
+  scheduler_->SubscribeInOrder(
+      stage_ptr->input,
+      [scheduler, shared_stage](Scheduler::SourceId,
+                                const Scheduler::Byte* packet,
+                                Scheduler::Time timestamp) {
+        ProcessPacket(scheduler, shared_stage.get(), packet, timestamp);
+      },
+      stage_ptr->subscription_id, pool_id);
+  return true;
+}
+
+void PitchTracker::ProcessPacket(Scheduler* scheduler, Stage* stage_ptr,
+                                 const Scheduler::Byte* packet,
+                                 Scheduler::Time timestamp) {
+  Stage& stage = *stage_ptr;
+  auto samples = reinterpret_cast<const LiveAudio::StereoSample*>(packet);
+  int sample_count = scheduler->GetPacketSize(stage.input_source) /
+                     (int)sizeof(LiveAudio::StereoSample);
+  auto metadata = reinterpret_cast<const LiveAudio::PacketMetadata*>(
+      scheduler->GetPacketMetadata(stage.input_source, packet));
+  if (metadata->first_sample != stage.next_sample) {
+    // lost packets, start collecting and tracking again
+    stage.filled = 0;
+    if (stage.hmm) stage.hmm->Reset();
+  }
+  stage.next_sample = metadata->first_sample + (uint64_t)sample_count;
+  int size = stage.yin->size();
+  for (int i = 0; i < sample_count; ++i) {
+    stage.window[(size_t)stage.filled++] =
+        (samples[i].left + samples[i].right) * 0.5f;
+    if (stage.filled < size) continue;
+    // labeled by the time of the first sample in the frame
+    double offset = (double)(i + 1 - size) * metadata->usec_per_sample;
+    AnalyseFrame(scheduler, stage,
+                 timestamp + (Scheduler::Time)std::llround(offset),
+                 metadata->usec_per_sample);
+    std::copy(stage.window.begin() + stage.hop, stage.window.end(),
+              stage.window.begin());
+    stage.filled = size - stage.hop;
+  }
+  scheduler->ReleasePacket(stage.input_source, packet);
+}
+
+void PitchTracker::AnalyseFrame(Scheduler* scheduler, Stage& stage,
+                                Scheduler::Time timestamp,
+                                double usec_per_sample) {
+  stage.yin->Analyse(stage.window.data());
+  PitchDecision decision;
+  if (stage.hmm) {
+    int count = stage.yin->GetCandidates(stage.candidates.data());
+    // of an earlier frame
+    if (!stage.hmm->Step(stage.candidates.data(), count, timestamp,
+                         decision))
+      return;
+  } else {
+    PitchCandidate pitch;
+    stage.yin->GetPeriod(pitch);
+    decision.time = timestamp;
+    decision.period = pitch.period;
+    decision.probability = pitch.probability;
+  }
+
+  // not waiting for the sinks: they may be queued behind this worker
+  auto result = reinterpret_cast<Pitch*>(
+      scheduler->GetPacketForSubmission(stage.output_source));
+  if (!result) {
+    stage.frames_lost++;
+    return;
+  }
+  result->f0_hz = decision.period > 0.0f
+                      ? (float)(1e6 / (decision.period * usec_per_sample))
+                      : 0.0f;
+  result->confidence = decision.probability;
+  scheduler->SubmitPacket(stage.output_source,
+                          reinterpret_cast<Scheduler::Byte*>(result),
+                          decision.time);
+}
+
+void PitchTracker::Shutdown(int /*exit_code*/) {
+  for (auto& stage : stages_) {
+    scheduler_->Unsubscribe(stage->input, stage->subscription_id);
+    if (stage->frames_lost) {
+      log_->LogMessage(Log::kWarning, ("Stage " + stage->name + ": ").c_str(),
+                       (int)stage->frames_lost,
+                       " frames lost, result queue full!");
+    }
+  }
+  stages_.clear();
+}
+
+void PitchTracker::PrintHelp() {
+  Log::Print("ZAMT Pitch Tracker with YIN");
+  Log::Print(" Pipeline stages: pitch Name input=Source size=Samples "
+             "hop=Samples fmin=Hz fmax=Hz");
+  Log::Print("                  lag=Frames method=pyin|yin queue=Packets "
+             "pool=Pool");
+}
+
+}  // namespace pitch_yin
+}  // namespace zamt
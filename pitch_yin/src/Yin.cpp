@@ -0,0 +1,169 @@
+#include "zamt/pitch_yin/Yin.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace zamt {
+namespace pitch_yin {
+
+namespace {
+
+const int kThresholds = YinAnalyzer::kThresholds;
+
+// The probability of the thresholds up to i / kThresholds, by a beta
+// distribution with alpha 2 and beta 18 as in pYIN.
+const std::array<float, kThresholds + 1>& GetPriorSums() {
+  static const std::array<float, kThresholds + 1> sums = [] {
+    std::array<double, kThresholds> prior;
+    double total = 0.0;
+    for (int i = 0; i < kThresholds; ++i) {
+      double threshold = (i + 1) / (double)kThresholds;
+      prior[(size_t)i] = threshold * std::pow(1.0 - threshold, 17.0);
+      total += prior[(size_t)i];
+    }
+    std::array<float, kThresholds + 1> result;
+    double sum = 0.0;
+    result[0] = 0.0f;
+    for (int i = 0; i < kThresholds; ++i) {
+      sum += prior[(size_t)i];
+      result[(size_t)i + 1] = (float)(sum / total);
+    }
+    return result;
+  }();
+  return sums;
+}
+
+// Number of thresholds not above the value.
+int CountThresholds(float value) {
+  int count = (int)std::floor(value * kThresholds);
+  return std::max(0, std::min(count, kThresholds));
+}
+
+}  // namespace
+
+YinAnalyzer::YinAnalyzer(int size, int min_period, int max_period)
+    : size_(size),
+      min_period_(min_period),
+      max_period_(max_period),
+      window_(size - max_period - 1),
+      fft_(size),
+      frame_bins_((size_t)fft_.bins()),
+      energies_((size_t)size + 1),
+      difference_((size_t)max_period + 2),
+      normalized_((size_t)max_period + 2) {
+  assert(min_period >= 2 && min_period <= max_period);
+  assert(window_ > max_period);
+}
+
+void YinAnalyzer::Analyse(const float* frame) {
+  energies_[0] = 0.0;
+  for (int i = 0; i < size_; ++i)
+    energies_[(size_t)i + 1] = energies_[(size_t)i] + frame[i] * frame[i];
+
+  float* samples = fft_.samples();
+  std::complex<float>* bins = fft_.spectrum();
+  memcpy(samples, frame, (size_t)size_ * sizeof(float));
+  fft_.Forward();
+  std::copy(bins, bins + fft_.bins(), frame_bins_.begin());
+  // the window is zero padded, the frame is long enough not to wrap around
+  memcpy(samples, frame, (size_t)window_ * sizeof(float));
+  memset(samples + window_, 0, (size_t)(size_ - window_) * sizeof(float));
+  fft_.Forward();
+  for (int bin = 0; bin < fft_.bins(); ++bin)
+    bins[bin] = std::conj(bins[bin]) * frame_bins_[(size_t)bin];
+  fft_.Inverse();  // the correlation of the window with the frame
+
+  double scale = 2.0 / size_;
+  double window_energy = energies_[(size_t)window_];
+  for (int lag = 0; lag <= max_period_ + 1; ++lag) {
+    double shifted_energy =
+        energies_[(size_t)(lag + window_)] - energies_[(size_t)lag];
+    double difference = window_energy + shifted_energy - scale * samples[lag];
+    // rounding errors around 0
+    difference_[(size_t)lag] = (float)std::max(0.0, difference);
+  }
+  Normalize();
+}
+
+#ifdef TEST
+void YinAnalyzer::AnalyseNaively(const float* frame) {
+  for (int lag = 0; lag <= max_period_ + 1; ++lag) {
+    double difference = 0.0;
+    for (int i = 0; i < window_; ++i) {
+      double delta = frame[i] - frame[i + lag];
+      difference += delta * delta;
+    }
+    difference_[(size_t)lag] = (float)difference;
+  }
+  Normalize();
+}
+#endif
+
+void YinAnalyzer::Normalize() {
+  normalized_[0] = 1.0f;
+  double sum = 0.0;
+  for (int lag = 1; lag <= max_period_ + 1; ++lag) {
+    sum += difference_[(size_t)lag];
+    double difference = difference_[(size_t)lag];
+    normalized_[(size_t)lag] =
+        sum > 0.0 ? (float)(difference * lag / sum) : 1.0f;
+  }
+}
+
+bool YinAnalyzer::GetPeriod(PitchCandidate& pitch, float threshold) const {
+  for (int lag = min_period_; lag <= max_period_; ++lag) {
+    if (normalized_[(size_t)lag] >= threshold) continue;
+    // to the bottom of the dip
+    while (lag < max_period_ &&
+           normalized_[(size_t)lag + 1] < normalized_[(size_t)lag])
+      ++lag;
+    pitch.period = Interpolate(lag);
+    pitch.probability = 1.0f - normalized_[(size_t)lag];
+    return true;
+  }
+  float deepest = *std::min_element(&normalized_[(size_t)min_period_],
+                                    &normalized_[(size_t)max_period_ + 1]);
+  pitch.period = 0.0f;
+  pitch.probability = std::max(0.0f, 1.0f - deepest);
+  return false;
+}
+
+int YinAnalyzer::GetCandidates(PitchCandidate* candidates) const {
+  const std::array<float, kThresholds + 1>& prior_sums = GetPriorSums();
+  // a threshold chooses the first dip under it, so a dip gets the
+  // thresholds from its depth up to the depth of the dips before
+  int count = 0;
+  int thresholds_left = kThresholds;
+  for (int lag = min_period_; lag <= max_period_ && thresholds_left; ++lag) {
+    float value = normalized_[(size_t)lag];
+    if (value >= normalized_[(size_t)lag - 1] ||
+        value > normalized_[(size_t)lag + 1])
+      continue;
+    int thresholds_below = CountThresholds(value);
+    if (thresholds_below >= thresholds_left) continue;
+    candidates[count].period = Interpolate(lag);
+    candidates[count].probability = prior_sums[(size_t)thresholds_left] -
+                                    prior_sums[(size_t)thresholds_below];
+    ++count;
+    thresholds_left = thresholds_below;
+  }
+  assert(count <= kThresholds);
+  return count;
+}
+
+// Parabolic interpolation of the dip at the lag.
+float YinAnalyzer::Interpolate(int lag) const {
+  float before = normalized_[(size_t)lag - 1];
+  float at = normalized_[(size_t)lag];
+  float after = normalized_[(size_t)lag + 1];
+  float curvature = before - 2.0f * at + after;
+  if (curvature <= 0.0f) return (float)lag;
+  float shift = 0.5f * (before - after) / curvature;
+  return (float)lag + std::max(-0.5f, std::min(shift, 0.5f));
+}
+
+}  // namespace pitch_yin
+}  // namespace zamt
@@ -0,0 +1,76 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/pitch_yin/PitchHmm.h"
+#include "zamt/pitch_yin/Yin.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/// Cost of a frame of 2048 samples at 48 kHz for pitches from 60 to
+/// 1000 Hz: the difference function by transforms and by its definition,
+/// then the pYIN candidates and a step of the online Viterbi decoding.
+
+using namespace zamt;
+using namespace zamt::pitch_yin;
+
+using Clock = std::chrono::steady_clock;
+
+static const int kSampleRate = 48000;
+static const int kSize = 2048;
+static const int kMinPeriod = kSampleRate / 1000;
+static const int kMaxPeriod = kSampleRate / 60;
+static const int kFrames = 200;
+
+double GetMicroseconds(Clock::time_point start, int frames) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+             .count() /
+         frames;
+}
+
+TEST_BEGIN() {
+  const double pi = std::acos(-1.0);
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+  std::vector<float> frame(kSize);
+  for (int i = 0; i < kSize; ++i)
+    frame[(size_t)i] =
+        0.5f * (float)std::sin(2.0 * pi * 220.0 * i / kSampleRate) +
+        noise(random);
+  YinAnalyzer yin(kSize, kMinPeriod, kMaxPeriod);
+  PitchHmm hmm((float)kMinPeriod, (float)kMaxPeriod, 8);
+  PitchCandidate candidates[YinAnalyzer::kThresholds];
+  PitchDecision decision;
+
+  auto start = Clock::now();
+  for (int i = 0; i < kFrames; ++i) yin.Analyse(frame.data());
+  double transformed = GetMicroseconds(start, kFrames);
+  PitchCandidate pitch;
+  EXPECT(yin.GetPeriod(pitch) &&
+         std::fabs(pitch.period * 220.0f - kSampleRate) < 0.01f * kSampleRate);
+
+  int naive_frames = kFrames / 10;
+  start = Clock::now();
+  for (int i = 0; i < naive_frames; ++i) yin.AnalyseNaively(frame.data());
+  double naive = GetMicroseconds(start, naive_frames);
+
+  int count = 0;
+  start = Clock::now();
+  for (int i = 0; i < kFrames; ++i) count = yin.GetCandidates(candidates);
+  double candidate_search = GetMicroseconds(start, kFrames);
+
+  int decided = 0;
+  start = Clock::now();
+  for (int i = 0; i < kFrames; ++i)
+    decided += hmm.Step(candidates, count, (Scheduler::Time)i, decision);
+  double viterbi = GetMicroseconds(start, kFrames);
+  EXPECT(decided == kFrames - 8 && decision.period > 0.0f);
+
+  printf("Difference by transforms: %.1f us/frame\n", transformed);
+  printf("Difference by definition: %.1f us/frame\n", naive);
+  printf("pYIN candidates: %.1f us/frame\n", candidate_search);
+  printf("Viterbi step (%d states, lag 8): %.1f us/frame\n", 2 * hmm.bins(),
+         viterbi);
+}
+TEST_END()
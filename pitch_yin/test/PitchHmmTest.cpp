@@ -0,0 +1,98 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/pitch_yin/PitchHmm.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace zamt;
+using namespace zamt::pitch_yin;
+
+static const float kMinPeriod = 48.0f;
+static const float kMaxPeriod = 800.0f;
+static const int kLag = 8;
+
+// Frame i is at time i, decisions are checked as they come.
+struct Track {
+  PitchHmm hmm{kMinPeriod, kMaxPeriod, kLag};
+  Scheduler::Time frames = 0;
+  std::vector<PitchDecision> decisions;
+
+  void Add(std::vector<PitchCandidate> candidates) {
+    PitchDecision decision;
+    bool decided = hmm.Step(candidates.data(), (int)candidates.size(),
+                            frames, decision);
+    EXPECT(decided == (frames >= (Scheduler::Time)kLag));
+    if (decided) {
+      EXPECT(decision.time == frames - kLag);
+      decisions.push_back(decision);
+    }
+    ++frames;
+  }
+};
+
+void TestSteadyPitch() {
+  Track track;
+  for (int i = 0; i < 50; ++i)
+    track.Add({{100.0f + 0.1f * (float)(i % 3), 0.9f}, {200.0f, 0.05f}});
+  ASSERT(track.decisions.size() == 50 - kLag);
+  for (const PitchDecision& decision : track.decisions) {
+    EXPECT(std::fabs(decision.period - 100.1f) < 0.2f);
+    EXPECT(std::fabs(decision.probability - 0.95f) < 1e-4f);
+  }
+}
+
+void TestOutlier() {
+  Track track;
+  for (int i = 0; i < 40; ++i) {
+    if (i == 20) {
+      // an octave error
+      track.Add({{50.0f, 0.85f}, {100.0f, 0.1f}});
+    } else {
+      track.Add({{100.0f, 0.9f}});
+    }
+  }
+  ASSERT(track.decisions.size() == 40 - kLag);
+  for (const PitchDecision& decision : track.decisions)
+    EXPECT(decision.period == 100.0f);
+}
+
+void TestVoicing() {
+  Track track;
+  for (int i = 0; i < 60; ++i) {
+    if (i >= 20 && i < 40) {
+      track.Add({});
+    } else {
+      track.Add({{i < 20 ? 300.0f : 150.0f, 0.9f}});
+    }
+  }
+  ASSERT(track.decisions.size() == 60 - kLag);
+  for (const PitchDecision& decision : track.decisions) {
+    Scheduler::Time frame = decision.time;
+    if (frame < 20) {
+      EXPECT(decision.period == 300.0f);
+    } else if (frame < 40) {
+      EXPECT(decision.period == 0.0f && decision.probability == 0.0f);
+    } else {
+      EXPECT(decision.period == 150.0f);
+    }
+  }
+}
+
+void TestNoLag() {
+  PitchHmm hmm(kMinPeriod, kMaxPeriod, 0);
+  PitchCandidate candidate{400.0f, 0.8f};
+  PitchDecision decision;
+  ASSERT(hmm.Step(&candidate, 1, 7, decision));
+  EXPECT(decision.time == 7 && decision.period == 400.0f);
+  hmm.Reset();
+  ASSERT(hmm.Step(nullptr, 0, 8, decision));
+  EXPECT(decision.time == 8 && decision.period == 0.0f);
+}
+
+TEST_BEGIN() {
+  TestSteadyPitch();
+  TestOutlier();
+  TestVoicing();
+  TestNoLag();
+}
+TEST_END()
@@ -0,0 +1,98 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/pitch_yin/Yin.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace zamt;
+using namespace zamt::pitch_yin;
+
+static const int kSampleRate = 48000;
+static const int kSize = 2048;
+static const int kMinPeriod = kSampleRate / 1000;
+static const int kMaxPeriod = kSampleRate / 60;
+
+// A tone with its octave and fifth above.
+std::vector<float> MakeTone(double frequency, float level) {
+  const double pi = std::acos(-1.0);
+  std::vector<float> frame(kSize);
+  for (int i = 0; i < kSize; ++i) {
+    double phase = 2.0 * pi * frequency * i / kSampleRate;
+    frame[(size_t)i] = level * (float)(0.6 * std::sin(phase) +
+                                       0.3 * std::sin(2.0 * phase + 1.0) +
+                                       0.1 * std::sin(3.0 * phase + 2.0));
+  }
+  return frame;
+}
+
+void TestSameAsNaive() {
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+  std::vector<float> frame = MakeTone(330.0, 0.5f);
+  for (float& sample : frame) sample += noise(random);
+  YinAnalyzer yin(kSize, kMinPeriod, kMaxPeriod);
+  yin.Analyse(frame.data());
+  std::vector<float> fast(yin.difference(), yin.difference() + kMaxPeriod + 2);
+  yin.AnalyseNaively(frame.data());
+  const float* naive = yin.difference();
+  float energy = naive[kMaxPeriod];
+  for (int lag = 0; lag <= kMaxPeriod + 1; ++lag)
+    EXPECT(std::fabs(fast[(size_t)lag] - naive[lag]) < energy * 1e-4f);
+}
+
+void TestPeriods() {
+  YinAnalyzer yin(kSize, kMinPeriod, kMaxPeriod);
+  for (double frequency : {65.0, 110.0, 261.6, 440.0, 987.8}) {
+    std::vector<float> frame = MakeTone(frequency, 0.8f);
+    yin.Analyse(frame.data());
+    double period = kSampleRate / frequency;
+    PitchCandidate pitch;
+    ASSERT(yin.GetPeriod(pitch));
+    EXPECT(std::fabs(pitch.period - period) < 0.01 * period);
+    EXPECT(pitch.probability > 0.9f);
+
+    PitchCandidate candidates[YinAnalyzer::kThresholds];
+    int count = yin.GetCandidates(candidates);
+    ASSERT(count > 0);
+    float total = 0.0f;
+    float best = 0.0f;
+    for (int i = 0; i < count; ++i) {
+      total += candidates[i].probability;
+      if (candidates[i].probability > best) {
+        best = candidates[i].probability;
+        EXPECT(std::fabs(candidates[i].period - period) < 0.01 * period);
+      }
+    }
+    EXPECT(total > 0.9f && total <= 1.0001f);
+  }
+}
+
+void TestUnvoiced() {
+  YinAnalyzer yin(kSize, kMinPeriod, kMaxPeriod);
+  std::vector<float> silence(kSize, 0.0f);
+  yin.Analyse(silence.data());
+  PitchCandidate pitch;
+  EXPECT(!yin.GetPeriod(pitch));
+  EXPECT(pitch.period == 0.0f);
+  PitchCandidate candidates[YinAnalyzer::kThresholds];
+  EXPECT(yin.GetCandidates(candidates) == 0);
+
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+  std::vector<float> frame(kSize);
+  for (float& sample : frame) sample = noise(random);
+  yin.Analyse(frame.data());
+  EXPECT(!yin.GetPeriod(pitch));
+  int count = yin.GetCandidates(candidates);
+  float total = 0.0f;
+  for (int i = 0; i < count; ++i) total += candidates[i].probability;
+  EXPECT(total < 0.1f);
+}
+
+TEST_BEGIN() {
+  TestSameAsNaive();
+  TestPeriods();
+  TestUnvoiced();
+}
+TEST_END()
@@ -0,0 +1,24 @@
+set(this_module pitch_yin)
+
+
+# the transforms come from dft_fftw, which is built with an audio input
+set(other_modules
+  core
+  liveaudio_pulse
+  dft_fftw
+)
+
+set(test_cpps
+  PitchBenchmark.cpp
+)
+AddTest(PitchBenchmark ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  PitchHmmTest.cpp
+)
+AddTest(PitchHmmTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  YinTest.cpp
+)
+AddTest(YinTest ${this_module} "${other_modules}" "${test_cpps}")
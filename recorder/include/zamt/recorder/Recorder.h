@@ -0,0 +1,67 @@
+#ifndef ZAMT_RECORDER_RECORDER_H_
+#define ZAMT_RECORDER_RECORDER_H_
+
+/// Records sources into files and replays them, set up by the pipeline.
+/**
+ * Pipeline stages of type "record" record their input source into a file
+ * until quit, so what a source submitted can be examined and reproduced.
+ * Stages of type "replay" register a new source named after the stage and
+ * submit the packets of a recording, with the recorded timing by default or
+ * as fast as the sinks take them (realtime=0). E.g.
+ *
+ *   record capture input=LiveAudio file=capture.rec
+ *   replay again file=capture.rec realtime=0
+ *
+ * Replays register their sources in Initialize and start after all modules
+ * connected, so their sinks in any module get them from the first packet.
+ * Records subscribe in Connect, when the sources of every module are
+ * registered, so their input can be a stage of any module or a replay.
+ */
+
+#include "zamt/core/CLIParameters.h"
+#include "zamt/core/Module.h"
+
+#include <memory>
+#include <vector>
+
+namespace zamt {
+
+class Log;
+class Scheduler;
+class SourceRecorder;
+class SourceReplayer;
+
+class Recorder : public Module {
+ public:
+  const static char* kModuleLabel;
+  const static char* kRecordStageType;
+  const static char* kReplayStageType;
+  const static int kDefaultQueueLength = 64;
+
+  Recorder(int argc, const char* const* argv);
+  ~Recorder();
+
+  void Initialize(const ModuleCenter* mc);
+  void Connect(const ModuleCenter* mc);
+  void Start(const ModuleCenter* mc);
+
+ private:
+  // Returns false if the stages cannot be set up.
+  bool AddReplays();
+  bool AddRecords();
+  void Shutdown(int exit_code);
+  void PrintHelp();
+
+  CLIParameters cli_;
+  std::unique_ptr<Log> log_;
+  const ModuleCenter* mc_ = nullptr;
+  Scheduler* scheduler_ = nullptr;
+  bool started_ = false;
+  std::vector<std::unique_ptr<SourceRecorder>> recorders_;
+  std::vector<std::unique_ptr<SourceReplayer>> replayers_;
+  std::vector<bool> replays_in_real_time_;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_RECORDER_RECORDER_H_
@@ -0,0 +1,128 @@
+#ifndef ZAMT_RECORDER_RECORDING_H_
+#define ZAMT_RECORDER_RECORDING_H_
+
+/// Binary file of the packets a scheduler source submitted.
+/**
+ * The file starts with a header describing the packets of the source,
+ * followed by fixed size records in the order of arrival. A record holds
+ * the timestamp of the packet, its arrival time since the 1st packet, the
+ * packet and its metadata block (both padded to 8 bytes).
+ * Records are only appended, so a recording cut short (e.g. by a crash) is
+ * valid up to its last full record. Fixed records let the reader map the
+ * file to memory and reach any packet directly.
+ * The writer collects the records in large chunks which are written out by
+ * its own thread, so the sink recording a source never waits for the disk.
+ */
+
+#include "zamt/core/Scheduler.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zamt {
+
+struct RecordingHeader {
+  char magic[8];
+  uint32_t packet_size;
+  uint32_t metadata_size;
+};
+
+struct RecordHeader {
+  uint64_t timestamp;   // of the packet (Scheduler::Time)
+  uint64_t arrival_us;  // since the arrival of the 1st packet
+};
+
+class RecordingWriter {
+ public:
+  using Byte = Scheduler::Byte;
+
+  const static char* kMagic;  // 8 bytes, version included
+  const static int kChunkSize = 1 << 20;  // bytes written at once
+
+  /// Size of a record with the padded packet and metadata.
+  static size_t GetRecordSize(int packet_size, int metadata_size);
+
+  RecordingWriter() = default;
+  ~RecordingWriter();
+
+  RecordingWriter(const RecordingWriter&) = delete;
+  RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+  /// Creates the file (truncating it) and starts the writer thread.
+  bool Open(const char* path, int packet_size, int metadata_size);
+
+  /// Copies a packet (and metadata if it has any) into the next record.
+  void Append(Scheduler::Time timestamp, uint64_t arrival_us,
+              const Byte* packet, const Byte* metadata);
+
+  /// Writes out all records and closes the file.
+  /// Returns false if anything could not be written.
+  bool Close();
+
+  int64_t records() const { return records_; }
+
+ private:
+  using Chunk = std::vector<Byte>;
+
+  void HandOverChunk();
+  void RunWriter();
+
+  FILE* file_ = nullptr;
+  int packet_size_ = 0;
+  int metadata_size_ = 0;
+  size_t record_size_ = 0;
+  int64_t records_ = 0;
+  Chunk chunk_;  // being filled
+
+  std::mutex chunks_mtx_;
+  std::condition_variable chunks_cv_;
+  std::deque<Chunk> full_chunks_;
+  std::vector<Chunk> spare_chunks_;
+  bool closing_ = false;
+  bool failed_ = false;
+  std::unique_ptr<std::thread> writer_;
+};
+
+class RecordingReader {
+ public:
+  using Byte = Scheduler::Byte;
+
+  RecordingReader() = default;
+  ~RecordingReader();
+
+  RecordingReader(const RecordingReader&) = delete;
+  RecordingReader& operator=(const RecordingReader&) = delete;
+
+  /// Maps a recording to memory, returns false if it is not a recording.
+  bool Open(const char* path);
+  void Close();
+
+  int packet_size() const { return packet_size_; }
+  int metadata_size() const { return metadata_size_; }
+  int64_t records() const { return records_; }
+
+  const RecordHeader& header(int64_t record) const;
+  const Byte* packet(int64_t record) const;
+  const Byte* metadata(int64_t record) const;  // nullptr if not recorded
+
+ private:
+  const Byte* GetRecord(int64_t record) const;
+
+  const Byte* data_ = nullptr;  // mapped file
+  size_t size_ = 0;
+  int packet_size_ = 0;
+  int metadata_size_ = 0;
+  size_t record_size_ = 0;
+  int64_t records_ = 0;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_RECORDER_RECORDING_H_
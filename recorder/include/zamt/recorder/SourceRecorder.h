@@ -0,0 +1,108 @@
+#ifndef ZAMT_RECORDER_SOURCERECORDER_H_
+#define ZAMT_RECORDER_SOURCERECORDER_H_
+
+/// Records a scheduler source into a file and replays it as a new source.
+/**
+ * The recorder is an in order sink of the source, so the packets are
+ * recorded in the order of submission with their timestamps and metadata.
+ * Arrival times are taken when the packets reach the recorder.
+ * The replayer registers a source with the packet and metadata size of the
+ * recording and submits the recorded packets from its own thread, either
+ * with the recorded gaps between them (dropping packets like a live source
+ * if the queue is full) or as fast as its sinks release the packets.
+ */
+
+#include "zamt/core/Scheduler.h"
+#include "zamt/recorder/Recording.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace zamt {
+
+class SourceRecorder {
+ public:
+  SourceRecorder(Scheduler& scheduler, Scheduler::SourceId source_id);
+  ~SourceRecorder();
+
+  SourceRecorder(const SourceRecorder&) = delete;
+  SourceRecorder& operator=(const SourceRecorder&) = delete;
+
+  /// Creates the file and subscribes to the source on the given pool.
+  bool Start(const char* path,
+             Scheduler::PoolId pool_id = Scheduler::kDefaultPool);
+
+  /// Unsubscribes and writes out the recording.
+  /// Returns false if anything could not be written.
+  bool Stop();
+
+  int64_t recorded() const;
+
+ private:
+  // Shared with the sink callback as pending tasks may outlive a Stop().
+  struct State {
+    std::mutex mtx;
+    bool recording = false;
+    RecordingWriter writer;
+    std::chrono::steady_clock::time_point first_arrival;
+  };
+
+  static void Record(Scheduler* scheduler, Scheduler::SourceHandle source,
+                     State* state, const Scheduler::Byte* packet,
+                     Scheduler::Time timestamp);
+
+  Scheduler& scheduler_;
+  Scheduler::SourceId source_id_;
+  Scheduler::SourceHandle source_;
+  std::shared_ptr<State> state_;
+  int subscription_id_ = -1;
+};
+
+class SourceReplayer {
+ public:
+  const static int kWaitForSinksInMs = 100;  // then checks for stopping
+
+  SourceReplayer(Scheduler& scheduler, Scheduler::SourceId source_id);
+  ~SourceReplayer();
+
+  SourceReplayer(const SourceReplayer&) = delete;
+  SourceReplayer& operator=(const SourceReplayer&) = delete;
+
+  /// Opens the recording and registers the source for its packets.
+  bool Open(const char* path, int packets_in_queue);
+
+  /// Starts submitting the packets with the recorded gaps (real_time) or
+  /// as fast as the sinks take them.
+  void Start(bool real_time);
+
+  /// Stops submitting and waits for the thread of the replay.
+  void Stop();
+
+  /// Waits until all the packets are submitted.
+  void Join();
+
+  Scheduler::SourceHandle source() const { return source_; }
+  int64_t records() const { return reader_.records(); }
+  int64_t replayed() const { return replayed_; }
+  int64_t dropped() const { return dropped_; }
+
+ private:
+  void Replay(bool real_time);
+
+  Scheduler& scheduler_;
+  Scheduler::SourceId source_id_;
+  Scheduler::SourceHandle source_;
+  RecordingReader reader_;
+  std::atomic<bool> should_run_{false};
+  std::atomic<int64_t> replayed_{0};
+  std::atomic<int64_t> dropped_{0};
+  std::unique_ptr<std::thread> replay_;
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_RECORDER_SOURCERECORDER_H_
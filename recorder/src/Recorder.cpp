@@ -0,0 +1,126 @@
+#include "zamt/recorder/Recorder.h"
+
+#include "zamt/core/Core.h"
+#include "zamt/core/Log.h"
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/core/Scheduler.h"
+#include "zamt/recorder/SourceRecorder.h"
+
+namespace zamt {
+
+const char* Recorder::kModuleLabel = "recorder";
+const char* Recorder::kRecordStageType = "record";
+const char* Recorder::kReplayStageType = "replay";
+
+ZAMT_MODULE_DEPENDS(Recorder, Core);
+
+Recorder::Recorder(int argc, const char* const* argv) : cli_(argc, argv) {
+  log_.reset(new Log(kModuleLabel, cli_));
+  if (cli_.HasParam(Core::kHelpParamStr)) {
+    PrintHelp();
+    return;
+  }
+  started_ = true;
+}
+
+Recorder::~Recorder() { Shutdown(0); }
+
+void Recorder::Initialize(const ModuleCenter* mc) {
+  mc_ = mc;
+  if (!started_) return;
+  Core& core = mc_->Get<Core>();
+  scheduler_ = &core.scheduler();
+  if (!AddReplays()) {
+    started_ = false;
+    core.Quit(Core::kExitCodeBadPipeline);
+  }
+}
+
+void Recorder::Connect(const ModuleCenter*) {
+  if (!started_) return;
+  Core& core = mc_->Get<Core>();
+  if (!AddRecords()) {
+    started_ = false;
+    core.Quit(Core::kExitCodeBadPipeline);
+    return;
+  }
+  if (recorders_.empty() && replayers_.empty()) return;
+  core.RegisterForQuitEvent(
+      std::bind(&Recorder::Shutdown, this, std::placeholders::_1));
+}
+
+void Recorder::Start(const ModuleCenter*) {
+  if (!started_) return;
+  for (size_t i = 0; i < replayers_.size(); ++i)
+    replayers_[i]->Start(replays_in_real_time_[i]);
+}
+
+bool Recorder::AddReplays() {
+  const PipelineConfig& pipeline = mc_->Get<Core>().pipeline();
+  for (auto stage : pipeline.GetStages(kReplayStageType)) {
+    const char* file = stage->GetParam("file");
+    Scheduler::SourceId source_id = scheduler_->AllocateSourceId();
+    std::unique_ptr<SourceReplayer> replayer(
+        new SourceReplayer(*scheduler_, source_id));
+    bool real_time = stage->GetNumParam("realtime", 1) != 0;
+    int queue = stage->GetNumParam("queue", kDefaultQueueLength);
+    if (!file || queue < 1 || !replayer->Open(file, queue)) {
+      log_->Message(Log::kError, "Replay ", stage->name, ": cannot open ",
+                    file ? file : "(no file)");
+      return false;
+    }
+    scheduler_->SetSourceName(source_id, stage->name);
+    log_->Message("Replay ", stage->name, ": ", replayer->records(),
+                  " packets from ", file);
+    replayers_.push_back(std::move(replayer));
+    replays_in_real_time_.push_back(real_time);
+  }
+  return true;
+}
+
+bool Recorder::AddRecords() {
+  const PipelineConfig& pipeline = mc_->Get<Core>().pipeline();
+  for (auto stage : pipeline.GetStages(kRecordStageType)) {
+    const char* input = stage->GetParam("input");
+    const char* file = stage->GetParam("file");
+    Scheduler::SourceId source_id;
+    if (!input || !scheduler_->FindSource(input, source_id)) {
+      log_->Message(Log::kError, "Record ", stage->name, ": no input ",
+                    input ? input : "(none)");
+      return false;
+    }
+    std::unique_ptr<SourceRecorder> recorder(
+        new SourceRecorder(*scheduler_, source_id));
+    if (!file || !recorder->Start(file)) {
+      log_->Message(Log::kError, "Record ", stage->name, ": cannot create ",
+                    file ? file : "(no file)");
+      return false;
+    }
+    log_->Message("Record ", stage->name, ": ", input, " into ", file);
+    recorders_.push_back(std::move(recorder));
+  }
+  return true;
+}
+
+void Recorder::Shutdown(int /*exit_code*/) {
+  for (auto& replayer : replayers_) replayer->Stop();
+  for (auto& recorder : recorders_) {
+    int64_t packets = recorder->recorded();
+    if (recorder->Stop()) {
+      log_->Message("Recorded ", packets, " packets.");
+    } else {
+      log_->Message(Log::kError, "Recording failed after ", packets,
+                    " packets!");
+    }
+  }
+  recorders_.clear();
+}
+
+void Recorder::PrintHelp() {
+  Log::Print("ZAMT Recorder of Sources");
+  Log::Print(" Pipeline stages: record Name input=Source file=Path");
+  Log::Print("                  replay Name file=Path realtime=0|1 "
+             "queue=Packets");
+}
+
+}  // namespace zamt
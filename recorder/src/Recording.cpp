@@ -0,0 +1,177 @@
+#include "zamt/recorder/Recording.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zamt {
+
+const char* RecordingWriter::kMagic = "ZAMTREC1";
+
+namespace {
+
+size_t Padded(int size) { return ((size_t)size + 7) & ~(size_t)7; }
+
+}  // namespace
+
+size_t RecordingWriter::GetRecordSize(int packet_size, int metadata_size) {
+  return sizeof(RecordHeader) + Padded(packet_size) + Padded(metadata_size);
+}
+
+RecordingWriter::~RecordingWriter() { Close(); }
+
+bool RecordingWriter::Open(const char* path, int packet_size,
+                           int metadata_size) {
+  assert(!file_ && packet_size > 0 && metadata_size >= 0);
+  file_ = fopen(path, "wb");
+  if (!file_) return false;
+  packet_size_ = packet_size;
+  metadata_size_ = metadata_size;
+  record_size_ = GetRecordSize(packet_size, metadata_size);
+  records_ = 0;
+  closing_ = false;
+  failed_ = false;
+  RecordingHeader header;
+  memcpy(header.magic, kMagic, sizeof(header.magic));
+  header.packet_size = (uint32_t)packet_size;
+  header.metadata_size = (uint32_t)metadata_size;
+  if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  chunk_.reserve((size_t)kChunkSize + record_size_);
+  writer_.reset(new std::thread(&RecordingWriter::RunWriter, this));
+  return true;
+}
+
+void RecordingWriter::Append(Scheduler::Time timestamp, uint64_t arrival_us,
+                             const Byte* packet, const Byte* metadata) {
+  assert(file_);
+  size_t start = chunk_.size();
+  chunk_.resize(start + record_size_, 0);
+  Byte* record = &chunk_[start];
+  RecordHeader header{timestamp, arrival_us};
+  memcpy(record, &header, sizeof(header));
+  record += sizeof(header);
+  memcpy(record, packet, (size_t)packet_size_);
+  if (metadata_size_) {
+    assert(metadata);
+    memcpy(record + Padded(packet_size_), metadata, (size_t)metadata_size_);
+  }
+  ++records_;
+  if (chunk_.size() >= (size_t)kChunkSize) HandOverChunk();
+}
+
+bool RecordingWriter::Close() {
+  if (!file_) return true;
+  if (!chunk_.empty()) HandOverChunk();
+  {
+    std::lock_guard<std::mutex> lock(chunks_mtx_);
+    closing_ = true;
+  }
+  chunks_cv_.notify_one();
+  writer_->join();
+  writer_.reset();
+  bool ok = !failed_;
+  if (fclose(file_) != 0) ok = false;
+  file_ = nullptr;
+  spare_chunks_.clear();
+  return ok;
+}
+
+void RecordingWriter::HandOverChunk() {
+  Chunk next;
+  {
+    std::lock_guard<std::mutex> lock(chunks_mtx_);
+    full_chunks_.push_back(std::move(chunk_));
+    if (!spare_chunks_.empty()) {
+      next = std::move(spare_chunks_.back());
+      spare_chunks_.pop_back();
+    }
+  }
+  chunks_cv_.notify_one();
+  next.clear();
+  next.reserve((size_t)kChunkSize + record_size_);
+  chunk_ = std::move(next);
+}
+
+void RecordingWriter::RunWriter() {
+  std::unique_lock<std::mutex> lock(chunks_mtx_);
+  for (;;) {
+    chunks_cv_.wait(lock, [this] { return closing_ || !full_chunks_.empty(); });
+    if (full_chunks_.empty()) return;  // closing
+    Chunk chunk = std::move(full_chunks_.front());
+    full_chunks_.pop_front();
+    lock.unlock();
+    bool written = fwrite(chunk.data(), 1, chunk.size(), file_) == chunk.size();
+    lock.lock();
+    if (!written) failed_ = true;
+    spare_chunks_.push_back(std::move(chunk));
+  }
+}
+
+RecordingReader::~RecordingReader() { Close(); }
+
+bool RecordingReader::Open(const char* path) {
+  assert(!data_);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat file_stat;
+  bool ok = fstat(fd, &file_stat) == 0 &&
+            (size_t)file_stat.st_size >= sizeof(RecordingHeader);
+  if (ok) {
+    size_ = (size_t)file_stat.st_size;
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ok = data != MAP_FAILED;
+    if (ok) data_ = static_cast<const Byte*>(data);
+  }
+  close(fd);  // the mapping stays
+  if (!ok) return false;
+
+  RecordingHeader header;
+  memcpy(&header, data_, sizeof(header));
+  if (memcmp(header.magic, RecordingWriter::kMagic, sizeof(header.magic)) ||
+      header.packet_size == 0 || header.packet_size > INT32_MAX ||
+      header.metadata_size > INT32_MAX) {
+    Close();
+    return false;
+  }
+  packet_size_ = (int)header.packet_size;
+  metadata_size_ = (int)header.metadata_size;
+  record_size_ = RecordingWriter::GetRecordSize(packet_size_, metadata_size_);
+  records_ = (int64_t)((size_ - sizeof(header)) / record_size_);
+  return true;
+}
+
+void RecordingReader::Close() {
+  if (!data_) return;
+  munmap(const_cast<Byte*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  records_ = 0;
+}
+
+const RecordHeader& RecordingReader::header(int64_t record) const {
+  return *reinterpret_cast<const RecordHeader*>(GetRecord(record));
+}
+
+const RecordingReader::Byte* RecordingReader::packet(int64_t record) const {
+  return GetRecord(record) + sizeof(RecordHeader);
+}
+
+const RecordingReader::Byte* RecordingReader::metadata(int64_t record) const {
+  if (!metadata_size_) return nullptr;
+  return packet(record) + Padded(packet_size_);
+}
+
+const RecordingReader::Byte* RecordingReader::GetRecord(int64_t record) const {
+  assert(data_ && record >= 0 && record < records_);
+  return data_ + sizeof(RecordingHeader) + (size_t)record * record_size_;
+}
+
+}  // namespace zamt
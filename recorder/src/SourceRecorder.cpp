@@ -0,0 +1,140 @@
+#include "zamt/recorder/SourceRecorder.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace zamt {
+
+using clock = std::chrono::steady_clock;
+
+SourceRecorder::SourceRecorder(Scheduler& scheduler,
+                               Scheduler::SourceId source_id)
+    : scheduler_(scheduler),
+      source_id_(source_id),
+      source_(scheduler.GetSourceHandle(source_id)),
+      state_(std::make_shared<State>()) {}
+
+SourceRecorder::~SourceRecorder() { Stop(); }
+
+bool SourceRecorder::Start(const char* path, Scheduler::PoolId pool_id) {
+  assert(subscription_id_ < 0);
+  if (!source_.valid()) return false;
+  {
+    std::lock_guard<std::mutex> lock(state_->mtx);
+    if (!state_->writer.Open(path, scheduler_.GetPacketSize(source_),
+                             scheduler_.GetMetadataSize(source_)))
+      return false;
+    state_->recording = true;
+  }
+  Scheduler* scheduler = &scheduler_;
+  Scheduler::SourceHandle source = source_;
+  std::shared_ptr<State> state = state_;
+  scheduler_.SubscribeInOrder(
+      source_id_,
+      [scheduler, source, state](Scheduler::SourceId,
+                                 const Scheduler::Byte* packet,
+                                 Scheduler::Time timestamp) {
+        Record(scheduler, source, state.get(), packet, timestamp);
+      },
+      subscription_id_, pool_id);
+  return true;
+}
+
+bool SourceRecorder::Stop() {
+  if (subscription_id_ < 0) return true;
+  scheduler_.Unsubscribe(source_id_, subscription_id_);
+  subscription_id_ = -1;
+  std::lock_guard<std::mutex> lock(state_->mtx);
+  state_->recording = false;
+  return state_->writer.Close();
+}
+
+int64_t SourceRecorder::recorded() const {
+  std::lock_guard<std::mutex> lock(state_->mtx);
+  return state_->writer.records();
+}
+
+void SourceRecorder::Record(Scheduler* scheduler,
+                            Scheduler::SourceHandle source, State* state,
+                            const Scheduler::Byte* packet,
+                            Scheduler::Time timestamp) {
+  {
+    std::lock_guard<std::mutex> lock(state->mtx);
+    if (state->recording) {
+      clock::time_point now = clock::now();
+      if (state->writer.records() == 0) state->first_arrival = now;
+      auto arrival_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            now - state->first_arrival)
+                            .count();
+      const Scheduler::Byte* metadata =
+          scheduler->GetMetadataSize(source)
+              ? scheduler->GetPacketMetadata(source, packet)
+              : nullptr;
+      state->writer.Append(timestamp, (uint64_t)arrival_us, packet, metadata);
+    }
+  }
+  scheduler->ReleasePacket(source, packet);
+}
+
+SourceReplayer::SourceReplayer(Scheduler& scheduler,
+                               Scheduler::SourceId source_id)
+    : scheduler_(scheduler), source_id_(source_id) {}
+
+SourceReplayer::~SourceReplayer() { Stop(); }
+
+bool SourceReplayer::Open(const char* path, int packets_in_queue) {
+  assert(!source_.valid());
+  if (!reader_.Open(path)) return false;
+  source_ = scheduler_.RegisterSource(source_id_, reader_.packet_size(),
+                                      packets_in_queue,
+                                      reader_.metadata_size());
+  return source_.valid();
+}
+
+void SourceReplayer::Start(bool real_time) {
+  assert(source_.valid() && !replay_);
+  should_run_ = true;
+  replay_.reset(new std::thread(&SourceReplayer::Replay, this, real_time));
+}
+
+void SourceReplayer::Stop() {
+  should_run_ = false;
+  Join();
+}
+
+void SourceReplayer::Join() {
+  if (!replay_) return;
+  replay_->join();
+  replay_.reset();
+}
+
+void SourceReplayer::Replay(bool real_time) {
+  clock::time_point start = clock::now();
+  for (int64_t i = 0; i < reader_.records() && should_run_; ++i) {
+    const RecordHeader& header = reader_.header(i);
+    Scheduler::Byte* packet;
+    if (real_time) {
+      std::this_thread::sleep_until(
+          start + std::chrono::microseconds(header.arrival_us));
+      packet = scheduler_.GetPacketForSubmission(source_);
+      if (!packet) {
+        dropped_++;
+        continue;
+      }
+    } else {
+      while (!(packet = scheduler_.WaitForPacketForSubmission(
+                   source_, kWaitForSinksInMs))) {
+        if (!should_run_) return;
+      }
+    }
+    memcpy(packet, reader_.packet(i), (size_t)reader_.packet_size());
+    if (reader_.metadata_size()) {
+      memcpy(scheduler_.GetPacketMetadata(source_, packet),
+             reader_.metadata(i), (size_t)reader_.metadata_size());
+    }
+    scheduler_.SubmitPacket(source_, packet, header.timestamp);
+    replayed_++;
+  }
+}
+
+}  // namespace zamt
@@ -0,0 +1,109 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/recorder/Recording.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+using namespace zamt;
+
+static const char* kPath = "RecordingTest.rec";
+
+void FillPacket(uint8_t* packet, int size, int num) {
+  for (int i = 0; i < size; ++i) packet[i] = (uint8_t)(num + i);
+}
+
+void RecordsAreReadBack() {
+  const int packet_size = 5;
+  const int records = 3;
+  RecordingWriter writer;
+  ASSERT(writer.Open(kPath, packet_size, sizeof(double)));
+  for (int i = 0; i < records; ++i) {
+    uint8_t packet[packet_size];
+    FillPacket(packet, packet_size, i);
+    double metadata = i * 0.5;
+    writer.Append((Scheduler::Time)i * 1000, (uint64_t)i * 10, packet,
+                  reinterpret_cast<const uint8_t*>(&metadata));
+  }
+  EXPECT(writer.records() == records);
+  ASSERT(writer.Close());
+
+  RecordingReader reader;
+  ASSERT(reader.Open(kPath));
+  EXPECT(reader.packet_size() == packet_size);
+  EXPECT(reader.metadata_size() == sizeof(double));
+  ASSERT(reader.records() == records);
+  for (int i = 0; i < records; ++i) {
+    EXPECT(reader.header(i).timestamp == (uint64_t)i * 1000);
+    EXPECT(reader.header(i).arrival_us == (uint64_t)i * 10);
+    uint8_t packet[packet_size];
+    FillPacket(packet, packet_size, i);
+    EXPECT(memcmp(reader.packet(i), packet, packet_size) == 0);
+    EXPECT(*reinterpret_cast<const double*>(reader.metadata(i)) == i * 0.5);
+  }
+  reader.Close();
+  remove(kPath);
+}
+
+void ChunksAreWrittenInOrder() {
+  // Several chunks are handed over to the writer thread.
+  const int packet_size = 1000;
+  const int records = 3 * RecordingWriter::kChunkSize / packet_size;
+  RecordingWriter writer;
+  ASSERT(writer.Open(kPath, packet_size, 0));
+  uint8_t packet[packet_size];
+  for (int i = 0; i < records; ++i) {
+    FillPacket(packet, packet_size, i);
+    writer.Append((Scheduler::Time)i, 0, packet, nullptr);
+  }
+  ASSERT(writer.Close());
+
+  RecordingReader reader;
+  ASSERT(reader.Open(kPath));
+  ASSERT(reader.records() == records);
+  EXPECT(reader.metadata(0) == nullptr);
+  for (int i = 0; i < records; ++i) {
+    FillPacket(packet, packet_size, i);
+    EXPECT(reader.header(i).timestamp == (uint64_t)i);
+    EXPECT(memcmp(reader.packet(i), packet, packet_size) == 0);
+  }
+  reader.Close();
+  remove(kPath);
+}
+
+void CutRecordingIsValidUpToLastRecord() {
+  RecordingWriter writer;
+  ASSERT(writer.Open(kPath, 16, 0));
+  uint8_t packet[16] = {};
+  for (int i = 0; i < 4; ++i) writer.Append(0, 0, packet, nullptr);
+  ASSERT(writer.Close());
+  size_t size =
+      sizeof(RecordingHeader) + 4 * RecordingWriter::GetRecordSize(16, 0);
+  ASSERT(truncate(kPath, (off_t)size - 1) == 0);
+
+  RecordingReader reader;
+  ASSERT(reader.Open(kPath));
+  EXPECT(reader.records() == 3);
+  reader.Close();
+  remove(kPath);
+}
+
+void OnlyRecordingsAreOpened() {
+  RecordingReader reader;
+  EXPECT(!reader.Open("NoSuchRecording.rec"));
+  FILE* file = fopen(kPath, "wb");
+  ASSERT(file);
+  fputs("This is not a recording at all.", file);
+  fclose(file);
+  EXPECT(!reader.Open(kPath));
+  remove(kPath);
+}
+
+TEST_BEGIN() {
+  RecordsAreReadBack();
+  ChunksAreWrittenInOrder();
+  CutRecordingIsValidUpToLastRecord();
+  OnlyRecordingsAreOpened();
+}
+TEST_END()
@@ -0,0 +1,77 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/recorder/SourceRecorder.h"
+
+#include <cstdio>
+
+using namespace zamt;
+
+static const char* kPath = "SourceRecorderTest.rec";
+static const int kPackets = 20;
+
+struct Metadata {
+  int num;
+};
+
+static std::atomic<int> packets_arrived;
+
+void CheckReplayed(Scheduler* sch, Scheduler::SourceId source_id,
+                   const Scheduler::Byte* packet, Scheduler::Time timestamp) {
+  int num = (int)packet[0];
+  EXPECT(packet[15] == (uint8_t)(num + 15));
+  EXPECT(timestamp == (Scheduler::Time)num * 1000);
+  auto metadata = reinterpret_cast<const Metadata*>(
+      sch->GetPacketMetadata(source_id, packet));
+  EXPECT(metadata->num == num);
+  packets_arrived++;
+  sch->ReleasePacket(source_id, packet);
+}
+
+void Record(Scheduler& sch) {
+  sch.RegisterSource(1, 16, 4, sizeof(Metadata));
+  SourceRecorder recorder(sch, 1);
+  ASSERT(recorder.Start(kPath));
+  for (int i = 0; i < kPackets; ++i) {
+    uint8_t* p;
+    while (!(p = sch.WaitForPacketForSubmission(1, 1000)))
+      std::this_thread::yield();
+    for (int j = 0; j < 16; ++j) p[j] = (uint8_t)(i + j);
+    reinterpret_cast<Metadata*>(sch.GetPacketMetadata(1, p))->num = i;
+    sch.SubmitPacket(1, p, (Scheduler::Time)i * 1000);
+  }
+  while (recorder.recorded() != kPackets) std::this_thread::yield();
+  ASSERT(recorder.Stop());
+}
+
+void Replay(Scheduler& sch, Scheduler::SourceId source_id, bool real_time) {
+  packets_arrived = 0;
+  SourceReplayer replayer(sch, source_id);
+  ASSERT(replayer.Open(kPath, 2));
+  ASSERT(replayer.records() == kPackets);
+  EXPECT(sch.GetPacketSize(source_id) == 16);
+  EXPECT(sch.GetMetadataSize(source_id) == sizeof(Metadata));
+  int subscription_id;
+  sch.Subscribe(source_id,
+                std::bind(&CheckReplayed, &sch, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                false, subscription_id);
+  replayer.Start(real_time);
+  replayer.Join();
+  int64_t submitted = replayer.replayed();
+  EXPECT(submitted + replayer.dropped() == kPackets);
+  if (!real_time) EXPECT(submitted == kPackets);
+  while (packets_arrived != submitted) std::this_thread::yield();
+}
+
+void ReplayGivesBackTheRecordedPackets() {
+  Scheduler sch(2);
+  Record(sch);
+  Replay(sch, 2, false);
+  Replay(sch, 3, true);
+  sch.Shutdown();
+  remove(kPath);
+}
+
+TEST_BEGIN() {
+  ReplayGivesBackTheRecordedPackets();
+}
+TEST_END()
@@ -0,0 +1,16 @@
+set(this_module recorder)
+
+
+set(other_modules
+  core
+)
+
+set(test_cpps
+  RecordingTest.cpp
+)
+AddTest(RecordingTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  SourceRecorderTest.cpp
+)
+AddTest(SourceRecorderTest ${this_module} "${other_modules}" "${test_cpps}")
@@ -8,9 +8,32 @@ set(modules
   liveaudio_pulse
   vis_gtk
   dft_fftw
+  recorder
+  featurestore
+  nn_infer
+  pitch_yin
 )
 AddExe(zamtdemo "${modules}")
 
+set(modules
+  core
+  liveaudio_alsa
+  vis_gtk
+  dft_fftw
+  recorder
+  featurestore
+  nn_infer
+  pitch_yin
+)
+AddExe(zamtdemo_alsa "${modules}")
+
+set(modules
+  core
+  featurestore
+  batch
+)
+AddExe(zamtbatch "${modules}")
+
 # and what/where is zamt_modules?
 AddAllTests("${zamt_modules}")
 
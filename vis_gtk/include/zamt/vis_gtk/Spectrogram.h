@@ -0,0 +1,89 @@
+#ifndef ZAMT_VIS_GTK_SPECTROGRAM_H_
+#define ZAMT_VIS_GTK_SPECTROGRAM_H_
+
+/// Scrolling spectrogram window for spectral sources.
+/**
+ * The producer adds one column of power values per frame: it is converted to
+ * decibels, reduced to at most kWindowHeight rows (the loudest bin of each
+ * row), mapped through a colormap table to pixels and put into a queue of
+ * pending columns without waiting. The rendering thread copies the
+ * pending columns into a persistent image ring (one pixel column each) and
+ * draws the ring with two blits at the scroll offset, so the cost of a frame
+ * does not depend on the history shown.
+ * Columns can be added from one thread at a time.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <cairomm/context.h>
+#include <cairomm/surface.h>
+
+namespace zamt {
+
+class ModuleCenter;
+
+class Spectrogram {
+ public:
+  const static int kColormapSize = 256;
+  const static int kMaxPendingColumns = 128;
+  const static int kWindowHeight = 480;
+
+  /// Opens a window showing the last history columns of bins values,
+  /// levels from min_db to max_db are mapped to the colors.
+  Spectrogram(const ModuleCenter* mc, const char* title, int bins, int history,
+              float min_db = -96.0f, float max_db = 0.0f);
+  ~Spectrogram();
+
+  /// Adds a column of bins power values (squared magnitudes).
+  /// The column is dropped if the rendering thread is too far behind.
+  void AddColumn(const float* power);
+
+  /// Number of columns dropped so far.
+  int64_t dropped_columns() const {
+    return dropped_columns_.load(std::memory_order_relaxed);
+  }
+
+  /// Converts count power values to decibels with a polynomial logarithm,
+  /// accurate to 0.01 dB.
+  static void PowerToDecibel(const float* power, int count, float* decibel);
+
+  /// Splits count values into rows (at most count) ranges of about the same
+  /// length and stores the maximum of each, values and maxima may be the
+  /// same array.
+  static void MaxPerRow(const float* values, int count, float* maxima,
+                        int rows);
+
+  /// Pixel (RGB24) of level in [0, 1] on the colormap.
+  static uint32_t ColormapPixel(float level);
+
+ private:
+  void Draw(const Cairo::RefPtr<Cairo::Context>& cctx, int width, int height);
+
+  const ModuleCenter* mc_;
+  int window_id_;
+  int bins_;
+  int rows_;  // of pixels, bins are merged above kWindowHeight
+  int history_;
+  float min_db_;
+  float max_db_;
+  uint32_t colormap_[kColormapSize];
+
+  // Producer side.
+  std::vector<float> decibel_;
+  std::atomic<int64_t> dropped_columns_{0};
+
+  // Pending pixel columns, lowest row first.
+  std::vector<uint32_t> pending_;
+  std::atomic<int64_t> columns_added_{0};
+  std::atomic<int64_t> columns_drawn_{0};
+
+  // Owned by the rendering thread.
+  Cairo::RefPtr<Cairo::ImageSurface> ring_;
+  int ring_column_ = 0;  // the next one to fill, also the oldest one shown
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_VIS_GTK_SPECTROGRAM_H_
@@ -0,0 +1,63 @@
+#ifndef ZAMT_VIS_GTK_TRIPLEBUFFER_H_
+#define ZAMT_VIS_GTK_TRIPLEBUFFER_H_
+
+/// Wait-free handover of the latest state from a producer to the renderer.
+/**
+ * The producer (e.g. an audio thread) fills the write buffer and publishes
+ * it, the renderer picks up the latest published buffer at frame rate.
+ * Three buffers are rotated with one atomic exchange on each side, so
+ * neither side ever waits for the other and no data is copied twice.
+ * Publications between two frames overwrite each other, only the latest
+ * is read. One producer and one consumer thread can use it.
+ */
+
+#include <atomic>
+
+namespace zamt {
+
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  /// Producer: the buffer to fill, it keeps the contents of 2 publishes ago.
+  T& write_buffer() { return buffers_[write_]; }
+
+  /// Producer: hands over the write buffer and gets a new one.
+  void Publish() {
+    write_ = middle_.exchange(write_ | kFresh, std::memory_order_acq_rel) &
+             kIndexMask;
+  }
+
+  /// Consumer: returns if something was published since the last Update().
+  bool HasNew() const {
+    return (middle_.load(std::memory_order_acquire) & kFresh) != 0;
+  }
+
+  /// Consumer: takes the latest publication if there is a new one.
+  /// Returns if read_buffer() changed.
+  bool Update() {
+    if (!HasNew()) return false;
+    read_ = middle_.exchange(read_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  /// Consumer: the latest publication taken by Update().
+  const T& read_buffer() const { return buffers_[read_]; }
+  T& read_buffer() { return buffers_[read_]; }
+
+ private:
+  const static int kIndexMask = 3;
+  const static int kFresh = 4;
+
+  T buffers_[3];
+  int write_ = 0;  // owned by the producer
+  int read_ = 2;   // owned by the consumer
+  std::atomic<int> middle_{1};
+};
+
+}  // namespace zamt
+
+#endif  // ZAMT_VIS_GTK_TRIPLEBUFFER_H_
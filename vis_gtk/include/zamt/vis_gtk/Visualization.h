@@ -8,6 +8,17 @@
  * Visualization takes care of Gtk::Application and Gtk::Window creation.
  * One can schedule rendering on the next frame by asking for a callback to the
  * given rendering code on the rendering thread.
+ * Queries mark their window dirty and wake up the main loop with an event.
+ * A dirty window follows the frame clock of the display and draws at most
+ * once per display frame (and at most at the given frame rate) until no new
+ * query arrives. Idle windows are not polled at all.
+ * In headless mode there is no display: windows are image surfaces, frames
+ * are rendered at the given rate (or as fast as queried with -fps0) and can
+ * be saved as PNG files. Render times are logged for every window when it is
+ * closed, so visualizers can be benchmarked without a display.
+ * The rendering thread is the UI thread of the scheduler: its main loop is
+ * woken up by the scheduler's UI task event and runs the waiting UI tasks
+ * in batches, so drawing is not starved by a flood of them.
  *
  * Leak checkers like address sanitizer can show static allocations as leaks
  * coming from libglib.so (1 alloc) and libfontconfig.so (several alloc)
@@ -16,13 +27,21 @@
 
 #include "zamt/core/CLIParameters.h"
 #include "zamt/core/Module.h"
+#include "zamt/vis_gtk/TripleBuffer.h"
 
 #include <atomic>
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <memory>
 #include <thread>
 
+#include <chrono>
+
+#include <cairomm/surface.h>
+#include <gdkmm/frameclock.h>
+#include <glibmm/dispatcher.h>
+#include <glibmm/main.h>
 #include <gtkmm/application.h>
 #include <gtkmm/drawingarea.h>
 #include <gtkmm/window.h>
@@ -30,13 +49,17 @@
 namespace zamt {
 
 class Log;
+class Scheduler;
 
 class Visualization : public Module {
  public:
   const static char* kModuleLabel;
   const static char* kGTKApplicationID;
   const static char* kActivationsPerSecondParamStr;
+  const static char* kHeadlessParamStr;
+  const static char* kDumpFramesParamStr;
   const static int kActivationsPerSecond = 25;
+  const static int kUITasksPerWakeUp = 16;  // then the loop can draw
 
   /// This callback is run on rendering thread giving it the context for
   /// drawing and the current width and height of the window (0,0 is top-left).
@@ -48,6 +71,12 @@ class Visualization : public Module {
   void Initialize(const ModuleCenter* mc);
   void Shutdown(int exit_code);
 
+  /// Target frame rate, 0 if rendering is not throttled.
+  int activations_per_second() const { return activations_per_second_; }
+
+  /// Rendering goes to image surfaces instead of a display.
+  bool headless() const { return headless_; }
+
   /// Open a new window with the given attributes and return its id.
   void OpenWindow(const char* window_title, int width, int height,
                   int& window_id);
@@ -58,26 +87,58 @@ class Visualization : public Module {
   /// Ask for a callback from the rendering thread on the next frame.
   /// There can be only one query in the queue for one window. A second query
   /// removes the previous one if the previous render have not started yet.
+  /// It never waits for the rendering thread, only the first query after a
+  /// frame wakes it up. Queries for one window should come from one thread.
   void QueryRender(int window_id, RenderCallback render_callback);
 
  private:
+  struct RenderStats {
+    int64_t frames = 0;
+    int64_t sum_render_us = 0;
+    int64_t max_render_us = 0;
+  };
+
   struct Window {
     bool IsEmpty() { return !window_title_; }
-    bool IsInitialized() { return (bool)canvas_; }
+    bool IsInitialized() { return canvas_ || surface_; }
     void OpenWindow(Glib::RefPtr<Gtk::Application>& application);
     void CloseWindow(Glib::RefPtr<Gtk::Application>& application);
+    void OpenOffscreen();
+    void CloseOffscreen();
     bool OnDraw(const Cairo::RefPtr<Cairo::Context>& cr);
+    bool OnTick(const Glib::RefPtr<Gdk::FrameClock>& frame_clock);
+    // Runs the latest queried callback if there is one, returns if it did.
+    bool Render(const Cairo::RefPtr<Cairo::Context>& cr, int width,
+                int height);
     const char* window_title_ = nullptr;
     int width_;
     int height_;
     std::unique_ptr<Gtk::Window> window_;
     std::unique_ptr<Gtk::DrawingArea> canvas_;
-    RenderCallback queried_callback_;
-    std::atomic_flag callback_mutex_ = ATOMIC_FLAG_INIT;
+    Cairo::RefPtr<Cairo::ImageSurface> surface_;  // in headless mode
+    TripleBuffer<RenderCallback> queried_callback_;
+    // Set by the query thread when it wakes up the main loop, cleared by the
+    // main loop when it stops following the frame clock.
+    std::atomic<bool> dirty_{false};
+    unsigned int tick_id_ = 0;  // 0 if the frame clock is not followed
+    int64_t frame_period_us_ = 0;
+    int64_t last_frame_us_ = 0;
+    RenderStats stats_;
   };
 
-  bool OnTimeout();
+  // Opens and closes windows, starts following the frame clock for dirty
+  // ones, runs on the main loop when woken up.
+  void OnWindowEvent();
+  void WakeUpMainLoop();
+  // Runs the UI tasks of the scheduler on the main loop when signaled.
+  bool OnUITasks(Glib::IOCondition condition);
   void RunMainLoop();
+  void RunHeadlessLoop();
+  // Waits in the headless loop, running the UI tasks meanwhile.
+  void RunUITasksUntil(std::chrono::steady_clock::time_point deadline);
+  // Returns if a frame was rendered.
+  bool RenderOffscreen(int window_id);
+  void LogRenderStats(int window_id, const RenderStats& stats);
   void PrintHelp();
 
   static std::atomic<bool> shutdown_initiated_;
@@ -87,7 +148,14 @@ class Visualization : public Module {
   std::unique_ptr<Log> log_;
   std::unique_ptr<std::thread> visualization_loop_;
   int activations_per_second_;
+  bool headless_ = false;
+  const char* dump_frames_dir_ = nullptr;
   Glib::RefPtr<Gtk::Application> application_;
+  std::unique_ptr<Glib::Dispatcher> window_event_;
+  std::atomic<bool> window_event_ready_{false};
+  // Set in Initialize(), the UI tasks of the scheduler are run from then on.
+  std::atomic<Scheduler*> scheduler_{nullptr};
+  sigc::connection UI_tasks_watch_;
   std::deque<Window> windows_;
   std::atomic_flag windows_mutex_ = ATOMIC_FLAG_INIT;
 };
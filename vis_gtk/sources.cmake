@@ -1,4 +1,5 @@
 set(module_cpps
+  Spectrogram.cpp
   Visualization.cpp
 )
 
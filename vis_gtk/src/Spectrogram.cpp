@@ -0,0 +1,174 @@
+#include "zamt/vis_gtk/Spectrogram.h"
+
+#include "zamt/core/ModuleCenter.h"
+#include "zamt/vis_gtk/Visualization.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+
+namespace zamt {
+
+namespace {
+
+// Smallest power shown, keeps the logarithm finite.
+const float kMinPower = 1e-20f;
+
+// Colormap control points from silent to loud: black, blue, red, yellow,
+// white, equally spaced.
+const int kColormapStops = 5;
+const float kColormapRGB[kColormapStops][3] = {{0.0f, 0.0f, 0.0f},
+                                               {0.1f, 0.0f, 0.6f},
+                                               {0.9f, 0.1f, 0.2f},
+                                               {1.0f, 0.9f, 0.0f},
+                                               {1.0f, 1.0f, 1.0f}};
+
+}  // namespace
+
+Spectrogram::Spectrogram(const ModuleCenter* mc, const char* title, int bins,
+                         int history, float min_db, float max_db)
+    : mc_(mc),
+      bins_(bins),
+      rows_(std::min(bins, (int)kWindowHeight)),
+      history_(history),
+      min_db_(min_db),
+      max_db_(max_db),
+      decibel_((size_t)bins),
+      pending_((size_t)(rows_ * kMaxPendingColumns)) {
+  assert(mc_ && bins_ > 0 && history_ > 0 && max_db_ > min_db_);
+  for (int i = 0; i < kColormapSize; ++i)
+    colormap_[i] = ColormapPixel((float)i / (kColormapSize - 1));
+  Visualization& vis = mc_->Get<Visualization>();
+  vis.OpenWindow(title, history_, kWindowHeight, window_id_);
+}
+
+Spectrogram::~Spectrogram() {
+  assert(mc_);
+  Visualization& vis = mc_->Get<Visualization>();
+  vis.CloseWindow(window_id_);
+}
+
+void Spectrogram::AddColumn(const float* power) {
+  int64_t added = columns_added_.load(std::memory_order_relaxed);
+  if (added - columns_drawn_.load(std::memory_order_acquire) >=
+      kMaxPendingColumns) {
+    dropped_columns_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  PowerToDecibel(power, bins_, decibel_.data());
+  if (rows_ < bins_) MaxPerRow(decibel_.data(), bins_, decibel_.data(), rows_);
+  float coef = (kColormapSize - 1) / (max_db_ - min_db_);
+  uint32_t* column =
+      &pending_[(size_t)((added % kMaxPendingColumns) * rows_)];
+  for (int row = 0; row < rows_; ++row) {
+    float index = (decibel_[(size_t)row] - min_db_) * coef;
+    index = std::min(std::max(index, 0.0f), (float)(kColormapSize - 1));
+    column[row] = colormap_[(int)index];
+  }
+  columns_added_.store(added + 1, std::memory_order_release);
+
+  Visualization& vis = mc_->Get<Visualization>();
+  vis.QueryRender(window_id_,
+                  std::bind(&Spectrogram::Draw, this, std::placeholders::_1,
+                            std::placeholders::_2, std::placeholders::_3));
+}
+
+void Spectrogram::PowerToDecibel(const float* power, int count,
+                                 float* decibel) {
+  // 10 * log10(x) = 10 * log10(2) * log2(x), log2(x) = exponent + log2(m)
+  // where m is in [1, 2). log2(m) comes from the series of
+  // 2 * atanh(t) / ln(2) with t = (m - 1) / (m + 1) in [0, 1/3].
+  // No branches, so the loop is vectorized.
+  const float kDecibelPerOctave = 3.01029996f;
+  const float kInvLn2x2 = 2.88539008f;
+  for (int i = 0; i < count; ++i) {
+    float x = std::max(power[i], kMinPower);
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    float exponent = (float)((int)(bits >> 23) - 127);
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    float t = (m - 1.0f) / (m + 1.0f);
+    float t2 = t * t;
+    float log2_m =
+        kInvLn2x2 * t * (1.0f + t2 * (1.0f / 3 + t2 * (0.2f + t2 / 7)));
+    decibel[i] = kDecibelPerOctave * (exponent + log2_m);
+  }
+}
+
+void Spectrogram::MaxPerRow(const float* values, int count, float* maxima,
+                            int rows) {
+  assert(rows > 0 && rows <= count);
+  // a row never starts before its index, so maxima can be values
+  int begin = 0;
+  for (int row = 0; row < rows; ++row) {
+    int end = (int)((int64_t)(row + 1) * count / rows);
+    float maximum = values[begin];
+    for (int i = begin + 1; i < end; ++i)
+      maximum = std::max(maximum, values[i]);
+    maxima[row] = maximum;
+    begin = end;
+  }
+}
+
+uint32_t Spectrogram::ColormapPixel(float level) {
+  level = std::min(std::max(level, 0.0f), 1.0f);
+  float position = level * (kColormapStops - 1);
+  int stop = std::min((int)position, kColormapStops - 2);
+  float ratio = position - (float)stop;
+  uint32_t pixel = 0;
+  for (int c = 0; c < 3; ++c) {
+    float value = kColormapRGB[stop][c] +
+                  (kColormapRGB[stop + 1][c] - kColormapRGB[stop][c]) * ratio;
+    pixel = (pixel << 8) | (uint32_t)(value * 255.0f + 0.5f);
+  }
+  return pixel;
+}
+
+void Spectrogram::Draw(const Cairo::RefPtr<Cairo::Context>& cctx, int width,
+                       int height) {
+  if (!ring_) {
+    ring_ = Cairo::ImageSurface::create(Cairo::FORMAT_RGB24, history_, rows_);
+    ring_->flush();
+    memset(ring_->get_data(), 0,
+           (size_t)(ring_->get_stride() * ring_->get_height()));
+  }
+
+  // move the pending columns to the ring, high frequencies on top
+  int64_t drawn = columns_drawn_.load(std::memory_order_relaxed);
+  int64_t added = columns_added_.load(std::memory_order_acquire);
+  if (added != drawn) {
+    ring_->flush();
+    unsigned char* data = ring_->get_data();
+    int stride = ring_->get_stride();
+    for (; drawn < added; ++drawn) {
+      const uint32_t* column =
+          &pending_[(size_t)((drawn % kMaxPendingColumns) * rows_)];
+      unsigned char* pixel =
+          data + (rows_ - 1) * stride + ring_column_ * (int)sizeof(uint32_t);
+      for (int row = 0; row < rows_; ++row, pixel -= stride)
+        memcpy(pixel, &column[row], sizeof(uint32_t));
+      if (++ring_column_ >= history_) ring_column_ = 0;
+    }
+    ring_->mark_dirty();
+    columns_drawn_.store(added, std::memory_order_release);
+  }
+
+  // oldest columns (from ring_column_) on the left, newest on the right
+  cctx->save();
+  cctx->scale((double)width / history_, (double)height / rows_);
+  int older = history_ - ring_column_;
+  cctx->set_source(ring_, -ring_column_, 0);
+  cctx->rectangle(0, 0, older, rows_);
+  cctx->fill();
+  if (ring_column_) {
+    cctx->set_source(ring_, older, 0);
+    cctx->rectangle(older, 0, ring_column_, rows_);
+    cctx->fill();
+  }
+  cctx->restore();
+}
+
+}  // namespace zamt
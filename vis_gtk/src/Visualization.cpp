@@ -3,17 +3,34 @@
 #include "zamt/core/Core.h"
 #include "zamt/core/Log.h"
 #include "zamt/core/ModuleCenter.h"
+#include "zamt/core/Scheduler.h"
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
 
-#include <glibmm/main.h>
+#include <poll.h>
 
 namespace zamt {
 
 const char* Visualization::kModuleLabel = "vis_gtk";
 const char* Visualization::kGTKApplicationID = "hu.lib.zamt";
 const char* Visualization::kActivationsPerSecondParamStr = "-fps";
+const char* Visualization::kHeadlessParamStr = "-nogui";
+const char* Visualization::kDumpFramesParamStr = "-dumpframes";
+
+ZAMT_MODULE_DEPENDS(Visualization, Core);
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+int64_t MicrosecondsSince(clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() -
+                                                               start)
+      .count();
+}
+}  // namespace
 
 Visualization::Visualization(int argc, const char* const* argv)
     : cli_(argc, argv) {
@@ -25,6 +42,12 @@ Visualization::Visualization(int argc, const char* const* argv)
   int fps = cli_.GetNumParam(kActivationsPerSecondParamStr);
   activations_per_second_ =
       (fps == CLIParameters::kNotFound) ? kActivationsPerSecond : fps;
+  headless_ = cli_.HasParam(kHeadlessParamStr);
+  dump_frames_dir_ = cli_.GetParam(kDumpFramesParamStr);
+  if (activations_per_second_ < 0 ||
+      (activations_per_second_ == 0 && !headless_)) {
+    activations_per_second_ = kActivationsPerSecond;
+  }
   log_->LogMessage("Starting...");
   visualization_loop_.reset(new std::thread(&Visualization::RunMainLoop, this));
 }
@@ -40,11 +63,15 @@ void Visualization::Initialize(const ModuleCenter* mc) {
   Core& core = mc_->Get<Core>();
   core.RegisterForQuitEvent(
       std::bind(&Visualization::Shutdown, this, std::placeholders::_1));
+  if (!visualization_loop_) return;
+  scheduler_ = &core.scheduler();
+  WakeUpMainLoop();  // to watch the UI tasks
 }
 
 void Visualization::Shutdown(int /*exit_code*/) {
   shutdown_initiated_ = true;
   log_->LogMessage("Stopping...");
+  WakeUpMainLoop();
 }
 
 void Visualization::OpenWindow(const char* window_title, int width, int height,
@@ -64,6 +91,7 @@ void Visualization::OpenWindow(const char* window_title, int width, int height,
   assert(!windows_[id].IsEmpty() && !windows_[id].IsInitialized());
   window_id = (int)id;
   windows_mutex_.clear(std::memory_order_release);
+  WakeUpMainLoop();
 }
 
 void Visualization::CloseWindow(int window_id) {
@@ -75,16 +103,26 @@ void Visualization::CloseWindow(int window_id) {
   windows_[id].window_title_ = nullptr;
   assert(windows_[id].IsEmpty() && windows_[id].IsInitialized());
   windows_mutex_.clear(std::memory_order_release);
+  WakeUpMainLoop();
 }
 
 void Visualization::QueryRender(int window_id, RenderCallback render_callback) {
   assert(render_callback);
   size_t id = (size_t)window_id;
   assert(id < windows_.size() && !windows_[id].IsEmpty());
-  while (windows_[id].callback_mutex_.test_and_set(std::memory_order_acquire))
-    ;
-  windows_[id].queried_callback_ = render_callback;
-  windows_[id].callback_mutex_.clear(std::memory_order_release);
+  Window& win = windows_[id];
+  win.queried_callback_.write_buffer() = render_callback;
+  win.queried_callback_.Publish();
+  if (!win.dirty_.exchange(true)) WakeUpMainLoop();
+}
+
+void Visualization::WakeUpMainLoop() {
+  if (window_event_ready_) window_event_->emit();
+}
+
+bool Visualization::OnUITasks(Glib::IOCondition /*condition*/) {
+  scheduler_.load()->DoUITasks(kUITasksPerWakeUp);
+  return true;
 }
 
 void Visualization::Window::OpenWindow(
@@ -108,24 +146,65 @@ void Visualization::Window::CloseWindow(
   window_->unset_application();
   window_.reset(nullptr);
   canvas_.reset(nullptr);
-  queried_callback_ = nullptr;
+  tick_id_ = 0;  // removed with the canvas
+  dirty_ = false;
+  queried_callback_.Update();
+  queried_callback_.read_buffer() = nullptr;
+}
+
+void Visualization::Window::OpenOffscreen() {
+  assert(window_title_ && width_ && height_ && !surface_);
+  surface_ = Cairo::ImageSurface::create(Cairo::FORMAT_RGB24, width_, height_);
+  stats_ = RenderStats();
+}
+
+void Visualization::Window::CloseOffscreen() {
+  assert(surface_);
+  surface_ = Cairo::RefPtr<Cairo::ImageSurface>();
+  queried_callback_.Update();
+  queried_callback_.read_buffer() = nullptr;
 }
 
 bool Visualization::Window::OnDraw(const Cairo::RefPtr<Cairo::Context>& cr) {
-  if (shutdown_initiated_ || !window_ || !canvas_ || !queried_callback_)
-    return true;
-  while (callback_mutex_.test_and_set(std::memory_order_acquire))
-    ;
-  RenderCallback callback = queried_callback_;
-  queried_callback_ = nullptr;
-  callback_mutex_.clear(std::memory_order_release);
-  int width = canvas_->get_allocated_width();
-  int height = canvas_->get_allocated_height();
+  if (shutdown_initiated_ || !window_ || !canvas_) return true;
+  Render(cr, canvas_->get_allocated_width(), canvas_->get_allocated_height());
+  return true;
+}
+
+bool Visualization::Window::OnTick(
+    const Glib::RefPtr<Gdk::FrameClock>& frame_clock) {
+  if (!queried_callback_.HasNew()) {
+    // Nothing new since the last frame, stop following the frame clock.
+    // A query arriving meanwhile either sees the flag cleared and wakes up
+    // the main loop again or is noticed here.
+    dirty_ = false;
+    if (!queried_callback_.HasNew() || dirty_.exchange(true)) {
+      tick_id_ = 0;
+      return false;
+    }
+  }
+  int64_t frame_time_us = frame_clock->get_frame_time();
+  if (frame_time_us - last_frame_us_ < frame_period_us_) return true;
+  last_frame_us_ = frame_time_us;
+  canvas_->queue_draw();
+  return true;
+}
+
+bool Visualization::Window::Render(const Cairo::RefPtr<Cairo::Context>& cr,
+                                   int width, int height) {
+  if (!queried_callback_.Update()) return false;
+  const RenderCallback& callback = queried_callback_.read_buffer();
+  if (!callback) return false;
+  clock::time_point start = clock::now();
   callback(cr, width, height);
+  int64_t render_us = MicrosecondsSince(start);
+  stats_.frames++;
+  stats_.sum_render_us += render_us;
+  if (render_us > stats_.max_render_us) stats_.max_render_us = render_us;
   return true;
 }
 
-bool Visualization::OnTimeout() {
+void Visualization::OnWindowEvent() {
   if (shutdown_initiated_) {
     assert(application_);
     application_->quit();
@@ -133,36 +212,55 @@ bool Visualization::OnTimeout() {
       if (!windows_[id].IsEmpty() && windows_[id].IsInitialized())
         CloseWindow((int)id);
     }
+    UI_tasks_watch_.disconnect();
+  } else if (!UI_tasks_watch_.connected() && scheduler_.load() &&
+             scheduler_.load()->GetUITaskEventFd() >= 0) {
+    UI_tasks_watch_ = Glib::signal_io().connect(
+        sigc::mem_fun(this, &Visualization::OnUITasks),
+        scheduler_.load()->GetUITaskEventFd(), Glib::IO_IN);
   }
   for (size_t id = 0; id < windows_.size(); ++id) {
     Window& win = windows_[id];
     while (windows_mutex_.test_and_set(std::memory_order_acquire))
       ;
     if (win.IsEmpty() && win.IsInitialized()) {
+      LogRenderStats((int)id, win.stats_);
       win.CloseWindow(application_);
       assert(win.IsEmpty() && !win.IsInitialized());
     }
     if (!win.IsEmpty() && !win.IsInitialized()) {
+      win.stats_ = RenderStats();
+      win.frame_period_us_ = 1000000 / activations_per_second_;
       win.OpenWindow(application_);
       assert(!win.IsEmpty() && win.IsInitialized());
     }
-    if (win.IsInitialized() && win.queried_callback_) {
-      win.canvas_->queue_draw();
+    if (win.IsInitialized() && win.dirty_ && !win.tick_id_) {
+      win.tick_id_ = win.canvas_->add_tick_callback(
+          sigc::mem_fun(&win, &Visualization::Window::OnTick));
     }
     windows_mutex_.clear(std::memory_order_release);
   }
-  return !shutdown_initiated_;
 }
 
 void Visualization::RunMainLoop() {
+  if (headless_) {
+    RunHeadlessLoop();
+    return;
+  }
   log_->LogMessage("Visualization mainloop starting up...");
   // int argc = cli_.argc();
   // char** argv = (char**)cli_.argv();
   application_ = Gtk::Application::create(Glib::ustring(kGTKApplicationID));
-  log_->LogMessage("Setting mainloop timer to ", activations_per_second_,
-                   " fps");
-  Glib::signal_timeout().connect(sigc::mem_fun(this, &Visualization::OnTimeout),
-                                 1000 / (unsigned)activations_per_second_);
+  log_->LogMessage("Limiting frame rate to ", activations_per_second_, " fps");
+  // the dispatcher delivers to the main loop of the thread creating it
+  window_event_.reset(new Glib::Dispatcher());
+  window_event_->connect(sigc::mem_fun(this, &Visualization::OnWindowEvent));
+  window_event_ready_ = true;
+  // catch up with the events before the dispatcher was ready
+  Glib::signal_idle().connect([this]() {
+    OnWindowEvent();
+    return false;
+  });
   Gtk::Window about_window;
   about_window.add_label("\n   ZAMT is running...   \n", false,
                          Gtk::ALIGN_CENTER, Gtk::ALIGN_CENTER);
@@ -171,11 +269,98 @@ void Visualization::RunMainLoop() {
   log_->LogMessage("Visualization mainloop stopping...");
 }
 
+void Visualization::RunHeadlessLoop() {
+  log_->LogMessage("Headless rendering loop starting up...");
+  if (activations_per_second_) {
+    log_->LogMessage("Rendering at ", activations_per_second_, " fps");
+  } else {
+    log_->LogMessage("Rendering is not throttled");
+  }
+  clock::time_point next_frame = clock::now();
+  bool stopping = false;
+  while (!stopping) {
+    stopping = shutdown_initiated_;
+    bool rendered = false;
+    for (size_t id = 0; id < windows_.size(); ++id) {
+      Window& win = windows_[id];
+      while (windows_mutex_.test_and_set(std::memory_order_acquire))
+        ;
+      if (stopping && !win.IsEmpty() && win.IsInitialized())
+        win.window_title_ = nullptr;
+      if (win.IsEmpty() && win.IsInitialized()) {
+        LogRenderStats((int)id, win.stats_);
+        win.CloseOffscreen();
+        assert(win.IsEmpty() && !win.IsInitialized());
+      }
+      if (!win.IsEmpty() && !win.IsInitialized()) {
+        win.OpenOffscreen();
+        assert(!win.IsEmpty() && win.IsInitialized());
+      }
+      windows_mutex_.clear(std::memory_order_release);
+      // the window is only closed on this thread
+      if (win.IsInitialized() && RenderOffscreen((int)id)) rendered = true;
+    }
+    if (activations_per_second_) {
+      next_frame +=
+          std::chrono::microseconds(1000000 / activations_per_second_);
+      clock::time_point now = clock::now();
+      if (next_frame < now) next_frame = now;  // do not catch up
+      RunUITasksUntil(next_frame);
+    } else if (!rendered) {
+      RunUITasksUntil(clock::now() + std::chrono::milliseconds(1));
+    }
+  }
+  log_->LogMessage("Headless rendering loop stopping...");
+}
+
+void Visualization::RunUITasksUntil(clock::time_point deadline) {
+  Scheduler* scheduler = scheduler_.load();
+  if (!scheduler || scheduler->GetUITaskEventFd() < 0) {
+    std::this_thread::sleep_until(deadline);
+    return;
+  }
+  pollfd UI_tasks{scheduler->GetUITaskEventFd(), POLLIN, 0};
+  for (;;) {
+    auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       deadline - clock::now())
+                       .count();
+    if (timeout <= 0) return;
+    if (poll(&UI_tasks, 1, (int)timeout) == 1)
+      scheduler->DoUITasks(kUITasksPerWakeUp);
+  }
+}
+
+bool Visualization::RenderOffscreen(int window_id) {
+  Window& win = windows_[(size_t)window_id];
+  Cairo::RefPtr<Cairo::Context> cr = Cairo::Context::create(win.surface_);
+  if (!win.Render(cr, win.width_, win.height_)) return false;
+  if (dump_frames_dir_) {
+    win.surface_->flush();
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/window%d_%06lld.png", dump_frames_dir_,
+             window_id, (long long)win.stats_.frames);
+    win.surface_->write_to_png(path);
+  }
+  return true;
+}
+
+void Visualization::LogRenderStats(int window_id, const RenderStats& stats) {
+  if (!stats.frames) return;
+  log_->Message("Window ", window_id, " rendered ", stats.frames,
+                " frames, avg ", stats.sum_render_us / stats.frames,
+                " us, max ", stats.max_render_us, " us");
+}
+
 void Visualization::PrintHelp() {
   Log::Print("ZAMT Visualization Module using GTK");
   Log::Print(
-      " -fpsNum        Sets target rendering FPS to Num per seconds instead "
+      " -fpsNum        Limits rendering FPS to Num per seconds instead "
       "of the default 25.");
+  Log::Print(
+      " -nogui         Renders to memory without a display, -fps0 renders "
+      "every query.");
+  Log::Print(" -dumpframesDir Saves the frames rendered in headless mode "
+             "as PNG files in Dir.");
 }
 
 std::atomic<bool> Visualization::shutdown_initiated_(false);
@@ -0,0 +1,73 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/vis_gtk/Spectrogram.h"
+
+#include <cmath>
+#include <cstdint>
+
+using namespace zamt;
+
+static const int values = 1000;
+
+void DecibelsAreAccurate() {
+  float power[values];
+  float decibel[values];
+  // from -200 dB to +20 dB
+  for (int i = 0; i < values; ++i)
+    power[i] = (float)std::pow(10.0, -20.0 + 22.0 * i / values);
+  Spectrogram::PowerToDecibel(power, values, decibel);
+  double max_error = 0.0;
+  for (int i = 0; i < values; ++i) {
+    double error = std::fabs(decibel[i] - 10.0 * std::log10(power[i]));
+    if (error > max_error) max_error = error;
+  }
+  EXPECT(max_error < 0.01);
+}
+
+void SilenceIsFinite() {
+  float power[2] = {0.0f, -1.0f};
+  float decibel[2];
+  Spectrogram::PowerToDecibel(power, 2, decibel);
+  EXPECT(std::isfinite(decibel[0]) && decibel[0] < -190.0f);
+  EXPECT(decibel[1] == decibel[0]);
+}
+
+void RowsKeepTheLoudestBin() {
+  float bins[7] = {1.0f, 5.0f, 2.0f, 0.0f, 3.0f, -1.0f, 4.0f};
+  float rows[3];
+  // rows of bins 0-1, 2-3 and 4-6
+  Spectrogram::MaxPerRow(bins, 7, rows, 3);
+  EXPECT(rows[0] == 5.0f && rows[1] == 2.0f && rows[2] == 4.0f);
+  Spectrogram::MaxPerRow(bins, 7, bins, 7);
+  EXPECT(bins[1] == 5.0f && bins[5] == -1.0f);
+  Spectrogram::MaxPerRow(bins, 7, bins, 1);
+  EXPECT(bins[0] == 5.0f);
+}
+
+int Brightness(uint32_t pixel) {
+  return (int)((pixel >> 16) & 0xff) + (int)((pixel >> 8) & 0xff) +
+         (int)(pixel & 0xff);
+}
+
+void ColormapGoesFromBlackToWhite() {
+  EXPECT(Spectrogram::ColormapPixel(0.0f) == 0x000000u);
+  EXPECT(Spectrogram::ColormapPixel(1.0f) == 0xffffffu);
+  EXPECT(Spectrogram::ColormapPixel(-1.0f) == 0x000000u);
+  EXPECT(Spectrogram::ColormapPixel(2.0f) == 0xffffffu);
+  int last = -1;
+  int darker = 0;
+  for (int i = 0; i < Spectrogram::kColormapSize; ++i) {
+    float level = (float)i / (Spectrogram::kColormapSize - 1);
+    int brightness = Brightness(Spectrogram::ColormapPixel(level));
+    if (brightness < last) darker++;
+    last = brightness;
+  }
+  EXPECT(darker == 0);
+}
+
+TEST_BEGIN() {
+  DecibelsAreAccurate();
+  SilenceIsFinite();
+  RowsKeepTheLoudestBin();
+  ColormapGoesFromBlackToWhite();
+}
+TEST_END()
@@ -0,0 +1,92 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/vis_gtk/TripleBuffer.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace zamt;
+
+void NothingNewAtStart() {
+  TripleBuffer<int> tb;
+  EXPECT(!tb.HasNew());
+  EXPECT(!tb.Update());
+}
+
+void LatestPublicationWins() {
+  TripleBuffer<int> tb;
+  tb.write_buffer() = 1;
+  tb.Publish();
+  tb.write_buffer() = 2;
+  tb.Publish();
+  EXPECT(tb.HasNew());
+  ASSERT(tb.Update());
+  EXPECT(tb.read_buffer() == 2);
+  EXPECT(!tb.HasNew());
+  EXPECT(!tb.Update());
+  EXPECT(tb.read_buffer() == 2);
+  tb.write_buffer() = 3;
+  tb.Publish();
+  ASSERT(tb.Update());
+  EXPECT(tb.read_buffer() == 3);
+}
+
+void ReaderKeepsItsBuffer() {
+  TripleBuffer<int> tb;
+  tb.write_buffer() = 1;
+  tb.Publish();
+  ASSERT(tb.Update());
+  // the producer never gets the buffer being read
+  for (int i = 2; i < 10; ++i) {
+    EXPECT(&tb.write_buffer() != &tb.read_buffer());
+    tb.write_buffer() = i;
+    tb.Publish();
+    EXPECT(tb.read_buffer() == 1);
+  }
+}
+
+struct Snapshot {
+  static const int kSize = 256;
+  long values[kSize];
+};
+
+static const long publications = 200000;
+
+void SnapshotsAreConsistentBetweenThreads() {
+  TripleBuffer<Snapshot> tb;
+  std::atomic<bool> done(false);
+  std::thread producer([&tb, &done]() {
+    for (long seq = 1; seq <= publications; ++seq) {
+      Snapshot& snapshot = tb.write_buffer();
+      for (int i = 0; i < Snapshot::kSize; ++i) snapshot.values[i] = seq;
+      tb.Publish();
+    }
+    done = true;
+  });
+  long last_seq = 0;
+  int torn = 0;
+  int backwards = 0;
+  while (last_seq != publications) {
+    if (!tb.Update()) {
+      if (done && !tb.HasNew()) break;
+      continue;
+    }
+    const Snapshot& snapshot = tb.read_buffer();
+    long seq = snapshot.values[0];
+    for (int i = 1; i < Snapshot::kSize; ++i)
+      if (snapshot.values[i] != seq) torn++;
+    if (seq <= last_seq) backwards++;
+    last_seq = seq;
+  }
+  producer.join();
+  EXPECT(torn == 0);
+  EXPECT(backwards == 0);
+  EXPECT(last_seq == publications);
+}
+
+TEST_BEGIN() {
+  NothingNewAtStart();
+  LatestPublicationWins();
+  ReaderKeepsItsBuffer();
+  SnapshotsAreConsistentBetweenThreads();
+}
+TEST_END()
@@ -0,0 +1,50 @@
+#include "zamt/core/TestSuite.h"
+#include "zamt/vis_gtk/Visualization.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace zamt;
+
+static const int width = 320;
+static const int height = 200;
+
+static std::atomic<int> frames(0);
+static std::atomic<bool> size_ok(true);
+
+void Render(const Cairo::RefPtr<Cairo::Context>& cctx, int w, int h) {
+  if (w != width || h != height) size_ok = false;
+  cctx->set_source_rgb(1.0, 0.0, 0.0);
+  cctx->paint();
+  frames++;
+}
+
+bool WaitForFrames(int expected) {
+  for (int i = 0; i < 1000 && frames < expected; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return frames == expected;
+}
+
+void RendersQueriesWithoutDisplay() {
+  const char* argv[] = {"test", "-nogui", "-fps0"};
+  Visualization vis(3, argv);
+  EXPECT(vis.headless());
+  EXPECT(vis.activations_per_second() == 0);
+  int window_id;
+  vis.OpenWindow("test", width, height, window_id);
+  vis.QueryRender(window_id, Render);
+  EXPECT(WaitForFrames(1));
+  // no new query, no new frame
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT(frames == 1);
+  vis.QueryRender(window_id, Render);
+  EXPECT(WaitForFrames(2));
+  EXPECT(size_ok);
+  vis.Shutdown(0);
+}
+
+TEST_BEGIN() {
+  RendersQueriesWithoutDisplay();
+}
+TEST_END()
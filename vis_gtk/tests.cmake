@@ -2,9 +2,21 @@ set(this_module vis_gtk)
 
 
 set(other_modules
+  core
 )
 
 set(test_cpps
+  TripleBufferTest.cpp
 )
-#AddTest(SomeTest ${this_module} "${other_modules}" "${test_cpps}")
+AddTest(TripleBufferTest ${this_module} "${other_modules}" "${test_cpps}")
 
+
+set(test_cpps
+  SpectrogramTest.cpp
+)
+AddTest(SpectrogramTest ${this_module} "${other_modules}" "${test_cpps}")
+
+set(test_cpps
+  VisualizationTest.cpp
+)
+AddTest(VisualizationTest ${this_module} "${other_modules}" "${test_cpps}")